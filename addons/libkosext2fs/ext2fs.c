@@ -17,6 +17,7 @@
 #include "block.h"
 #include "ext2fs.h"
 #include "directory.h"
+#include "journal.h"
 #include "ext2internal.h"
 
 static int initted = 0;
@@ -61,16 +62,41 @@ uint8_t *ext2_block_read(ext2_fs_t *fs, uint32_t bl, int *err) {
     if(i < 0) {
         i = 0;
 
-        /* Make sure that if the block is dirty, we write it back out. */
+        /* Make sure that if the block is dirty, we write it back out. If we
+           have a journal, metadata has to go through it instead. */
         if(cache[0]->flags & EXT2_CACHE_FLAG_DIRTY) {
-            if(ext2_block_write_nc(fs, cache[0]->block, cache[0]->data)) {
+            int flags = cache[0]->flags;
+            int rv;
+
+            cache[0]->flags = 0;
+
+            if(!fs->journal)
+                rv = ext2_block_write_nc(fs, cache[0]->block, cache[0]->data);
+            else if(flags & EXT2_CACHE_FLAG_DATA)
+                rv = ext2_journal_write_data(fs, cache[0]->block,
+                                             cache[0]->data);
+            else
+                rv = ext2_journal_evict(fs, cache[0]->block, cache[0]->data);
+
+            if(rv) {
                 /* XXXX: Uh oh... */
+                cache[0]->flags = flags;
                 *err = EIO;
                 return NULL;
             }
         }
     }
 
+    /* If the block was evicted before, but hasn't been committed yet, the copy
+       in the journal is the one we want. */
+    if(ext2_journal_lookup(fs, bl, cache[i]->data, 1)) {
+        cache[i]->block = bl;
+        cache[i]->flags = EXT2_CACHE_FLAG_VALID | EXT2_CACHE_FLAG_DIRTY;
+        rv = cache[i]->data;
+        make_mru(fs, cache, i);
+        goto out;
+    }
+
     /* Try to read the block in question. */
     if(ext2_block_read_nc(fs, bl, cache[i]->data)) {
         *err = EIO;
@@ -98,6 +124,9 @@ int ext2_block_read_nc(ext2_fs_t *fs, uint32_t block_num, uint8_t *rv) {
     if(fs->sb.s_blocks_count <= block_num)
         return -EINVAL;
 
+    if(ext2_journal_lookup(fs, block_num, rv, 0))
+        return 0;
+
     if(fs->dev->read_blocks(fs->dev, block_num << fs_per_block,
                             1 << fs_per_block, rv))
         return -EIO;
@@ -132,6 +161,22 @@ int ext2_block_mark_dirty(ext2_fs_t *fs, uint32_t block_num) {
     for(i = fs->cache_size - 1; i >= 0; --i) {
         if(cache[i]->block == block_num && cache[i]->flags) {
             cache[i]->flags |= EXT2_CACHE_FLAG_DIRTY;
+            cache[i]->flags &= ~EXT2_CACHE_FLAG_DATA;
+            make_mru(fs, cache, i);
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+
+int ext2_block_mark_dirty_data(ext2_fs_t *fs, uint32_t block_num) {
+    int i;
+    ext2_cache_t **cache = fs->bcache;
+
+    for(i = fs->cache_size - 1; i >= 0; --i) {
+        if(cache[i]->block == block_num && cache[i]->flags) {
+            cache[i]->flags |= EXT2_CACHE_FLAG_DIRTY | EXT2_CACHE_FLAG_DATA;
             make_mru(fs, cache, i);
             return 0;
         }
@@ -148,12 +193,16 @@ int ext2_block_cache_wb(ext2_fs_t *fs) {
     if(!(fs->mnt_flags & EXT2FS_MNT_FLAG_RW))
         return 0;
 
+    /* With a journal, everything has to go out as part of a transaction. */
+    if(fs->journal)
+        return ext2_journal_commit(fs);
+
     for(i = fs->cache_size - 1; i >= 0; --i) {
         if(cache[i]->flags & EXT2_CACHE_FLAG_DIRTY) {
             if((err = ext2_block_write_nc(fs, cache[i]->block, cache[i]->data)))
                 return err;
 
-            cache[i]->flags &= ~EXT2_CACHE_FLAG_DIRTY;
+            cache[i]->flags &= ~(EXT2_CACHE_FLAG_DIRTY | EXT2_CACHE_FLAG_DATA);
         }
     }
     
@@ -297,6 +346,7 @@ ext2_fs_t *ext2_fs_init_ex(kos_blockdev_t *bd, uint32_t flags, int cache_sz) {
     }
 
     rv->dev = bd;
+    rv->journal = NULL;
     rv->mnt_flags = flags & EXT2FS_MNT_VALID_FLAGS_MASK;
 
     if(rv->mnt_flags != flags) {
@@ -431,10 +481,18 @@ ext2_fs_t *ext2_fs_init_ex(kos_blockdev_t *bd, uint32_t flags, int cache_sz) {
 
     rv->cache_size = cache_sz;
 
+    /* If the filesystem has a journal, replay anything that's left in it and
+       get it ready to use. */
+    if(ext2_journal_init(rv)) {
+        dbglog(DBG_ERROR, "ext2_fs_init: Error opening the journal\n");
+        j = cache_sz;
+        goto out_bcache;
+    }
+
     return rv;
 
 out_bcache:
-    for(; j >= 0; --j) {
+    while(j--) {
         free(rv->bcache[j]->data);
     }
 
@@ -476,7 +534,9 @@ int ext2_fs_sync(ext2_fs_t *fs) {
         frv = -1;
     }
 
-    if((fs->flags & EXT2_FS_FLAG_SB_DIRTY)) {
+    /* The journal takes care of the superblock and block group descriptors
+       along with everything else. */
+    if((fs->flags & EXT2_FS_FLAG_SB_DIRTY) && !fs->journal) {
         /* Write the main superblock and the block group descriptors. */
         if((rv = ext2_write_superblock(fs, 0))) {
             dbglog(DBG_ERROR, "ext2_fs_sync: Error writing back the main "
@@ -495,6 +555,12 @@ int ext2_fs_sync(ext2_fs_t *fs) {
         }
     }
 
+    /* Finally, make sure the block device doesn't have anything cached. */
+    if(fs->dev->flush && fs->dev->flush(fs->dev)) {
+        dbglog(DBG_ERROR, "ext2_fs_sync: Error flushing the block device.\n");
+        frv = -1;
+    }
+
     return frv;
 }
 
@@ -503,6 +569,7 @@ void ext2_fs_shutdown(ext2_fs_t *fs) {
 
     /* Sync the filesystem back to the block device, if needed. */
     ext2_fs_sync(fs);
+    ext2_journal_shutdown(fs);
 
     for(i = 0; i < fs->cache_size; ++i) {
         free(fs->bcache[i]->data);
@@ -50,6 +50,20 @@ __BEGIN_DECLS
 */
 #define EXT2_CACHE_BLOCKS       32
 
+/* Maximum number of blocks that will be gathered up into a single request to
+   the block device when writing to the journal (or checkpointing from it). On
+   filesystems with a journal, this many blocks worth of memory is allocated
+   for each mounted filesystem. Larger values mean fewer, larger writes to the
+   block device. */
+#define EXT2_JOURNAL_BATCH_BLOCKS   16
+
+/* Number of dirty metadata blocks that may be evicted from the block cache and
+   held by the journal before a commit is requested. The commit itself happens
+   at the end of the current filesystem operation, so this is a soft limit, but
+   it bounds how much memory the journal uses in between commits (up to this
+   many filesystem blocks, plus a little bookkeeping). */
+#define EXT2_JOURNAL_PENDING_BLOCKS 64
+
 /* End tunable filesystem parameters. */
 
 /* Convenience stuff, for in case you want to use this outside of KOS. */
@@ -65,6 +79,7 @@ typedef struct kos_blockdev {
     int (*write_blocks)(struct kos_blockdev *d, uint32_t block, size_t count,
                         const void *buf);
     uint32_t (*count_blocks)(struct kos_blockdev *d);
+    int (*flush)(struct kos_blockdev *d);
 } kos_blockdev_t;
 
 #ifndef SYMLOOP_MAX
@@ -104,6 +119,12 @@ int ext2_block_write_nc(ext2_fs_t *fs, uint32_t block_num, const uint8_t *blk);
 
 int ext2_block_mark_dirty(ext2_fs_t *fs, uint32_t block_num);
 
+/* Mark a block as dirty, and as containing file data rather than metadata. On a
+   journaled filesystem, data blocks are not written to the journal, but are
+   written in place before any of the metadata that refers to them is
+   committed. */
+int ext2_block_mark_dirty_data(ext2_fs_t *fs, uint32_t block_num);
+
 /* Write-back all dirty blocks from the filesystem's cache. You probably want to
    call the corresponding inode function before this one. */
 int ext2_block_cache_wb(ext2_fs_t *fs);
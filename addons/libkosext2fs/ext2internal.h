@@ -6,6 +6,7 @@
 
 #include "block.h"
 #include "superblock.h"
+#include "journal.h"
 
 #ifndef EXT2_NOT_IN_KOS
 #include <kos/blockdev.h>
@@ -18,6 +19,7 @@
 
 #define EXT2_CACHE_FLAG_VALID   1
 #define EXT2_CACHE_FLAG_DIRTY   2
+#define EXT2_CACHE_FLAG_DATA    4
 
 typedef struct ext2_cache {
     uint32_t flags;
@@ -38,6 +40,8 @@ struct ext2fs_struct {
 
     uint32_t flags;
     uint32_t mnt_flags;
+
+    ext2_journal_t *journal;
 };
 
 /* The superblock and/or block descriptors need to be written to the block
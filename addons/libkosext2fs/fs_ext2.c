@@ -22,6 +22,7 @@
 #include "ext2fs.h"
 #include "inode.h"
 #include "directory.h"
+#include "journal.h"
 
 #ifdef __STRICT_ANSI__
 /* These don't necessarily get prototyped in string.h in standard-compliant mode
@@ -54,6 +55,17 @@ static struct {
     fs_ext2_fs_t *fs;
 } fh[MAX_EXT2_FILES];
 
+/* Called with the mutex held at the end of anything that changes the
+   filesystem, when it is consistent again. If the journal wants a commit, this
+   is where it happens. */
+static void op_done(ext2_fs_t *fs) {
+    int rv;
+
+    if((rv = ext2_journal_op_done(fs)))
+        dbglog(DBG_ERROR, "fs_ext2: Error committing the journal: %s\n",
+               strerror(-rv));
+}
+
 static int create_empty_file(fs_ext2_fs_t *fs, const char *fn,
                              ext2_inode_t **rinode, uint32_t *rinode_num) {
     int irv;
@@ -221,6 +233,7 @@ created:
     fh[fd].ptr = 0;
     fh[fd].fs = mnt;
 
+    op_done(mnt->fs);
     mutex_unlock(&ext2_mutex);
 
     return (void *)(fd + 1);
@@ -233,6 +246,7 @@ static int fs_ext2_close(void *h) {
 
     if(fd < MAX_EXT2_FILES && fh[fd].mode) {
         ext2_inode_put(fh[fd].inode);
+        op_done(fh[fd].fs->fs);
         fh[fd].inode_num = 0;
         fh[fd].mode = 0;
     }
@@ -384,7 +398,7 @@ static ssize_t fs_ext2_write(void *h, const void *buf, size_t cnt) {
             }
 
             memset(block + (sz & (bs - 1)), 0, fh[fd].ptr - sz);
-            ext2_block_mark_dirty(fs, bn);
+            ext2_block_mark_dirty_data(fs, bn);
         }
         /* Nope, we need to allocate a new one... */
         else {
@@ -398,7 +412,7 @@ static ssize_t fs_ext2_write(void *h, const void *buf, size_t cnt) {
                 }
 
                 memset(block + (sz & (bs - 1)), 0, bs - (sz & (bs - 1)));
-                ext2_block_mark_dirty(fs, bn);
+                ext2_block_mark_dirty_data(fs, bn);
                 sz &= (bs - 1);
                 sz += bs;
             }
@@ -406,11 +420,12 @@ static ssize_t fs_ext2_write(void *h, const void *buf, size_t cnt) {
             /* The size should now be nicely at a block boundary... */
             while(sz < fh[fd].ptr) {
                 if(!(block = ext2_inode_alloc_block(fs, fh[fd].inode,
-                                                    sz >> lbs, &errno))) {
+                                                    sz >> lbs, &bn, &errno))) {
                     mutex_unlock(&ext2_mutex);
                     return -1;
                 }
 
+                ext2_block_mark_dirty_data(fs, bn);
                 sz += bs;
             }
         }
@@ -439,7 +454,7 @@ static ssize_t fs_ext2_write(void *h, const void *buf, size_t cnt) {
             cnt = 0;
         }
 
-        ext2_block_mark_dirty(fs, bn);
+        ext2_block_mark_dirty_data(fs, bn);
     }
 
     /* While we still have more to write, do it. */
@@ -453,14 +468,14 @@ static ssize_t fs_ext2_write(void *h, const void *buf, size_t cnt) {
             }
 
             if(!(block = ext2_inode_alloc_block(fs, fh[fd].inode,
-                                                fh[fd].ptr >> lbs, &errno))) {
+                                                fh[fd].ptr >> lbs, &bn,
+                                                &errno))) {
                 mutex_unlock(&ext2_mutex);
                 return -1;
             }
         }
-        else {
-            ext2_block_mark_dirty(fs, bn);
-        }
+
+        ext2_block_mark_dirty_data(fs, bn);
 
         if(cnt > bs) {
             memcpy(block, bbuf, bs);
@@ -482,6 +497,7 @@ static ssize_t fs_ext2_write(void *h, const void *buf, size_t cnt) {
     fh[fd].inode->i_mtime = time(NULL);
     ext2_inode_mark_dirty(fh[fd].inode);
 
+    op_done(fs);
     mutex_unlock(&ext2_mutex);
     return rv;
 }
@@ -940,6 +956,7 @@ static int fs_ext2_rename(vfs_handler_t *vfs, const char *fn1,
     free(cp);
     ext2_inode_put(pinode);
     ext2_inode_put(inode);
+    op_done(fs->fs);
     mutex_lock(&ext2_mutex);
     return irv;
 }
@@ -1076,6 +1093,7 @@ static int fs_ext2_unlink(vfs_handler_t *vfs, const char *fn) {
     }
 
     /* And, we're done. Unlock the mutex. */
+    op_done(fs->fs);
     mutex_unlock(&ext2_mutex);
     return 0;
 }
@@ -1184,6 +1202,7 @@ static int fs_ext2_mkdir(vfs_handler_t *vfs, const char *fn) {
 
     ext2_inode_put(ninode);
     ext2_inode_put(inode);
+    op_done(fs->fs);
     mutex_unlock(&ext2_mutex);
     free(cp);
     return 0;
@@ -1321,6 +1340,7 @@ static int fs_ext2_rmdir(vfs_handler_t *vfs, const char *fn) {
     ext2_inode_put(pinode);
 
     /* And, we're done. Unlock the mutex. */
+    op_done(fs->fs);
     mutex_unlock(&ext2_mutex);
     return 0;
 }
@@ -1478,6 +1498,7 @@ static int fs_ext2_link(vfs_handler_t *vfs, const char *path1,
 
     ext2_inode_put(pinode);
     ext2_inode_put(inode);
+    op_done(fs->fs);
     mutex_unlock(&ext2_mutex);
     return 0;
 }
@@ -1601,7 +1622,8 @@ static int fs_ext2_symlink(vfs_handler_t *vfs, const char *path1,
 
         while(len) {
             if(!(block = ext2_inode_alloc_block(fs->fs, inode,
-                                                inode->i_size >> lbs, &rv))) {
+                                                inode->i_size >> lbs, NULL,
+                                                &rv))) {
                 ext2_inode_put(pinode);
                 ext2_inode_deref(fs->fs, inode_num, 1);
                 free(cp);
@@ -1643,6 +1665,7 @@ static int fs_ext2_symlink(vfs_handler_t *vfs, const char *path1,
 
     ext2_inode_put(pinode);
     ext2_inode_put(inode);
+    op_done(fs->fs);
     mutex_unlock(&ext2_mutex);
     return 0;
 }
@@ -549,8 +549,9 @@ int ext2_inode_free_all(ext2_fs_t *fs, ext2_inode_t *inode,
     struct int_inode *iinode = (struct int_inode *)inode;
     ext2_xattr_hdr_t *xattr;
 
-    /* Do a write-back on the block cache... */
-    if((rv = ext2_block_cache_wb(fs)))
+    /* Do a write-back on the block cache... With a journal, this would commit
+       half of the operation, so leave it for ext2_journal_op_done(). */
+    if(!fs->journal && (rv = ext2_block_cache_wb(fs)))
         return rv;
 
     if(for_del) {
@@ -702,7 +703,8 @@ static uint8_t *alloc_direct_blk(ext2_fs_t *fs, struct int_inode *inode,
 }
 
 static uint8_t *alloc_ind_blk(ext2_fs_t *fs, struct int_inode *inode,
-                              uint32_t bg, uint32_t *rbn, int *err) {
+                              uint32_t bg, uint32_t *rbn, uint32_t *dbn,
+                              int *err) {
     uint8_t *buf;
     uint32_t *buf32;
     uint32_t bn, bn2;
@@ -719,6 +721,8 @@ static uint8_t *alloc_ind_blk(ext2_fs_t *fs, struct int_inode *inode,
         return NULL;
     }
 
+    *dbn = bn2;
+
     buf32[0] = bn2;
     *rbn = bn;
     inode->inode.i_blocks += 2 << fs->sb.s_log_block_size;
@@ -728,7 +732,8 @@ static uint8_t *alloc_ind_blk(ext2_fs_t *fs, struct int_inode *inode,
 }
 
 static uint8_t *alloc_dind_blk(ext2_fs_t *fs, struct int_inode *inode,
-                               uint32_t bg, uint32_t *rbn, int *err) {
+                               uint32_t bg, uint32_t *rbn, uint32_t *dbn,
+                               int *err) {
     uint8_t *buf;
     uint32_t *buf32;
     uint32_t bn, bn2;
@@ -740,7 +745,7 @@ static uint8_t *alloc_dind_blk(ext2_fs_t *fs, struct int_inode *inode,
     buf32 = (uint32_t *)buf;
 
     /* Allocate the indirect and direct blocks and update the inode */
-    if(!(buf = alloc_ind_blk(fs, inode, bg, &bn2, err))) {
+    if(!(buf = alloc_ind_blk(fs, inode, bg, &bn2, dbn, err))) {
         mark_block_free(fs, bn);
         return NULL;
     }
@@ -754,7 +759,8 @@ static uint8_t *alloc_dind_blk(ext2_fs_t *fs, struct int_inode *inode,
 }
 
 static uint8_t *alloc_tind_blk(ext2_fs_t *fs, struct int_inode *inode,
-                               uint32_t bg, uint32_t *rbn, int *err) {
+                               uint32_t bg, uint32_t *rbn, uint32_t *dbn,
+                               int *err) {
     uint8_t *buf;
     uint32_t *buf32;
     uint32_t bn, bn2;
@@ -767,7 +773,7 @@ static uint8_t *alloc_tind_blk(ext2_fs_t *fs, struct int_inode *inode,
 
     /* Allocate the double indirect, indirect, and direct blocks and update the
        inode */
-    if(!(buf = alloc_dind_blk(fs, inode, bg, &bn2, err))) {
+    if(!(buf = alloc_dind_blk(fs, inode, bg, &bn2, dbn, err))) {
         mark_block_free(fs, bn);
         return NULL;
     }
@@ -781,11 +787,11 @@ static uint8_t *alloc_tind_blk(ext2_fs_t *fs, struct int_inode *inode,
 }
 
 uint8_t *ext2_inode_alloc_block(ext2_fs_t *fs, ext2_inode_t *inode,
-                                uint32_t blocks, int *err) {
+                                uint32_t blocks, uint32_t *r_block, int *err) {
     struct int_inode *iinode = (struct int_inode *)inode;
     uint8_t *buf;
     uint32_t *ind, *ind2, *ind3;
-    uint32_t bg, ibn, ibn2, ibn3;
+    uint32_t bg, ibn, ibn2, ibn3, bn;
     uint32_t blocks_per_ind = fs->block_size >> 2;
 
     /* Don't even bother if we're mounted read-only. */
@@ -800,12 +806,21 @@ uint8_t *ext2_inode_alloc_block(ext2_fs_t *fs, ext2_inode_t *inode,
 
     bg = (iinode->inode_num - 1) / fs->sb.s_inodes_per_group;
 
+    /* The caller might not care where the data block ended up. */
+    if(!r_block)
+        r_block = &bn;
+
     /* First, see if we have a slot in the direct blocks open still. */
     if(blocks < 12) {
-        return alloc_direct_blk(fs, iinode, bg, &inode->i_block[blocks], err);
+        if((buf = alloc_direct_blk(fs, iinode, bg, &inode->i_block[blocks],
+                                   err)))
+            *r_block = inode->i_block[blocks];
+
+        return buf;
     }
     else if(blocks == 12) {
-        return alloc_ind_blk(fs, iinode, bg, &inode->i_block[12], err);
+        return alloc_ind_blk(fs, iinode, bg, &inode->i_block[12], r_block,
+                             err);
     }
 
     blocks -= 12;
@@ -818,13 +833,16 @@ uint8_t *ext2_inode_alloc_block(ext2_fs_t *fs, ext2_inode_t *inode,
         }
 
         /* Allocate the data block. */
-        if((buf = alloc_direct_blk(fs, iinode, bg, &ind[blocks], err)))
+        if((buf = alloc_direct_blk(fs, iinode, bg, &ind[blocks], err))) {
+            *r_block = ind[blocks];
             ext2_block_mark_dirty(fs, inode->i_block[12]);
+        }
 
         return buf;
     }
     else if(blocks == blocks_per_ind) {
-        return alloc_dind_blk(fs, iinode, bg, &inode->i_block[13], err);
+        return alloc_dind_blk(fs, iinode, bg, &inode->i_block[13], r_block,
+                              err);
     }
 
     blocks -= blocks_per_ind;
@@ -844,20 +862,24 @@ uint8_t *ext2_inode_alloc_block(ext2_fs_t *fs, ext2_inode_t *inode,
                 return NULL;
 
             /* Allocate the data block. */
-            if((buf = alloc_direct_blk(fs, iinode, bg, &ind[blocks], err)))
+            if((buf = alloc_direct_blk(fs, iinode, bg, &ind[blocks], err))) {
+                *r_block = ind[blocks];
                 ext2_block_mark_dirty(fs, ind2[ibn]);
+            }
 
             return buf;
         }
         else {
-            if((buf = alloc_ind_blk(fs, iinode, bg, &ind2[ibn], err)))
+            if((buf = alloc_ind_blk(fs, iinode, bg, &ind2[ibn], r_block,
+                                    err)))
                 ext2_block_mark_dirty(fs, inode->i_block[13]);
 
             return buf;
         }
     }
     else if(blocks == (blocks_per_ind * blocks_per_ind)) {
-        return alloc_tind_blk(fs, iinode, bg, &inode->i_block[14], err);
+        return alloc_tind_blk(fs, iinode, bg, &inode->i_block[14], r_block,
+                              err);
     }
 
     /* So, it comes to this... */
@@ -877,7 +899,8 @@ uint8_t *ext2_inode_alloc_block(ext2_fs_t *fs, ext2_inode_t *inode,
         if(!(ind3 = (uint32_t *)ext2_block_read(fs, inode->i_block[14], err)))
             return NULL;
 
-        if((buf = alloc_dind_blk(fs, iinode, bg, &ind3[ibn3], err)))
+        if((buf = alloc_dind_blk(fs, iinode, bg, &ind3[ibn3], r_block,
+                                 err)))
             ext2_block_mark_dirty(fs, inode->i_block[14]);
 
         return buf;
@@ -890,7 +913,8 @@ uint8_t *ext2_inode_alloc_block(ext2_fs_t *fs, ext2_inode_t *inode,
         if(!(ind2 = (uint32_t *)ext2_block_read(fs, ind3[ibn3], err)))
             return NULL;
 
-        if((buf = alloc_ind_blk(fs, iinode, bg, &ind2[ibn2], err)))
+        if((buf = alloc_ind_blk(fs, iinode, bg, &ind2[ibn2], r_block,
+                                err)))
             ext2_block_mark_dirty(fs, ind3[ibn3]);
 
         return buf;
@@ -906,8 +930,10 @@ uint8_t *ext2_inode_alloc_block(ext2_fs_t *fs, ext2_inode_t *inode,
         if(!(ind = (uint32_t *)ext2_block_read(fs, ind2[ibn2], err)))
             return NULL;
 
-        if((buf = alloc_direct_blk(fs, iinode, bg, &ind[ibn], err)))
+        if((buf = alloc_direct_blk(fs, iinode, bg, &ind[ibn], err))) {
+            *r_block = ind[ibn];
             ext2_block_mark_dirty(fs, ind2[ibn2]);
+        }
 
         return buf;
     }
@@ -0,0 +1,1073 @@
+/* KallistiOS ##version##
+
+   journal.c
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "ext2fs.h"
+#include "inode.h"
+#include "block.h"
+#include "journal.h"
+#include "superblock.h"
+#include "ext2internal.h"
+
+/* Is a log block that we just read part of the transaction we are expecting? */
+#define JNL_HDR_OK(h, seq) (jbd32((h)->h_magic) == EXT2_JOURNAL_MAGIC && \
+                            jbd32((h)->h_sequence) == (seq))
+
+/* Contiguous run of journal blocks on the block device. Journals are almost
+   always allocated contiguously by mke2fs/tune2fs, so there's usually only one
+   of these. */
+typedef struct jnl_extent {
+    uint32_t lblk;
+    uint32_t pblk;
+    uint32_t count;
+} jnl_extent_t;
+
+/* A metadata block that has been kicked out of the block cache before the
+   transaction it belongs to has been committed. */
+typedef struct jnl_pending {
+    uint32_t block;
+    uint8_t *data;
+} jnl_pending_t;
+
+/* A metadata block to be committed, wherever it happens to live right now. */
+typedef struct jnl_ent {
+    uint32_t block;
+    const uint8_t *data;
+} jnl_ent_t;
+
+/* Revoke record, used only during recovery. */
+typedef struct jnl_revoke {
+    uint32_t block;
+    uint32_t seq;
+} jnl_revoke_t;
+
+struct ext2_journal {
+    /* Where the journal lives on the block device. */
+    jnl_extent_t *map;
+    int map_count;
+
+    /* Copy of the journal superblock (the whole first block of the log). */
+    uint8_t *sb_buf;
+
+    /* The log itself occupies blocks [first, maxlen) of the journal. */
+    uint32_t first;
+    uint32_t maxlen;
+
+    /* Next block of the log to write to, the block the on-disk superblock says
+       the log starts at (0 if empty), and how many blocks of committed
+       transactions lie between the two. */
+    uint32_t head;
+    uint32_t tail;
+    uint32_t used;
+
+    /* ID of the next transaction to be committed. */
+    uint32_t sequence;
+
+    /* Largest number of metadata blocks we will put in one transaction. */
+    uint32_t max_trans;
+
+    uint8_t uuid[16];
+
+    /* Blocks evicted from the block cache awaiting commit. */
+    jnl_pending_t *pending;
+    uint32_t pending_count;
+
+    /* Staging buffer for batching writes (EXT2_JOURNAL_BATCH_BLOCKS blocks). */
+    uint8_t *stage;
+
+    int committing;
+
+    /* Set when enough blocks are pending that they should be committed at the
+       end of the current operation. */
+    int commit_wanted;
+
+    /* Set if a commit failed, in which case the log may hold the only good
+       copy of some blocks and must be left for recovery. */
+    int error;
+};
+
+/* Read a big-endian 32-bit value, regardless of the host byte order. This is
+   its own inverse, so it works for writing too. */
+static inline uint32_t jbd32(uint32_t x) {
+    const uint8_t *b = (const uint8_t *)&x;
+
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+        ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+}
+
+static inline uint32_t jnl_next(const ext2_journal_t *j, uint32_t blk) {
+    return (++blk == j->maxlen) ? j->first : blk;
+}
+
+static int dev_io(ext2_fs_t *fs, uint32_t pblk, uint32_t count, void *buf,
+                  int write) {
+    int fs_per_block = fs->sb.s_log_block_size - fs->dev->l_block_size + 10;
+
+    if(fs_per_block < 0)
+        return -EINVAL;
+
+    if(write) {
+        if(fs->dev->write_blocks(fs->dev, pblk << fs_per_block,
+                                 count << fs_per_block, buf))
+            return -EIO;
+    }
+    else {
+        if(fs->dev->read_blocks(fs->dev, pblk << fs_per_block,
+                                count << fs_per_block, buf))
+            return -EIO;
+    }
+
+    return 0;
+}
+
+/* Make sure everything written so far has actually hit the device before
+   anything else is written. The journal is useless without this if the block
+   device has a write-back cache of its own. */
+static int dev_flush(ext2_fs_t *fs) {
+    if(fs->dev->flush && fs->dev->flush(fs->dev))
+        return -EIO;
+
+    return 0;
+}
+
+/* Translate a block of the journal to a block on the device. Also returns the
+   number of blocks following it that are physically contiguous. */
+static uint32_t jnl_bmap(const ext2_journal_t *j, uint32_t lblk,
+                         uint32_t *run) {
+    int i;
+
+    for(i = 0; i < j->map_count; ++i) {
+        if(lblk >= j->map[i].lblk && lblk < j->map[i].lblk + j->map[i].count) {
+            if(run)
+                *run = j->map[i].count - (lblk - j->map[i].lblk);
+
+            return j->map[i].pblk + (lblk - j->map[i].lblk);
+        }
+    }
+
+    return 0;
+}
+
+/* Read or write count consecutive blocks of the log, starting at lblk and
+   wrapping around the end of the log as needed. */
+static int jnl_io(ext2_fs_t *fs, uint32_t lblk, uint32_t count, uint8_t *buf,
+                  int write) {
+    ext2_journal_t *j = fs->journal;
+    uint32_t pblk, run;
+    int rv;
+
+    while(count) {
+        if(!(pblk = jnl_bmap(j, lblk, &run)))
+            return -EIO;
+
+        if(run > count)
+            run = count;
+
+        if(lblk + run > j->maxlen)
+            run = j->maxlen - lblk;
+
+        if((rv = dev_io(fs, pblk, run, buf, write)))
+            return rv;
+
+        buf += run * fs->block_size;
+        count -= run;
+        lblk += run;
+
+        if(lblk == j->maxlen)
+            lblk = j->first;
+    }
+
+    return 0;
+}
+
+static int jnl_add_extent(ext2_journal_t *j, uint32_t lblk, uint32_t pblk) {
+    jnl_extent_t *tmp;
+
+    if(j->map_count) {
+        tmp = &j->map[j->map_count - 1];
+
+        if(tmp->lblk + tmp->count == lblk && tmp->pblk + tmp->count == pblk) {
+            ++tmp->count;
+            return 0;
+        }
+    }
+
+    if(!(tmp = (jnl_extent_t *)realloc(j->map, sizeof(jnl_extent_t) *
+                                       (j->map_count + 1))))
+        return -ENOMEM;
+
+    j->map = tmp;
+    tmp[j->map_count].lblk = lblk;
+    tmp[j->map_count].pblk = pblk;
+    tmp[j->map_count].count = 1;
+    ++j->map_count;
+
+    return 0;
+}
+
+/* Walk an indirect block of the journal inode (of the given depth), adding
+   everything it points to to the extent map. */
+static int jnl_map_ind(ext2_fs_t *fs, uint32_t iblk, int depth, uint32_t *lblk,
+                       uint32_t nblocks) {
+    ext2_journal_t *j = fs->journal;
+    uint32_t per_ind = fs->block_size >> 2;
+    uint32_t *ind, i;
+    int rv = 0;
+
+    if(!iblk)
+        return -EIO;
+
+    if(!(ind = (uint32_t *)malloc(fs->block_size)))
+        return -ENOMEM;
+
+    if((rv = dev_io(fs, iblk, 1, ind, 0)))
+        goto out;
+
+    for(i = 0; i < per_ind && *lblk < nblocks && !rv; ++i) {
+        if(depth)
+            rv = jnl_map_ind(fs, ind[i], depth - 1, lblk, nblocks);
+        else if(!ind[i])
+            rv = -EIO;
+        else
+            rv = jnl_add_extent(j, (*lblk)++, ind[i]);
+    }
+
+out:
+    free(ind);
+    return rv;
+}
+
+/* Figure out where the journal inode's blocks are. We do this without going
+   through the block or inode caches, since we may be about to replay the log
+   over the top of whatever they would have loaded. */
+static int jnl_map(ext2_fs_t *fs, uint32_t inode_num) {
+    ext2_journal_t *j = fs->journal;
+    ext2_inode_t *inode;
+    uint8_t *buf;
+    uint32_t bg, index, in_per_block, nblocks, lblk = 0;
+    int i, rv = 0;
+
+    if(!inode_num || inode_num > fs->sb.s_inodes_count)
+        return -EINVAL;
+
+    if(!(buf = (uint8_t *)malloc(fs->block_size)))
+        return -ENOMEM;
+
+    in_per_block = fs->block_size / fs->sb.s_inode_size;
+    bg = (inode_num - 1) / fs->sb.s_inodes_per_group;
+    index = (inode_num - 1) % fs->sb.s_inodes_per_group;
+
+    if((rv = dev_io(fs, fs->bg[bg].bg_inode_table + index / in_per_block, 1,
+                    buf, 0)))
+        goto out;
+
+    inode = (ext2_inode_t *)(buf + (index % in_per_block) *
+                             fs->sb.s_inode_size);
+    nblocks = (uint32_t)(ext2_inode_size(inode) >> ext2_log_block_size(fs));
+
+    for(i = 0; i < 12 && lblk < nblocks && !rv; ++i) {
+        if(!inode->i_block[i])
+            rv = -EIO;
+        else
+            rv = jnl_add_extent(j, lblk++, inode->i_block[i]);
+    }
+
+    for(i = 0; i < 3 && lblk < nblocks && !rv; ++i) {
+        rv = jnl_map_ind(fs, inode->i_block[12 + i], i, &lblk, nblocks);
+    }
+
+    if(!rv && lblk < 2)
+        rv = -EIO;
+
+out:
+    free(buf);
+    return rv;
+}
+
+static int jnl_write_sb(ext2_fs_t *fs, uint32_t start) {
+    ext2_journal_t *j = fs->journal;
+    ext2_journal_sb_t *jsb = (ext2_journal_sb_t *)j->sb_buf;
+    int rv;
+
+    jsb->s_start = jbd32(start);
+    jsb->s_sequence = jbd32(j->sequence);
+
+    if((rv = dev_flush(fs)))
+        return rv;
+
+    if((rv = dev_io(fs, j->map[0].pblk, 1, j->sb_buf, 1)) ||
+       (rv = dev_flush(fs)))
+        return rv;
+
+    j->tail = start;
+
+    return 0;
+}
+
+/* Move the tail of the log up to the head. Everything in the log has already
+   been checkpointed by the time we get here, so nothing is lost by doing so. */
+static int jnl_push_tail(ext2_fs_t *fs) {
+    ext2_journal_t *j = fs->journal;
+    int rv;
+
+    if((rv = jnl_write_sb(fs, j->head)))
+        return rv;
+
+    j->used = 0;
+    return 0;
+}
+
+/* Build the image of the block containing the main superblock. */
+static int sb_block(ext2_fs_t *fs, uint8_t *buf, uint32_t *blk) {
+    int rv;
+
+    if(fs->block_size == 1024) {
+        *blk = 1;
+        memcpy(buf, &fs->sb, 1024);
+        return 0;
+    }
+
+    *blk = 0;
+
+    if((rv = dev_io(fs, 0, 1, buf, 0)))
+        return rv;
+
+    memcpy(buf + 1024, &fs->sb, 1024);
+    return 0;
+}
+
+static int sb_write(ext2_fs_t *fs) {
+    uint8_t *buf;
+    uint32_t blk;
+    int rv;
+
+    if(!(buf = (uint8_t *)malloc(fs->block_size)))
+        return -ENOMEM;
+
+    if(!(rv = sb_block(fs, buf, &blk)))
+        rv = dev_io(fs, blk, 1, buf, 1);
+
+    free(buf);
+    return rv;
+}
+
+static jnl_pending_t *pending_find(ext2_journal_t *j, uint32_t block_num) {
+    uint32_t i;
+
+    for(i = 0; i < j->pending_count; ++i) {
+        if(j->pending[i].block == block_num)
+            return &j->pending[i];
+    }
+
+    return NULL;
+}
+
+static void pending_remove(ext2_journal_t *j, jnl_pending_t *p) {
+    free(p->data);
+    *p = j->pending[--j->pending_count];
+}
+
+/* Add a copy of a block to the pending list, replacing any older copy. */
+static int pending_add(ext2_fs_t *fs, uint32_t block_num, const uint8_t *data) {
+    ext2_journal_t *j = fs->journal;
+    jnl_pending_t *p;
+
+    if(!(p = pending_find(j, block_num))) {
+        if(!(p = (jnl_pending_t *)realloc(j->pending, sizeof(jnl_pending_t) *
+                                          (j->pending_count + 1))))
+            return -ENOMEM;
+
+        j->pending = p;
+        p = &p[j->pending_count];
+
+        if(!(p->data = (uint8_t *)malloc(fs->block_size)))
+            return -ENOMEM;
+
+        p->block = block_num;
+        ++j->pending_count;
+    }
+
+    memcpy(p->data, data, fs->block_size);
+    return 0;
+}
+
+/* Put the superblock and block group descriptors into the pending list. */
+static int pending_add_sb(ext2_fs_t *fs) {
+    uint8_t *buf;
+    uint32_t blk, bg_per_block, count = fs->bg_count;
+    ext2_bg_desc_t *ptr = fs->bg;
+    int rv;
+
+    if(!(buf = (uint8_t *)malloc(fs->block_size)))
+        return -ENOMEM;
+
+    if((rv = sb_block(fs, buf, &blk)) || (rv = pending_add(fs, blk, buf)))
+        goto out;
+
+    bg_per_block = fs->block_size / sizeof(ext2_bg_desc_t);
+    blk = fs->sb.s_first_data_block + 1;
+
+    while(count) {
+        memset(buf, 0, fs->block_size);
+
+        if(count < bg_per_block) {
+            memcpy(buf, ptr, count * sizeof(ext2_bg_desc_t));
+            count = 0;
+        }
+        else {
+            memcpy(buf, ptr, bg_per_block * sizeof(ext2_bg_desc_t));
+            ptr += bg_per_block;
+            count -= bg_per_block;
+        }
+
+        if((rv = pending_add(fs, blk++, buf)))
+            goto out;
+    }
+
+out:
+    free(buf);
+    return rv;
+}
+
+static int ent_cmp(const void *a, const void *b) {
+    const jnl_ent_t *e1 = (const jnl_ent_t *)a, *e2 = (const jnl_ent_t *)b;
+
+    return (e1->block > e2->block) - (e1->block < e2->block);
+}
+
+/* Write a set of blocks to their home locations in ascending order, merging
+   runs of adjacent blocks into a single request to the block device. */
+static int write_home(ext2_fs_t *fs, jnl_ent_t *ents, uint32_t count) {
+    ext2_journal_t *j = fs->journal;
+    uint32_t i, n = 0, start = 0;
+    int rv;
+
+    qsort(ents, count, sizeof(jnl_ent_t), ent_cmp);
+
+    for(i = 0; i < count; ++i) {
+        if(n && (ents[i].block != start + n ||
+                 n == EXT2_JOURNAL_BATCH_BLOCKS)) {
+            if((rv = dev_io(fs, start, n, j->stage, 1)))
+                return rv;
+
+            n = 0;
+        }
+
+        if(!n)
+            start = ents[i].block;
+
+        memcpy(j->stage + n++ * fs->block_size, ents[i].data, fs->block_size);
+    }
+
+    if(n)
+        return dev_io(fs, start, n, j->stage, 1);
+
+    return 0;
+}
+
+/* Write out one transaction containing the given metadata blocks and then
+   checkpoint it. */
+static int commit_one(ext2_fs_t *fs, jnl_ent_t *ents, uint32_t count) {
+    ext2_journal_t *j = fs->journal;
+    uint32_t bs = fs->block_size;
+    uint32_t tpd = (bs - sizeof(ext2_journal_hdr_t) - 16) /
+        sizeof(ext2_journal_tag_t);
+    uint32_t ndesc = (count + tpd - 1) / tpd;
+    uint32_t needed = count + ndesc + 1;
+    uint32_t i, k, n, pos, staged = 0, start;
+    ext2_journal_hdr_t *hdr;
+    ext2_journal_tag_t *tag;
+    uint8_t *desc, *blk;
+    int rv;
+
+    /* Make sure there's room in the log for this transaction. Since we always
+       checkpoint right after committing, we can just move the tail up to the
+       head if there isn't. */
+    if(!j->tail || needed > j->maxlen - j->first - j->used) {
+        if((rv = jnl_push_tail(fs)))
+            return rv;
+    }
+
+    start = pos = j->head;
+
+    for(i = 0; i < count; i += n) {
+        n = count - i < tpd ? count - i : tpd;
+
+        /* Flush the stage if the descriptor won't fit. */
+        if(staged == EXT2_JOURNAL_BATCH_BLOCKS) {
+            if((rv = jnl_io(fs, start, staged, j->stage, 1)))
+                return rv;
+
+            start = pos;
+            staged = 0;
+        }
+
+        /* Fill in the whole descriptor before any of its blocks, since it may
+           well be written out before the blocks it describes are staged. */
+        desc = j->stage + staged++ * bs;
+        pos = jnl_next(j, pos);
+        memset(desc, 0, bs);
+
+        hdr = (ext2_journal_hdr_t *)desc;
+        hdr->h_magic = jbd32(EXT2_JOURNAL_MAGIC);
+        hdr->h_blocktype = jbd32(EXT2_JOURNAL_DESCRIPTOR);
+        hdr->h_sequence = jbd32(j->sequence);
+        blk = desc + sizeof(ext2_journal_hdr_t);
+
+        for(k = 0; k < n; ++k) {
+            tag = (ext2_journal_tag_t *)blk;
+            tag->t_blocknr = jbd32(ents[i + k].block);
+            tag->t_flags = k ? EXT2_JOURNAL_FLAG_SAME_UUID : 0;
+
+            if(jbd32(*(const uint32_t *)ents[i + k].data) == EXT2_JOURNAL_MAGIC)
+                tag->t_flags |= EXT2_JOURNAL_FLAG_ESCAPE;
+
+            if(k == n - 1)
+                tag->t_flags |= EXT2_JOURNAL_FLAG_LAST_TAG;
+
+            tag->t_flags = jbd32(tag->t_flags);
+            blk += sizeof(ext2_journal_tag_t);
+
+            if(!k) {
+                memcpy(blk, j->uuid, 16);
+                blk += 16;
+            }
+        }
+
+        /* Now stage the blocks themselves. */
+        for(k = 0; k < n; ++k) {
+            if(staged == EXT2_JOURNAL_BATCH_BLOCKS) {
+                if((rv = jnl_io(fs, start, staged, j->stage, 1)))
+                    return rv;
+
+                start = pos;
+                staged = 0;
+            }
+
+            blk = j->stage + staged++ * bs;
+            pos = jnl_next(j, pos);
+            memcpy(blk, ents[i + k].data, bs);
+
+            if(jbd32(*(const uint32_t *)blk) == EXT2_JOURNAL_MAGIC)
+                memset(blk, 0, 4);
+        }
+    }
+
+    /* Get everything but the commit block out... */
+    if(staged && (rv = jnl_io(fs, start, staged, j->stage, 1)))
+        return rv;
+
+    if((rv = dev_flush(fs)))
+        return rv;
+
+    /* ... and then commit the transaction. */
+    memset(j->stage, 0, bs);
+    hdr = (ext2_journal_hdr_t *)j->stage;
+    hdr->h_magic = jbd32(EXT2_JOURNAL_MAGIC);
+    hdr->h_blocktype = jbd32(EXT2_JOURNAL_COMMIT);
+    hdr->h_sequence = jbd32(j->sequence);
+
+    if((rv = jnl_io(fs, pos, 1, j->stage, 1)) || (rv = dev_flush(fs)))
+        return rv;
+
+    j->head = jnl_next(j, pos);
+    j->used += needed;
+    ++j->sequence;
+
+    /* The transaction is safe in the log, so put everything where it really
+       belongs. */
+    return write_home(fs, ents, count);
+}
+
+int ext2_journal_commit(ext2_fs_t *fs) {
+    ext2_journal_t *j = fs->journal;
+    ext2_cache_t **cache = fs->bcache;
+    jnl_ent_t *ents;
+    uint32_t count = 0, data = 0, i, n;
+    int k, rv = 0;
+
+    if(!j || j->committing)
+        return 0;
+
+    j->committing = 1;
+
+    if((fs->flags & EXT2_FS_FLAG_SB_DIRTY) && (rv = pending_add_sb(fs)))
+        goto out;
+
+    if(!(ents = (jnl_ent_t *)malloc(sizeof(jnl_ent_t) *
+                                    (fs->cache_size + j->pending_count)))) {
+        rv = -ENOMEM;
+        goto out;
+    }
+
+    /* Ordered mode: data blocks go straight to their home location before any
+       of the metadata that refers to them is committed. */
+    for(k = 0; k < fs->cache_size; ++k) {
+        if((cache[k]->flags & EXT2_CACHE_FLAG_DIRTY) &&
+           (cache[k]->flags & EXT2_CACHE_FLAG_DATA)) {
+            ents[data].block = cache[k]->block;
+            ents[data++].data = cache[k]->data;
+        }
+    }
+
+    if(data) {
+        if(j->used && (rv = jnl_push_tail(fs)))
+            goto out_free;
+
+        if((rv = write_home(fs, ents, data)))
+            goto out_free;
+
+        for(k = 0; k < fs->cache_size; ++k) {
+            if(cache[k]->flags & EXT2_CACHE_FLAG_DATA)
+                cache[k]->flags &= ~(EXT2_CACHE_FLAG_DIRTY |
+                                     EXT2_CACHE_FLAG_DATA);
+        }
+    }
+
+    /* Gather up all the metadata, both in the cache and evicted from it. */
+    for(k = 0; k < fs->cache_size; ++k) {
+        if(cache[k]->flags & EXT2_CACHE_FLAG_DIRTY) {
+            ents[count].block = cache[k]->block;
+            ents[count++].data = cache[k]->data;
+        }
+    }
+
+    for(i = 0; i < j->pending_count; ++i) {
+        ents[count].block = j->pending[i].block;
+        ents[count++].data = j->pending[i].data;
+    }
+
+    /* Write it all out, splitting it up if it's too big for the log. */
+    for(i = 0; i < count; i += n) {
+        n = count - i < j->max_trans ? count - i : j->max_trans;
+
+        if((rv = commit_one(fs, ents + i, n)))
+            goto out_free;
+    }
+
+    for(k = 0; k < fs->cache_size; ++k) {
+        cache[k]->flags &= ~EXT2_CACHE_FLAG_DIRTY;
+    }
+
+    for(i = 0; i < j->pending_count; ++i) {
+        free(j->pending[i].data);
+    }
+
+    j->pending_count = 0;
+    j->commit_wanted = 0;
+    fs->flags &= ~EXT2_FS_FLAG_SB_DIRTY;
+
+out_free:
+    free(ents);
+out:
+    if(rv)
+        j->error = 1;
+
+    j->committing = 0;
+    return rv;
+}
+
+int ext2_journal_evict(ext2_fs_t *fs, uint32_t block_num, const uint8_t *data) {
+    ext2_journal_t *j = fs->journal;
+    int rv;
+
+    if((rv = pending_add(fs, block_num, data)))
+        return rv;
+
+    if(j->pending_count >= EXT2_JOURNAL_PENDING_BLOCKS)
+        j->commit_wanted = 1;
+
+    /* Committing here would split the current operation across transactions,
+       so only do it if one operation alone is about to outgrow the log. */
+    if(j->pending_count + fs->cache_size >= j->max_trans)
+        return ext2_journal_commit(fs);
+
+    return 0;
+}
+
+int ext2_journal_op_done(ext2_fs_t *fs) {
+    ext2_journal_t *j = fs->journal;
+    int rv;
+
+    if(!j || !j->commit_wanted)
+        return 0;
+
+    /* The inode cache has to go out first, or the transaction would have the
+       blocks an inode points to, but not the inode itself. */
+    if((rv = ext2_inode_cache_wb(fs)))
+        return rv;
+
+    return ext2_journal_commit(fs);
+}
+
+int ext2_journal_write_data(ext2_fs_t *fs, uint32_t block_num,
+                            const uint8_t *data) {
+    ext2_journal_t *j = fs->journal;
+    int rv;
+
+    /* This block might have been metadata in a transaction that's still in the
+       log. Make sure it won't be replayed over the top of the new data. */
+    if(j->used && (rv = jnl_push_tail(fs)))
+        return rv;
+
+    return ext2_block_write_nc(fs, block_num, data);
+}
+
+int ext2_journal_lookup(ext2_fs_t *fs, uint32_t block_num, uint8_t *buf,
+                        int take) {
+    jnl_pending_t *p;
+
+    if(!fs->journal || !(p = pending_find(fs->journal, block_num)))
+        return 0;
+
+    memcpy(buf, p->data, fs->block_size);
+
+    if(take)
+        pending_remove(fs->journal, p);
+
+    return 1;
+}
+
+static int revoked(const jnl_revoke_t *rt, uint32_t rcount, uint32_t block,
+                   uint32_t seq) {
+    uint32_t i;
+
+    for(i = 0; i < rcount; ++i) {
+        if(rt[i].block == block && rt[i].seq >= seq)
+            return 1;
+    }
+
+    return 0;
+}
+
+#define PASS_SCAN   0
+#define PASS_REVOKE 1
+#define PASS_REPLAY 2
+
+/* One pass over the log, in the style of the Linux recovery code. The scan pass
+   figures out where the last fully committed transaction ends, the revoke pass
+   collects revoke records, and the replay pass writes the blocks back home. */
+static int recover_pass(ext2_fs_t *fs, int pass, uint32_t *end_seq,
+                        uint32_t *end_blk, jnl_revoke_t **rt,
+                        uint32_t *rcount, uint32_t *replayed) {
+    ext2_journal_t *j = fs->journal;
+    ext2_journal_sb_t *jsb = (ext2_journal_sb_t *)j->sb_buf;
+    uint32_t bs = fs->block_size;
+    uint32_t blk = jbd32(jsb->s_start), seq = jbd32(jsb->s_sequence);
+    uint32_t left = j->maxlen - j->first, off, flags, target, cnt;
+    ext2_journal_hdr_t *hdr;
+    ext2_journal_tag_t *tag;
+    jnl_revoke_t *tmp;
+    uint8_t *buf, *dbuf;
+    int rv = 0;
+
+    if(!(buf = (uint8_t *)malloc(bs * 2)))
+        return -ENOMEM;
+
+    dbuf = buf + bs;
+    hdr = (ext2_journal_hdr_t *)buf;
+
+    while(left-- && (pass == PASS_SCAN || seq != *end_seq)) {
+        if((rv = jnl_io(fs, blk, 1, buf, 0)))
+            goto out;
+
+        if(!JNL_HDR_OK(hdr, seq))
+            break;
+
+        blk = jnl_next(j, blk);
+
+        switch(jbd32(hdr->h_blocktype)) {
+            case EXT2_JOURNAL_DESCRIPTOR:
+                off = sizeof(ext2_journal_hdr_t);
+
+                while(off + sizeof(ext2_journal_tag_t) <= bs && left) {
+                    tag = (ext2_journal_tag_t *)(buf + off);
+                    flags = jbd32(tag->t_flags);
+                    target = jbd32(tag->t_blocknr);
+
+                    if(pass == PASS_REPLAY &&
+                       !revoked(*rt, *rcount, target, seq)) {
+                        if((rv = jnl_io(fs, blk, 1, dbuf, 0)))
+                            goto out;
+
+                        if(flags & EXT2_JOURNAL_FLAG_ESCAPE)
+                            *(uint32_t *)dbuf = jbd32(EXT2_JOURNAL_MAGIC);
+
+                        if(target >= fs->sb.s_blocks_count) {
+                            dbglog(DBG_WARNING, "ext2_journal: log refers "
+                                   "to block %" PRIu32 " beyond the end of "
+                                   "the filesystem\n", target);
+                        }
+                        else if((rv = dev_io(fs, target, 1, dbuf, 1))) {
+                            goto out;
+                        }
+
+                        ++*replayed;
+                    }
+
+                    blk = jnl_next(j, blk);
+                    --left;
+                    off += sizeof(ext2_journal_tag_t);
+
+                    if(!(flags & EXT2_JOURNAL_FLAG_SAME_UUID))
+                        off += 16;
+
+                    if(flags & EXT2_JOURNAL_FLAG_LAST_TAG)
+                        break;
+                }
+                break;
+
+            case EXT2_JOURNAL_COMMIT:
+                ++seq;
+
+                if(pass == PASS_SCAN) {
+                    *end_seq = seq;
+                    *end_blk = blk;
+                }
+                break;
+
+            case EXT2_JOURNAL_REVOKE:
+                if(pass != PASS_REVOKE)
+                    break;
+
+                cnt = jbd32(*(uint32_t *)(buf + sizeof(ext2_journal_hdr_t)));
+                if(cnt > bs)
+                    cnt = bs;
+
+                for(off = sizeof(ext2_journal_hdr_t) + 4; off + 4 <= cnt;
+                    off += 4) {
+                    if(!(tmp = (jnl_revoke_t *)realloc(*rt,
+                                                       sizeof(jnl_revoke_t) *
+                                                       (*rcount + 1)))) {
+                        rv = -ENOMEM;
+                        goto out;
+                    }
+
+                    *rt = tmp;
+                    tmp[*rcount].block = jbd32(*(uint32_t *)(buf + off));
+                    tmp[(*rcount)++].seq = seq;
+                }
+                break;
+
+            default:
+                /* Not something we understand, so treat it as the end of the
+                   log. */
+                left = 0;
+                break;
+        }
+    }
+
+out:
+    free(buf);
+    return rv;
+}
+
+static int jnl_recover(ext2_fs_t *fs) {
+    ext2_journal_t *j = fs->journal;
+    ext2_journal_sb_t *jsb = (ext2_journal_sb_t *)j->sb_buf;
+    uint32_t end_seq = jbd32(jsb->s_sequence), end_blk = 0, rcount = 0;
+    uint32_t replayed = 0;
+    jnl_revoke_t *rt = NULL;
+    int rv;
+
+    if((rv = recover_pass(fs, PASS_SCAN, &end_seq, &end_blk, &rt, &rcount,
+                          &replayed)))
+        return rv;
+
+    if((rv = recover_pass(fs, PASS_REVOKE, &end_seq, &end_blk, &rt, &rcount,
+                          &replayed)))
+        goto out;
+
+    if((rv = recover_pass(fs, PASS_REPLAY, &end_seq, &end_blk, &rt, &rcount,
+                          &replayed)))
+        goto out;
+
+    dbglog(DBG_KDEBUG, "ext2_journal: replayed %" PRIu32 " transactions (%"
+           PRIu32 " blocks)\n", end_seq - jbd32(jsb->s_sequence), replayed);
+
+    /* Start the next transaction with a number that can't be confused with
+       anything still sitting in the log. */
+    j->sequence = end_seq + 1;
+
+out:
+    free(rt);
+    return rv;
+}
+
+static void jnl_free(ext2_journal_t *j) {
+    uint32_t i;
+
+    for(i = 0; i < j->pending_count; ++i) {
+        free(j->pending[i].data);
+    }
+
+    free(j->pending);
+    free(j->stage);
+    free(j->sb_buf);
+    free(j->map);
+    free(j);
+}
+
+int ext2_journal_init(ext2_fs_t *fs) {
+    ext2_journal_t *j;
+    ext2_journal_sb_t *jsb;
+    uint32_t type, incompat, needs_recovery;
+    int rw = fs->mnt_flags & EXT2FS_MNT_FLAG_RW, rv, k;
+
+    fs->journal = NULL;
+
+    if(!(fs->sb.s_feature_compat & EXT2_FEATURE_COMPAT_HAS_JOURNAL))
+        return 0;
+
+    if(fs->sb.s_feature_incompat & EXT2_FEATURE_INCOMPAT_JOURNAL_DEV) {
+        dbglog(DBG_WARNING, "ext2_journal: external journals are not "
+               "supported\n");
+        goto unusable;
+    }
+
+    if(!(j = (ext2_journal_t *)calloc(1, sizeof(ext2_journal_t))))
+        return -ENOMEM;
+
+    fs->journal = j;
+
+    if(!(j->sb_buf = (uint8_t *)malloc(fs->block_size)) ||
+       !(j->stage = (uint8_t *)malloc(fs->block_size *
+                                      EXT2_JOURNAL_BATCH_BLOCKS))) {
+        rv = -ENOMEM;
+        goto err;
+    }
+
+    if((rv = jnl_map(fs, fs->sb.s_journal_inum))) {
+        dbglog(DBG_WARNING, "ext2_journal: cannot map journal inode %" PRIu32
+               "\n", fs->sb.s_journal_inum);
+        goto bad;
+    }
+
+    if((rv = dev_io(fs, j->map[0].pblk, 1, j->sb_buf, 0)))
+        goto err;
+
+    jsb = (ext2_journal_sb_t *)j->sb_buf;
+    type = jbd32(jsb->s_header.h_blocktype);
+    incompat = type == EXT2_JOURNAL_SB_V2 ?
+        jbd32(jsb->s_feature_incompat) : 0;
+
+    if(jbd32(jsb->s_header.h_magic) != EXT2_JOURNAL_MAGIC ||
+       (type != EXT2_JOURNAL_SB_V1 && type != EXT2_JOURNAL_SB_V2) ||
+       jbd32(jsb->s_blocksize) != fs->block_size) {
+        dbglog(DBG_WARNING, "ext2_journal: invalid journal superblock\n");
+        goto bad;
+    }
+
+    if(incompat & ~EXT2_JOURNAL_INCOMPAT_REVOKE) {
+        dbglog(DBG_WARNING, "ext2_journal: unsupported journal features: %08"
+               PRIx32 "\n", incompat);
+        goto bad;
+    }
+
+    j->first = jbd32(jsb->s_first);
+    j->maxlen = jbd32(jsb->s_maxlen);
+
+    if(!j->first || j->maxlen <= j->first + 2 ||
+       !jnl_bmap(j, j->maxlen - 1, NULL)) {
+        dbglog(DBG_WARNING, "ext2_journal: journal is smaller than its "
+               "superblock claims\n");
+        goto bad;
+    }
+
+    if(type == EXT2_JOURNAL_SB_V2)
+        memcpy(j->uuid, jsb->s_uuid, 16);
+
+    j->sequence = jbd32(jsb->s_sequence);
+    j->max_trans = (j->maxlen - j->first) / 4;
+    needs_recovery = jsb->s_start != 0;
+
+    if(needs_recovery) {
+        if(!rw) {
+            dbglog(DBG_WARNING, "ext2_journal: filesystem needs recovery, but "
+                   "is being mounted read-only. Data may be out of date.\n");
+            jnl_free(j);
+            fs->journal = NULL;
+            return 0;
+        }
+
+        if((rv = jnl_recover(fs)))
+            goto err;
+
+        /* Throw away anything we might have cached before the replay and load
+           the (possibly updated) superblock and block group descriptors. */
+        for(k = 0; k < fs->cache_size; ++k) {
+            fs->bcache[k]->flags = 0;
+        }
+
+        if((rv = ext2_read_superblock(&fs->sb, fs->dev)) ||
+           (rv = ext2_read_blockgroups(fs, fs->sb.s_first_data_block + 1)))
+            goto err;
+    }
+
+    if(!rw) {
+        jnl_free(j);
+        fs->journal = NULL;
+        return 0;
+    }
+
+    /* Start out with an empty log. */
+    j->head = j->first;
+
+    if((rv = jnl_write_sb(fs, 0)))
+        goto err;
+
+    /* Let e2fsck and Linux know the journal is in use. */
+    fs->sb.s_feature_incompat |= EXT2_FEATURE_INCOMPAT_RECOVER;
+
+    if((rv = sb_write(fs)))
+        goto err;
+
+    return 0;
+
+bad:
+    jnl_free(j);
+    fs->journal = NULL;
+
+unusable:
+    if(fs->sb.s_feature_incompat & EXT2_FEATURE_INCOMPAT_RECOVER) {
+        dbglog(DBG_WARNING, "ext2_journal: cannot recover filesystem, mounting "
+               "read-only\n");
+        fs->mnt_flags &= ~EXT2FS_MNT_FLAG_RW;
+    }
+
+    return 0;
+
+err:
+    jnl_free(j);
+    fs->journal = NULL;
+    return rv;
+}
+
+void ext2_journal_shutdown(ext2_fs_t *fs) {
+    ext2_journal_t *j = fs->journal;
+
+    if(!j)
+        return;
+
+    /* Mark the log as empty and the filesystem as clean, in that order. */
+    if(!j->error && !j->pending_count && !jnl_write_sb(fs, 0)) {
+        fs->sb.s_feature_incompat &= ~EXT2_FEATURE_INCOMPAT_RECOVER;
+        sb_write(fs);
+    }
+    else {
+        dbglog(DBG_ERROR, "ext2_journal: couldn't empty the journal, it will "
+               "be replayed at the next mount\n");
+    }
+
+    jnl_free(j);
+    fs->journal = NULL;
+}
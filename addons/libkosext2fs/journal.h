@@ -0,0 +1,127 @@
+/* KallistiOS ##version##
+
+   journal.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+#ifndef __EXT2_JOURNAL_H
+#define __EXT2_JOURNAL_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+
+#include "ext2fs.h"
+
+/* On-disk format of the journal. This is the same format used by the ext3
+   filesystem in Linux (JBD/JBD2), so that a filesystem written by us can be
+   recovered by e2fsck or the Linux kernel and vice versa. Unlike everything
+   else in an ext2 filesystem, all fields in the journal are big-endian. */
+
+#define EXT2_JOURNAL_MAGIC          0xC03B3998
+
+/* h_blocktype values */
+#define EXT2_JOURNAL_DESCRIPTOR     1
+#define EXT2_JOURNAL_COMMIT         2
+#define EXT2_JOURNAL_SB_V1          3
+#define EXT2_JOURNAL_SB_V2          4
+#define EXT2_JOURNAL_REVOKE         5
+
+/* t_flags values for descriptor block tags */
+#define EXT2_JOURNAL_FLAG_ESCAPE    1
+#define EXT2_JOURNAL_FLAG_SAME_UUID 2
+#define EXT2_JOURNAL_FLAG_DELETED   4
+#define EXT2_JOURNAL_FLAG_LAST_TAG  8
+
+/* s_feature_incompat values. We only understand revoke records. */
+#define EXT2_JOURNAL_INCOMPAT_REVOKE    0x00000001
+
+typedef struct ext2_journal_hdr {
+    uint32_t h_magic;
+    uint32_t h_blocktype;
+    uint32_t h_sequence;
+} ext2_journal_hdr_t;
+
+/* The journal superblock will not have its s_start field updated for each and
+   every transaction, as that would double the number of writes we do to the
+   journal. Instead, the tail of the log is only pushed forward when we run
+   out of space, or when a data block that might be covered by an old
+   transaction is about to be written in place. */
+typedef struct ext2_journal_sb {
+    ext2_journal_hdr_t s_header;
+
+    /* Static information describing the journal. */
+    uint32_t s_blocksize;
+    uint32_t s_maxlen;
+    uint32_t s_first;
+
+    /* Dynamic information describing the current state of the log. */
+    uint32_t s_sequence;
+    uint32_t s_start;
+    uint32_t s_errno;
+
+    /* Version 2 superblock fields. */
+    uint32_t s_feature_compat;
+    uint32_t s_feature_incompat;
+    uint32_t s_feature_ro_compat;
+    uint8_t s_uuid[16];
+    uint32_t s_nr_users;
+    uint32_t s_dynsuper;
+    uint32_t s_max_transaction;
+    uint32_t s_max_trans_data;
+} ext2_journal_sb_t;
+
+typedef struct ext2_journal_tag {
+    uint32_t t_blocknr;
+    uint32_t t_flags;
+} ext2_journal_tag_t;
+
+/* Opaque in-memory journal state. */
+struct ext2_journal;
+typedef struct ext2_journal ext2_journal_t;
+
+/* Open the journal of a filesystem (if it has one), replaying any transactions
+   left behind by an unclean shutdown. This must be called after the block group
+   descriptors and the block cache have been set up. If anything was replayed,
+   the superblock and block group descriptors are re-read from the device.
+   Returns 0 on success (including when the filesystem has no journal), or a
+   negative error code. */
+int ext2_journal_init(ext2_fs_t *fs);
+
+/* Commit all outstanding changes to the journal and then checkpoint them into
+   their final location on the block device. File data blocks are written in
+   place first, as in the "ordered" mode of ext3. */
+int ext2_journal_commit(ext2_fs_t *fs);
+
+/* Mark the end of a filesystem operation, when everything is consistent again.
+   If a commit has been requested, the inode cache is written back and the
+   commit is done now. Returns 0 on success (or if there was nothing to do), or
+   a negative error code. */
+int ext2_journal_op_done(ext2_fs_t *fs);
+
+/* Empty the journal and mark the filesystem as cleanly unmounted. You should
+   have called ext2_fs_sync() before calling this. */
+void ext2_journal_shutdown(ext2_fs_t *fs);
+
+/* Hand a dirty metadata block that is being evicted from the block cache to
+   the journal. The block will be written out with the next transaction. Once
+   EXT2_JOURNAL_PENDING_BLOCKS blocks are being held, a commit is requested for
+   the next call to ext2_journal_op_done(). */
+int ext2_journal_evict(ext2_fs_t *fs, uint32_t block_num, const uint8_t *data);
+
+/* Write a dirty data block that is being evicted from the block cache in
+   place, pushing the tail of the log forward first if needed. */
+int ext2_journal_write_data(ext2_fs_t *fs, uint32_t block_num,
+                            const uint8_t *data);
+
+/* Look for a block that has been evicted from the block cache but not yet
+   committed. Copies it to buf and returns 1 if found, 0 otherwise. If take is
+   non-zero, the journal forgets about the block (the caller is expected to
+   keep it dirty in the block cache). */
+int ext2_journal_lookup(ext2_fs_t *fs, uint32_t block_num, uint8_t *buf,
+                        int take);
+
+__END_DECLS
+
+#endif /* !__EXT2_JOURNAL_H */
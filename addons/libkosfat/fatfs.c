@@ -411,6 +411,12 @@ int fat_fs_sync(fat_fs_t *fs) {
         frv = -3;
     }
 
+    /* Finally, make sure the block device doesn't have anything cached. */
+    if(fs->dev->flush && fs->dev->flush(fs->dev)) {
+        dbglog(DBG_ERROR, "fat_fs_sync: Error flushing the block device.\n");
+        frv = -4;
+    }
+
     return frv;
 }
 
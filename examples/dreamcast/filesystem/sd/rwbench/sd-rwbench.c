@@ -0,0 +1,185 @@
+/* KallistiOS ##version##
+
+   sd-rwbench.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example measures the read and write throughput of an SD card attached
+   to SCIF, using a few different request sizes. Small requests are sent to
+   the card as single-block commands (CMD17/CMD24), while larger ones are
+   streamed with the multi-block commands (CMD18/CMD25).
+
+   The write test is optional, as it writes over the start of the first
+   partition on the card. The original contents are read back in first and
+   restored when the test is done, but don't run it on a card with anything you
+   care about on it.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <dc/sd.h>
+#include <dc/maple.h>
+#include <dc/maple/controller.h>
+
+#include <arch/arch.h>
+#include <arch/timer.h>
+
+#include <kos/init.h>
+#include <kos/dbgio.h>
+#include <kos/blockdev.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+/* Number of blocks transferred in each test. */
+#define TEST_BLOCKS     1024
+
+static uint8_t tbuf[TEST_BLOCKS * 512] __attribute__((aligned(32)));
+static uint8_t save[TEST_BLOCKS * 512] __attribute__((aligned(32)));
+
+static const size_t req_sizes[] = { 1, 8, 64, TEST_BLOCKS };
+
+#define NUM_SIZES   (sizeof(req_sizes) / sizeof(req_sizes[0]))
+
+static uint32_t wait_buttons(void) {
+    maple_device_t *dev;
+    cont_state_t *state;
+
+    for(;;) {
+        dev = maple_enum_type(0, MAPLE_FUNC_CONTROLLER);
+
+        if(dev) {
+            state = (cont_state_t *)maple_dev_status(dev);
+
+            if(state && state->buttons)
+                return state->buttons;
+        }
+    }
+}
+
+static void __attribute__((__noreturn__)) wait_exit(void) {
+    printf("Press any button to exit.\n");
+    wait_buttons();
+    arch_exit();
+}
+
+static double mb_per_sec(uint64_t us) {
+    return (TEST_BLOCKS * 512.0) / (double)us;
+}
+
+/* Transfer TEST_BLOCKS blocks in requests of n blocks each, returning the time
+   taken in microseconds, or 0 on error. */
+static uint64_t run(kos_blockdev_t *dev, size_t n, int write) {
+    uint64_t begin, end;
+    size_t i;
+    int rv;
+
+    begin = timer_us_gettime64();
+
+    for(i = 0; i < TEST_BLOCKS; i += n) {
+        if(write)
+            rv = dev->write_blocks(dev, i, n, tbuf + i * 512);
+        else
+            rv = dev->read_blocks(dev, i, n, tbuf + i * 512);
+
+        if(rv) {
+            printf("%s of block %u failed: %s\n", write ? "Write" : "Read",
+                   (unsigned int)i, strerror(errno));
+            return 0;
+        }
+    }
+
+    end = timer_us_gettime64();
+    return end - begin ? end - begin : 1;
+}
+
+int main(int argc, char *argv[]) {
+    kos_blockdev_t sd_dev;
+    uint64_t us;
+    uint8_t pt;
+    size_t i, j;
+
+    (void)argc;
+    (void)argv;
+
+    dbgio_dev_select("fb");
+    printf("Initializing SD card.\n");
+
+    if(sd_init()) {
+        printf("Could not initialize the SD card. Please make sure that you "
+               "have an SD card adapter plugged in and an SD card inserted.\n");
+        wait_exit();
+    }
+
+    /* Grab the block device for the first partition on the SD card. Note that
+       you must have the SD card formatted with an MBR partitioning scheme. */
+    if(sd_blockdev_for_partition(0, &sd_dev, &pt)) {
+        printf("Could not find the first partition on the SD card!\n");
+        wait_exit();
+    }
+
+    if(sd_dev.count_blocks(&sd_dev) < TEST_BLOCKS) {
+        printf("The first partition is too small for this test.\n");
+        wait_exit();
+    }
+
+    printf("Reading %d blocks:\n", TEST_BLOCKS);
+
+    for(i = 0; i < NUM_SIZES; ++i) {
+        if(!(us = run(&sd_dev, req_sizes[i], 0)))
+            wait_exit();
+
+        printf("  %4u blocks/request: %6.3f MB/s\n", (unsigned int)req_sizes[i],
+               mb_per_sec(us));
+    }
+
+    printf("\nPress A to run the write test (this writes over the start of the "
+           "first partition, and then puts it back). Press any other button to "
+           "exit.\n");
+
+    if(!(wait_buttons() & CONT_A))
+        arch_exit();
+
+    /* Keep a copy of what was there before... */
+    if(sd_dev.read_blocks(&sd_dev, 0, TEST_BLOCKS, save)) {
+        printf("Could not read the original data: %s\n", strerror(errno));
+        wait_exit();
+    }
+
+    printf("Writing %d blocks:\n", TEST_BLOCKS);
+
+    for(i = 0; i < NUM_SIZES; ++i) {
+        for(j = 0; j < sizeof(tbuf); ++j)
+            tbuf[j] = (uint8_t)(j * 7 + i);
+
+        if(!(us = run(&sd_dev, req_sizes[i], 1)))
+            break;
+
+        printf("  %4u blocks/request: %6.3f MB/s", (unsigned int)req_sizes[i],
+               mb_per_sec(us));
+
+        /* Make sure it all actually made it there. */
+        memset(tbuf, 0, sizeof(tbuf));
+
+        if(sd_dev.read_blocks(&sd_dev, 0, TEST_BLOCKS, tbuf)) {
+            printf(" (read back failed)\n");
+            break;
+        }
+
+        for(j = 0; j < sizeof(tbuf); ++j) {
+            if(tbuf[j] != (uint8_t)(j * 7 + i))
+                break;
+        }
+
+        printf(j == sizeof(tbuf) ? " (verified)\n" : " (MISMATCH)\n");
+    }
+
+    /* ... and put it back. */
+    if(sd_dev.write_blocks(&sd_dev, 0, TEST_BLOCKS, save))
+        printf("Could not restore the original data: %s\n", strerror(errno));
+
+    sd_shutdown();
+    wait_exit();
+    return 0;
+}
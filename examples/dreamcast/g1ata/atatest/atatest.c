@@ -7,6 +7,10 @@
    partition of an ATA device attached to G1, both over PIO and DMA and then
    compares the timing information from both. PIO reads seem to run at about
    3.5 MB/sec, whereas DMA gets around 12.5 MB/sec (quite the improvement).
+
+   It then reads the same amount of data from the start of the disk again using
+   the queued DMA interface, in several smaller requests that are all queued up
+   at once and completed from the DMA interrupt.
 */
 
 #include <string.h>
@@ -20,15 +24,29 @@
 
 #include <kos/dbglog.h>
 #include <kos/blockdev.h>
+#include <kos/thread.h>
 
 static unsigned char dmabuf[1024 * 512] __attribute__((aligned(32)));
 static unsigned char piobuf[1024 * 512] __attribute__((aligned(32)));
 static unsigned char tmp[512] __attribute__((aligned(32)));
 
+#define QUEUE_REQS  8
+
+static g1_ata_req_t reqs[QUEUE_REQS];
+static volatile int reqs_done = 0;
+
+static void req_done(g1_ata_req_t *req, int status) {
+    (void)req;
+    (void)status;
+
+    ++reqs_done;
+}
+
 int main(int argc, char *argv[]) {
     kos_blockdev_t bd_pio, bd_dma;
     uint64 spio, epio, sdma, edma, timer;
     uint8_t pt;
+    int i;
 
     dbglog(DBG_DEBUG, "Starting G1 ATA test program...\n");
     g1_ata_init();
@@ -89,6 +107,54 @@ int main(int argc, char *argv[]) {
         dbglog(DBG_DEBUG, "Both buffers matched!\n");
     }
 
+    /* Read the first 1024 sectors of the disk with queued DMA requests. */
+    dbglog(DBG_DEBUG, "Reading 1024 blocks by queued DMA!\n");
+
+    sdma = timer_ms_gettime64();
+
+    for(i = 0; i < QUEUE_REQS; ++i) {
+        reqs[i].sector = i * (1024 / QUEUE_REQS);
+        reqs[i].count = 1024 / QUEUE_REQS;
+        reqs[i].buf = dmabuf + i * (1024 / QUEUE_REQS) * 512;
+        reqs[i].callback = &req_done;
+
+        if(g1_ata_queue_read_dma(&reqs[i])) {
+            dbglog(DBG_DEBUG, "couldn't queue DMA read: %s\n",
+                   strerror(errno));
+            return -1;
+        }
+    }
+
+    /* This is where you'd do something useful with each request's data as it
+       comes in... */
+    while(reqs_done < QUEUE_REQS)
+        thd_pass();
+
+    edma = timer_ms_gettime64();
+    timer = edma - sdma;
+
+    dbglog(DBG_DEBUG, "Queued DMA read took %llu ms (%f MB/sec)\n", timer,
+           (512 * 1024) / ((double)timer) / 1000.0);
+
+    for(i = 0; i < QUEUE_REQS; ++i) {
+        if(reqs[i].status) {
+            dbglog(DBG_DEBUG, "Queued request %d failed!\n", i);
+            return -1;
+        }
+    }
+
+    if(g1_ata_read_lba(0, 1024, piobuf)) {
+        dbglog(DBG_DEBUG, "couldn't read block by PIO: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if(memcmp(piobuf, dmabuf, 1024 * 512)) {
+        dbglog(DBG_DEBUG, "Queued DMA buffer does not match?!\n");
+    }
+    else {
+        dbglog(DBG_DEBUG, "Queued DMA buffer matched!\n");
+    }
+
     /* Clean up... */
     g1_ata_shutdown();
 
@@ -0,0 +1,120 @@
+/* KallistiOS ##version##
+
+   bfont_text.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example draws a screen of debug text every frame with the BIOS font
+   text drawing in dc/pvr/pvr_bfont.h: a few lines of changing numbers in
+   several colors, some Japanese, and Dreamcast and VMU icons.
+
+   Each glyph is copied into the atlas texture the first time it's drawn,
+   and is a single sprite from then on. After a few seconds, the average
+   time spent drawing the text each frame is printed, next to the time it
+   takes bfont_draw_str_ex() to draw the same text into a framebuffer sized
+   buffer in RAM with the CPU.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <dc/pvr.h>
+#include <dc/biosfont.h>
+#include <dc/pvr/pvr_bfont.h>
+#include <dc/pvr/pvr_sprite_batch.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define LINES   16
+#define FRAMES  300
+
+static const uint32_t colors[] = {
+    0xffffffff, 0xffff8080, 0xff80ff80, 0xff8080ff, 0xffffff80
+};
+
+/* "Nihongo" (Japanese) in Shift-JIS, then a few icons */
+static const char extra[] = "\x93\xfa\x96\x7b\x8c\xea  \\di14 \\di15 \\vi05";
+
+static uint16_t ram_fb[640 * 480];
+
+static void make_line(char *buf, size_t size, int line, int frame) {
+    snprintf(buf, size, "line %2d  frame %5d  value %08x  %6.2f", line, frame,
+             (unsigned)rand(), (double)(frame * 0.01f * line));
+}
+
+int main(int argc, char *argv[]) {
+    pvr_sprite_batch_params_t bp = { 2048, 64 };
+    pvr_bfont_params_t tp = { 512, 256, PVR_LIST_TR_POLY, 0 };
+    pvr_bfont_stats_t st;
+    uint64_t t, pvr_us = 0, cpu_us = 0;
+    char buf[LINES][64];
+    int frame, i;
+
+    (void)argc;
+    (void)argv;
+
+    pvr_init_defaults();
+    pvr_set_bg_color(0.1f, 0.1f, 0.2f);
+    bfont_set_encoding(BFONT_CODE_SJIS);
+
+    if(pvr_sprite_batch_init(&bp) < 0 || pvr_bfont_init(&tp) < 0) {
+        printf("can't set up text drawing\n");
+        return -1;
+    }
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        for(i = 0; i < LINES; i++)
+            make_line(buf[i], sizeof(buf[i]), i, frame);
+
+        pvr_wait_ready();
+        pvr_scene_begin();
+        pvr_list_begin(PVR_LIST_TR_POLY);
+
+        t = timer_us_gettime64();
+
+        for(i = 0; i < LINES; i++)
+            pvr_bfont_draw(16.0f, 16.0f + i * 24.0f, 10.0f,
+                           colors[i % 5], buf[i]);
+
+        pvr_bfont_draw(16.0f, 16.0f + LINES * 24.0f, 10.0f, 0xffffffff,
+                       extra);
+
+        pvr_us += timer_us_gettime64() - t;
+
+        pvr_list_finish();
+        pvr_scene_finish();
+
+        /* The same text, drawn the old way */
+        t = timer_us_gettime64();
+
+        for(i = 0; i < LINES; i++)
+            bfont_draw_str_ex(ram_fb + (16 + i * 24) * 640 + 16, 640,
+                              colors[i % 5], 0, 16, false, buf[i]);
+
+        bfont_draw_str_ex(ram_fb + (16 + LINES * 24) * 640 + 16, 640,
+                          0xffff, 0, 16, false, extra);
+
+        cpu_us += timer_us_gettime64() - t;
+    }
+
+    pvr_bfont_stats(&st);
+
+    printf("%d lines, %d frames\n", LINES + 1, FRAMES);
+    printf("pvr_bfont_draw:    %5lu us per frame\n",
+           (unsigned long)(pvr_us / FRAMES));
+    printf("bfont_draw_str_ex: %5lu us per frame\n\n",
+           (unsigned long)(cpu_us / FRAMES));
+    printf("%llu glyphs, %llu loads, %llu evictions, %llu dropped\n",
+           (unsigned long long)st.glyphs, (unsigned long long)st.loads,
+           (unsigned long long)st.evictions, (unsigned long long)st.dropped);
+
+    pvr_bfont_shutdown();
+    pvr_sprite_batch_shutdown();
+    pvr_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+/* KallistiOS ##version##
+
+   cmdbuf_threads.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example builds the opaque list from several threads at once, using
+   command buffers. The screen is a grid of colored quads, split into bands of
+   rows; each worker thread fills the command buffer for its own band, and the
+   main thread attaches them to the list in band order once they're all done.
+
+   Press Start to exit.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_cmdbuf.h>
+#include <dc/maple.h>
+#include <dc/maple/controller.h>
+
+#include <kos/init.h>
+#include <kos/sem.h>
+#include <kos/thread.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define WORKERS     4
+#define GRID_W      32
+#define GRID_H      32
+#define BAND_H      (GRID_H / WORKERS)
+
+/* Bytes of vertex data in one band, with its header */
+#define BAND_SIZE   (sizeof(pvr_poly_hdr_t) + \
+                     BAND_H * GRID_W * 4 * sizeof(pvr_vertex_t))
+
+static pvr_init_params_t params = {
+    /* Only opaque polygons */
+    { PVR_BINSIZE_16, PVR_BINSIZE_0, PVR_BINSIZE_0, PVR_BINSIZE_0,
+      PVR_BINSIZE_0 },
+
+    /* Vertex buffer size */
+    512 * 1024,
+
+    /* Vertex DMA enabled */
+    1,
+
+    /* No FSAA */
+    0,
+
+    /* Translucent Autosort enabled. */
+    0,
+
+    /* Extra OPBs */
+    3,
+
+    /* Vertex buffer double-buffering enabled */
+    0
+};
+
+/* Nothing but the blank header pvr_scene_finish() puts in every list goes in
+   the list's own vertex buffer, which has to keep another 32 bytes free. */
+static uint8_t op_buf[2 * 64] __attribute__((aligned(32)));
+
+typedef struct worker {
+    int band;
+    kthread_t *thd;
+    semaphore_t go;
+    pvr_cmdbuf_t cb;
+    uint8_t buf[2 * BAND_SIZE] __attribute__((aligned(32)));
+} worker_t;
+
+static worker_t workers[WORKERS];
+static semaphore_t done = SEM_INITIALIZER(0);
+static pvr_poly_hdr_t hdr;
+static volatile int frame;
+static volatile bool quit;
+
+static void build_band(worker_t *w) {
+    float qw = 640.0f / GRID_W, qh = 480.0f / GRID_H;
+    pvr_vertex_t *v;
+    uint32_t c;
+    int row, i;
+
+    pvr_cmdbuf_prim(&w->cb, &hdr, sizeof(hdr));
+
+    for(row = w->band * BAND_H; row < (w->band + 1) * BAND_H; row++) {
+        float y = row * qh;
+
+        v = pvr_cmdbuf_reserve(&w->cb, GRID_W * 4 * sizeof(pvr_vertex_t));
+
+        if(!v)
+            return;
+
+        for(i = 0; i < GRID_W; i++, v += 4) {
+            float x = i * qw;
+
+            c = 0xff000000 | (((i * 8 + frame) & 0xff) << 16) |
+                (((row * 8) & 0xff) << 8) | ((w->band * 64) & 0xff);
+
+            v[0].flags = PVR_CMD_VERTEX;
+            v[0].x = x;
+            v[0].y = y + qh;
+            v[0].z = 1.0f;
+            v[0].argb = c;
+            v[0].oargb = 0;
+
+            v[1].flags = PVR_CMD_VERTEX;
+            v[1].x = x;
+            v[1].y = y;
+            v[1].z = 1.0f;
+            v[1].argb = c;
+            v[1].oargb = 0;
+
+            v[2].flags = PVR_CMD_VERTEX;
+            v[2].x = x + qw;
+            v[2].y = y + qh;
+            v[2].z = 1.0f;
+            v[2].argb = c;
+            v[2].oargb = 0;
+
+            v[3].flags = PVR_CMD_VERTEX_EOL;
+            v[3].x = x + qw;
+            v[3].y = y;
+            v[3].z = 1.0f;
+            v[3].argb = c;
+            v[3].oargb = 0;
+        }
+
+        pvr_cmdbuf_commit(&w->cb, GRID_W * 4 * sizeof(pvr_vertex_t));
+    }
+}
+
+static void *worker_thd(void *param) {
+    worker_t *w = (worker_t *)param;
+
+    for(;;) {
+        sem_wait(&w->go);
+
+        if(quit)
+            break;
+
+        build_band(w);
+        sem_signal(&done);
+    }
+
+    return NULL;
+}
+
+static void draw_frame(void) {
+    int i;
+
+    pvr_wait_ready();
+    pvr_scene_begin();
+
+    /* Start all of the workers on this frame... */
+    for(i = 0; i < WORKERS; i++) {
+        pvr_cmdbuf_begin(&workers[i].cb);
+        sem_signal(&workers[i].go);
+    }
+
+    /* ...wait for them all to finish, in whatever order they do... */
+    for(i = 0; i < WORKERS; i++)
+        sem_wait(&done);
+
+    /* ...then put their work in the list in a fixed order. */
+    pvr_list_begin(PVR_LIST_OP_POLY);
+
+    for(i = 0; i < WORKERS; i++)
+        pvr_list_cmdbuf(PVR_LIST_OP_POLY, &workers[i].cb);
+
+    pvr_list_finish();
+
+    pvr_scene_finish();
+}
+
+int main(int argc, char *argv[]) {
+    pvr_poly_cxt_t cxt;
+    maple_device_t *cont;
+    cont_state_t *state;
+    int i;
+
+    (void)argc;
+    (void)argv;
+
+    if(pvr_init(&params) < 0)
+        return -1;
+
+    pvr_set_vertbuf(PVR_LIST_OP_POLY, op_buf, sizeof(op_buf));
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    pvr_poly_compile(&hdr, &cxt);
+
+    for(i = 0; i < WORKERS; i++) {
+        workers[i].band = i;
+        sem_init(&workers[i].go, 0);
+        pvr_cmdbuf_init(&workers[i].cb, workers[i].buf, sizeof(workers[i].buf));
+        workers[i].thd = thd_create(false, worker_thd, workers + i);
+    }
+
+    printf("%d workers building %d quads each\n", WORKERS, BAND_H * GRID_W);
+
+    while(!quit) {
+        if((cont = maple_enum_type(0, MAPLE_FUNC_CONTROLLER))) {
+            state = (cont_state_t *)maple_dev_status(cont);
+
+            if(state && (state->buttons & CONT_START))
+                quit = true;
+        }
+
+        draw_frame();
+        frame++;
+    }
+
+    for(i = 0; i < WORKERS; i++) {
+        sem_signal(&workers[i].go);
+        thd_join(workers[i].thd, NULL);
+        sem_destroy(&workers[i].go);
+    }
+
+    pvr_shutdown();
+    return 0;
+}
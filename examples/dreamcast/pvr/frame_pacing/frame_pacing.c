@@ -0,0 +1,168 @@
+/* KallistiOS ##version##
+
+   frame_pacing.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example shows how to pace frames with dc/pvr/pvr_pace.h. It draws a
+   few hundred moving quads, with a CPU load that's a little under a frame's
+   worth most of the time and goes over it every so often, the way a game's
+   does when something happens. It runs for a while each in a few ways:
+
+   - with pvr_wait_ready() only, as most programs do;
+   - paced at 60Hz, with late flips;
+   - paced at 60Hz, starting just in time, with late flips, polling the
+     controllers at the start of each frame;
+   - paced at 30Hz.
+
+   and prints how many frames were shown on time, late, or flipped to late,
+   along with the time between vertical blanks each way took per frame.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_pace.h>
+#include <dc/maple.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define QUADS       400
+#define FRAMES      600
+
+/* CPU time per frame, and that of every SPIKE_EVERY'th one, in us. */
+#define LOAD_US         9000
+#define SPIKE_US        14000
+#define SPIKE_EVERY     20
+
+static pvr_poly_hdr_t hdr;
+
+static void draw_frame(int frame) {
+    pvr_vertex_t v[4];
+    float x, y, s = 24.0f;
+    uint32_t c;
+    int i, j;
+
+    pvr_list_begin(PVR_LIST_OP_POLY);
+    pvr_prim(&hdr, sizeof(hdr));
+
+    for(i = 0; i < QUADS; i++) {
+        x = 308.0f + 280.0f * cosf((i * 7 + frame) * 0.013f);
+        y = 228.0f + 200.0f * sinf((i * 11 + frame) * 0.017f);
+        c = 0xff000000 | ((i * 37) & 0xff) << 16 | ((i * 91) & 0xff) << 8 |
+            ((frame + i) & 0xff);
+
+        for(j = 0; j < 4; j++) {
+            v[j].flags = j == 3 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+            v[j].x = x + (j & 2 ? s : 0.0f);
+            v[j].y = y + (j & 1 ? 0.0f : s);
+            v[j].z = 1.0f + i * 0.001f;
+            v[j].argb = c;
+            v[j].oargb = 0;
+        }
+
+        pvr_prim(v, sizeof(v));
+    }
+
+    pvr_list_finish();
+}
+
+/* Stand in for a game's logic. */
+static void busy(int frame) {
+    uint64_t end = timer_us_gettime64() +
+                   (frame % SPIKE_EVERY ? LOAD_US : SPIKE_US);
+
+    while(timer_us_gettime64() < end)
+        ;
+}
+
+/* Draw FRAMES frames, paced with params if it isn't NULL, and print how it
+   went. */
+static void run(const char *name, const pvr_pace_params_t *params) {
+    pvr_pace_stats_t st;
+    pvr_stats_t ps;
+    size_t vbl;
+    int frame;
+
+    if(params && pvr_pace_init(params) < 0) {
+        printf("%s: can't start pacing\n", name);
+        return;
+    }
+
+    pvr_get_stats(&ps);
+    vbl = ps.vbl_count;
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        if(params)
+            pvr_pace_begin();
+        else
+            pvr_wait_ready();
+
+        busy(frame);
+
+        pvr_scene_begin();
+        draw_frame(frame);
+        pvr_scene_finish();
+
+        if(params)
+            pvr_pace_end();
+    }
+
+    pvr_get_stats(&ps);
+    printf("%-24s %.2f vblanks per frame\n", name,
+           (double)(ps.vbl_count - vbl) / FRAMES);
+
+    if(params) {
+        pvr_pace_stats(&st);
+        pvr_pace_shutdown();
+
+        printf("%24s %lu on time, %lu late (%lu vblanks), %lu flipped late\n",
+               "", (unsigned long)st.on_time, (unsigned long)st.late,
+               (unsigned long)st.missed_vbls, (unsigned long)st.late_flips);
+        printf("%24s cpu %lu us (max %lu), render %lu us (max %lu)\n", "",
+               (unsigned long)st.cpu_us, (unsigned long)st.cpu_max_us,
+               (unsigned long)st.render_us, (unsigned long)st.render_max_us);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    pvr_pace_params_t late = {
+        .interval = 1,
+        .late_flip_us = 4000
+    };
+    pvr_pace_params_t jit = {
+        .interval = 1,
+        .late_flip_us = 4000,
+        .jit = true,
+        .margin_us = 1000,
+        .poll_functions = MAPLE_FUNC_CONTROLLER
+    };
+    pvr_pace_params_t half = {
+        .interval = 2
+    };
+    pvr_poly_cxt_t cxt;
+
+    (void)argc;
+    (void)argv;
+
+    pvr_init_defaults();
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    pvr_poly_compile(&hdr, &cxt);
+
+    printf("%d quads, %d frames each, %d us of CPU (%d every %d frames)\n\n",
+           QUADS, FRAMES, LOAD_US, SPIKE_US, SPIKE_EVERY);
+
+    run("unpaced", NULL);
+    run("60Hz, late flips", &late);
+    run("60Hz, just in time", &jit);
+    run("30Hz", &half);
+
+    pvr_shutdown();
+    return 0;
+}
@@ -0,0 +1,231 @@
+/* KallistiOS ##version##
+
+   frame_pipeline.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example shows what the pipeline depth and frame fences in
+   dc/pvr/pvr_fence.h are for. Each frame spends a set amount of time on
+   "game logic", then sends a big grid of quads through vertex DMA, which
+   keeps the TA busy for a while, and a quad drawn with a texture that is
+   made fresh for that frame.
+
+   With a depth of 2, the CPU waits in pvr_wait_ready() for the TA to take
+   the last frame before it can start on the next. With a depth of 3, it can
+   start straight away, and only waits (in pvr_scene_finish()) if the TA is
+   still busy once it's done. For each amount of logic, the frame rate and
+   the time per frame spent waiting are printed both ways.
+
+   Each frame's texture is handed to pvr_mem_free_after() with the frame's
+   fence as soon as the frame is finished, and is freed once the frame has
+   been rendered; the texture memory free at the start and end shows that
+   none of it is lost.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_fence.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define GRID_W      64
+#define GRID_H      48
+#define FRAMES      120
+#define TXR_SIZE    64
+
+/* Bytes of vertex data in one row of quads */
+#define ROW_SIZE    (GRID_W * 4 * sizeof(pvr_vertex_t))
+
+static pvr_init_params_t params = {
+    /* Only opaque polygons */
+    { PVR_BINSIZE_16, PVR_BINSIZE_0, PVR_BINSIZE_0, PVR_BINSIZE_0,
+      PVR_BINSIZE_0 },
+
+    /* Vertex buffer size */
+    2 * 1024 * 1024,
+
+    /* Vertex DMA enabled */
+    1,
+
+    /* No FSAA */
+    0,
+
+    /* Translucent Autosort enabled. */
+    0,
+
+    /* Extra OPBs */
+    3,
+
+    /* Vertex buffer double-buffering enabled */
+    0
+};
+
+/* The whole grid, and the textured quad, doubled for double buffering */
+static uint8_t vert_buf[2 * (ROW_SIZE * GRID_H + 1024)] __attribute__((aligned(32)));
+
+static uint16_t pixels[TXR_SIZE * TXR_SIZE];
+
+static pvr_poly_hdr_t hdr;
+
+/* Stand in for the game's logic. */
+static void spin(int us) {
+    uint64_t end = timer_us_gettime64() + us;
+
+    while(timer_us_gettime64() < end)
+        ;
+}
+
+static void build_row(pvr_vertex_t *v, int row, int frame) {
+    float qw = 640.0f / GRID_W, qh = 480.0f / GRID_H;
+    float y = row * qh;
+    uint32_t c;
+    int i, j;
+
+    for(i = 0; i < GRID_W; i++, v += 4) {
+        c = 0xff000000 | (((i * 4 + frame) & 0xff) << 16) |
+            (((row * 4) & 0xff) << 8);
+
+        for(j = 0; j < 4; j++) {
+            v[j].flags = j == 3 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+            v[j].x = i * qw + (j & 2 ? qw : 0.0f);
+            v[j].y = y + (j & 1 ? 0.0f : qh);
+            v[j].z = 1.0f;
+            v[j].argb = c;
+            v[j].oargb = 0;
+        }
+    }
+}
+
+/* Make this frame's texture, and draw it in the middle of the screen. */
+static pvr_ptr_t draw_texture(int frame) {
+    pvr_poly_cxt_t cxt;
+    pvr_poly_hdr_t thdr;
+    pvr_vertex_t v[4];
+    pvr_ptr_t txr;
+    int i;
+
+    for(i = 0; i < TXR_SIZE * TXR_SIZE; i++)
+        pixels[i] = ((i + frame) & 0x1f) << 11 | (frame & 0x3f) << 5;
+
+    if(!(txr = pvr_mem_malloc(sizeof(pixels))))
+        return NULL;
+
+    pvr_txr_load(pixels, txr, sizeof(pixels));
+
+    pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY,
+                     PVR_TXRFMT_RGB565 | PVR_TXRFMT_NONTWIDDLED, TXR_SIZE,
+                     TXR_SIZE, txr, PVR_FILTER_NONE);
+    pvr_poly_compile(&thdr, &cxt);
+    pvr_list_prim(PVR_LIST_OP_POLY, &thdr, sizeof(thdr));
+
+    for(i = 0; i < 4; i++) {
+        v[i].flags = i == 3 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+        v[i].x = 256.0f + (i & 2 ? 128.0f : 0.0f);
+        v[i].y = 176.0f + (i & 1 ? 0.0f : 128.0f);
+        v[i].z = 2.0f;
+        v[i].u = i & 2 ? 1.0f : 0.0f;
+        v[i].v = i & 1 ? 0.0f : 1.0f;
+        v[i].argb = 0xffffffff;
+        v[i].oargb = 0;
+    }
+
+    pvr_list_prim(PVR_LIST_OP_POLY, v, sizeof(v));
+
+    return txr;
+}
+
+/* Draw FRAMES frames, returning the frame rate, and the average time spent
+   waiting per frame in *wait_us. */
+static float run(int depth, int logic_us, uint64_t *wait_us) {
+    uint64_t t, start, waited = 0;
+    pvr_vertex_t *v;
+    pvr_ptr_t txr;
+    int frame, row;
+
+    pvr_set_pipeline_depth(depth);
+    start = timer_us_gettime64();
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        t = timer_us_gettime64();
+        pvr_wait_ready();
+        waited += timer_us_gettime64() - t;
+
+        pvr_scene_begin();
+        spin(logic_us);
+
+        pvr_list_begin(PVR_LIST_OP_POLY);
+        pvr_list_prim(PVR_LIST_OP_POLY, &hdr, sizeof(hdr));
+
+        for(row = 0; row < GRID_H; row++) {
+            if(!(v = pvr_list_reserve(PVR_LIST_OP_POLY, ROW_SIZE)))
+                break;
+
+            build_row(v, row, frame);
+            pvr_list_commit(PVR_LIST_OP_POLY, ROW_SIZE);
+        }
+
+        txr = draw_texture(frame);
+        pvr_list_finish();
+
+        t = timer_us_gettime64();
+        pvr_scene_finish();
+        waited += timer_us_gettime64() - t;
+
+        /* The PVR still needs it until this frame is rendered. */
+        if(txr)
+            pvr_mem_free_after(txr, pvr_scene_fence());
+    }
+
+    /* Let the pipeline empty out before the depth is changed. */
+    pvr_fence_wait(pvr_scene_fence(), PVR_FENCE_DISPLAYED, 1000);
+    pvr_fence_collect();
+
+    *wait_us = waited / FRAMES;
+
+    return FRAMES * 1000000.0f / (timer_us_gettime64() - start);
+}
+
+int main(int argc, char *argv[]) {
+    static const int logic[] = { 0, 4000, 8000, 12000 };
+    pvr_poly_cxt_t cxt;
+    uint64_t w2, w3;
+    float f2, f3;
+    size_t avail;
+    unsigned int i;
+
+    (void)argc;
+    (void)argv;
+
+    if(pvr_init(&params) < 0)
+        return -1;
+
+    pvr_set_vertbuf(PVR_LIST_OP_POLY, vert_buf, sizeof(vert_buf));
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    pvr_poly_compile(&hdr, &cxt);
+
+    avail = pvr_mem_available();
+
+    printf("%d quads per frame, %d frames each\n\n", GRID_W * GRID_H, FRAMES);
+    printf("%10s %18s %18s\n", "logic us", "depth 2", "depth 3");
+
+    for(i = 0; i < sizeof(logic) / sizeof(logic[0]); i++) {
+        f2 = run(2, logic[i], &w2);
+        f3 = run(3, logic[i], &w3);
+
+        printf("%10d %6.1f fps %5lu us %6.1f fps %5lu us\n", logic[i],
+               (double)f2, (unsigned long)w2, (double)f3,
+               (unsigned long)w3);
+    }
+
+    printf("\ntexture memory free: %u before, %u after\n", (unsigned)avail,
+           (unsigned)pvr_mem_available());
+
+    pvr_shutdown();
+    return 0;
+}
@@ -19,6 +19,10 @@
    This effect demonstrates how to use 8-bit textures with dynamic palette 
    animation, giving the appearance of a smoothly animated wormhole. The player
    can press the START button on the controller to exit the demo.
+
+   The palette is a bank allocated from the palette table, and each frame's
+   colors are staged and committed together, so that they change between
+   renders rather than partway through one.
 */
 
 #include <stdlib.h>
@@ -58,6 +62,7 @@ static const uint32_t wormhole_palette[32] = {
 };
 
 static pvr_poly_hdr_t hdr;
+static int pal_base;
 
 static void draw_screen() {
     pvr_vertex_t vert;
@@ -141,7 +146,9 @@ static void animate_wormhole(uint32_t frame) {
     /* Simulate movement by changing palette over time, keeping index 0 fixed */
     int offset = frame % 31;  
     for(int i = 1; i < 32; i++) /* Start from 1 to exclude index 0(BG color) */
-        pvr_set_pal_entry(i, wormhole_palette[(i + offset) % 31 + 1]);
+        pvr_pal_stage(pal_base + i, wormhole_palette[(i + offset) % 31 + 1]);
+
+    pvr_pal_commit();
 }
 
 static int check_start(void) {
@@ -167,12 +174,13 @@ int main(int argc, char** argv) {
     /* Initialize the texture */
     texptr = generate_texture(WORMHOLE_WIDTH, WORMHOLE_HEIGHT);
 
-    /* Set the background color */
-    pvr_set_pal_entry(0, wormhole_palette[0]);
+    /* Get a palette and set the background color */
+    pal_base = pvr_pal_bank_alloc(256);
+    pvr_pal_stage(pal_base, wormhole_palette[0]);
 
     /* Setup PVR context */
     pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY, PVR_TXRFMT_PAL8BPP | 
-                    PVR_TXRFMT_8BPP_PAL(0), WORMHOLE_WIDTH, WORMHOLE_HEIGHT, 
+                    PVR_TXRFMT_8BPP_PAL(pal_base / 256), WORMHOLE_WIDTH, WORMHOLE_HEIGHT, 
                     texptr, PVR_FILTER_BILINEAR);
     pvr_poly_compile(&hdr, &cxt);
 
@@ -193,6 +201,7 @@ int main(int argc, char** argv) {
     }
 
     pvr_mem_free(texptr);
+    pvr_pal_bank_free(pal_base);
 
     return 0;
 }
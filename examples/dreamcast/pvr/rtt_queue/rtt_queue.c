@@ -0,0 +1,181 @@
+/* KallistiOS ##version##
+
+   rtt_queue.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example renders into three textures every frame with the render
+   target queue in dc/pvr/pvr_rtt.h, then draws all three on the screen.
+
+   Two of the targets are 256x256 and one is 512x256, each with a spinning
+   fan of triangles of its own color. Only the tiles each target covers are
+   registered and rendered, and the two 256x256 targets share a tile matrix
+   layout. After a few seconds, the average registration and render times
+   of each target are printed, along with the frame rate.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_rtt.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define TARGETS 3
+#define FRAMES  300
+#define FAN     24
+
+static const struct {
+    uint32_t w, h;
+    uint32_t color;
+} sizes[TARGETS] = {
+    { 256, 256, 0xffff4040 },
+    { 256, 256, 0xff40ff40 },
+    { 512, 256, 0xff4040ff },
+};
+
+static int targets[TARGETS];
+static pvr_ptr_t textures[TARGETS];
+static int frame;
+
+/* Draw a fan of triangles around the middle of a w by h area. */
+static void draw_fan(float w, float h, float angle, uint32_t color) {
+    pvr_poly_cxt_t cxt;
+    pvr_poly_hdr_t hdr;
+    pvr_vertex_t v[3];
+    float r = (w < h ? w : h) * 0.45f, a;
+    int i;
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    pvr_poly_compile(&hdr, &cxt);
+    pvr_prim(&hdr, sizeof(hdr));
+
+    for(i = 0; i < FAN; i += 2) {
+        a = angle + i * 2.0f * (float)M_PI / FAN;
+
+        v[0].flags = PVR_CMD_VERTEX;
+        v[0].x = w / 2;
+        v[0].y = h / 2;
+        v[0].z = 1.0f;
+        v[0].argb = 0xffffffff;
+        v[0].oargb = 0;
+
+        v[1] = v[0];
+        v[1].x = w / 2 + r * cosf(a);
+        v[1].y = h / 2 + r * sinf(a);
+        v[1].argb = color;
+
+        v[2] = v[1];
+        v[2].flags = PVR_CMD_VERTEX_EOL;
+        v[2].x = w / 2 + r * cosf(a + 2.0f * (float)M_PI / FAN);
+        v[2].y = h / 2 + r * sinf(a + 2.0f * (float)M_PI / FAN);
+
+        pvr_prim(v, sizeof(v));
+    }
+}
+
+static void draw_target(int target, void *data) {
+    int i = (int)(intptr_t)data;
+
+    pvr_list_begin(PVR_LIST_OP_POLY);
+    draw_fan(sizes[i].w, sizes[i].h, frame * 0.02f * (i + 1),
+             sizes[i].color);
+    pvr_list_finish();
+
+    (void)target;
+}
+
+/* Draw texture i at x, y on the screen. */
+static void draw_texture(int i, float x, float y) {
+    pvr_poly_cxt_t cxt;
+    pvr_poly_hdr_t hdr;
+    pvr_vertex_t v[4];
+    int j;
+
+    pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY,
+                     PVR_TXRFMT_RGB565 | PVR_TXRFMT_NONTWIDDLED, sizes[i].w,
+                     sizes[i].h, textures[i], PVR_FILTER_NONE);
+    pvr_poly_compile(&hdr, &cxt);
+    pvr_prim(&hdr, sizeof(hdr));
+
+    for(j = 0; j < 4; j++) {
+        v[j].flags = j == 3 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+        v[j].x = x + (j & 2 ? sizes[i].w : 0);
+        v[j].y = y + (j & 1 ? 0 : sizes[i].h);
+        v[j].z = 1.0f;
+        v[j].u = j & 2 ? 1.0f : 0.0f;
+        v[j].v = j & 1 ? 0.0f : 1.0f;
+        v[j].argb = 0xffffffff;
+        v[j].oargb = 0;
+    }
+
+    pvr_prim(v, sizeof(v));
+}
+
+int main(int argc, char *argv[]) {
+    pvr_rtt_stats_t st;
+    uint64_t start;
+    uint32_t n;
+    int i;
+
+    (void)argc;
+    (void)argv;
+
+    pvr_init_defaults();
+    pvr_set_bg_color(0.2f, 0.2f, 0.2f);
+
+    for(i = 0; i < TARGETS; i++) {
+        textures[i] = pvr_mem_malloc(sizes[i].w * sizes[i].h * 2);
+        targets[i] = pvr_rtt_target(textures[i], sizes[i].w, sizes[i].h);
+
+        if(!textures[i] || targets[i] < 0) {
+            printf("couldn't set up target %d\n", i);
+            return -1;
+        }
+    }
+
+    start = timer_us_gettime64();
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        for(i = 0; i < TARGETS; i++)
+            pvr_rtt_queue(targets[i], draw_target, (void *)(intptr_t)i);
+
+        pvr_rtt_flush();
+
+        pvr_wait_ready();
+        pvr_scene_begin();
+        pvr_list_begin(PVR_LIST_OP_POLY);
+        draw_texture(0, 32.0f, 32.0f);
+        draw_texture(1, 352.0f, 32.0f);
+        draw_texture(2, 64.0f, 320.0f);
+        pvr_list_finish();
+        pvr_scene_finish();
+    }
+
+    printf("\n%.1f fps with %d targets\n\n",
+           FRAMES * 1000000.0 / (timer_us_gettime64() - start), TARGETS);
+    printf("%-8s %8s %10s %10s   (us per render)\n", "target", "renders",
+           "register", "render");
+
+    for(i = 0; i < TARGETS; i++) {
+        pvr_rtt_stats(targets[i], &st);
+        n = st.renders ? st.renders : 1;
+
+        printf("%3lux%-4lu %8lu %10.1f %10.1f\n", (unsigned long)sizes[i].w,
+               (unsigned long)sizes[i].h, (unsigned long)st.renders,
+               st.reg_total / 1000.0 / n, st.rnd_total / 1000.0 / n);
+    }
+
+    for(i = 0; i < TARGETS; i++) {
+        pvr_rtt_target_free(targets[i]);
+        pvr_mem_free(textures[i]);
+    }
+
+    pvr_shutdown();
+    return 0;
+}
@@ -0,0 +1,275 @@
+/* KallistiOS ##version##
+
+   sprite_batch.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example finds out how many sprites can be drawn at 60 frames per
+   second, two ways: the usual way, compiling a header for each sprite and
+   sending it and the sprite with pvr_prim(), and with the sprite batcher in
+   dc/pvr/pvr_sprite_batch.h, which sorts the sprites by state and sends one
+   header for each run of them through the store queues.
+
+   The sprites are small, translucent and textured, using one of four
+   textures and one of two blending modes each, in four layers. The number
+   of sprites goes up until the frame rate drops below 60, or there's no
+   more room; for each count, the time spent submitting per frame and the
+   frame rate are printed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_sprite_batch.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define MAX_SPRITES 16384
+#define STEP        1024
+#define FRAMES      60
+#define SPR_SIZE    16.0f
+#define TXR_SIZE    32
+#define TEXTURES    4
+#define STATES      (TEXTURES * 2)
+
+static pvr_init_params_t params = {
+    /* Only translucent polygons */
+    { PVR_BINSIZE_0, PVR_BINSIZE_0, PVR_BINSIZE_16, PVR_BINSIZE_0,
+      PVR_BINSIZE_0 },
+
+    /* Vertex buffer size */
+    2 * 1024 * 1024,
+
+    /* No DMA */
+    0,
+
+    /* No FSAA */
+    0,
+
+    /* Translucent Autosort enabled. */
+    0,
+
+    /* Extra OPBs */
+    3,
+
+    /* Vertex buffer double-buffering enabled */
+    0
+};
+
+static pvr_ptr_t textures[TEXTURES];
+static int states[STATES];
+
+/* Where each sprite starts, and which way it moves */
+static float pos_x[MAX_SPRITES], pos_y[MAX_SPRITES];
+static float vel_x[MAX_SPRITES], vel_y[MAX_SPRITES];
+
+enum {
+    MODE_PRIM,
+    MODE_BATCH
+};
+
+static void make_textures(void) {
+    static uint16_t pixels[TXR_SIZE * TXR_SIZE];
+    static const uint16_t colors[TEXTURES] = { 0x0f44, 0x04f4, 0x044f, 0x0ff4 };
+    int t, x, y, dx, dy;
+
+    for(t = 0; t < TEXTURES; t++) {
+        /* A soft edged ball */
+        for(y = 0; y < TXR_SIZE; y++) {
+            for(x = 0; x < TXR_SIZE; x++) {
+                dx = x - TXR_SIZE / 2;
+                dy = y - TXR_SIZE / 2;
+                pixels[y * TXR_SIZE + x] = colors[t] |
+                    (dx * dx + dy * dy < (TXR_SIZE * TXR_SIZE) / 4 ?
+                     0xc000 : 0);
+            }
+        }
+
+        textures[t] = pvr_mem_malloc(sizeof(pixels));
+        pvr_txr_load(pixels, textures[t], sizeof(pixels));
+    }
+}
+
+static void sprite_cxt(pvr_sprite_cxt_t *cxt, int s) {
+    pvr_sprite_cxt_txr(cxt, PVR_LIST_TR_POLY,
+                       PVR_TXRFMT_ARGB4444 | PVR_TXRFMT_NONTWIDDLED,
+                       TXR_SIZE, TXR_SIZE, textures[s % TEXTURES],
+                       PVR_FILTER_NONE);
+
+    /* Every other state is additive */
+    if(s >= TEXTURES)
+        cxt->blend.dst = PVR_BLEND_ONE;
+}
+
+static void setup(void) {
+    pvr_sprite_batch_params_t bp = { MAX_SPRITES, STATES };
+    pvr_sprite_cxt_t cxt;
+    pvr_sprite_hdr_t hdr;
+    int i;
+
+    make_textures();
+    pvr_sprite_batch_init(&bp);
+
+    for(i = 0; i < STATES; i++) {
+        sprite_cxt(&cxt, i);
+        pvr_sprite_compile(&hdr, &cxt);
+        states[i] = pvr_sprite_batch_state(&hdr);
+    }
+
+    for(i = 0; i < MAX_SPRITES; i++) {
+        pos_x[i] = rand() % (640 - (int)SPR_SIZE);
+        pos_y[i] = rand() % (480 - (int)SPR_SIZE);
+        vel_x[i] = (rand() % 5) - 2;
+        vel_y[i] = (rand() % 5) - 2;
+    }
+}
+
+/* Where sprite i is in the given frame, bouncing back and forth. */
+static void sprite_pos(int i, int frame, float *x, float *y) {
+    int fx = (int)(pos_x[i] + vel_x[i] * frame) % (2 * (640 - (int)SPR_SIZE));
+    int fy = (int)(pos_y[i] + vel_y[i] * frame) % (2 * (480 - (int)SPR_SIZE));
+
+    if(fx < 0)
+        fx = -fx;
+
+    if(fy < 0)
+        fy = -fy;
+
+    *x = fx < 640 - SPR_SIZE ? fx : 2 * (640 - SPR_SIZE) - fx;
+    *y = fy < 480 - SPR_SIZE ? fy : 2 * (480 - SPR_SIZE) - fy;
+}
+
+/* The usual way: a compiled header and two pvr_prim() calls per sprite */
+static void draw_prim(int count, int frame) {
+    pvr_sprite_cxt_t cxt;
+    pvr_sprite_hdr_t hdr;
+    pvr_sprite_txr_t spr;
+    float x, y;
+    int i;
+
+    spr.flags = PVR_CMD_VERTEX_EOL;
+    spr.dummy = 0;
+    spr.auv = PVR_PACK_16BIT_UV(0.0f, 0.0f);
+    spr.buv = PVR_PACK_16BIT_UV(1.0f, 0.0f);
+    spr.cuv = PVR_PACK_16BIT_UV(1.0f, 1.0f);
+
+    for(i = 0; i < count; i++) {
+        sprite_cxt(&cxt, i % STATES);
+        pvr_sprite_compile(&hdr, &cxt);
+        pvr_prim(&hdr, sizeof(hdr));
+
+        sprite_pos(i, frame, &x, &y);
+        spr.ax = x;
+        spr.ay = y;
+        spr.az = 1.0f + (i & 3);
+        spr.bx = x + SPR_SIZE;
+        spr.by = y;
+        spr.bz = spr.az;
+        spr.cx = x + SPR_SIZE;
+        spr.cy = y + SPR_SIZE;
+        spr.cz = spr.az;
+        spr.dx = x;
+        spr.dy = y + SPR_SIZE;
+        pvr_prim(&spr, sizeof(spr));
+    }
+}
+
+static void draw_batch(int count, int frame) {
+    float x, y;
+    int i;
+
+    for(i = 0; i < count; i++) {
+        sprite_pos(i, frame, &x, &y);
+        pvr_sprite_batch_rect(states[i % STATES], i & 3, x, y, SPR_SIZE,
+                              SPR_SIZE, 1.0f + (i & 3), 0.0f, 0.0f, 1.0f,
+                              1.0f);
+    }
+}
+
+/* Draw FRAMES frames of count sprites. Returns the frame rate, and the
+   average time spent submitting in *submit_us. */
+static float run(int mode, int count, uint64_t *submit_us) {
+    uint64_t begin, start, total = 0;
+    int frame;
+
+    pvr_wait_ready();
+    start = timer_us_gettime64();
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        pvr_wait_ready();
+
+        begin = timer_us_gettime64();
+        pvr_scene_begin();
+        pvr_list_begin(PVR_LIST_TR_POLY);
+
+        if(mode == MODE_PRIM)
+            draw_prim(count, frame);
+        else
+            draw_batch(count, frame);
+
+        pvr_list_finish();
+        pvr_scene_finish();
+        total += timer_us_gettime64() - begin;
+    }
+
+    pvr_wait_ready();
+    *submit_us = total / FRAMES;
+
+    return FRAMES * 1000000.0f / (timer_us_gettime64() - start);
+}
+
+static int find_max(int mode, const char *name) {
+    uint64_t us;
+    float fps;
+    int count, best = 0;
+
+    printf("\n%s:\n", name);
+
+    for(count = STEP; count <= MAX_SPRITES; count += STEP) {
+        fps = run(mode, count, &us);
+        printf("  %6d sprites %8lu us submitting %6.1f fps\n", count,
+               (unsigned long)us, (double)fps);
+
+        /* Allow a little slack for the timing of the first frame */
+        if(fps < 59.0f)
+            break;
+
+        best = count;
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    pvr_sprite_batch_stats_t st;
+    int prim, batch;
+
+    (void)argc;
+    (void)argv;
+
+    if(pvr_init(&params) < 0)
+        return -1;
+
+    pvr_set_bg_color(0.1f, 0.1f, 0.2f);
+    setup();
+
+    prim = find_max(MODE_PRIM, "pvr_sprite_compile + pvr_prim");
+    batch = find_max(MODE_BATCH, "pvr_sprite_batch");
+    pvr_sprite_batch_stats(&st);
+
+    printf("\nsprites at 60 fps: %d with pvr_prim, %d with the batcher\n",
+           prim, batch);
+    printf("batcher: %llu sprites, %llu headers, %llu dropped, "
+           "%llu sort passes\n", (unsigned long long)st.sprites,
+           (unsigned long long)st.headers, (unsigned long long)st.dropped,
+           (unsigned long long)st.sort_passes);
+
+    pvr_sprite_batch_shutdown();
+    pvr_shutdown();
+    return 0;
+}
@@ -0,0 +1,235 @@
+/* KallistiOS ##version##
+
+   tnl_bench.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example measures how fast 3D strips can be transformed and sent to
+   the TA three ways: a vertex at a time with mat_trans_single3() and
+   pvr_prim(), a strip at a time with mat_transform_sq(), and through
+   pvr_tnl_submit(), which also rejects strips that are off the screen and
+   clips the ones that cross the near plane.
+
+   The scene is a large floor made of strips, with the camera low down in the
+   middle of it, so that some of the strips are behind the camera, some are
+   off to the sides, and some run from in front of the camera to behind it.
+   Only pvr_tnl_submit() draws those last ones properly; the other two are
+   just there for the timing.
+
+   The numbers printed are the average time per frame spent transforming and
+   submitting, and the rate at which vertices were passed in.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_tnl.h>
+#include <dc/matrix.h>
+#include <dc/matrix3d.h>
+#include <dc/fmath.h>
+#include <dc/sq.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+/* Strips in the floor, and quads in each strip */
+#define STRIPS      48
+#define QUADS       48
+#define STRIP_LEN   ((QUADS + 1) * 2)
+#define VERTS       (STRIPS * STRIP_LEN)
+
+#define FRAMES      120
+
+static pvr_init_params_t params = {
+    /* Only opaque polygons */
+    { PVR_BINSIZE_32, PVR_BINSIZE_0, PVR_BINSIZE_0, PVR_BINSIZE_0,
+      PVR_BINSIZE_0 },
+
+    /* Vertex buffer size (unused) */
+    512 * 1024,
+
+    /* No DMA */
+    0,
+
+    /* No FSAA */
+    0,
+
+    /* Translucent Autosort enabled. */
+    0,
+
+    /* Extra OPBs */
+    3,
+
+    /* Vertex buffer double-buffering enabled */
+    0
+};
+
+static pvr_vertex_t floor_verts[VERTS] __attribute__((aligned(32)));
+static pvr_poly_hdr_t hdr;
+
+enum {
+    MODE_SINGLE,
+    MODE_SQ,
+    MODE_TNL
+};
+
+/* The floor is 48 units square, centered on the origin, with strips running
+   along Z. */
+static void build_floor(void) {
+    pvr_vertex_t *v = floor_verts;
+    float x0, z;
+    uint32_t c;
+    int s, q;
+
+    for(s = 0; s < STRIPS; s++) {
+        x0 = s - STRIPS / 2.0f;
+
+        for(q = 0; q <= QUADS; q++) {
+            z = q - QUADS / 2.0f;
+            c = ((s ^ q) & 1) ? 0xff4060c0 : 0xffc0c0c0;
+
+            v->flags = PVR_CMD_VERTEX;
+            v->x = x0;
+            v->y = 0.0f;
+            v->z = z;
+            v->argb = c;
+            v->oargb = 0;
+            v++;
+
+            v->flags = q == QUADS ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+            v->x = x0 + 1.0f;
+            v->y = 0.0f;
+            v->z = z;
+            v->argb = c;
+            v->oargb = 0;
+            v++;
+        }
+    }
+}
+
+static void setup_camera(int frame) {
+    point_t eye = { 0.0f, 1.5f, 0.0f, 1.0f };
+    point_t at;
+    vector_t up = { 0.0f, 1.0f, 0.0f, 0.0f };
+    float a = frame * 0.02f;
+
+    at.x = fsin(a) * 10.0f;
+    at.y = 0.0f;
+    at.z = fcos(a) * 10.0f;
+    at.w = 1.0f;
+
+    mat_identity();
+    mat_perspective(320.0f, 240.0f, 1.0f / ftan(F_PI / 6.0f), 0.1f, 100.0f);
+    mat_lookat(&eye, &at, &up);
+}
+
+static void submit_single(void) {
+    pvr_vertex_t v;
+    int i;
+
+    for(i = 0; i < VERTS; i++) {
+        v = floor_verts[i];
+        mat_trans_single3(v.x, v.y, v.z);
+        pvr_prim(&v, sizeof(v));
+    }
+}
+
+static void submit_sq(void) {
+    int i;
+
+    for(i = 0; i < VERTS; i += STRIP_LEN)
+        mat_transform_sq(floor_verts + i, SQ_MASK_DEST(PVR_TA_INPUT),
+                         STRIP_LEN);
+}
+
+/* Render FRAMES frames, returning the total time spent submitting vertices
+   in microseconds. */
+static uint64_t run(int mode) {
+    uint64_t begin, total = 0;
+    int frame;
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        setup_camera(frame);
+
+        pvr_wait_ready();
+        pvr_scene_begin();
+        pvr_list_begin(PVR_LIST_OP_POLY);
+        pvr_prim(&hdr, sizeof(hdr));
+
+        begin = timer_us_gettime64();
+
+        switch(mode) {
+            case MODE_SINGLE:
+                submit_single();
+                break;
+            case MODE_SQ:
+                submit_sq();
+                break;
+            case MODE_TNL:
+                pvr_tnl_submit(PVR_LIST_OP_POLY, floor_verts, VERTS);
+                break;
+        }
+
+        total += timer_us_gettime64() - begin;
+
+        pvr_list_finish();
+        pvr_scene_finish();
+    }
+
+    return total;
+}
+
+static void report(const char *name, uint64_t us) {
+    double per_frame = (double)us / FRAMES;
+
+    printf("%-20s %10.1f us/frame %10.2f Mverts/s\n", name, per_frame,
+           VERTS / per_frame);
+}
+
+int main(int argc, char *argv[]) {
+    pvr_poly_cxt_t cxt;
+    pvr_tnl_stats_t st;
+    uint64_t single_us, sq_us, tnl_us;
+
+    (void)argc;
+    (void)argv;
+
+    if(pvr_init(&params) < 0)
+        return -1;
+
+    pvr_set_bg_color(0.2f, 0.3f, 0.4f);
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    cxt.gen.culling = PVR_CULLING_NONE;
+    pvr_poly_compile(&hdr, &cxt);
+
+    build_floor();
+
+    printf("%d strips of %d vertices, %d frames\n", STRIPS, STRIP_LEN,
+           FRAMES);
+
+    /* Once to warm up, then for real. */
+    run(MODE_SINGLE);
+    single_us = run(MODE_SINGLE);
+    sq_us = run(MODE_SQ);
+
+    pvr_tnl_reset_stats();
+    tnl_us = run(MODE_TNL);
+    pvr_tnl_get_stats(&st);
+
+    report("mat_trans_single3", single_us);
+    report("mat_transform_sq", sq_us);
+    report("pvr_tnl_submit", tnl_us);
+
+    printf("\nper frame: %lu strips accepted, %lu rejected, %lu split; "
+           "%lu triangles clipped, %lu rejected; %lu vertices out\n",
+           st.strips_accepted / FRAMES, st.strips_rejected / FRAMES,
+           st.strips_split / FRAMES, st.tris_clipped / FRAMES,
+           st.tris_rejected / FRAMES, st.vertices_out / FRAMES);
+
+    pvr_shutdown();
+    return 0;
+}
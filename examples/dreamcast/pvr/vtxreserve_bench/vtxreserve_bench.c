@@ -0,0 +1,189 @@
+/* KallistiOS ##version##
+
+   vtxreserve_bench.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example compares two ways of getting vertices into the DMA vertex
+   buffers: building them in a buffer of your own and handing them over with
+   pvr_list_prim() (which copies them in), and writing them straight into the
+   DMA buffer with pvr_list_reserve() and pvr_list_commit().
+
+   The scene is a grid of colored quads covering the screen, sent one row at a
+   time either way. The opaque list's main buffer is deliberately too small
+   for the whole grid, so the last rows spill over into its extension buffer.
+
+   The numbers printed are the average time per frame spent generating and
+   submitting vertices, and the rate at which vertex data went in.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <dc/pvr.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define GRID_W      64
+#define GRID_H      64
+#define FRAMES      120
+
+/* Bytes of vertex data in one row of quads */
+#define ROW_SIZE    (GRID_W * 4 * sizeof(pvr_vertex_t))
+
+static pvr_init_params_t params = {
+    /* Only opaque polygons */
+    { PVR_BINSIZE_16, PVR_BINSIZE_0, PVR_BINSIZE_0, PVR_BINSIZE_0,
+      PVR_BINSIZE_0 },
+
+    /* Vertex buffer size */
+    2 * 1024 * 1024,
+
+    /* Vertex DMA enabled */
+    1,
+
+    /* No FSAA */
+    0,
+
+    /* Translucent Autosort enabled. */
+    0,
+
+    /* Extra OPBs */
+    3,
+
+    /* Vertex buffer double-buffering enabled */
+    0
+};
+
+/* About half of the rows fit in the main buffer, and the rest go in the
+   extension (which has a couple of rows to spare). Each is doubled for double
+   buffering. */
+static uint8_t main_buf[2 * ROW_SIZE * (GRID_H / 2)] __attribute__((aligned(32)));
+static uint8_t ext_buf[2 * ROW_SIZE * (GRID_H / 2 + 2)] __attribute__((aligned(32)));
+
+/* Where rows are built before pvr_list_prim() copies them */
+static pvr_vertex_t row_buf[GRID_W * 4];
+
+static pvr_poly_hdr_t hdr;
+
+/* Fill in the vertices for one row of quads. */
+static void build_row(pvr_vertex_t *v, int row, int frame) {
+    float qw = 640.0f / GRID_W, qh = 480.0f / GRID_H;
+    float y = row * qh;
+    uint32_t c;
+    int i;
+
+    for(i = 0; i < GRID_W; i++, v += 4) {
+        float x = i * qw;
+
+        c = 0xff000000 | (((i * 4 + frame) & 0xff) << 16) |
+            (((row * 4) & 0xff) << 8) | ((frame * 2) & 0xff);
+
+        v[0].flags = PVR_CMD_VERTEX;
+        v[0].x = x;
+        v[0].y = y + qh;
+        v[0].z = 1.0f;
+        v[0].argb = c;
+        v[0].oargb = 0;
+
+        v[1].flags = PVR_CMD_VERTEX;
+        v[1].x = x;
+        v[1].y = y;
+        v[1].z = 1.0f;
+        v[1].argb = c;
+        v[1].oargb = 0;
+
+        v[2].flags = PVR_CMD_VERTEX;
+        v[2].x = x + qw;
+        v[2].y = y + qh;
+        v[2].z = 1.0f;
+        v[2].argb = c;
+        v[2].oargb = 0;
+
+        v[3].flags = PVR_CMD_VERTEX_EOL;
+        v[3].x = x + qw;
+        v[3].y = y;
+        v[3].z = 1.0f;
+        v[3].argb = c;
+        v[3].oargb = 0;
+    }
+}
+
+/* Render FRAMES frames, returning the total time spent submitting vertices
+   in microseconds. */
+static uint64_t run(int reserve) {
+    uint64_t begin, total = 0;
+    pvr_vertex_t *v;
+    int frame, row;
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        pvr_wait_ready();
+        pvr_scene_begin();
+        pvr_list_begin(PVR_LIST_OP_POLY);
+
+        begin = timer_us_gettime64();
+        pvr_list_prim(PVR_LIST_OP_POLY, &hdr, sizeof(hdr));
+
+        for(row = 0; row < GRID_H; row++) {
+            if(reserve) {
+                if(!(v = pvr_list_reserve(PVR_LIST_OP_POLY, ROW_SIZE)))
+                    break;
+
+                build_row(v, row, frame);
+                pvr_list_commit(PVR_LIST_OP_POLY, ROW_SIZE);
+            }
+            else {
+                build_row(row_buf, row, frame);
+                pvr_list_prim(PVR_LIST_OP_POLY, row_buf, ROW_SIZE);
+            }
+        }
+
+        total += timer_us_gettime64() - begin;
+
+        pvr_list_finish();
+        pvr_scene_finish();
+    }
+
+    return total;
+}
+
+static void report(const char *name, uint64_t us) {
+    double per_frame = (double)us / FRAMES;
+
+    printf("%-20s %10.1f us/frame %10.2f MB/s\n", name, per_frame,
+           (ROW_SIZE * GRID_H) / per_frame);
+}
+
+int main(int argc, char *argv[]) {
+    pvr_poly_cxt_t cxt;
+    uint64_t copy_us, resv_us;
+
+    (void)argc;
+    (void)argv;
+
+    if(pvr_init(&params) < 0)
+        return -1;
+
+    pvr_set_vertbuf(PVR_LIST_OP_POLY, main_buf, sizeof(main_buf));
+    pvr_set_vertbuf_ext(PVR_LIST_OP_POLY, ext_buf, sizeof(ext_buf));
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    pvr_poly_compile(&hdr, &cxt);
+
+    printf("%d quads, %u bytes of vertices per frame, %d frames\n",
+           GRID_W * GRID_H, (unsigned)(ROW_SIZE * GRID_H), FRAMES);
+
+    /* Once to warm up, then for real. */
+    run(0);
+    copy_us = run(0);
+    resv_us = run(1);
+
+    report("pvr_list_prim", copy_us);
+    report("pvr_list_reserve", resv_us);
+
+    pvr_shutdown();
+    return 0;
+}
@@ -0,0 +1,139 @@
+/* KallistiOS ##version##
+
+   capture.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   This example shows how to capture what's on the screen continuously with
+   dc/vid_capture.h. It draws a few hundred moving quads for a while without
+   capturing, then again while capturing every other frame to
+   /pc/capNNNNN.qoi, and prints the frame rate and the average time spent
+   building a frame both ways, along with what was captured.
+
+   Like the screenshot example, this needs dcload's '-c "."' option for /pc.
+   The .qoi files can be opened by most image viewers, or turned into a
+   video, e.g. with "ffmpeg -framerate 30 -i cap%05d.qoi cap.mp4".
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <dc/pvr.h>
+#include <dc/video.h>
+#include <dc/vid_capture.h>
+
+#include <arch/timer.h>
+
+#include <kos/init.h>
+
+KOS_INIT_FLAGS(INIT_DEFAULT);
+
+#define QUADS       400
+#define FRAMES      300
+
+static pvr_poly_hdr_t hdr;
+
+static void draw_frame(int frame) {
+    pvr_vertex_t v[4];
+    float x, y, s = 24.0f;
+    uint32_t c;
+    int i, j;
+
+    pvr_list_begin(PVR_LIST_OP_POLY);
+    pvr_prim(&hdr, sizeof(hdr));
+
+    for(i = 0; i < QUADS; i++) {
+        x = 308.0f + 280.0f * cosf((i * 7 + frame) * 0.013f);
+        y = 228.0f + 200.0f * sinf((i * 11 + frame) * 0.017f);
+        c = 0xff000000 | ((i * 37) & 0xff) << 16 | ((i * 91) & 0xff) << 8 |
+            ((frame + i) & 0xff);
+
+        for(j = 0; j < 4; j++) {
+            v[j].flags = j == 3 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX;
+            v[j].x = x + (j & 2 ? s : 0.0f);
+            v[j].y = y + (j & 1 ? 0.0f : s);
+            v[j].z = 1.0f + i * 0.001f;
+            v[j].argb = c;
+            v[j].oargb = 0;
+        }
+
+        pvr_prim(v, sizeof(v));
+    }
+
+    pvr_list_finish();
+}
+
+/* Draw FRAMES frames, returning the frame rate, and the average time spent
+   building a frame in *busy_us. */
+static float run(uint64_t *busy_us) {
+    uint64_t t, start, busy = 0;
+    int frame;
+
+    start = timer_us_gettime64();
+
+    for(frame = 0; frame < FRAMES; frame++) {
+        pvr_wait_ready();
+
+        t = timer_us_gettime64();
+        pvr_scene_begin();
+        draw_frame(frame);
+        pvr_scene_finish();
+        busy += timer_us_gettime64() - t;
+    }
+
+    *busy_us = busy / FRAMES;
+
+    return FRAMES * 1000000.0f / (timer_us_gettime64() - start);
+}
+
+int main(int argc, char *argv[]) {
+    vid_capture_params_t params = {
+        .path = "/pc/cap%05u.qoi",
+        .buffers = 3,
+        .interval = 2
+    };
+    vid_capture_stats_t st;
+    pvr_poly_cxt_t cxt;
+    uint64_t b1, b2;
+    float f1, f2;
+
+    (void)argc;
+    (void)argv;
+
+    pvr_init_defaults();
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    pvr_poly_compile(&hdr, &cxt);
+
+    f1 = run(&b1);
+
+    /* After pvr_init(), so frames are grabbed just after each flip. */
+    if(vid_capture_start(&params) < 0) {
+        printf("can't start capture\n");
+        return -1;
+    }
+
+    f2 = run(&b2);
+
+    vid_capture_stop();
+    vid_capture_stats(&st);
+
+    printf("%d quads, %d frames each\n\n", QUADS, FRAMES);
+    printf("without capture: %5.1f fps, %5lu us per frame\n", (double)f1,
+           (unsigned long)b1);
+    printf("with capture:    %5.1f fps, %5lu us per frame\n\n", (double)f2,
+           (unsigned long)b2);
+
+    printf("%lu grabbed, %lu dropped, %lu written, %lu errors\n",
+           (unsigned long)st.grabbed, (unsigned long)st.dropped,
+           (unsigned long)st.written, (unsigned long)st.errors);
+
+    if(st.bytes_out)
+        printf("%llu bytes of frames in %llu bytes of files (%.1f:1)\n",
+               (unsigned long long)st.bytes_in,
+               (unsigned long long)st.bytes_out,
+               (double)st.bytes_in / (double)st.bytes_out);
+
+    pvr_shutdown();
+    return 0;
+}
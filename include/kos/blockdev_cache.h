@@ -0,0 +1,135 @@
+/* KallistiOS ##version##
+
+   kos/blockdev_cache.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file    kos/blockdev_cache.h
+    \brief   Caching block device wrapper.
+    \ingroup vfs_blockdev
+
+    This file contains a block device that can be stacked on top of any other
+    block device to give it a block cache. None of the block devices in KOS do
+    any caching of their own, and each filesystem has its own ideas about what
+    (if anything) it wants to cache, so this provides a uniform place to get
+    the benefits of caching for any filesystem on any device.
+
+    The wrapper provides the following:
+    - An LRU cache of device blocks, looked up by a hash of the block number.
+    - Sequential read-ahead, which turns a stream of small reads into a few
+      large ones.
+    - Write-back caching of small writes. Dirty blocks are flushed all at once
+      in ascending block order (starting from the last position written, like
+      an elevator), with runs of adjacent blocks merged into a single write.
+    - Large reads and writes bypass the cache entirely, so that streaming a big
+      file doesn't evict everything else.
+
+    Blocks written to the wrapper are not guaranteed to be on the underlying
+    device until the wrapper's flush() function has been called (or it has been
+    shut down). All of the filesystems in KOS already call flush() when they are
+    synced or unmounted.
+
+    Shutting the wrapper down writes everything out and shuts down the
+    underlying device, but the wrapper itself stays usable: filesystems shut
+    their device down when unmounted and init() it again if remounted. Once
+    you are completely done with it, release it with blockdev_cache_free().
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __KOS_BLOCKDEV_CACHE_H
+#define __KOS_BLOCKDEV_CACHE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <kos/blockdev.h>
+
+/** \addtogroup vfs_blockdev
+    @{
+*/
+
+/** \brief  Maximum number of blocks merged into one request.
+
+    Dirty blocks that are adjacent on the device are gathered into a single
+    write of up to this many blocks when the cache is flushed, and writes any
+    larger than this bypass the cache. This many blocks of memory is allocated
+    as a bounce buffer for each cache, in addition to the cache itself and the
+    read-ahead buffer.
+*/
+#define BLOCKDEV_CACHE_MERGE_MAX    32
+
+/** \brief  Statistics about a caching block device.
+
+    \headerfile kos/blockdev_cache.h
+*/
+typedef struct blockdev_cache_stats {
+    uint64_t hits;              /**< \brief Blocks read from the cache. */
+    uint64_t misses;            /**< \brief Blocks read that weren't cached. */
+    uint64_t readahead;         /**< \brief Blocks fetched by read-ahead. */
+    uint64_t dev_reads;         /**< \brief Read requests sent to the device. */
+    uint64_t dev_writes;        /**< \brief Write requests sent to the device. */
+    uint64_t blocks_read;       /**< \brief Blocks read from the device. */
+    uint64_t blocks_written;    /**< \brief Blocks written to the device. */
+} blockdev_cache_stats_t;
+
+/** \brief  Wrap a block device with a block cache.
+
+    This function creates a new block device that passes everything through to
+    the given device, but with a block cache in between. The wrapper takes
+    ownership of the underlying device: a copy of it is kept internally, and its
+    init(), shutdown() and flush() functions are called by the wrapper's. You
+    should not use the underlying device directly after this.
+
+    As the wrapper is a block device like any other, wrappers can be stacked on
+    top of each other (although there isn't much reason to do so).
+
+    \param  rv              Used to return the new block device.
+    \param  dev             The block device to wrap.
+    \param  blocks          The number of device blocks to cache.
+    \param  readahead       The number of blocks to read ahead when sequential
+                            reads are detected (0 to disable read-ahead).
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EFAULT - rv or dev was NULL \n
+    \em     EINVAL - blocks was 0 \n
+    \em     ENOMEM - out of memory
+*/
+int blockdev_cache_wrap(kos_blockdev_t *rv, const kos_blockdev_t *dev,
+                        size_t blocks, size_t readahead);
+
+/** \brief  Free a caching block device.
+
+    This function releases all of the memory used by a block device created
+    with blockdev_cache_wrap(). It does not write anything out, so the device
+    should have been shut down first. The device must not be used after this.
+
+    \param  d               A block device created by blockdev_cache_wrap().
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - d is not a caching block device
+*/
+int blockdev_cache_free(kos_blockdev_t *d);
+
+/** \brief  Retrieve statistics from a caching block device.
+
+    \param  d               A block device created by blockdev_cache_wrap().
+    \param  st              Used to return the statistics.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - d is not a caching block device
+*/
+int blockdev_cache_stats(kos_blockdev_t *d, blockdev_cache_stats_t *st);
+
+/** @} */
+
+__END_DECLS
+
+#endif /* !__KOS_BLOCKDEV_CACHE_H */
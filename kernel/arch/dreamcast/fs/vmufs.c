@@ -21,10 +21,18 @@ This is a whole new module that sits between the fs_vmu module and the maple
 VMU driver. It's based loosely on the stuff in the old fs_vmu, but it's been
 rewritten and reworked to be clearer, more clean, use threads better, etc.
 
-Unlike the fs_vmu module, this code is stateless. You make a call and you get
-back data (or have written it). There are no handles involved or anything
-else like that. The new fs_vmu sits on top of this and provides a (mostly)
-nice VFS interface similar to the old fs_vmu.
+Unlike the fs_vmu module, this code is (mostly) stateless. You make a call
+and you get back data (or have written it). There are no handles involved or
+anything else like that. The new fs_vmu sits on top of this and provides a
+(mostly) nice VFS interface similar to the old fs_vmu.
+
+The one bit of state we do keep is a copy of the root block, FAT and
+directory of each card. Reading all of those takes 15 block transfers on a
+standard VMU, which used to happen before every single read, write, delete
+and directory listing. The copy is thrown away whenever the card is
+unplugged, or whenever someone writes the FAT/dir through the low-level
+functions below. Changes made by the high-level functions are written back at
+the end of each call, unless a batch is open with vmufs_batch_begin().
 
 This module tends to do more work than it really needs to for some
 functions (like reading a named file) but it does it that way to have very
@@ -47,6 +55,23 @@ Function comments located in vmufs.h.
    be much of an issue :) */
 static mutex_t mutex;
 
+/* Cached filesystem metadata for one memory card. The valid flag and batch
+   depth may be cleared from an IRQ (when the card is unplugged), so nothing
+   else in here is touched except with the mutex held. */
+typedef struct {
+    volatile int    valid;      /* Is the rest of this a copy of the card? */
+    volatile int    batch;      /* vmufs_batch_begin() nesting depth */
+    int             fat_dirty;  /* FAT needs to be written back */
+    int             dir_dirty;  /* Some dirents have their dirty flag set */
+    vmu_root_t      root;
+    vmu_dir_t       *dir;
+    int             dirsize;
+    uint16          *fat;
+    int             fatsize;
+} vmufs_cache_t;
+
+static vmufs_cache_t *cache[MAPLE_PORT_COUNT][MAPLE_UNIT_COUNT];
+
 /* Convert a decimal number to BCD; max of two digits */
 static uint8 dec_to_bcd(int dec) {
     uint8 rv = 0;
@@ -88,6 +113,9 @@ int vmufs_root_read(maple_device_t * dev, vmu_root_t * root_buf) {
 }
 
 int vmufs_root_write(maple_device_t * dev, vmu_root_t * root_buf) {
+    /* Whatever we had cached is probably wrong now */
+    vmufs_invalidate(dev);
+
     /* XXX: Assume root is at 255.. is there some way to figure this out dynamically? */
     if(vmu_block_write(dev, 255, (uint8 *)root_buf) != 0) {
         dbglog(DBG_ERROR, "vmufs_root_write: can't write block %d on device %c%c\n",
@@ -159,6 +187,7 @@ int vmufs_dir_read(maple_device_t * dev, vmu_root_t * root, vmu_dir_t * dir_buf)
 }
 
 int vmufs_dir_write(maple_device_t * dev, vmu_root_t * root, vmu_dir_t * dir_buf) {
+    vmufs_invalidate(dev);
     return vmufs_dir_ops(dev, root, dir_buf, 1);
 }
 
@@ -200,6 +229,7 @@ int vmufs_fat_read(maple_device_t * dev, vmu_root_t * root, uint16 * fat_buf) {
 }
 
 int vmufs_fat_write(maple_device_t * dev, vmu_root_t * root, uint16 * fat_buf) {
+    vmufs_invalidate(dev);
     return vmufs_fat_ops(dev, root, fat_buf, 1);
 }
 
@@ -495,11 +525,31 @@ int vmufs_mutex_unlock(void) {
     return mutex_unlock(&mutex);
 }
 
+void vmufs_invalidate(maple_device_t * dev) {
+    vmufs_cache_t * c;
+
+    if(!dev || dev->port >= MAPLE_PORT_COUNT || dev->unit >= MAPLE_UNIT_COUNT)
+        return;
+
+    /* This can be called from the maple IRQ, so all we do is mark it as
+       stale. The next vmufs_setup() will take care of the rest. Whatever batch
+       was open was for the old contents, so it's over too. */
+    c = cache[dev->port][dev->unit];
+
+    if(c) {
+        c->valid = 0;
+        c->batch = 0;
+    }
+}
+
 /* ****************** Higher level functions ******************** */
 
-/* Internal function gets everything setup for you */
-static int vmufs_setup(maple_device_t * dev, vmu_root_t * root, vmu_dir_t ** dir, int * dirsize,
-                       uint16 ** fat, int * fatsize) {
+/* Internal function gets everything setup for you. On success, the mutex is
+   held and *cp points at an up-to-date copy of the card's root, dir and FAT. */
+static int vmufs_setup(maple_device_t * dev, vmufs_cache_t ** cp) {
+    vmufs_cache_t * c;
+    int dirsize, fatsize;
+
     /* Check to make sure this is a valid device right now */
     if(!dev || !(dev->info.functions & MAPLE_FUNC_MEMCARD)) {
         if(!dev)
@@ -513,90 +563,184 @@ static int vmufs_setup(maple_device_t * dev, vmu_root_t * root, vmu_dir_t ** dir
 
     vmufs_mutex_lock();
 
-    /* Read its root block */
-    if(!root || vmufs_root_read(dev, root) < 0)
-        goto dead;
+    c = cache[dev->port][dev->unit];
 
-    if(dir) {
-        /* Alloc enough space for the whole dir */
-        *dirsize = vmufs_dir_blocks(root);
-        *dir = (vmu_dir_t *)malloc(*dirsize);
+    if(!c) {
+        c = (vmufs_cache_t *)calloc(1, sizeof(vmufs_cache_t));
 
-        if(!*dir) {
-            dbglog(DBG_ERROR, "vmufs_setup: can't alloc %d bytes for dir on device %c%c\n",
-                   *dirsize, dev->port + 'A', dev->unit + '0');
+        if(!c) {
+            dbglog(DBG_ERROR, "vmufs_setup: can't alloc cache for device %c%c\n",
+                   dev->port + 'A', dev->unit + '0');
             goto dead;
         }
 
-        /* Ensure that the dir is 0'd to avoid possible uninitialized reads */
-        memset(*dir, 0, sizeof(*dirsize));
+        cache[dev->port][dev->unit] = c;
+    }
 
-        /* Read it */
-        if(vmufs_dir_read(dev, root, *dir) < 0) {
-            free(*dir);
-            *dir = NULL;
-            goto dead;
+    /* If we've got a good copy already, we're done */
+    if(c->valid)
+        goto done;
+
+    if(c->fat_dirty || c->dir_dirty) {
+        dbglog(DBG_WARNING, "vmufs_setup: discarding unwritten changes on device %c%c\n",
+               dev->port + 'A', dev->unit + '0');
+        c->fat_dirty = c->dir_dirty = 0;
+    }
+
+    /* A batch can't carry over to a fresh copy of the card (which might not
+       even be the same card). If it did, nothing done to the card from here on
+       would be written back until the old batch was ended. */
+    c->batch = 0;
+
+    /* Mark it valid before we start reading; if the card gets pulled while
+       we're in the middle of it, this gets cleared again and we'll start over
+       next time. */
+    c->valid = 1;
+
+    /* Read its root block */
+    if(vmufs_root_read(dev, &c->root) < 0)
+        goto bad;
+
+    /* Alloc enough space for the whole dir (which could be a different size
+       than last time, if this is a different card) */
+    dirsize = vmufs_dir_blocks(&c->root);
+
+    if(dirsize != c->dirsize) {
+        free(c->dir);
+        c->dirsize = 0;
+        c->dir = (vmu_dir_t *)malloc(dirsize);
+
+        if(!c->dir) {
+            dbglog(DBG_ERROR, "vmufs_setup: can't alloc %d bytes for dir on device %c%c\n",
+                   dirsize, dev->port + 'A', dev->unit + '0');
+            goto bad;
         }
+
+        c->dirsize = dirsize;
     }
 
-    if(fat) {
-        /* Alloc enough space for the fat */
-        *fatsize = vmufs_fat_blocks(root);
-        *fat = (uint16 *)malloc(*fatsize);
+    /* Ensure that the dir is 0'd to avoid possible uninitialized reads */
+    memset(c->dir, 0, c->dirsize);
+
+    /* Read it */
+    if(vmufs_dir_read(dev, &c->root, c->dir) < 0)
+        goto bad;
 
-        if(!*fat) {
+    /* Alloc enough space for the fat */
+    fatsize = vmufs_fat_blocks(&c->root);
+
+    if(fatsize != c->fatsize) {
+        free(c->fat);
+        c->fatsize = 0;
+        c->fat = (uint16 *)malloc(fatsize);
+
+        if(!c->fat) {
             dbglog(DBG_ERROR, "vmufs_setup: can't alloc %d bytes for FAT on device %c%c\n",
-                   *fatsize, dev->port + 'A', dev->unit + '0');
-            if(dir)
-                free(*dir);
-            goto dead;
+                   fatsize, dev->port + 'A', dev->unit + '0');
+            goto bad;
         }
 
-        /* Read it */
-        if(vmufs_fat_read(dev, root, *fat) < 0) {
-            free(*fat);
-            if(dir)
-                free(*dir);
-            goto dead;
-        }
+        c->fatsize = fatsize;
     }
 
+    /* Read it */
+    if(vmufs_fat_read(dev, &c->root, c->fat) < 0)
+        goto bad;
+
+done:
     /* Ok, everything's cool */
+    *cp = c;
     return 0;
 
+bad:
+    c->valid = 0;
 dead:
     vmufs_mutex_unlock();
     return -1;
 }
 
 /* Internal function to tear everything down for you */
-static void vmufs_teardown(vmu_dir_t * dir, uint16 * fat) {
-    if(dir)
-        free(dir);
+static void vmufs_teardown(void) {
+    vmufs_mutex_unlock();
+}
 
-    if(fat)
-        free(fat);
+/* Write back whatever has changed in the cached FAT and dir. If both have
+   changed, the order they're written in decides what a card pulled halfway
+   through looks like, so the caller gets to pick. If either write fails, we
+   have no idea what's on the card anymore, so the cache is thrown out.
+   Returns -1 if the FAT couldn't be written, -2 for the dir. */
+static int vmufs_flush(maple_device_t * dev, vmufs_cache_t * c, int dir_first) {
+    if(!c->valid)
+        return -1;
 
-    vmufs_mutex_unlock();
+    /* These only write out the dir blocks with dirty entries in them */
+    if(dir_first && c->dir_dirty) {
+        if(vmufs_dir_ops(dev, &c->root, c->dir, 1) < 0)
+            goto baddir;
+
+        c->dir_dirty = 0;
+    }
+
+    if(c->fat_dirty) {
+        if(vmufs_fat_ops(dev, &c->root, c->fat, 1) < 0) {
+            c->valid = 0;
+            return -1;
+        }
+
+        c->fat_dirty = 0;
+    }
+
+    if(c->dir_dirty) {
+        if(vmufs_dir_ops(dev, &c->root, c->dir, 1) < 0)
+            goto baddir;
+
+        c->dir_dirty = 0;
+    }
+
+    return 0;
+
+baddir:
+    c->valid = 0;
+    return -2;
+}
+
+/* Finish off a change: flush it now unless it's part of a batch */
+static int vmufs_commit(maple_device_t * dev, vmufs_cache_t * c, int dir_first) {
+    if(c->batch)
+        return 0;
+
+    return vmufs_flush(dev, c, dir_first);
 }
 
 int vmufs_readdir(maple_device_t * dev, vmu_dir_t ** outbuf, int * outcnt) {
-    vmu_root_t root;
+    vmufs_cache_t *c;
     vmu_dir_t *dir;
-    int dircnt, dirsize, rv = 0;
+    int dircnt, rv = 0;
     unsigned int i, j;
 
     *outbuf = NULL;
     *outcnt = 0;
 
     /* Init everything */
-    if(vmufs_setup(dev, &root, &dir, &dirsize, NULL, NULL) < 0)
+    if(vmufs_setup(dev, &c) < 0)
         return -1;
 
+    /* Make a copy of the dir for the caller */
+    dir = (vmu_dir_t *)malloc(c->dirsize);
+
+    if(!dir) {
+        dbglog(DBG_ERROR, "vmufs_readdir: can't alloc %d bytes for dir on device %c%c\n",
+               c->dirsize, dev->port + 'A', dev->unit + '0');
+        rv = -2;
+        goto ex;
+    }
+
+    memcpy(dir, c->dir, c->dirsize);
+
     /* Go through and move all entries to the lowest-numbered spots. */
     dircnt = 0;
 
-    for(i = 0; i < dirsize / sizeof(vmu_dir_t); i++) {
+    for(i = 0; i < c->dirsize / sizeof(vmu_dir_t); i++) {
         /* Skip blanks */
         if(dir[i].filetype == 0)
             continue;
@@ -628,7 +772,7 @@ int vmufs_readdir(maple_device_t * dev, vmu_dir_t ** outbuf, int * outcnt) {
     }
 
 ex:
-    vmufs_teardown(NULL, NULL);
+    vmufs_teardown();
     return rv;
 }
 
@@ -656,20 +800,18 @@ static int vmufs_read_common(maple_device_t * dev, vmu_dir_t * dirent, uint16 *
 }
 
 int vmufs_read(maple_device_t * dev, const char * fn, void ** outbuf, int * outsize) {
-    vmu_root_t  root;
-    vmu_dir_t   * dir = NULL;
-    uint16      * fat = NULL;
-    int     fatsize, dirsize, idx, rv = 0;
+    vmufs_cache_t * c;
+    int     idx, rv = 0;
 
     *outbuf = NULL;
     *outsize = 0;
 
     /* Init everything */
-    if(vmufs_setup(dev, &root, &dir, &dirsize, &fat, &fatsize) < 0)
+    if(vmufs_setup(dev, &c) < 0)
         return -1;
 
     /* Look for the file we want */
-    idx = vmufs_dir_find(&root, dir, fn);
+    idx = vmufs_dir_find(&c->root, c->dir, fn);
 
     if(idx < 0) {
         //dbglog(DBG_ERROR, "vmufs_read: can't find file '%s' on device %c%c\n",
@@ -678,41 +820,40 @@ int vmufs_read(maple_device_t * dev, const char * fn, void ** outbuf, int * outs
         goto ex;
     }
 
-    if(vmufs_read_common(dev, dir + idx, fat, outbuf, outsize) < 0) {
+    if(vmufs_read_common(dev, c->dir + idx, c->fat, outbuf, outsize) < 0) {
         rv = -3;
         goto ex;
     }
 
 ex:
-    vmufs_teardown(dir, fat);
+    vmufs_teardown();
     return rv;
 }
 
 int vmufs_read_dirent(maple_device_t * dev, vmu_dir_t * dirent, void ** outbuf, int * outsize) {
-    vmu_root_t  root;
-    uint16      * fat = NULL;
-    int     fatsize, rv = 0;
+    vmufs_cache_t * c;
+    int     rv = 0;
 
     *outbuf = NULL;
     *outsize = 0;
 
     /* Init everything */
-    if(vmufs_setup(dev, &root, NULL, NULL, &fat, &fatsize) < 0)
+    if(vmufs_setup(dev, &c) < 0)
         return -1;
 
-    if(vmufs_read_common(dev, dirent, fat, outbuf, outsize) < 0)
+    if(vmufs_read_common(dev, dirent, c->fat, outbuf, outsize) < 0)
         rv = -2;
 
-    vmufs_teardown(NULL, fat);
+    vmufs_teardown();
     return rv;
 }
 
 /* Returns 0 for success, -7 for 'not enough space', and other values for other errors. :-)  */
 int vmufs_write(maple_device_t * dev, const char * fn, void * inbuf, int insize, int flags) {
-    vmu_root_t  root;
-    vmu_dir_t   * dir = NULL, nd;
-    uint16      * fat = NULL;
-    int     oldinsize, fatsize, dirsize, idx, rv = 0, st, fnlength;
+    vmufs_cache_t * c;
+    vmu_dir_t   nd, od;
+    uint16      oldfat[512 / sizeof(uint16)];
+    int     oldinsize, idx, oidx = -1, rv = 0, st, fnlength;
 
     /* Round up the size if necessary */
     oldinsize = insize;
@@ -726,11 +867,17 @@ int vmufs_write(maple_device_t * dev, const char * fn, void * inbuf, int insize,
     }
 
     /* Init everything */
-    if(vmufs_setup(dev, &root, &dir, &dirsize, &fat, &fatsize) < 0)
+    if(vmufs_setup(dev, &c) < 0)
         return -1;
 
+    /* Keep a copy of the FAT as it stands, so that if anything goes wrong we
+       can put it back the way it was. The cached copy may have changes from
+       earlier in a batch that we don't want to lose. (vmufs_fat_read() makes
+       sure the FAT is only one block.) */
+    memcpy(oldfat, c->fat, c->fatsize);
+
     /* Check if the file already exists */
-    idx = vmufs_dir_find(&root, dir, fn);
+    idx = vmufs_dir_find(&c->root, c->dir, fn);
 
     if(idx >= 0) {
         if(!(flags & VMUFS_OVERWRITE)) {
@@ -740,7 +887,10 @@ int vmufs_write(maple_device_t * dev, const char * fn, void * inbuf, int insize,
             goto ex;
         }
         else {
-            if(vmufs_file_delete(&root, fat, dir, fn) < 0) {
+            memcpy(&od, c->dir + idx, sizeof(vmu_dir_t));
+            oidx = idx;
+
+            if(vmufs_file_delete(&c->root, c->fat, c->dir, fn) < 0) {
                 dbglog(DBG_ERROR, "vmufs_write: can't delete old file '%s' on device %c%c\n",
                        fn, dev->port + 'A', dev->unit + '0');
                 rv = -3;
@@ -770,7 +920,7 @@ int vmufs_write(maple_device_t * dev, const char * fn, void * inbuf, int insize,
     // If any of these fail, the action to take can be decided by the caller.
 
     /* Write out the data and update our structs */
-    if((st = vmufs_file_write(dev, &root, fat, dir, &nd, inbuf, insize / 512)) < 0) {
+    if((st = vmufs_file_write(dev, &c->root, c->fat, c->dir, &nd, inbuf, insize / 512)) < 0) {
         if(st == -2)
             rv = -7;
         else
@@ -778,77 +928,138 @@ int vmufs_write(maple_device_t * dev, const char * fn, void * inbuf, int insize,
         goto ex;
     }
 
-    /* Ok, everything's looking good so far.. update the FAT */
-    if(vmufs_fat_write(dev, &root, fat) < 0) {
-        rv = -5;
-        goto ex;
-    }
+    c->fat_dirty = c->dir_dirty = 1;
 
-    /* This is the critical point. If the dir doesn't save correctly, then
+    /* Ok, everything's looking good so far.. update the FAT and then the dir.
+       This is the critical point. If the dir doesn't save correctly, then
        we may have an unusable card (until it's reformatted) or leaked
        blocks not attached to a file. Cross your fingers! */
-    if(vmufs_dir_write(dev, &root, dir) < 0) {
+    if((st = vmufs_commit(dev, c, 0)) < 0) {
         /* doh! */
-        dbglog(DBG_ERROR, "vmufs_write: warning, card may be corrupted or leaking blocks!\n");
-        rv = -6;
-        goto ex;
+        if(st == -2)
+            dbglog(DBG_ERROR, "vmufs_write: warning, card may be corrupted or leaking blocks!\n");
+
+        rv = st == -1 ? -5 : -6;
     }
 
     /* Looks like everything was good */
+    vmufs_teardown();
+    return rv;
+
 ex:
-    vmufs_teardown(dir, fat);
+    /* Undo whatever we did to the cached copy */
+    memcpy(c->fat, oldfat, c->fatsize);
+
+    if(oidx >= 0)
+        memcpy(c->dir + oidx, &od, sizeof(vmu_dir_t));
+
+    vmufs_teardown();
     return rv;
 }
 
 int vmufs_delete(maple_device_t * dev, const char * fn) {
-    vmu_root_t  root;
-    vmu_dir_t   * dir = NULL;
-    uint16      * fat = NULL;
-    int     fatsize, dirsize, rv = 0;
+    vmufs_cache_t * c;
+    uint16      oldfat[512 / sizeof(uint16)];
+    int     rv = 0;
 
     /* Init everything */
-    if(vmufs_setup(dev, &root, &dir, &dirsize, &fat, &fatsize) < 0)
+    if(vmufs_setup(dev, &c) < 0)
         return -2;
 
-    /* Ok, try to delete the file */
-    rv = vmufs_file_delete(&root, fat, dir, fn);
-
-    if(rv < 0) goto ex;
+    /* Ok, try to delete the file. If it goes wrong part way through, put the
+       FAT back the way it was. */
+    memcpy(oldfat, c->fat, c->fatsize);
+    rv = vmufs_file_delete(&c->root, c->fat, c->dir, fn);
 
-    /* If we succeeded, write back the dir and fat */
-    if(vmufs_dir_write(dev, &root, dir) < 0) {
-        rv = -2;
+    if(rv < 0) {
+        memcpy(c->fat, oldfat, c->fatsize);
         goto ex;
     }
 
-    /* This is the critical point. If the fat doesn't save correctly, then
-       we may have an unusable card (until it's reformatted) or leaked
-       blocks not attached to a file. Cross your fingers! */
-    if(vmufs_fat_write(dev, &root, fat) < 0) {
+    c->fat_dirty = c->dir_dirty = 1;
+
+    /* If we succeeded, write back the dir and then the fat. This is the
+       critical point. If the fat doesn't save correctly, then we may have an
+       unusable card (until it's reformatted) or leaked blocks not attached to
+       a file. Cross your fingers! */
+    if((rv = vmufs_commit(dev, c, 1)) < 0) {
         /* doh! */
-        dbglog(DBG_ERROR, "vmufs_delete: warning, card may be corrupted or leaking blocks!\n");
+        if(rv == -1)
+            dbglog(DBG_ERROR, "vmufs_delete: warning, card may be corrupted or leaking blocks!\n");
+
         rv = -2;
         goto ex;
     }
 
     /* Looks like everything was good */
 ex:
-    vmufs_teardown(dir, fat);
+    vmufs_teardown();
     return rv;
 }
 
 int vmufs_free_blocks(maple_device_t * dev) {
-    vmu_root_t  root;
-    uint16      * fat = NULL;
-    int     fatsize, rv = 0;
+    vmufs_cache_t * c;
+    int     rv = 0;
 
     /* Init everything */
-    if(vmufs_setup(dev, &root, NULL, NULL, &fat, &fatsize) < 0)
+    if(vmufs_setup(dev, &c) < 0)
+        return -1;
+
+    rv = vmufs_fat_free(&c->root, c->fat);
+
+    vmufs_teardown();
+    return rv;
+}
+
+int vmufs_sync(maple_device_t * dev) {
+    vmufs_cache_t * c;
+    int     rv;
+
+    if(vmufs_setup(dev, &c) < 0)
+        return -1;
+
+    rv = vmufs_flush(dev, c, 0);
+
+    vmufs_teardown();
+    return rv;
+}
+
+int vmufs_batch_begin(maple_device_t * dev) {
+    vmufs_cache_t * c;
+
+    if(vmufs_setup(dev, &c) < 0)
         return -1;
 
-    rv = vmufs_fat_free(&root, fat);
+    c->batch++;
+
+    vmufs_teardown();
+    return 0;
+}
 
-    vmufs_teardown(NULL, fat);
+int vmufs_batch_end(maple_device_t * dev) {
+    vmufs_cache_t * c;
+    int     rv = 0;
+
+    if(vmufs_setup(dev, &c) < 0) {
+        /* The card is gone (or broken), so there's nothing to write back. We
+           still need to close the batch, though. */
+        if(dev && dev->port < MAPLE_PORT_COUNT && dev->unit < MAPLE_UNIT_COUNT) {
+            vmufs_mutex_lock();
+            c = cache[dev->port][dev->unit];
+
+            if(c && c->batch > 0)
+                c->batch--;
+
+            vmufs_mutex_unlock();
+        }
+
+        return -1;
+    }
+
+    if(c->batch > 0 && --c->batch == 0)
+        rv = vmufs_flush(dev, c, 0);
+
+    vmufs_teardown();
     return rv;
 }
 
@@ -861,6 +1072,37 @@ int vmufs_init(void) {
 }
 
 int vmufs_shutdown(void) {
+    maple_device_t * dev;
+    vmufs_cache_t * c;
+    int p, u;
+
+    vmufs_mutex_lock();
+
+    /* Write back anything left over from an unfinished batch and throw the
+       cache away */
+    for(p = 0; p < MAPLE_PORT_COUNT; p++) {
+        for(u = 0; u < MAPLE_UNIT_COUNT; u++) {
+            c = cache[p][u];
+
+            if(!c)
+                continue;
+
+            if(c->valid && (c->fat_dirty || c->dir_dirty)) {
+                dev = maple_enum_dev(p, u);
+
+                if(!dev || vmufs_flush(dev, c, 0) < 0)
+                    dbglog(DBG_ERROR, "vmufs_shutdown: unwritten changes lost on device %c%c\n",
+                           p + 'A', u + '0');
+            }
+
+            free(c->dir);
+            free(c->fat);
+            free(c);
+            cache[p][u] = NULL;
+        }
+    }
+
+    vmufs_mutex_unlock();
     mutex_destroy(&mutex);
     return 0;
 }
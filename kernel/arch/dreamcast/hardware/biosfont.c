@@ -69,6 +69,10 @@ void bfont_set_encoding(bfont_code_t enc) {
         assert_msg(0, "Unknown bfont encoding mode");
 }
 
+bfont_code_t bfont_get_encoding(void) {
+    return bfont_code_mode;
+}
+
 /* Set the foreground color and return the old color */
 uint32_t bfont_set_foreground_color(uint32_t c) {
     uint32_t rv = bfont_fgcolor;
@@ -183,6 +183,13 @@ static uint64_t dma_sector = 0;
 static semaphore_t dma_done = SEM_INITIALIZER(0);
 static kthread_t *dma_thd = NULL;
 
+/* Queue of asynchronous DMA requests. The one at the head is the one being
+   transferred right now. dma_q_active is set from when the first request is
+   started until the queue drains, including while callbacks are running. */
+static g1_ata_req_t *dma_q_head = NULL;
+static g1_ata_req_t *dma_q_tail = NULL;
+static int dma_q_active = 0;
+
 /* From cdrom.c */
 extern mutex_t _g1_ata_mutex;
 
@@ -253,15 +260,86 @@ static void g1_dma_done(void) {
     mutex_unlock_as_thread(&_g1_ata_mutex, dma_thd);
 }
 
+/* Program the hardware for a queued request. This is called both from
+   g1_ata_queue_read_dma() and the DMA interrupt handler. */
+static void dma_q_start(g1_ata_req_t *req) {
+    int lba28 = !CAN_USE_LBA48() || use_lba28(req->sector, req->count);
+
+    if(lba28) {
+        g1_ata_select_device(G1_ATA_SLAVE | G1_ATA_LBA_MODE |
+                             ((req->sector >> 24) & 0x0F));
+        dma_cmd = ATA_CMD_READ_DMA;
+    }
+    else {
+        g1_ata_select_device(G1_ATA_SLAVE | G1_ATA_LBA_MODE);
+        dma_cmd = ATA_CMD_READ_DMA_EXT;
+    }
+
+    dma_sector = req->sector;
+    dma_nb_sectors = req->count;
+    g1_ata_set_sector_and_count(req->sector, req->count, lba28);
+
+    OUT32(G1_ATA_DMA_ADDRESS, ((uintptr_t)req->buf) & MEM_AREA_CACHE_MASK);
+    OUT32(G1_ATA_DMA_LENGTH, req->count * 512);
+    OUT32(G1_ATA_DMA_DIRECTION, G1_DMA_TO_MEMORY);
+    OUT32(G1_ATA_DMA_ENABLE, 1);
+
+    g1_ata_wait_nbsy();
+    g1_ata_wait_drdy();
+
+    OUT8(G1_ATA_COMMAND_REG, dma_cmd);
+    OUT32(G1_ATA_DMA_STATUS, 1);
+}
+
+/* Finish off the request at the head of the queue, and get the next one going
+   before anything else. */
+static void dma_q_complete(uint32 code) {
+    g1_ata_req_t *req = dma_q_head;
+    uint8_t status;
+    int rv = 0;
+
+    /* Acknowledge the IRQ and check how it went. */
+    status = IN8(G1_ATA_STATUS_REG);
+
+    if(code != ASIC_EVT_GD_DMA || (status & (G1_ATA_SR_ERR | G1_ATA_SR_DF)))
+        rv = -EIO;
+
+    if(!(dma_q_head = req->next))
+        dma_q_tail = NULL;
+
+    req->status = rv;
+
+    /* The callback might queue up more work, which will be picked up below. */
+    if(req->callback)
+        req->callback(req, rv);
+
+    if(dma_q_head) {
+        dma_q_start(dma_q_head);
+        return;
+    }
+
+    dma_q_active = 0;
+    dma_in_progress = 0;
+
+    /* Make sure to select the GD-ROM drive back. */
+    g1_ata_select_device(G1_ATA_MASTER);
+    mutex_unlock_as_thread(&_g1_ata_mutex, dma_thd);
+}
+
 static void g1_dma_irq_hnd(uint32 code, void *data) {
     int can_lba48 = CAN_USE_LBA48();
     size_t nb_sectors;
     uint8_t status;
 
-    /* XXXX: Probably should look at the code to make sure it isn't an error. */
-    (void)code;
     (void)data;
 
+    if(dma_q_active) {
+        dma_q_complete(code);
+        return;
+    }
+
+    /* XXXX: Probably should look at the code to make sure it isn't an error. */
+
     if(dma_in_progress && !can_lba48 && dma_nb_sectors > ATA_MAX_SECTORS_LBA28) {
         dma_sector += ATA_MAX_SECTORS_LBA28;
         dma_nb_sectors -= ATA_MAX_SECTORS_LBA28;
@@ -756,6 +834,99 @@ int g1_ata_read_lba_dma(uint64_t sector, size_t count, void *buf,
     return dma_common(cmd, count, addr, G1_DMA_TO_MEMORY, block);
 }
 
+int g1_ata_queue_read_dma(g1_ata_req_t *req) {
+    const size_t max_sectors = CAN_USE_LBA48() ? ATA_MAX_SECTORS_LBA48 :
+        ATA_MAX_SECTORS_LBA28;
+    uintptr_t addr;
+    int old;
+
+    if(!req || !req->buf || (((uintptr_t)req->buf) & 0x1F)) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    /* Make sure that we've been initialized and there's a disk attached. */
+    if(!devices) {
+        errno = ENXIO;
+        return -1;
+    }
+
+    /* Make sure the disk supports LBA mode. */
+    if(!device.max_lba) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    /* Make sure the disk supports Multi-Word DMA mode 2. */
+    if(!device.wdma_modes) {
+        errno = EPERM;
+        return -1;
+    }
+
+    /* Each request has to fit in a single command, since the interrupt handler
+       doesn't do any chaining for queued requests. */
+    if(!req->count || req->count > max_sectors ||
+       (req->sector + req->count) > device.max_lba) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    addr = (uintptr_t)req->buf;
+
+    if((addr & MEM_AREA_P2_BASE) != MEM_AREA_P2_BASE)
+        dcache_inval_range(addr, req->count * 512);
+
+    req->next = NULL;
+    req->status = 1;
+
+    /* If the queue is already running, just tack this onto the end of it and
+       the interrupt handler will get to it. */
+    old = irq_disable();
+
+    if(dma_q_active) {
+        if(dma_q_tail)
+            dma_q_tail->next = req;
+        else
+            dma_q_head = req;
+
+        dma_q_tail = req;
+        irq_restore(old);
+        return 0;
+    }
+
+    irq_restore(old);
+
+    /* Otherwise, we need to take the bus. It will be released in the interrupt
+       handler once the queue is empty. */
+    if(g1_ata_mutex_lock()) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    old = irq_disable();
+
+    if(dma_in_progress || g1_dma_in_progress()) {
+        irq_restore(old);
+        g1_ata_mutex_unlock();
+        dbglog(DBG_KDEBUG, "g1_ata_queue_read_dma: DMA in progress\n");
+        errno = EIO;
+        return -1;
+    }
+
+    dma_q_head = dma_q_tail = req;
+    dma_q_active = 1;
+    dma_in_progress = 1;
+    dma_blocking = 0;
+    dma_thd = irq_inside_int() ? (kthread_t *)0xFFFFFFFF : thd_current;
+    irq_restore(old);
+
+    /* Wait for the device to signal it is ready, and start it up. */
+    g1_ata_wait_bsydrq();
+    dma_q_start(req);
+
+    return 0;
+}
+
 int g1_ata_write_lba(uint64_t sector, size_t count, const void *buf) {
     unsigned int i, j;
     size_t nsects;
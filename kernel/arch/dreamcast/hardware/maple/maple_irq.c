@@ -4,9 +4,11 @@
    Copyright (C) 2002 Megan Potter
    Copyright (C) 2015 Lawrence Sebald
    Copyright (C) 2016 Joe Fenton
+   Copyright (C) 2026 The KOS Team and contributors
  */
 
 #include <malloc.h>
+#include <errno.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -15,6 +17,7 @@
 #include <dc/asic.h>
 #include <dc/pvr.h>
 #include <kos/thread.h>
+#include <arch/irq.h>
 
 /*********************************************************************/
 /* VBlank IRQ handler */
@@ -233,6 +236,29 @@ void maple_vbl_irq_hnd(uint32 code, void *data) {
     /* dbgio_write_str("finish vbl_irq_hnd\n"); */
 }
 
+/* Poll devices now rather than at the next VBL */
+int maple_poll(uint32 functions) {
+    maple_driver_t *drv;
+
+    irq_disable_scoped();
+
+    /* The queue can't be sent while the bus is busy, and then the devices
+       will be polled at the next VBL anyway. */
+    if(maple_state.dma_in_progress) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    LIST_FOREACH(drv, &maple_state.driver_list, drv_list) {
+        if(drv->periodic != NULL && (drv->functions & functions))
+            drv->periodic(drv);
+    }
+
+    maple_queue_flush();
+
+    return 0;
+}
+
 /*********************************************************************/
 /* Maple DMA completion handler */
 
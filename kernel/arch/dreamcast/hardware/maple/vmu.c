@@ -70,6 +70,13 @@ static int vmu_attach(maple_driver_t *drv, maple_device_t *dev) {
     return 0;
 }
 
+static void vmu_detach(maple_driver_t *drv, maple_device_t *dev) {
+    (void)drv;
+
+    /* Whatever gets plugged in here next won't have the same filesystem */
+    vmufs_invalidate(dev);
+}
+
 static void vmu_poll_reply(maple_state_t *st, maple_frame_t *frm) {
     (void)st;
 
@@ -158,7 +165,7 @@ static maple_driver_t vmu_drv = {
     .periodic = NULL,
     .status_size = sizeof(vmu_state_t),
     .attach = vmu_attach,
-    .detach = NULL
+    .detach = vmu_detach
 };
 
 /* Add the VMU to the driver chain */
@@ -0,0 +1,342 @@
+/* KallistiOS ##version##
+
+   pvr_batch.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <errno.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_batch.h>
+#include "pvr_internal.h"
+
+/*
+
+   Polygon header batching
+
+   Please see ../../include/dc/pvr/pvr_batch.h for more info on this API!
+
+   The header cache is direct mapped: a context hashes to exactly one slot,
+   and a miss just compiles over whatever was there. That keeps lookups to a
+   hash, a compare and (rarely) a compile, with nothing to maintain.
+
+   Held back draws keep a copy of their header in a record, and their vertices
+   in a buffer shared by the two sortable lists. Flushing sorts pointers to
+   the records by header (texture word first, as that's the state most
+   likely to differ) and then by the order they were drawn in, so that draws
+   with the same state keep their relative order.
+
+*/
+
+#define BATCH_LISTS     2   /* Sortable lists: opaque and punch-through */
+
+typedef struct hdr_slot {
+    pvr_poly_hdr_t  hdr;
+    pvr_poly_cxt_t  cxt;
+    uint32_t        hash;
+    bool            valid;
+} __attribute__((aligned(32))) hdr_slot_t;
+
+typedef struct batch_draw {
+    pvr_poly_hdr_t  hdr;
+    uint32_t        offset;     /* Of the vertices in the vertex buffer */
+    uint32_t        size;
+    uint32_t        seq;
+} __attribute__((aligned(32))) batch_draw_t;
+
+typedef struct batch_list {
+    batch_draw_t    *draws;
+    batch_draw_t    **order;
+    uint32_t        count;
+} batch_list_t;
+
+static hdr_slot_t *hdr_cache;
+static uint32_t hdr_cache_mask;
+static pvr_poly_hdr_t hdr_scratch;
+
+static batch_list_t lists[BATCH_LISTS];
+static uint32_t max_draws;
+static uint8_t *vtx_buf;
+static uint32_t vtx_size, vtx_used;
+
+/* Last header sent to each list, and whether there is one. */
+static pvr_poly_hdr_t last_hdr[PVR_OPB_COUNT];
+static uint8_t last_valid;
+
+static pvr_batch_stats_t stats;
+
+static inline batch_list_t *sort_list(pvr_list_t list) {
+    if(!max_draws)
+        return NULL;
+
+    if(list == PVR_LIST_OP_POLY)
+        return lists;
+    else if(list == PVR_LIST_PT_POLY)
+        return lists + 1;
+
+    return NULL;
+}
+
+int pvr_batch_init(const pvr_batch_params_t *params) {
+    size_t n, i;
+
+    pvr_batch_shutdown();
+
+    if(params->hdr_cache_size) {
+        for(n = 1; n < params->hdr_cache_size; n <<= 1)
+            ;
+
+        if(!(hdr_cache = memalign(32, n * sizeof(hdr_slot_t))))
+            goto fail;
+
+        memset(hdr_cache, 0, n * sizeof(hdr_slot_t));
+        hdr_cache_mask = n - 1;
+    }
+
+    if(params->max_draws && params->vertex_buf_size) {
+        for(i = 0; i < BATCH_LISTS; ++i) {
+            lists[i].draws = memalign(32, params->max_draws *
+                                      sizeof(batch_draw_t));
+            lists[i].order = malloc(params->max_draws *
+                                    sizeof(batch_draw_t *));
+
+            if(!lists[i].draws || !lists[i].order)
+                goto fail;
+        }
+
+        if(!(vtx_buf = memalign(32, params->vertex_buf_size)))
+            goto fail;
+
+        max_draws = params->max_draws;
+        vtx_size = params->vertex_buf_size & ~31;
+    }
+
+    return 0;
+
+fail:
+    pvr_batch_shutdown();
+    errno = ENOMEM;
+    return -1;
+}
+
+void pvr_batch_shutdown(void) {
+    size_t i;
+
+    free(hdr_cache);
+    hdr_cache = NULL;
+    hdr_cache_mask = 0;
+
+    for(i = 0; i < BATCH_LISTS; ++i) {
+        free(lists[i].draws);
+        free(lists[i].order);
+        lists[i].draws = NULL;
+        lists[i].order = NULL;
+        lists[i].count = 0;
+    }
+
+    free(vtx_buf);
+    vtx_buf = NULL;
+    vtx_size = vtx_used = 0;
+    max_draws = 0;
+}
+
+static uint32_t cxt_hash(const pvr_poly_cxt_t *cxt) {
+    const uint32_t *w = (const uint32_t *)cxt;
+    uint32_t h = 0x811c9dc5;
+    size_t i;
+
+    for(i = 0; i < sizeof(*cxt) / sizeof(uint32_t); ++i)
+        h = (h ^ w[i]) * 0x9e3779b1;
+
+    return h ^ (h >> 15);
+}
+
+const pvr_poly_hdr_t *pvr_poly_hdr_cache(const pvr_poly_cxt_t *cxt) {
+    hdr_slot_t *s;
+    uint32_t h;
+
+    if(!hdr_cache) {
+        pvr_poly_compile(&hdr_scratch, cxt);
+        return &hdr_scratch;
+    }
+
+    h = cxt_hash(cxt);
+    s = hdr_cache + (h & hdr_cache_mask);
+
+    if(s->valid && s->hash == h && !memcmp(&s->cxt, cxt, sizeof(*cxt))) {
+        ++stats.cache_hits;
+        return &s->hdr;
+    }
+
+    ++stats.cache_misses;
+    pvr_poly_compile(&s->hdr, cxt);
+    s->cxt = *cxt;
+    s->hash = h;
+    s->valid = true;
+
+    return &s->hdr;
+}
+
+void pvr_poly_hdr_cache_clear(void) {
+    uint32_t i;
+
+    if(!hdr_cache)
+        return;
+
+    for(i = 0; i <= hdr_cache_mask; ++i)
+        hdr_cache[i].valid = false;
+}
+
+/* Send data to a list, whether it's open for direct submission or has a
+   vertex buffer to go in. */
+static int batch_send(pvr_list_t list, const void *data, size_t size) {
+    if(pvr_state.list_reg_open == (int)list)
+        return pvr_prim(data, size);
+
+    if(pvr_state.dma_mode && pvr_state.dma_buffers[pvr_state.ram_target].base[list])
+        return pvr_list_prim(list, data, size);
+
+    return -1;
+}
+
+static inline bool hdr_equal(const pvr_poly_hdr_t *a, const pvr_poly_hdr_t *b) {
+    const uint32_t *x = (const uint32_t *)a, *y = (const uint32_t *)b;
+
+    return x[0] == y[0] && x[1] == y[1] && x[2] == y[2] && x[3] == y[3] &&
+           x[4] == y[4] && x[5] == y[5] && x[6] == y[6] && x[7] == y[7];
+}
+
+int pvr_batch_hdr(pvr_list_t list, const pvr_poly_hdr_t *hdr) {
+    if(list >= PVR_OPB_COUNT)
+        return -1;
+
+    if((last_valid & BIT(list)) && hdr_equal(&last_hdr[list], hdr)) {
+        ++stats.hdrs_skipped;
+        stats.bytes_saved += sizeof(pvr_poly_hdr_t);
+        return 0;
+    }
+
+    if(batch_send(list, hdr, sizeof(pvr_poly_hdr_t)))
+        return -1;
+
+    last_hdr[list] = *hdr;
+    last_valid |= BIT(list);
+    ++stats.hdrs_sent;
+
+    return 1;
+}
+
+int pvr_batch_draw(pvr_list_t list, const pvr_poly_hdr_t *hdr,
+                   const void *verts, size_t size) {
+    batch_list_t *l = sort_list(list);
+    batch_draw_t *d;
+
+    if(l) {
+        if(l->count < max_draws && vtx_used + size <= vtx_size) {
+            d = l->draws + l->count;
+            d->hdr = *hdr;
+            d->offset = vtx_used;
+            d->size = size;
+            d->seq = l->count;
+            l->order[l->count++] = d;
+
+            memcpy(vtx_buf + vtx_used, verts, size);
+            vtx_used += size;
+
+            ++stats.draws_sorted;
+            return 0;
+        }
+
+        /* No room to hold it back. Order doesn't matter in this list, so it
+           can just go straight in. */
+        ++stats.draws_direct;
+    }
+
+    if(pvr_batch_hdr(list, hdr) < 0)
+        return -1;
+
+    return batch_send(list, verts, size);
+}
+
+static int draw_cmp(const void *a, const void *b) {
+    const batch_draw_t *x = *(const batch_draw_t * const *)a;
+    const batch_draw_t *y = *(const batch_draw_t * const *)b;
+
+    if(x->hdr.mode3 != y->hdr.mode3)
+        return x->hdr.mode3 < y->hdr.mode3 ? -1 : 1;
+
+    if(x->hdr.mode2 != y->hdr.mode2)
+        return x->hdr.mode2 < y->hdr.mode2 ? -1 : 1;
+
+    if(x->hdr.mode1 != y->hdr.mode1)
+        return x->hdr.mode1 < y->hdr.mode1 ? -1 : 1;
+
+    if(x->hdr.cmd != y->hdr.cmd)
+        return x->hdr.cmd < y->hdr.cmd ? -1 : 1;
+
+    /* The rest only differ for modifier volumes and intensity colors, which
+       are rare enough that there's no need to be clever about them. */
+    if(!hdr_equal(&x->hdr, &y->hdr))
+        return memcmp(&x->hdr, &y->hdr, sizeof(pvr_poly_hdr_t));
+
+    return (int)x->seq - (int)y->seq;
+}
+
+int pvr_batch_flush(pvr_list_t list) {
+    batch_list_t *l = sort_list(list);
+    batch_draw_t *d;
+    uint32_t i;
+
+    if(!l || !l->count)
+        return 0;
+
+    qsort(l->order, l->count, sizeof(batch_draw_t *), draw_cmp);
+
+    for(i = 0; i < l->count; ++i) {
+        d = l->order[i];
+
+        if(pvr_batch_hdr(list, &d->hdr) < 0 ||
+           batch_send(list, vtx_buf + d->offset, d->size))
+            return -1;
+    }
+
+    l->count = 0;
+
+    /* Once nothing is held back, the vertex buffer can start over. */
+    if(!lists[0].count && !lists[1].count)
+        vtx_used = 0;
+
+    return 0;
+}
+
+void pvr_batch_invalidate(pvr_list_t list) {
+    if(list < PVR_OPB_COUNT)
+        last_valid &= ~BIT(list);
+}
+
+void pvr_batch_stats(pvr_batch_stats_t *st) {
+    *st = stats;
+}
+
+/* Called by pvr_scene_begin(): nothing has been sent in the new scene yet.
+   Anything still held back was drawn to a list that was already finished, and
+   can't be sent any more. */
+void pvr_int_batch_reset(void) {
+    size_t i;
+
+    last_valid = 0;
+
+    for(i = 0; i < BATCH_LISTS; ++i)
+        lists[i].count = 0;
+
+    vtx_used = 0;
+}
+
+/* Called by pvr_list_finish(), while the list can still be submitted to, and
+   by pvr_scene_finish() for lists with a DMA vertex buffer. */
+void pvr_int_batch_finish(pvr_list_t list) {
+    pvr_batch_flush(list);
+}
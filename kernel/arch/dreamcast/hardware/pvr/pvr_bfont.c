@@ -0,0 +1,526 @@
+/* KallistiOS ##version##
+
+   pvr_bfont.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_bfont.h>
+#include <dc/pvr/pvr_fence.h>
+#include <dc/pvr/pvr_sprite_batch.h>
+#include <dc/biosfont.h>
+#include <dc/syscalls.h>
+#include <kos/thread.h>
+
+/*
+
+   BIOS font text
+
+   Please see ../../include/dc/pvr/pvr_bfont.h for more info on this API!
+
+   The atlas is split into slots 16 pixels wide and 32 high, numbered across
+   and then down. A half-width character takes one slot; anything wider
+   takes an even slot and the one after it (a whole cell). Each slot has the
+   number of the first slot of the glyph in it, or -1 if it's empty, and the
+   first slot has the glyph's key and the fence of the last scene to draw it.
+
+   A glyph's key is where its bitmap is in the font, with its size on top,
+   so the same glyph reached through different encodings is only loaded
+   once. Keys are found in an open addressing hash table of slot numbers.
+
+   Every glyph bitmap in the font (thin and wide characters, Dreamcast and
+   VMU icons) is rows of 1 bit pixels, most significant bit first, with no
+   padding between rows, so they're all copied out the same way.
+
+   Sprites only have 16-bit texture coordinates (8 significant bits), but
+   every glyph edge is a slot edge, or 12 or 24 pixels past one, which is
+   always exact.
+
+*/
+
+#define SLOT_W      16
+#define SLOT_H      32
+
+#define KIND_THIN   1
+#define KIND_WIDE   2
+#define KIND_VMU    3
+
+/* Size of each kind of glyph */
+static const uint8_t kind_w[] = { 0, BFONT_THIN_WIDTH, BFONT_WIDE_WIDTH,
+                                  BFONT_ICON_DIMEN };
+static const uint8_t kind_h[] = { 0, BFONT_HEIGHT, BFONT_HEIGHT,
+                                  BFONT_ICON_DIMEN };
+
+typedef struct {
+    uint32_t    key;
+    pvr_fence_t fence;
+    int16_t     first;
+} slot_t;
+
+static pvr_ptr_t atlas;
+static uint32_t atlas_w, atlas_h;
+static slot_t *slots;
+static uint32_t n_slots, slots_across;
+
+static uint16_t *hash;
+static uint32_t hash_mask, hash_shift;
+
+static const uint8_t *font_base;
+
+static pvr_sprite_hdr_t base_hdr;
+static uint8_t text_layer;
+
+static struct {
+    uint32_t argb;
+    int state;
+} colors[PVR_BFONT_MAX_COLORS];
+
+static int n_colors;
+
+/* Sprite batcher state generation the colors were registered in */
+static uint32_t colors_gen;
+
+static pvr_bfont_stats_t stats;
+
+static inline uint32_t hash_of(uint32_t key) {
+    return (key * 0x9e3779b1) >> hash_shift;
+}
+
+static int hash_find(uint32_t key) {
+    uint32_t i = hash_of(key);
+
+    while(hash[i]) {
+        if(slots[hash[i] - 1].key == key)
+            return hash[i] - 1;
+
+        i = (i + 1) & hash_mask;
+    }
+
+    return -1;
+}
+
+static void hash_add(uint32_t key, int s) {
+    uint32_t i = hash_of(key);
+
+    while(hash[i])
+        i = (i + 1) & hash_mask;
+
+    hash[i] = s + 1;
+}
+
+static void hash_remove(uint32_t key) {
+    uint32_t i = hash_of(key), j, home;
+
+    while(slots[hash[i] - 1].key != key)
+        i = (i + 1) & hash_mask;
+
+    /* Move later entries of the run back into the gap, unless that would
+       put them before where they hash to. */
+    hash[i] = 0;
+
+    for(j = (i + 1) & hash_mask; hash[j]; j = (j + 1) & hash_mask) {
+        home = hash_of(slots[hash[j] - 1].key);
+
+        if(((j - home) & hash_mask) >= ((j - i) & hash_mask)) {
+            hash[i] = hash[j];
+            hash[j] = 0;
+            i = j;
+        }
+    }
+}
+
+/* How long ago a slot was drawn, or 0 if it can't be replaced yet. */
+static uint32_t slot_age(uint32_t s, pvr_fence_t now) {
+    slot_t *g;
+
+    if(slots[s].first < 0)
+        return UINT32_MAX;
+
+    g = slots + slots[s].first;
+
+    if(!pvr_fence_reached(g->fence, PVR_FENCE_RENDER_DONE))
+        return 0;
+
+    return now - g->fence + 1;
+}
+
+static void evict(uint32_t s) {
+    slot_t *g;
+    int i;
+
+    if(slots[s].first < 0)
+        return;
+
+    g = slots + slots[s].first;
+    hash_remove(g->key);
+
+    for(i = (g->key >> 28) == KIND_THIN ? 1 : 2; i; i--)
+        g[i - 1].first = -1;
+
+    ++stats.evictions;
+}
+
+/* Find the room for a glyph: the slot (or pair of them) drawn longest ago.
+   A glyph that has never been drawn is always the oldest. */
+static int find_room(uint32_t span) {
+    pvr_fence_t now = pvr_scene_fence();
+    uint32_t s, age, best_age = 0;
+    int best = -1;
+
+    for(s = 0; s < n_slots; s += span) {
+        age = slot_age(s, now);
+
+        if(span == 2 && age)
+            age = age < slot_age(s + 1, now) ? age : slot_age(s + 1, now);
+
+        if(age > best_age) {
+            best_age = age;
+            best = s;
+
+            if(age == UINT32_MAX)
+                break;
+        }
+    }
+
+    if(best >= 0) {
+        evict(best);
+
+        if(span == 2)
+            evict(best + 1);
+    }
+
+    return best;
+}
+
+/* Copy a glyph out of the font into the atlas. */
+static int load_glyph(uint32_t key, const uint8_t *src) {
+    uint16_t pixels[SLOT_H][SLOT_W * 2];
+    uint32_t kind = key >> 28, w = kind_w[kind], h = kind_h[kind];
+    uint32_t span = kind == KIND_THIN ? 1 : 2;
+    uint32_t x, y, bit = 0, *dst;
+    uint32_t *row;
+    int s, i;
+
+    if((s = find_room(span)) < 0)
+        return -1;
+
+    /* Transparent white, with the glyph's pixels opaque */
+    for(y = 0; y < SLOT_H; y++)
+        for(x = 0; x < SLOT_W * 2; x++)
+            pixels[y][x] = 0x0fff;
+
+    /* The BIOS may be using the font. */
+    while(syscall_font_lock())
+        thd_pass();
+
+    for(y = 0; y < h; y++)
+        for(x = 0; x < w; x++, bit++)
+            if(src[bit >> 3] & (0x80 >> (bit & 7)))
+                pixels[y][x] = 0xffff;
+
+    syscall_font_unlock();
+
+    dst = (uint32_t *)((uint8_t *)atlas +
+                       ((s / slots_across) * SLOT_H * atlas_w +
+                        (s % slots_across) * SLOT_W) * 2);
+
+    for(y = 0; y < SLOT_H; y++, dst += atlas_w / 2) {
+        row = (uint32_t *)pixels[y];
+
+        for(i = 0; i < (int)span * SLOT_W / 2; i++)
+            dst[i] = row[i];
+    }
+
+    slots[s].key = key;
+    slots[s + span - 1].first = s;
+    slots[s].first = s;
+    hash_add(key, s);
+    ++stats.loads;
+
+    return s;
+}
+
+static int color_state(uint32_t argb) {
+    pvr_sprite_hdr_t hdr;
+    int i;
+
+    /* The sprite batcher's states were cleared; register them again. */
+    if(colors_gen != pvr_sprite_batch_generation()) {
+        colors_gen = pvr_sprite_batch_generation();
+        n_colors = 0;
+    }
+
+    for(i = 0; i < n_colors; i++)
+        if(colors[i].argb == argb)
+            return colors[i].state;
+
+    if(n_colors == PVR_BFONT_MAX_COLORS)
+        return -1;
+
+    hdr = base_hdr;
+    hdr.argb = argb;
+
+    if((colors[n_colors].state = pvr_sprite_batch_state(&hdr)) < 0)
+        return -1;
+
+    colors[n_colors].argb = argb;
+
+    return colors[n_colors++].state;
+}
+
+static void draw_glyph(int state, const uint8_t *src, uint32_t kind,
+                       float x, float y, float z) {
+    uint32_t key = (kind << 28) | (src - font_base);
+    float u, v;
+    int s;
+
+    if(state < 0) {
+        ++stats.dropped;
+        return;
+    }
+
+    if((s = hash_find(key)) < 0 && (s = load_glyph(key, src)) < 0) {
+        ++stats.dropped;
+        return;
+    }
+
+    slots[s].fence = pvr_scene_fence();
+
+    u = (float)((s % slots_across) * SLOT_W) / atlas_w;
+    v = (float)((s / slots_across) * SLOT_H) / atlas_h;
+
+    if(pvr_sprite_batch_rect(state, text_layer, x, y, kind_w[kind],
+                             kind_h[kind], z, u, v,
+                             u + (float)kind_w[kind] / atlas_w,
+                             v + (float)kind_h[kind] / atlas_h) < 0)
+        ++stats.dropped;
+    else
+        ++stats.glyphs;
+}
+
+/* Does the line starting here have a VMU icon in it? */
+static bool has_vmu_icon(const char *str) {
+    for(; *str && *str != '\n'; str++)
+        if(str[0] == '\\' && str[1] == 'v' && str[2] == 'i')
+            return true;
+
+    return false;
+}
+
+static inline uint32_t icon_code(const char *str) {
+    char hex[3] = { str[3], str[4], '\0' };
+
+    return strtol(hex, NULL, 16);
+}
+
+/* Lay out a string the same way as bfont_draw_str_ex(), drawing it if state
+   isn't -2. Returns where the last line ended, and the widest line's width
+   in *width. */
+static float layout(float x0, float y, float z, int state, const char *str,
+                    float *width) {
+    bfont_code_t mode = bfont_get_encoding();
+    const uint8_t *src;
+    uint32_t c, kind, line_h;
+    float x = x0, w = 0.0f;
+    bool draw = state != -2;
+
+    line_h = has_vmu_icon(str) ? BFONT_ICON_DIMEN : BFONT_HEIGHT;
+
+    for(; *str; str++) {
+        c = *str & 0xff;
+        src = NULL;
+        kind = KIND_THIN;
+
+        if(c == '\n') {
+            w = x - x0 > w ? x - x0 : w;
+            x = x0;
+            y += line_h;
+            line_h = has_vmu_icon(str + 1) ? BFONT_ICON_DIMEN : BFONT_HEIGHT;
+            continue;
+        }
+        else if(c == '\t') {
+            x += 4 * BFONT_THIN_WIDTH;
+            continue;
+        }
+        else if(c == ' ' && mode != BFONT_CODE_RAW) {
+            /* Blank anyway, so don't spend a slot or a sprite on it. */
+            x += BFONT_THIN_WIDTH;
+            continue;
+        }
+        else if(c == '\\' && str[1] == 'd' && str[2] == 'i' && str[3] &&
+                str[4]) {
+            src = bfont_find_dc_icon(icon_code(str));
+            kind = KIND_WIDE;
+            str += 4;
+        }
+        else if(c == '\\' && str[1] == 'v' && str[2] == 'i' && str[3] &&
+                str[4]) {
+            src = bfont_find_icon(icon_code(str));
+            kind = KIND_VMU;
+            str += 4;
+        }
+        else if(mode == BFONT_CODE_RAW) {
+            src = font_base + c;
+        }
+        else if(mode != BFONT_CODE_ISO8859_1 && (c & 0x80)) {
+            if(mode == BFONT_CODE_EUC && c == 0x8e) {
+                /* Half-width katakana */
+                if(str[1])
+                    c = *++str & 0xff;
+
+                if(c < 0xa1 || c > 0xdf)
+                    c = 0xa0;
+
+                src = bfont_find_char_jp_half(c);
+            }
+            else if(mode == BFONT_CODE_EUC || (c & 0xf0) == 0x80 ||
+                    (c & 0xf0) == 0x90 || (c & 0xf0) == 0xe0) {
+                if(!str[1])
+                    break;
+
+                c = (c << 8) | (*++str & 0xff);
+                src = bfont_find_char_jp(c);
+                kind = KIND_WIDE;
+            }
+            else {
+                src = bfont_find_char_jp_half(c);
+            }
+        }
+        else {
+            src = bfont_find_char(c);
+        }
+
+        /* Bad icons take no room, like with bfont_draw_str(). */
+        if(!src)
+            continue;
+
+        if(draw)
+            draw_glyph(state, src, kind, x, kind == KIND_VMU ? y :
+                       y + line_h - BFONT_HEIGHT, z);
+
+        x += kind_w[kind];
+    }
+
+    *width = x - x0 > w ? x - x0 : w;
+
+    return x;
+}
+
+int pvr_bfont_init(const pvr_bfont_params_t *params) {
+    pvr_sprite_cxt_t cxt;
+    pvr_sprite_hdr_t hdr;
+    uint32_t n;
+
+    pvr_bfont_shutdown();
+
+    if(__builtin_popcount(params->atlas_w) != 1 ||
+       __builtin_popcount(params->atlas_h) != 1 ||
+       params->atlas_w < 32 || params->atlas_w > 1024 ||
+       params->atlas_h < 32 || params->atlas_h > 1024 ||
+       (params->list != PVR_LIST_TR_POLY && params->list != PVR_LIST_PT_POLY)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    atlas_w = params->atlas_w;
+    atlas_h = params->atlas_h;
+    slots_across = atlas_w / SLOT_W;
+    n_slots = slots_across * (atlas_h / SLOT_H);
+
+    /* At most half full */
+    for(n = 2; n < n_slots * 2; n <<= 1)
+        ;
+
+    hash_mask = n - 1;
+    hash_shift = 32 - __builtin_ctz(n);
+
+    atlas = pvr_mem_malloc(atlas_w * atlas_h * 2);
+    slots = malloc(n_slots * sizeof(slot_t));
+    hash = calloc(n, sizeof(uint16_t));
+
+    if(!atlas || !slots || !hash) {
+        pvr_bfont_shutdown();
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for(n = 0; n < n_slots; n++)
+        slots[n].first = -1;
+
+    font_base = syscall_font_address();
+
+    pvr_sprite_cxt_txr(&cxt, params->list,
+                       PVR_TXRFMT_ARGB4444 | PVR_TXRFMT_NONTWIDDLED,
+                       atlas_w, atlas_h, atlas, PVR_FILTER_NONE);
+    pvr_sprite_compile(&base_hdr, &cxt);
+
+    text_layer = params->layer;
+
+    /* The states for the colors from last time are still registered, so point
+       them at the new atlas rather than registering more. */
+    if(colors_gen != pvr_sprite_batch_generation())
+        n_colors = 0;
+
+    for(n = 0; n < (uint32_t)n_colors; n++) {
+        hdr = base_hdr;
+        hdr.argb = colors[n].argb;
+        pvr_sprite_batch_set_state(colors[n].state, &hdr);
+    }
+
+    memset(&stats, 0, sizeof(stats));
+
+    return 0;
+}
+
+void pvr_bfont_shutdown(void) {
+    /* The last scene to draw text may still be rendering. */
+    if(atlas)
+        pvr_mem_free_after(atlas, pvr_scene_fence());
+
+    free(slots);
+    free(hash);
+
+    atlas = NULL;
+    slots = NULL;
+    hash = NULL;
+}
+
+float pvr_bfont_draw(float x, float y, float z, uint32_t argb,
+                     const char *str) {
+    float w;
+
+    if(!atlas)
+        return x;
+
+    return layout(x, y, z, color_state(argb), str, &w);
+}
+
+float pvr_bfont_draw_fmt(float x, float y, float z, uint32_t argb,
+                         const char *fmt, ...) {
+    char str[1088];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(str, sizeof(str), fmt, args);
+    va_end(args);
+
+    return pvr_bfont_draw(x, y, z, argb, str);
+}
+
+float pvr_bfont_width(const char *str) {
+    float w;
+
+    layout(0.0f, 0.0f, 0.0f, -2, str, &w);
+
+    return w;
+}
+
+void pvr_bfont_stats(pvr_bfont_stats_t *st) {
+    *st = stats;
+}
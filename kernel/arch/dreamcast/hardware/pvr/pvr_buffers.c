@@ -33,24 +33,74 @@
 #define LIST_ENABLED(i) (pvr_state.lists_enabled & BIT(i))
 
 
+/* What each TA buffer's tile matrix is laid out for: the tile count, in the
+   form of PVR_TILEMAT_CFG, and the sort mode. */
+static uint32 tm_tsize[2];
+static bool tm_presort[2];
+
+/* Sort mode for the frames to come */
+static bool presort_mode;
+
+/* Lay out a tile matrix for a render of tw by th tiles. Each tile (32x32)
+   gets an entry pointing at its part of each list's object pointer buffers,
+   which the TA lays out one list after another, one block per tile. */
+static void pvr_fill_tile_matrix(int which, int tw, int th, bool presort) {
+    volatile pvr_ta_buffers_t   *buf;
+    int     x, y, i, tn;
+    uint32      *vr;  /* Note: We're working in 4-byte pointer maths in this function */
+    uint32      opb[PVR_OPB_COUNT], accum;
+
+    buf = pvr_state.ta_buffers + which;
+    vr = (uint32*)PVR_RAM_BASE + BYTES_TO_WORDS(buf->tile_matrix);
+
+    /* Initial init tile */
+    vr[0] = 0x10000000;
+    vr[1] = 0x80000000;
+    vr[2] = 0x80000000;
+    vr[3] = 0x80000000;
+    vr[4] = 0x80000000;
+    vr[5] = 0x80000000;
+    vr += 6;
+
+    /* Where each list's buffers start, for this many tiles */
+    for(i = 0, accum = buf->opb; i < PVR_OPB_COUNT; i++) {
+        opb[i] = accum;
+        accum += pvr_state.opb_size[i] * tw * th;
+    }
+
+    for(x = 0; x < tw; x++) {
+        for(y = 0; y < th; y++) {
+            tn = (tw * y) + x;
+
+            /* Control word */
+            vr[0] = (y << 8) | (x << 2) | (presort << 29);
+
+            /* Opaque poly, opaque volume mod, translucent poly, translucent
+               volume mod and punch-thru poly buffers. If a list isn't
+               enabled, then we set the address to 0x80000000 which tells the
+               PVR to ignore it. */
+            for(i = 0; i < PVR_OPB_COUNT; i++)
+                vr[i + 1] = LIST_ENABLED(i) ? opb[i] + (pvr_state.opb_size[i] * tn) : 0x80000000;
+
+            vr += 6;
+        }
+    }
+
+    vr[-6] |= BIT(31);
+
+    tm_tsize[which] = ((th - 1) << 16) | (tw - 1);
+    tm_presort[which] = presort;
+}
+
 /* Fill Tile Matrix buffers. This function takes a base address and sets up
-   the rendering structures there. Each tile of the screen (32x32) receives
-   a small buffer space. */
+   the rendering structures there, for the whole screen. */
 static void pvr_init_tile_matrix(int which, bool presort) {
     volatile pvr_ta_buffers_t   *buf;
-    int     x, y, tn;
-    uint32      *vr;  /* Note: We're working in 4-byte pointer maths in this function */
-    volatile int    *opb_sizes;
-    //uint32      matbase, opbbase;
+    int     x;
+    uint32      *vr;
 
     vr = (uint32*)PVR_RAM_BASE;
     buf = pvr_state.ta_buffers + which;
-    opb_sizes = pvr_state.opb_size;
-
-#if 0
-    matbase = buf->tile_matrix;
-    opbbase = buf->opb;
-#endif
 
     /*
         FIXME? Is this header necessary? If we're moving the tilematrix
@@ -63,79 +113,96 @@ static void pvr_init_tile_matrix(int which, bool presort) {
     for(x = 0; x < 0x48; x += 4)
         * vr++ = 0;
 
-    /* Initial init tile */
-    vr[0] = 0x10000000;
-    vr[1] = 0x80000000;
-    vr[2] = 0x80000000;
-    vr[3] = 0x80000000;
-    vr[4] = 0x80000000;
-    vr[5] = 0x80000000;
-    vr += 6;
-
     /* Must skip over zeroed header for actual usage */
     buf->tile_matrix += 0x48;
 
-    /* Now the main tile matrix */
-#if 0
-    dbglog(DBG_KDEBUG, "  Using poly buffers %08lx/%08lx/%08lx/%08lx/%08lx\r\n",
-           buf->opb_type[0],
-           buf->opb_type[1],
-           buf->opb_type[2],
-           buf->opb_type[3],
-           buf->opb_type[4]);
-#endif  /* !NDEBUG */
-
     /*
-        This sets up the addresses for each list, for each tile in the
-        memory we allocate in pvr_allocate_buffers. If a list isn't enabled
-        for a tile, then we set the address to 0x80000000 which tells the PVR
-        to ignore it.
-
         Memory for each frame is arranged sort-of like this:
 
         [vertex_buffer | object pointer buffers | tilematrix header | tile matrix]
 
         This is the tile matrix setup.
     */
+    pvr_fill_tile_matrix(which, pvr_state.tw, pvr_state.th, presort);
+}
 
-    for(x = 0; x < pvr_state.tw; x++) {
-        for(y = 0; y < pvr_state.th; y++) {
-            tn = (pvr_state.tw * y) + x;
+/* Fill all tile matrices */
+void pvr_init_tile_matrices(bool presort) {
+    int i;
 
-            /* Control word */
-            vr[0] = (y << 8) | (x << 2) | (presort << 29);
+    presort_mode = presort;
 
-            /* Opaque poly buffer */
-            vr[1] = LIST_ENABLED(0) ? buf->opb_addresses[0] + (opb_sizes[0] * tn) : 0x80000000;
+    for(i = 0; i < 2; i++)
+        pvr_init_tile_matrix(i, presort);
+}
 
-            /* Opaque volume mod buffer */
-            vr[2] = LIST_ENABLED(1) ? buf->opb_addresses[1] + (opb_sizes[1] * tn) : 0x80000000;
+/* Make sure a tile matrix is laid out for a render of tw by th tiles in the
+   current sort mode; it's left alone if it already is. */
+void pvr_layout_tile_matrix(int which, int tw, int th) {
+    if(tm_tsize[which] != (uint32)(((th - 1) << 16) | (tw - 1)) ||
+       tm_presort[which] != presort_mode)
+        pvr_fill_tile_matrix(which, tw, th, presort_mode);
+}
 
-            /* Translucent poly buffer */
-            vr[3] = LIST_ENABLED(2) ? buf->opb_addresses[2] + (opb_sizes[2] * tn) : 0x80000000;
+/* The other buffer picks up the new mode when it's next registered into. The
+   one being registered into keeps the size the TA was set up with, which is a
+   render target's rather than the screen's during a render-to-texture. */
+void pvr_set_presort_mode(bool presort) {
+    presort_mode = presort;
+    pvr_layout_tile_matrix(pvr_state.ta_target,
+                           (pvr_state.ta_tsize & 0xffff) + 1,
+                           (pvr_state.ta_tsize >> 16) + 1);
+}
 
-            /* Translucent volume mod buffer */
-            vr[4] = LIST_ENABLED(3) ? buf->opb_addresses[3] + (opb_sizes[3] * tn) : 0x80000000;
 
-            /* Punch-thru poly buffer */
-            vr[5] = LIST_ENABLED(4) ? buf->opb_addresses[4] + (opb_sizes[4] * tn) : 0x80000000;
-            vr += 6;
+/* Work out OPB sizes from what's been measured since pvr_init() (or the last
+   pvr_reset_opb_stats()).
+
+   Only overflow use can be measured, so bins are never made smaller; the
+   savings come from overflow space that's never used. A list whose overflow
+   is more than half the size of its bins would usually be better off with
+   bins twice the size, as every block in a chain spends a word linking to the
+   next one. */
+int pvr_suggest_opb_sizes(pvr_init_params_t *params) {
+    volatile pvr_ta_buffers_t *buf;
+    uint32 tiles, words, area, need, total, peak;
+    int i, count;
+
+    if(!pvr_state.valid || !pvr_state.opb_frames)
+        return -1;
+
+    buf = pvr_state.ta_buffers + pvr_state.ta_target;
+    tiles = pvr_state.tw * pvr_state.th;
+    need = total = 0;
+
+    for(i = 0; i < PVR_OPB_COUNT; i++) {
+        words = BYTES_TO_WORDS(pvr_state.opb_size[i]);
+        peak = pvr_state.opb_used_max[i];
+
+        while(words && words < PVR_BINSIZE_32 &&
+              peak > WORDS_TO_BYTES(words) * tiles / 2) {
+            /* Doubling the bins adds as much again to each list */
+            area = WORDS_TO_BYTES(words) * tiles;
+            peak = peak > area ? peak - area : 0;
+            words *= 2;
         }
+
+        params->opb_sizes[i] = words;
+        total += WORDS_TO_BYTES(words) * tiles;
+        need += peak;
     }
 
-    vr[-6] |= BIT(31);
-}
+    /* Leave a quarter again as a margin. */
+    need += need / 4;
+    count = total ? (need + total - 1) / total : 0;
 
-/* Fill all tile matrices */
-void pvr_init_tile_matrices(bool presort) {
-    int i;
+    /* If it ran out, the peaks are short of what was really needed. */
+    if(pvr_state.opb_outofmem && count <= (int)buf->opb_overflow_count)
+        count = buf->opb_overflow_count + 1;
 
-    for(i = 0; i < 2; i++)
-        pvr_init_tile_matrix(i, presort);
-}
+    params->opb_overflow_count = count;
 
-void pvr_set_presort_mode(bool presort) {
-    pvr_init_tile_matrix(pvr_state.ta_target, presort);
+    return 0;
 }
 
 
@@ -180,6 +247,7 @@ void pvr_allocate_buffers(const pvr_init_params_t *params) {
 
     pvr_state.tsize_const = ((pvr_state.th - 1) << 16)
                             | ((pvr_state.tw - 1) << 0);
+    pvr_state.ta_tsize = pvr_state.tsize_const;
 
     /* Set clipping parameters */
     pvr_state.zclip = 0.0001f;
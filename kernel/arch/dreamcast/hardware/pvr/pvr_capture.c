@@ -0,0 +1,310 @@
+/* KallistiOS ##version##
+
+   pvr_capture.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arch/irq.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_capture.h>
+#include <kos/fs.h>
+#include "pvr_internal.h"
+
+/*
+
+   Frame capture
+
+   Please see ../../include/dc/pvr/pvr_capture.h for more info on this API!
+
+   Once armed, pvr_state.capture goes to 2 at the next pvr_scene_begin(),
+   and from then on, data sent straight to the TA is appended to a buffer as
+   it goes, already laid out as LIST chunks. Data in the DMA vertex buffers is
+   copied in from the buffers themselves when the scene is finished, since
+   it's all still there at that point. Then the file is written, which is
+   slow, but it's only one frame.
+
+*/
+
+/* Bytes of VRAM copied at a time for the texture dump. */
+#define VRAM_CHUNK  4096
+
+static char *cap_fn;
+static int cap_flags;
+static uint8 *cap_buf;
+static size_t cap_size, cap_used;
+static uint32 cap_trunc;
+
+/* Offset in cap_buf of the payload size of the last LIST chunk, and the list
+   it's for; data for the same list carries on in the same chunk. */
+static size_t cap_last;
+static int cap_last_list;
+
+int pvr_capture_frame(const char *fn, size_t max_bytes, int flags) {
+    char *name;
+    uint8 *buf;
+
+    if(pvr_state.capture) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    name = strdup(fn);
+    buf = malloc(max_bytes);
+
+    if(!name || !buf) {
+        free(name);
+        free(buf);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    cap_fn = name;
+    cap_flags = flags;
+    cap_buf = buf;
+    cap_size = max_bytes;
+    pvr_state.capture = 1;
+
+    return 0;
+}
+
+bool pvr_capture_pending(void) {
+    return pvr_state.capture != 0;
+}
+
+void pvr_int_capture_begin(void) {
+    /* Only start at the top of a frame. */
+    if(pvr_state.capture != 1)
+        return;
+
+    cap_used = 0;
+    cap_trunc = 0;
+    cap_last_list = -1;
+    pvr_state.capture = 2;
+}
+
+void pvr_int_capture_data(int list, const void *data, size_t size) {
+    uint32 hdr[3];
+
+    /* Once something's been left out, the rest would make no sense. */
+    if(pvr_state.capture != 2 || cap_trunc || !size)
+        return;
+
+    if(list != cap_last_list) {
+        if(cap_used + sizeof(hdr) + size > cap_size) {
+            cap_trunc = PVR_CAPTURE_TRUNCATED;
+            return;
+        }
+
+        hdr[0] = PVR_CAPTURE_LIST;
+        hdr[1] = 4;
+        hdr[2] = list;
+        memcpy(cap_buf + cap_used, hdr, sizeof(hdr));
+        cap_last = cap_used + 4;
+        cap_last_list = list;
+        cap_used += sizeof(hdr);
+    }
+    else if(cap_used + size > cap_size) {
+        cap_trunc = PVR_CAPTURE_TRUNCATED;
+        return;
+    }
+
+    memcpy(cap_buf + cap_used, data, size);
+    cap_used += size;
+    *(uint32 *)(cap_buf + cap_last) += size;
+}
+
+void pvr_dr_capture(void *addr) {
+    uint32 sq[8];
+    int i;
+
+    if(pvr_state.capture != 2)
+        return;
+
+    /* The Store Queues can be read back in privileged mode, from the P4
+       area; bit 5 of the address says which one it is. */
+    for(i = 0; i < 8; i++)
+        sq[i] = ((volatile uint32 *)(0xff001000 | ((uintptr_t)addr & 0x20)))[i];
+
+    pvr_int_capture_data(pvr_state.list_reg_open, sq, 32);
+}
+
+static int write_chunk(file_t f, uint32 id, uint32 arg, const void *data,
+                       size_t size, bool has_arg) {
+    uint32 hdr[3];
+    size_t hs = has_arg ? 12 : 8;
+
+    hdr[0] = id;
+    hdr[1] = size + (has_arg ? 4 : 0);
+    hdr[2] = arg;
+
+    if(fs_write(f, hdr, hs) != (ssize_t)hs)
+        return -1;
+
+    if(size && fs_write(f, data, size) != (ssize_t)size)
+        return -1;
+
+    return 0;
+}
+
+static int write_regs(file_t f) {
+    pvr_capture_regs_t r;
+    volatile pvr_ta_buffers_t *buf;
+    int i;
+    union {
+        float f;
+        uint32 i;
+    } zc;
+
+    buf = pvr_state.ta_buffers + pvr_state.ta_target;
+    zc.f = pvr_state.zclip;
+
+    memset(&r, 0, sizeof(r));
+    r.width = pvr_state.w;
+    r.height = pvr_state.h;
+    r.tiles_x = pvr_state.tw;
+    r.tiles_y = pvr_state.th;
+    r.fsaa = pvr_state.fsaa;
+    r.lists_enabled = pvr_state.lists_enabled;
+
+    for(i = 0; i < PVR_OPB_COUNT; i++)
+        r.opb_size[i] = pvr_state.opb_size[i];
+
+    r.opb_overflow_count = buf->opb_overflow_count;
+    r.bg_color = pvr_state.bg_color;
+    r.zclip = zc.i;
+    r.pclip_x = pvr_state.pclip_x;
+    r.pclip_y = pvr_state.pclip_y;
+    /* There's no copy of this outside of the tile matrix. */
+    r.presort = (((uint32 *)PVR_RAM_BASE)[buf->tile_matrix >> 2] >> 29) & 1;
+    r.to_texture = pvr_state.curr_to_texture;
+    r.dma_mode = pvr_state.dma_mode;
+    r.texture_base = pvr_state.texture_base;
+    r.txr_stride = PVR_GET(PVR_TXR_STRIDE_MULT);
+    r.pt_alpha_ref = PVR_GET(PVR_PT_ALPHA_REF);
+    r.cheap_shadow = PVR_GET(PVR_CHEAP_SHADOW);
+
+    return write_chunk(f, PVR_CAPTURE_REGS, 0, &r, sizeof(r), false);
+}
+
+static int write_palette(file_t f) {
+    uint32 *pal;
+    int i, rv;
+
+    if(!(pal = malloc(1024 * 4)))
+        return -1;
+
+    for(i = 0; i < 1024; i++)
+        pal[i] = PVR_GET(PVR_PALETTE_TABLE_BASE + 4 * i);
+
+    rv = write_chunk(f, PVR_CAPTURE_PALT, PVR_GET(PVR_PALETTE_CFG), pal,
+                     1024 * 4, true);
+    free(pal);
+
+    return rv;
+}
+
+static int write_vram(file_t f) {
+    uint32 *tmp;
+    uint32 off, end, i;
+    int rv = 0;
+
+    if(!(tmp = malloc(VRAM_CHUNK)))
+        return -1;
+
+    off = pvr_state.texture_base;
+    end = PVR_RAM_SIZE;
+
+    if(write_chunk(f, PVR_CAPTURE_VRAM, off, NULL, end - off, true)) {
+        free(tmp);
+        return -1;
+    }
+
+    /* Textures are read through the 64-bit area, the way the TSP sees them.
+       It has to be read a word at a time, so bounce it through RAM. */
+    while(off < end && !rv) {
+        for(i = 0; i < VRAM_CHUNK / 4; i++)
+            tmp[i] = ((volatile uint32 *)(PVR_RAM_INT_BASE + off))[i];
+
+        if(fs_write(f, tmp, VRAM_CHUNK) != VRAM_CHUNK)
+            rv = -1;
+
+        off += VRAM_CHUNK;
+    }
+
+    free(tmp);
+
+    return rv;
+}
+
+/* Copy one list's DMA vertex buffer pieces into the capture. */
+static void capture_dma_list(int list) {
+    volatile pvr_dma_buffers_t *b;
+    int i;
+
+    b = pvr_state.dma_buffers + pvr_state.ram_target;
+
+    if(!b->base[list])
+        return;
+
+    pvr_int_capture_data(list, b->base[list], b->ptr[list]);
+
+    if(b->ext_base[list])
+        pvr_int_capture_data(list, b->ext_base[list], b->ext_ptr[list]);
+
+    for(i = 0; i < b->chain_count[list]; i++)
+        pvr_int_capture_data(list, b->chain_base[list][i],
+                             b->chain_size[list][i]);
+}
+
+void pvr_int_capture_finish(void) {
+    uint32 hdr[3];
+    file_t f;
+    int i, rv;
+
+    if(pvr_state.capture != 2)
+        return;
+
+    if(pvr_state.dma_mode) {
+        for(i = 0; i < PVR_OPB_COUNT; i++)
+            capture_dma_list(i);
+    }
+
+    f = fs_open(cap_fn, O_WRONLY | O_CREAT | O_TRUNC);
+
+    if(f < 0) {
+        dbglog(DBG_ERROR, "pvr_capture: can't open '%s'\n", cap_fn);
+    }
+    else {
+        hdr[0] = PVR_CAPTURE_MAGIC;
+        hdr[1] = PVR_CAPTURE_VERSION;
+        hdr[2] = cap_trunc;
+
+        rv = fs_write(f, hdr, sizeof(hdr)) != sizeof(hdr);
+        rv = rv || write_regs(f);
+        rv = rv || write_palette(f);
+        rv = rv || fs_write(f, cap_buf, cap_used) != (ssize_t)cap_used;
+
+        if(!rv && (cap_flags & PVR_CAPTURE_TEXTURES))
+            rv = write_vram(f);
+
+        rv = rv || write_chunk(f, PVR_CAPTURE_END, 0, NULL, 0, false);
+
+        if(rv)
+            dbglog(DBG_ERROR, "pvr_capture: error writing '%s'\n", cap_fn);
+        else if(cap_trunc)
+            dbglog(DBG_WARNING, "pvr_capture: frame didn't fit, '%s' is "
+                   "truncated\n", cap_fn);
+
+        fs_close(f);
+    }
+
+    free(cap_buf);
+    free(cap_fn);
+    cap_buf = NULL;
+    cap_fn = NULL;
+    pvr_state.capture = 0;
+}
@@ -0,0 +1,134 @@
+/* KallistiOS ##version##
+
+   pvr_cmdbuf.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_cmdbuf.h>
+#include <dc/sq.h>
+#include "pvr_internal.h"
+
+/*
+
+   Command buffers
+
+   Please see ../../include/dc/pvr/pvr_cmdbuf.h for more info on this API!
+
+   Filling a command buffer touches nothing but the command buffer, which is
+   what makes it safe from any thread. Only pvr_cmdbuf_begin() looks at the
+   global state, to find out which half of the DMA buffers is being built.
+   pvr_list_cmdbuf() records the command buffer in that half's chain for the
+   list, and dma_next_list() in pvr_irq.c sends the chain after the list's
+   own buffers.
+
+*/
+
+int pvr_cmdbuf_init(pvr_cmdbuf_t *cb, void *buffer, size_t len) {
+    if(((uintptr_t)buffer & 31) || (len & 63)) {
+        dbglog(DBG_ERROR, "pvr_cmdbuf_init: buffer must be 32-byte aligned "
+               "and a multiple of 64 bytes long\n");
+        return -1;
+    }
+
+    cb->size = len / 2;
+    cb->base[0] = (uint8_t *)buffer;
+    cb->base[1] = (uint8_t *)buffer + cb->size;
+    cb->cur = cb->base[0];
+    cb->ptr = 0;
+    cb->resv = 0;
+
+    return 0;
+}
+
+void pvr_cmdbuf_begin(pvr_cmdbuf_t *cb) {
+    cb->cur = cb->base[pvr_state.ram_target];
+    cb->ptr = 0;
+    cb->resv = 0;
+}
+
+void *pvr_cmdbuf_reserve(pvr_cmdbuf_t *cb, size_t size) {
+    /* Ensure data size is multiple of 32-bytes. */
+    assert(!(size & 31));
+
+    if(cb->ptr + size > cb->size) {
+        cb->resv = 0;
+        return NULL;
+    }
+
+    cb->resv = size;
+    return cb->cur + cb->ptr;
+}
+
+int pvr_cmdbuf_commit(pvr_cmdbuf_t *cb, size_t size) {
+    assert(!(size & 31));
+
+    if(size > cb->resv)
+        return -1;
+
+    cb->ptr += size;
+    cb->resv = 0;
+
+    return 0;
+}
+
+int pvr_cmdbuf_prim(pvr_cmdbuf_t *cb, const void *data, size_t size) {
+    void *dst;
+
+    /* Ensure at least 4-byte alignment. */
+    assert(!((uintptr_t)data & 0x3));
+
+    if(!(dst = pvr_cmdbuf_reserve(cb, size)))
+        return -1;
+
+    memcpy(dst, data, size);
+    return pvr_cmdbuf_commit(cb, size);
+}
+
+int pvr_list_cmdbuf(pvr_list_t list, const pvr_cmdbuf_t *cb) {
+    volatile pvr_dma_buffers_t * b;
+    int n;
+
+    assert(list < PVR_OPB_COUNT);
+
+    if(!cb->ptr)
+        return 0;
+
+    b = pvr_state.dma_buffers + pvr_state.ram_target;
+
+    if(pvr_state.dma_mode && b->base[list]) {
+        n = b->chain_count[list];
+
+        if(n >= PVR_CMDBUF_CHAIN_MAX) {
+            dbglog(DBG_WARNING, "pvr_list_cmdbuf: too many command buffers "
+                   "in list %u\n", (unsigned)list);
+            return -1;
+        }
+
+        b->chain_base[list][n] = cb->cur;
+        b->chain_size[list][n] = cb->ptr;
+        b->chain_count[list] = n + 1;
+
+        return 0;
+    }
+
+    /* No DMA vertex buffer, so it has to go in now, while the list is open. */
+    if(pvr_state.list_reg_open != (int)list) {
+        dbglog(DBG_WARNING, "pvr_list_cmdbuf: list %u is not open\n",
+               (unsigned)list);
+        return -1;
+    }
+
+    sq_fast_cpy(SQ_MASK_DEST(PVR_TA_INPUT), cb->cur, cb->ptr >> 5);
+
+    if(pvr_state.telemetry)
+        pvr_int_telemetry_count(list, cb->cur, cb->ptr);
+
+    if(pvr_state.capture)
+        pvr_int_capture_data(list, cb->cur, cb->ptr);
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+/* KallistiOS ##version##
+
+   pvr_fence.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <errno.h>
+#include <kos/dbglog.h>
+#include <kos/genwait.h>
+#include <arch/irq.h>
+#include <arch/timer.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_fence.h>
+#include "pvr_internal.h"
+
+/*
+
+   Frame fences
+
+   Please see ../../include/dc/pvr/pvr_fence.h for more info on this API!
+
+   Every scene gets the next sequence number when it's begun. The number
+   follows the scene through the pipeline: it's taken as the TA's frame when
+   the TA is first used for the scene, as the render's frame when the render
+   starts, and as the frame waiting for a flip when the render is done. Each
+   stage's fence is the last number to get through it, and since scenes go
+   through in order, every number before it has got through too.
+
+   A render to texture is never flipped to, so it's displayed once it's
+   rendered; unless a screen frame from before it is still waiting for its
+   flip, in which case it has to wait for that.
+
+*/
+
+/* Most frees that can be waiting. */
+#define FREE_MAX    256
+
+static struct {
+    pvr_ptr_t   chunk;
+    pvr_fence_t fence;
+} frees[FREE_MAX];
+
+static unsigned int free_head, free_count;
+
+/* Is a at or after b? Sequence numbers wrap, so compare the difference. */
+static inline bool seq_reached(uint32 a, uint32 b) {
+    return (int32)(a - b) >= 0;
+}
+
+pvr_fence_t pvr_scene_fence(void) {
+    return pvr_state.frame_seq;
+}
+
+bool pvr_fence_reached(pvr_fence_t fence, pvr_fence_stage_t stage) {
+    switch(stage) {
+        case PVR_FENCE_TA_DONE:
+            return seq_reached(pvr_state.fence_ta, fence);
+        case PVR_FENCE_RENDER_DONE:
+            return seq_reached(pvr_state.fence_rnd, fence);
+        default:
+            return seq_reached(pvr_state.fence_disp, fence);
+    }
+}
+
+int pvr_fence_wait(pvr_fence_t fence, pvr_fence_stage_t stage, int timeout) {
+    uint64 end = timer_ms_gettime64() + timeout;
+    int64 left = 0;
+
+    /* Nothing will ever happen to a scene that's still being built. */
+    if(!seq_reached(pvr_state.finish_seq, fence)) {
+        errno = EDEADLK;
+        return -1;
+    }
+
+    irq_disable_scoped();
+
+    while(!pvr_fence_reached(fence, stage)) {
+        if(timeout) {
+            left = end - timer_ms_gettime64();
+
+            if(left <= 0) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+
+        genwait_wait((void *)&pvr_state.fence_ta, "PVR fence", left, NULL);
+    }
+
+    return 0;
+}
+
+int pvr_fence_collect(void) {
+    int n = 0;
+
+    while(free_count && pvr_fence_reached(frees[free_head].fence,
+                                          PVR_FENCE_RENDER_DONE)) {
+        pvr_mem_free(frees[free_head].chunk);
+        free_head = (free_head + 1) % FREE_MAX;
+        free_count--;
+        n++;
+    }
+
+    return n;
+}
+
+void pvr_mem_free_after(pvr_ptr_t chunk, pvr_fence_t fence) {
+    unsigned int i;
+
+    if(pvr_fence_reached(fence, PVR_FENCE_RENDER_DONE)) {
+        pvr_mem_free(chunk);
+        return;
+    }
+
+    /* Out of room: wait for the oldest one to be done with. */
+    if(free_count == FREE_MAX) {
+        pvr_fence_wait(frees[free_head].fence, PVR_FENCE_RENDER_DONE, 0);
+
+        /* That only fails if every one is for the scene being built. */
+        if(!pvr_fence_collect()) {
+            dbglog(DBG_WARNING, "pvr_mem_free_after: too many frees "
+                   "waiting, leaking %p\n", chunk);
+            return;
+        }
+    }
+
+    i = (free_head + free_count++) % FREE_MAX;
+    frees[i].chunk = chunk;
+    frees[i].fence = fence;
+}
+
+int pvr_set_pipeline_depth(int depth) {
+    if(depth < 2 || depth > 3 || (depth == 3 && !pvr_state.dma_mode)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pvr_state.pipeline_depth = depth;
+
+    return 0;
+}
+
+int pvr_get_pipeline_depth(void) {
+    return pvr_state.pipeline_depth;
+}
+
+/* Called by pvr_mem_reset(): everything has been freed already. */
+void pvr_int_fence_reset(void) {
+    free_head = free_count = 0;
+}
+
+/* All of the lists of the TA's frame are in. */
+void pvr_int_fence_ta_done(void) {
+    pvr_state.fence_ta = pvr_state.ta_frame;
+    genwait_wake_all((void *)&pvr_state.fence_ta);
+}
+
+/* The render is done; called before render_completed is set for it. */
+void pvr_int_fence_render_done(void) {
+    pvr_state.fence_rnd = pvr_state.rnd_frame;
+
+    if(!pvr_state.was_to_texture)
+        pvr_state.flip_frame = pvr_state.rnd_frame;
+    else if(pvr_state.render_completed)
+        pvr_state.txr_frame = pvr_state.rnd_frame;
+    else
+        pvr_state.fence_disp = pvr_state.rnd_frame;
+
+    genwait_wake_all((void *)&pvr_state.fence_ta);
+}
+
+/* The view has been flipped to the last frame rendered. */
+void pvr_int_fence_flip(void) {
+    pvr_state.fence_disp = pvr_state.flip_frame;
+
+    if(seq_reached(pvr_state.txr_frame, pvr_state.flip_frame))
+        pvr_state.fence_disp = pvr_state.txr_frame;
+
+    genwait_wake_all((void *)&pvr_state.fence_ta);
+}
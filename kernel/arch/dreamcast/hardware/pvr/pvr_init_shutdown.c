@@ -94,6 +94,9 @@ int pvr_init(const pvr_init_params_t *params) {
 
     pvr_state.vbuf_doublebuf = !params->vbuf_doublebuf_disabled;
 
+    // Two frames in flight until told otherwise.
+    pvr_state.pipeline_depth = 2;
+
     /* Everything's clear, do the initial buffer pointer setup */
     pvr_allocate_buffers(params);
 
@@ -124,6 +127,9 @@ int pvr_init(const pvr_init_params_t *params) {
     pvr_state.rnd_last_len = -1;
     pvr_state.vtx_buf_used = 0;
     pvr_state.vtx_buf_used_max = 0;
+    pvr_reset_opb_stats();
+    pvr_int_tnl_reset();
+    pvr_int_rtt_reset();
     pvr_state.dr_used = 0;
 
     /* If we're on a VGA box, disable vertical smoothing */
@@ -160,14 +166,16 @@ int pvr_init(const pvr_init_params_t *params) {
     asic_evt_set_handler(ASIC_EVT_PVR_RENDERDONE_TSP, pvr_int_handler, NULL);
     asic_evt_enable(ASIC_EVT_PVR_RENDERDONE_TSP, ASIC_IRQ_DEFAULT);
 
+    /* Counted for the OPB statistics */
+    asic_evt_set_handler(ASIC_EVT_PVR_OPB_OUTOFMEM, pvr_int_handler, NULL);
+    asic_evt_enable(ASIC_EVT_PVR_OPB_OUTOFMEM, ASIC_IRQ_DEFAULT);
+
 #ifdef PVR_RENDER_DBG
     /* Hook up interrupt handlers for error events */
     asic_evt_set_handler(ASIC_EVT_PVR_ISP_OUTOFMEM, pvr_int_handler, NULL);
     asic_evt_enable(ASIC_EVT_PVR_ISP_OUTOFMEM, ASIC_IRQ_DEFAULT);
     asic_evt_set_handler(ASIC_EVT_PVR_STRIP_HALT, pvr_int_handler, NULL);
     asic_evt_enable(ASIC_EVT_PVR_STRIP_HALT, ASIC_IRQ_DEFAULT);
-    asic_evt_set_handler(ASIC_EVT_PVR_OPB_OUTOFMEM, pvr_int_handler, NULL);
-    asic_evt_enable(ASIC_EVT_PVR_OPB_OUTOFMEM, ASIC_IRQ_DEFAULT);
     asic_evt_set_handler(ASIC_EVT_PVR_TA_INPUT_ERR, pvr_int_handler, NULL);
     asic_evt_enable(ASIC_EVT_PVR_TA_INPUT_ERR, ASIC_IRQ_DEFAULT);
     asic_evt_set_handler(ASIC_EVT_PVR_TA_INPUT_OVERFLOW, pvr_int_handler, NULL);
@@ -240,6 +248,8 @@ int pvr_shutdown(void) {
     asic_evt_disable(ASIC_EVT_PVR_PTDONE, ASIC_IRQ_DEFAULT);
     asic_evt_remove_handler(ASIC_EVT_PVR_RENDERDONE_TSP);
     asic_evt_disable(ASIC_EVT_PVR_RENDERDONE_TSP, ASIC_IRQ_DEFAULT);
+    asic_evt_remove_handler(ASIC_EVT_PVR_OPB_OUTOFMEM);
+    asic_evt_disable(ASIC_EVT_PVR_OPB_OUTOFMEM, ASIC_IRQ_DEFAULT);
 
     /* Shut down PVR DMA */
     pvr_dma_shutdown();
@@ -18,6 +18,7 @@
 
 #include <stdbool.h>
 #include <kos/mutex.h>
+#include <dc/pvr/pvr_cmdbuf.h>
 
 /**** State stuff ***************************************************/
 
@@ -134,6 +135,12 @@ typedef struct {
     uint8   * base[PVR_OPB_COUNT];  // DMA buffers, if assigned
     uint32  ptr[PVR_OPB_COUNT];     // DMA buffer write pointer, if used
     uint32  size[PVR_OPB_COUNT];    // DMA buffer sizes, or zero if none
+    uint8   * ext_base[PVR_OPB_COUNT];  // Extension buffers, if assigned
+    uint32  ext_ptr[PVR_OPB_COUNT];     // Extension buffer write pointer
+    uint32  ext_size[PVR_OPB_COUNT];    // Extension buffer sizes, or zero if none
+    const uint8 * chain_base[PVR_OPB_COUNT][PVR_CMDBUF_CHAIN_MAX + 1];  // Command buffers to send after the list
+    uint32  chain_size[PVR_OPB_COUNT][PVR_CMDBUF_CHAIN_MAX + 1];        // (plus room for the end of list marker)
+    int     chain_count[PVR_OPB_COUNT];
     int ready;                      // >0 if these buffers are ready to be DMAed
 } pvr_dma_buffers_t;
 
@@ -167,6 +174,7 @@ typedef struct {
     uint32  lists_closed;               // (1 << idx) for each list which the SH4 has lost interest in
     uint32  lists_transferred;          // (1 << idx) for each list which has completely transferred to the TA
     uint32  lists_dmaed;                // (1 << idx) for each list which has been DMA'd (DMA mode only)
+    int     dma_piece;                  // Piece of the current list being DMA'd (see pvr_irq.c)
 
     mutex_t dma_lock;                   // Locked if a DMA is in progress (vertex or texture)
     int     ta_checked_ready;           // >0 if the TA has been checked to be ready for the new scene
@@ -184,6 +192,7 @@ typedef struct {
     int     w, h;                       // Screen width, height
     int     tw, th;                     // Screen tile width, height
     uint32  tsize_const;                // Screen tile size constant
+    uint32  ta_tsize;                   // Tile size constant the TA is set up with
     float   zclip;                      // Z clip plane
     uint32  pclip_left, pclip_right;    // X pixel clip constants
     uint32  pclip_top, pclip_bottom;    // Y pixel clip constants
@@ -205,6 +214,39 @@ typedef struct {
     size_t   vtx_buf_used;               // Vertex buffer used size for the last frame
     size_t   vtx_buf_used_max;           // Maximum used vertex buffer size
 
+    /* OPB usage. Bytes are of the overflow space after the initial bins;
+       each list is charged for what the TA took while it was being sent. */
+    uint32  opb_pos;                            // TA_NEXT_OPB at the last list completion
+    uint32  opb_used[PVR_OPB_COUNT];            // Overflow bytes used by each list in the last frame
+    uint32  opb_used_max[PVR_OPB_COUNT];        // Most used by each list in one frame
+    uint32  opb_used_total;                     // Overflow bytes used in the last frame
+    uint32  opb_used_total_max;                 // Most used in one frame
+    uint32  opb_outofmem;                       // Times the TA ran out of OPB space
+    uint32  opb_frames;                         // Frames measured
+
+    // Non-zero if frame records are being kept (see pvr_telemetry.c)
+    int     telemetry;
+
+    // 1 if a frame capture is armed, 2 while one is recording (see pvr_capture.c)
+    int     capture;
+
+    // Frame sequence numbers, for fences (see pvr_fence.c)
+    uint32  frame_seq;                  // Last scene begun
+    uint32  finish_seq;                 // Last scene finished
+    uint32  ta_frame;                   // Scene being sent to the TA
+    uint32  rnd_frame;                  // Scene being rendered
+    uint32  flip_frame;                 // Rendered scene waiting for a flip
+    uint32  txr_frame;                  // Texture render done before that flip
+    uint32  fence_ta;                   // Last scene taken by the TA
+    uint32  fence_rnd;                  // Last scene rendered
+    uint32  fence_disp;                 // Last scene displayed
+    int     pipeline_depth;             // Frames in flight (2 or 3)
+
+    // Render target of each scene, plus one, or 0 for none (see pvr_rtt.c)
+    int     next_rtt;                   // Scene being built
+    int     ta_rtt;                     // Scene being sent to the TA
+    int     rnd_rtt;                    // Scene being rendered
+
     // Handle for the vblank interrupt
     int     vbl_handle;
 
@@ -269,6 +311,107 @@ void pvr_allocate_buffers(const pvr_init_params_t *params);
 /* Fill the tile matrices (after it's initialized) */
 void pvr_init_tile_matrices(bool presort);
 
+/* Lay out a tile matrix for a render of tw by th tiles, if it isn't already */
+void pvr_layout_tile_matrix(int which, int tw, int th);
+
+
+/**** pvr_batch.c *****************************************************/
+
+/* Forget the state of all lists at the start of a scene */
+void pvr_int_batch_reset(void);
+
+/* Send held back draws for a list that's about to be finished */
+void pvr_int_batch_finish(pvr_list_t list);
+
+
+/**** pvr_sprite_batch.c **********************************************/
+
+/* Throw away sprites left over from the last scene */
+void pvr_int_sprite_batch_reset(void);
+
+/* Send the sprites for a list that's about to be finished */
+void pvr_int_sprite_batch_finish(pvr_list_t list);
+
+
+/**** pvr_telemetry.c *************************************************/
+
+/* Start and finish the record of the frame being built */
+void pvr_int_telemetry_begin(void);
+void pvr_int_telemetry_finish(void);
+
+/* Count data sent straight to the TA for a list */
+void pvr_int_telemetry_count(int list, const void *data, size_t size);
+
+/* Add time spent waiting for the DMA channel to the frame being built */
+void pvr_int_telemetry_stall(uint64 ns);
+
+/* Note a pvr_sync_stats() event */
+void pvr_int_telemetry_sync(int event, uint64 t);
+
+
+/**** pvr_capture.c ***************************************************/
+
+/* Start and finish recording the frame being built, if a capture is armed */
+void pvr_int_capture_begin(void);
+void pvr_int_capture_finish(void);
+
+/* Record data sent straight to the TA for a list */
+void pvr_int_capture_data(int list, const void *data, size_t size);
+
+
+/**** pvr_tnl.c *******************************************************/
+
+/* Reset the statistics and viewport for a new screen */
+void pvr_int_tnl_reset(void);
+
+
+/**** pvr_fence.c ****************************************************/
+
+/* Forget memory waiting to be freed (its VRAM has already been reset) */
+void pvr_int_fence_reset(void);
+
+/* Note fence progress from the interrupt handlers */
+void pvr_int_fence_ta_done(void);
+void pvr_int_fence_render_done(void);
+void pvr_int_fence_flip(void);
+
+
+/**** pvr_rtt.c ******************************************************/
+
+/* Forget all render targets and jobs */
+void pvr_int_rtt_reset(void);
+
+/* Set up the tile matrix and TA for the scene the TA is being taken for */
+void pvr_int_rtt_setup(void);
+
+/* Note target timings from the interrupt handlers */
+void pvr_int_rtt_reg_done(void);
+void pvr_int_rtt_render_done(void);
+
+
+/**** pvr_palette.c **************************************************/
+
+/* Write committed palette changes out to the table, while not rendering */
+void pvr_int_pal_apply(void);
+
+
+/**** pvr_pace.c *****************************************************/
+
+/* Note a vertical blank, after any flip */
+void pvr_int_pace_vblank(void);
+
+/* Note a finished render, returning true if it should be flipped to now */
+bool pvr_int_pace_render_done(void);
+
+
+/**** pvr_mem_pool.c **************************************************/
+
+/* Drop the relocatable pool (its VRAM has already been reset) */
+void pvr_int_mem_pool_reset(void);
+
+/* Print the relocatable pool's statistics, if there is one */
+void pvr_int_mem_pool_print(void);
+
 
 /**** pvr_misc.c ******************************************************/
 
@@ -285,6 +428,9 @@ void pvr_init_tile_matrices(bool presort);
 /* Update statistical counters */
 void pvr_sync_stats(int event);
 
+/* Update OPB usage counters, when the given list has been transferred */
+void pvr_sync_opb_stats(int list);
+
 /* Synchronize the viewed page with what's in pvr_state */
 void pvr_sync_view(void);
 
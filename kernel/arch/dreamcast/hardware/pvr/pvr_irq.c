@@ -9,6 +9,7 @@
 #include <dc/pvr.h>
 #include <dc/asic.h>
 #include <arch/cache.h>
+#include <arch/timer.h>
 #include "pvr_internal.h"
 
 #include <kos/genwait.h>
@@ -31,7 +32,10 @@
 // nothing. Otherwise, start the DMA and chain back to us upon completion.
 static void dma_next_list(void *thread) {
     volatile pvr_dma_buffers_t * b;
+    const uint8 *src;
+    uint32 count;
     unsigned int i;
+    int piece;
 
     // Get the buffers for this frame.
     b = pvr_state.dma_buffers + (pvr_state.ram_target ^ 1);
@@ -49,12 +53,35 @@ static void dma_next_list(void *thread) {
                 continue;
             }
 
+            // Each list goes out in pieces: its main buffer, then its
+            // extension buffer, then any command buffers chained to it, in
+            // that order. Empty pieces are skipped.
+            while(pvr_state.dma_piece < b->chain_count[i] + 2) {
+                piece = pvr_state.dma_piece++;
+
+                if(piece == 0) {
+                    src = b->base[i];
+                    count = b->ptr[i];
+                }
+                else if(piece == 1) {
+                    src = b->ext_base[i];
+                    count = b->ext_ptr[i];
+                }
+                else {
+                    src = b->chain_base[i][piece - 2];
+                    count = b->chain_size[i][piece - 2];
+                }
+
+                if(count) {
+                    // Start the DMA transfer, chaining to ourselves.
+                    pvr_dma_load_ta(src, count, 0, dma_next_list, thread);
+                    return;
+                }
+            }
+
             // Mark this list as processed.
             pvr_state.lists_dmaed |= BIT(i);
-
-            // Start the DMA transfer, chaining to ourselves.
-            pvr_dma_load_ta(b->base[i], b->ptr[i], 0, dma_next_list, thread);
-            return;
+            pvr_state.dma_piece = 0;
         }
     }
 
@@ -72,10 +99,18 @@ static void dma_next_list(void *thread) {
 }
 
 void pvr_start_dma(void) {
+    uint64 t = 0;
+
     pvr_sync_stats(PVR_SYNC_REGSTART);
 
+    if(pvr_state.telemetry)
+        t = timer_ns_gettime64();
+
     mutex_lock((mutex_t *)&pvr_state.dma_lock);
 
+    if(pvr_state.telemetry)
+        pvr_int_telemetry_stall(timer_ns_gettime64() - t);
+
     // Begin DMAing the first list.
     dma_next_list(thd_get_current());
 }
@@ -96,6 +131,7 @@ static void pvr_render_lists(void) {
         // frame buffer.
         //DBG(("start_render(%d -> %d)\n", pvr_state.ta_target, pvr_state.view_target ^ 1));
         pvr_state.ta_target ^= pvr_state.vbuf_doublebuf;
+        pvr_int_pal_apply();
         pvr_begin_queued_render();
         pvr_state.render_busy = 1;
         pvr_sync_stats(PVR_SYNC_RNDSTART);
@@ -108,6 +144,8 @@ static void pvr_render_lists(void) {
         pvr_state.ta_busy = 0;
 
         pvr_state.was_to_texture = pvr_state.curr_to_texture;
+        pvr_state.rnd_frame = pvr_state.ta_frame;
+        pvr_state.rnd_rtt = pvr_state.ta_rtt;
 
         // Signal the client code to continue onwards.
         genwait_wake_all((void *)&pvr_state.ta_busy);
@@ -115,6 +153,24 @@ static void pvr_render_lists(void) {
     }
 }
 
+// Flip to the frame that has just been rendered.
+static void pvr_flip(void) {
+    //DBG(("view(%d)\n", pvr_state.view_target ^ 1));
+
+    // Handle PVR stats
+    pvr_sync_stats(PVR_SYNC_PAGEFLIP);
+
+    // Switch view address to the "good" buffer
+    pvr_state.view_target ^= 1;
+
+    pvr_sync_view();
+
+    // Clear the render completed flag.
+    pvr_state.render_completed = 0;
+
+    pvr_int_fence_flip();
+}
+
 void pvr_vblank_handler(uint32 code, void *data) {
     (void)code;
     (void)data;
@@ -123,20 +179,15 @@ void pvr_vblank_handler(uint32 code, void *data) {
 
     // If the render-done interrupt has fired then we are ready to flip to the
     // new frame buffer.
-    if(pvr_state.render_completed) {
-        //DBG(("view(%d)\n", pvr_state.view_target ^ 1));
+    if(pvr_state.render_completed)
+        pvr_flip();
 
-        // Handle PVR stats
-        pvr_sync_stats(PVR_SYNC_PAGEFLIP);
+    pvr_int_pace_vblank();
 
-        // Switch view address to the "good" buffer
-        pvr_state.view_target ^= 1;
-
-        pvr_sync_view();
-
-        // Clear the render completed flag.
-        pvr_state.render_completed = 0;
-    }
+    // Palette changes can go out now if nothing is being rendered; otherwise
+    // they wait for the next render to start.
+    if(!pvr_state.render_busy)
+        pvr_int_pal_apply();
 
     // We may have a pending render, that couldn't be done as the previous
     // render wasn't flipped yet; do it now.
@@ -151,26 +202,41 @@ void pvr_int_handler(uint32 code, void *data) {
         case ASIC_EVT_PVR_OPAQUEDONE:
             //DBG(("irq_opaquedone\n"));
             pvr_state.lists_transferred |= BIT(PVR_OPB_OP);
+            pvr_sync_opb_stats(PVR_OPB_OP);
             break;
         case ASIC_EVT_PVR_TRANSDONE:
             //DBG(("irq_transdone\n"));
             pvr_state.lists_transferred |= BIT(PVR_OPB_TP);
+            pvr_sync_opb_stats(PVR_OPB_TP);
             break;
         case ASIC_EVT_PVR_OPAQUEMODDONE:
             pvr_state.lists_transferred |= BIT(PVR_OPB_OM);
+            pvr_sync_opb_stats(PVR_OPB_OM);
             break;
         case ASIC_EVT_PVR_TRANSMODDONE:
             pvr_state.lists_transferred |= BIT(PVR_OPB_TM);
+            pvr_sync_opb_stats(PVR_OPB_TM);
             break;
         case ASIC_EVT_PVR_PTDONE:
             pvr_state.lists_transferred |= BIT(PVR_OPB_PT);
+            pvr_sync_opb_stats(PVR_OPB_PT);
+            break;
+        case ASIC_EVT_PVR_OPB_OUTOFMEM:
+            pvr_state.opb_outofmem++;
             break;
         case ASIC_EVT_PVR_RENDERDONE_TSP:
             //DBG(("irq_renderdone\n"));
             pvr_state.render_busy = 0;
+            pvr_int_fence_render_done();
             if (!pvr_state.was_to_texture)
                 pvr_state.render_completed = 1;
             pvr_sync_stats(PVR_SYNC_RNDDONE);
+            pvr_int_rtt_render_done();
+
+            // A frame that just missed its vertical blank can be flipped to
+            // now, rather than at the next one.
+            if(pvr_int_pace_render_done() && pvr_state.render_completed)
+                pvr_flip();
 
             genwait_wake_all((void *)&pvr_state.render_busy);
             break;
@@ -217,6 +283,8 @@ void pvr_int_handler(uint32 code, void *data) {
                 return;
 
             pvr_sync_stats(PVR_SYNC_REGDONE);
+            pvr_int_fence_ta_done();
+            pvr_int_rtt_reg_done();
             break;
     }
 
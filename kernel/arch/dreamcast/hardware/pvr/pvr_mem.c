@@ -196,6 +196,9 @@ void pvr_mem_reset(void) {
         pvr_mem_base = (pvr_ptr_t)(PVR_RAM_INT_BASE + pvr_state.texture_base);
         pvr_int_mem_reset();
     }
+
+    pvr_int_mem_pool_reset();
+    pvr_int_fence_reset();
 }
 
 /* Print some statistics (like mallocstats) */
@@ -203,6 +206,24 @@ void pvr_mem_stats(void) {
     printf("pvr_mem_stats():\n");
     pvr_int_malloc_stats();
     printf("max sbrk base: %08lx\n", (uint32)pvr_mem_base);
+
+    if(pvr_mem_base) {
+        struct mallinfo mi = pvr_int_mallinfo();
+        size_t top = PVR_RAM_INT_TOP - (size_t)pvr_mem_base;
+
+        /* The top chunk and whatever hasn't been sbrk'd yet are one block of
+           free space; everything else free is stuck between allocations. */
+        printf("free chunks: %d, %lu bytes (%lu unsplit at the top)\n",
+               mi.ordblks + mi.smblks, (unsigned long)(mi.fordblks + top),
+               (unsigned long)(mi.keepcost + top));
+
+        if(mi.fordblks + top)
+            printf("fragmentation: %lu%%\n",
+                   (unsigned long)(100 - (uint64)(mi.keepcost + top) * 100 /
+                                   (mi.fordblks + top)));
+    }
+
+    pvr_int_mem_pool_print();
 #ifdef PVR_KM_DBG
     pvr_mem_print_list();
 #endif
@@ -0,0 +1,642 @@
+/* KallistiOS ##version##
+
+   pvr_mem_pool.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dc/pvr.h>
+#include <kos/mutex.h>
+#include "pvr_internal.h"
+
+/*
+
+   Relocatable VRAM pool
+
+   pvr_mem_malloc() is a general purpose allocator, and after a long time of
+   loading and freeing textures of all sorts of sizes, it tends to end up with
+   lots of free memory that's split into pieces too small to hold anything. This
+   module is an alternative for programs that stream textures: a pool carved
+   out of VRAM once, handed out with a buddy allocator in power-of-two blocks
+   (which is what most textures are anyway), to users who refer to their blocks
+   by handle rather than by address. Since nobody holds on to the address of an
+   unlocked block, pvr_mem_compact() is free to move it.
+
+   All of the bookkeeping is kept in main RAM, as reading VRAM is slow. Free
+   blocks of each order are tracked with a bitmap with one bit for each
+   possible block of that order, plus a summary bitmap with one bit for each
+   non-zero word of that, so finding the lowest or highest free block of an
+   order only takes a couple of lookups. Allocated blocks are described by
+   their handle entry, and are found by walking the handle table (which only
+   the compaction pass needs to do).
+
+   Compaction works one order at a time, from the smallest up. For as long as
+   there are at least two free blocks of an order, the contents of the buddy
+   of the highest one is moved into the lowest one: allocated blocks are
+   copied across, free blocks within it are moved in the bitmaps, and the
+   buddy is then free and merges with the highest free block into a block of
+   the next order. So each move packs the pool towards its start and leaves a
+   bigger free block at its end. A buddy holding a locked block is skipped.
+
+*/
+
+#define POOL_MIN_ORDER  PVR_MEM_POOL_MIN_ORDER
+#define POOL_MAX_ORDER  (PVR_MEM_POOL_MIN_ORDER + PVR_MEM_POOL_ORDERS - 1)
+#define POOL_ORDERS     PVR_MEM_POOL_ORDERS
+#define POOL_BOUNCE     4096    /* Bounce buffer for moving blocks */
+#define POOL_NONE       0xffffffffUL    /* No block or entry */
+
+typedef struct pool_ent {
+    uint32_t    offset;         /* From the pool base (next free entry if unused) */
+    uint32_t    size;           /* Size asked for, 0 if unused */
+    uint16_t    locks;          /* Lock count; locked blocks can't be moved */
+    uint8_t     order;          /* log2 of the block size */
+    uint8_t     gen;            /* Bumped on each free, to catch stale handles */
+} pool_ent_t;
+
+typedef struct pool_order {
+    uint32_t    *bits;          /* One bit for each block of this order */
+    uint32_t    *summary;       /* One bit for each non-zero word of bits */
+    uint32_t    words;          /* Number of words in bits */
+    uint32_t    count;          /* Number of free blocks of this order */
+} pool_order_t;
+
+static struct {
+    uint8_t     *base;          /* NULL if the pool isn't set up */
+    uint32_t    size;
+    pool_order_t orders[POOL_ORDERS];
+
+    pool_ent_t  *ents;
+    uint32_t    nents;
+    uint32_t    free_ent;       /* Head of the unused entry list, or POOL_NONE */
+    uint32_t    handles;
+    uint32_t    used;           /* Bytes in allocated blocks */
+    uint32_t    requested;      /* Bytes actually asked for */
+
+    uint64_t    moved;          /* Bytes moved by compaction */
+    uint32_t    moves;          /* Blocks moved by compaction */
+} pool;
+
+static mutex_t pool_mutex = MUTEX_INITIALIZER;
+
+static uint8_t bounce[POOL_BOUNCE] __attribute__((aligned(32)));
+
+#define ORD(k)  (&pool.orders[(k) - POOL_MIN_ORDER])
+
+/* Handles are the entry index plus one in the low 24 bits (so zero is never a
+   valid handle) and the entry's generation in the top 8. */
+#define HANDLE(i)       (((uint32_t)pool.ents[i].gen << 24) | ((i) + 1))
+#define HANDLE_IDX(h)   (((h) & 0xffffff) - 1)
+
+/* Free block bitmaps */
+static void bit_set(int k, uint32_t off) {
+    pool_order_t *o = ORD(k);
+    uint32_t i = off >> k;
+
+    o->bits[i >> 5] |= 1UL << (i & 31);
+    o->summary[i >> 10] |= 1UL << ((i >> 5) & 31);
+    ++o->count;
+}
+
+static void bit_clear(int k, uint32_t off) {
+    pool_order_t *o = ORD(k);
+    uint32_t i = off >> k;
+
+    o->bits[i >> 5] &= ~(1UL << (i & 31));
+
+    if(!o->bits[i >> 5])
+        o->summary[i >> 10] &= ~(1UL << ((i >> 5) & 31));
+
+    --o->count;
+}
+
+static int bit_test(int k, uint32_t off) {
+    pool_order_t *o = ORD(k);
+    uint32_t i = off >> k;
+
+    if((i >> 5) >= o->words)
+        return 0;
+
+    return (o->bits[i >> 5] >> (i & 31)) & 1;
+}
+
+/* Find the lowest free block of order k. The order must have one. */
+static uint32_t find_low(int k) {
+    pool_order_t *o = ORD(k);
+    uint32_t s, w;
+
+    for(s = 0; !o->summary[s]; ++s)
+        ;
+
+    w = (s << 5) + __builtin_ctz(o->summary[s]);
+    return ((w << 5) + __builtin_ctz(o->bits[w])) << k;
+}
+
+/* Find the highest free block of order k below the block at offset end, or
+   return POOL_NONE if there isn't one. */
+static uint32_t find_below(int k, uint32_t end) {
+    pool_order_t *o = ORD(k);
+    uint32_t i = end >> k, w, bits, s, sbits;
+
+    if(!i)
+        return POOL_NONE;
+
+    /* Start with what's left of the word the end is in... */
+    --i;
+    w = i >> 5;
+    bits = o->bits[w] & (0xffffffffUL >> (31 - (i & 31)));
+
+    if(bits)
+        return ((w << 5) + 31 - __builtin_clz(bits)) << k;
+
+    /* ... then what's left of its summary word... */
+    s = w >> 5;
+    sbits = (w & 31) ? o->summary[s] & (0xffffffffUL >> (32 - (w & 31))) : 0;
+
+    /* ... and then the whole summary words before that. */
+    while(!sbits) {
+        if(!s)
+            return POOL_NONE;
+
+        sbits = o->summary[--s];
+    }
+
+    w = (s << 5) + 31 - __builtin_clz(sbits);
+    return ((w << 5) + 31 - __builtin_clz(o->bits[w])) << k;
+}
+
+/* Buddy allocation */
+static int size_order(size_t size) {
+    int k = POOL_MIN_ORDER;
+
+    while(k <= POOL_MAX_ORDER && (1UL << k) < size)
+        ++k;
+
+    return k;
+}
+
+static uint32_t block_alloc(int k) {
+    uint32_t off;
+    int j;
+
+    for(j = k; j <= POOL_MAX_ORDER && !ORD(j)->count; ++j)
+        ;
+
+    if(j > POOL_MAX_ORDER)
+        return POOL_NONE;
+
+    /* Take the lowest block, to keep things packed towards the start, and
+       split it down to the size we want. */
+    off = find_low(j);
+    bit_clear(j, off);
+
+    while(j > k) {
+        --j;
+        bit_set(j, off + (1UL << j));
+    }
+
+    return off;
+}
+
+static void block_free(uint32_t off, int k) {
+    uint32_t buddy;
+
+    /* A buddy that would be past the end of the pool is never free, so this
+       doesn't need to worry about merging with something that isn't there. */
+    while(k < POOL_MAX_ORDER) {
+        buddy = off ^ (1UL << k);
+
+        if(!bit_test(k, buddy))
+            break;
+
+        bit_clear(k, buddy);
+        off &= ~(1UL << k);
+        ++k;
+    }
+
+    bit_set(k, off);
+}
+
+/* Handle table */
+static pool_ent_t *ent_get(pvr_mem_handle_t h) {
+    uint32_t i = HANDLE_IDX(h);
+
+    if(!pool.base || !h || i >= pool.nents || !pool.ents[i].size ||
+       HANDLE(i) != h)
+        return NULL;
+
+    return pool.ents + i;
+}
+
+static int ent_alloc(void) {
+    pool_ent_t *n;
+    uint32_t i, cnt;
+
+    if(pool.free_ent == POOL_NONE) {
+        cnt = pool.nents ? pool.nents * 2 : 64;
+
+        if(cnt > 0xffffff)
+            return -1;
+
+        if(!(n = realloc(pool.ents, cnt * sizeof(pool_ent_t))))
+            return -1;
+
+        /* Chain all of the new entries onto the free list. */
+        for(i = pool.nents; i < cnt; ++i) {
+            n[i].offset = i + 1 < cnt ? i + 1 : POOL_NONE;
+            n[i].size = 0;
+            n[i].gen = 0;
+        }
+
+        pool.ents = n;
+        pool.free_ent = pool.nents;
+        pool.nents = cnt;
+    }
+
+    i = pool.free_ent;
+    pool.free_ent = pool.ents[i].offset;
+    return (int)i;
+}
+
+static void ent_free(uint32_t i) {
+    pool.ents[i].size = 0;
+    ++pool.ents[i].gen;
+    pool.ents[i].offset = pool.free_ent;
+    pool.free_ent = i;
+}
+
+static void pool_release(void) {
+    int k;
+
+    for(k = POOL_MIN_ORDER; k <= POOL_MAX_ORDER; ++k) {
+        free(ORD(k)->bits);
+        free(ORD(k)->summary);
+    }
+
+    free(pool.ents);
+    memset(&pool, 0, sizeof(pool));
+}
+
+int pvr_mem_pool_init(size_t size) {
+    uint32_t off, span, left;
+    int k;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if(pool.base) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    size &= ~((1UL << POOL_MIN_ORDER) - 1);
+
+    if(!size || size > (1UL << POOL_MAX_ORDER)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* The bitmaps cover the pool rounded up to a power of two. */
+    for(span = 1UL << POOL_MIN_ORDER; span < size; span <<= 1)
+        ;
+
+    for(k = POOL_MIN_ORDER; k <= POOL_MAX_ORDER; ++k) {
+        pool_order_t *o = ORD(k);
+
+        o->words = ((span >> k) + 31) >> 5;
+        o->bits = calloc(o->words, sizeof(uint32_t));
+        o->summary = calloc((o->words + 31) >> 5, sizeof(uint32_t));
+
+        if(!o->bits || !o->summary) {
+            pool_release();
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    if(!(pool.base = pvr_mem_malloc(size))) {
+        pool_release();
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pool.size = size;
+    pool.free_ent = POOL_NONE;
+
+    /* Start out with the biggest blocks that fit, largest first, so that each
+       one is aligned to its own size. */
+    for(off = 0, left = size; left; off += 1UL << k, left -= 1UL << k) {
+        for(k = POOL_MAX_ORDER; (1UL << k) > left; --k)
+            ;
+
+        bit_set(k, off);
+    }
+
+    return 0;
+}
+
+void pvr_mem_pool_shutdown(void) {
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!pool.base)
+        return;
+
+    pvr_mem_free(pool.base);
+    pool_release();
+}
+
+/* Called by pvr_mem_reset(), which has already thrown away the VRAM the pool
+   lived in. */
+void pvr_int_mem_pool_reset(void) {
+    mutex_lock_scoped(&pool_mutex);
+
+    if(pool.base)
+        pool_release();
+}
+
+pvr_mem_handle_t pvr_mem_halloc(size_t size) {
+    uint32_t off;
+    int i, k;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!pool.base || !size || (k = size_order(size)) > POOL_MAX_ORDER) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    if((i = ent_alloc()) < 0) {
+        errno = ENOMEM;
+        return 0;
+    }
+
+    if((off = block_alloc(k)) == POOL_NONE) {
+        ent_free(i);
+        errno = ENOMEM;
+        return 0;
+    }
+
+    pool.ents[i].offset = off;
+    pool.ents[i].size = size;
+    pool.ents[i].order = k;
+    pool.ents[i].locks = 0;
+
+    ++pool.handles;
+    pool.used += 1UL << k;
+    pool.requested += size;
+
+    return HANDLE(i);
+}
+
+void pvr_mem_hfree(pvr_mem_handle_t h) {
+    pool_ent_t *e;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!(e = ent_get(h))) {
+        dbglog(DBG_ERROR, "pvr_mem_hfree: invalid handle %08lx\n",
+               (unsigned long)h);
+        return;
+    }
+
+    block_free(e->offset, e->order);
+
+    --pool.handles;
+    pool.used -= 1UL << e->order;
+    pool.requested -= e->size;
+
+    ent_free(e - pool.ents);
+}
+
+pvr_ptr_t pvr_mem_hptr(pvr_mem_handle_t h) {
+    pool_ent_t *e;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!(e = ent_get(h)))
+        return NULL;
+
+    return (pvr_ptr_t)(pool.base + e->offset);
+}
+
+pvr_ptr_t pvr_mem_hlock(pvr_mem_handle_t h) {
+    pool_ent_t *e;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!(e = ent_get(h)) || e->locks == 0xffff)
+        return NULL;
+
+    ++e->locks;
+    return (pvr_ptr_t)(pool.base + e->offset);
+}
+
+void pvr_mem_hunlock(pvr_mem_handle_t h) {
+    pool_ent_t *e;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if((e = ent_get(h)) && e->locks)
+        --e->locks;
+}
+
+/* Copy a block from one place in VRAM to another. The PVR can't do that by
+   itself, so this reads it back through a buffer in main RAM, then DMAs it
+   back out to its new home. The DMA channel may be busy with somebody else's
+   transfer, in which case the store queues do it instead: the caller goes on
+   to point the handle at the new copy, so it can't be left undone. */
+static void pool_copy(uint32_t dst, uint32_t src, uint32_t size) {
+    const uint32_t *s = (const uint32_t *)(pool.base + src);
+    uint32_t *b;
+    uint32_t n, i;
+    int rv;
+
+    while(size) {
+        n = size < POOL_BOUNCE ? size : POOL_BOUNCE;
+        b = (uint32_t *)bounce;
+
+        for(i = 0; i < n; i += 4)
+            *b++ = *s++;
+
+        mutex_lock((mutex_t *)&pvr_state.dma_lock);
+        rv = pvr_txr_load_dma(bounce, (pvr_ptr_t)(pool.base + dst), n, true,
+                              NULL, 0);
+        mutex_unlock((mutex_t *)&pvr_state.dma_lock);
+
+        if(rv)
+            pvr_txr_load(bounce, (pvr_ptr_t)(pool.base + dst), n);
+
+        dst += n;
+        size -= n;
+    }
+}
+
+/* Can everything allocated within the block of order k at off be moved? */
+static int pool_movable(uint32_t off, int k) {
+    uint32_t i;
+
+    if(off + (1UL << k) > pool.size)
+        return 0;
+
+    for(i = 0; i < pool.nents; ++i) {
+        pool_ent_t *e = pool.ents + i;
+
+        if(e->size && e->locks && (e->offset >> k) == (off >> k))
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Move everything within the block of order k at src to the free block of
+   the same order at dst, returning the number of bytes copied. */
+static uint32_t pool_move(uint32_t dst, uint32_t src, int k) {
+    uint32_t i, j, off, end = src + (1UL << k), moved = 0;
+
+    /* Allocated blocks are copied... */
+    for(i = 0; i < pool.nents; ++i) {
+        pool_ent_t *e = pool.ents + i;
+
+        if(!e->size || (e->offset >> k) != (src >> k))
+            continue;
+
+        off = dst + (e->offset - src);
+        pool_copy(off, e->offset, 1UL << e->order);
+        e->offset = off;
+        moved += 1UL << e->order;
+        ++pool.moves;
+    }
+
+    /* ... and free ones just change places in the bitmaps. */
+    for(j = POOL_MIN_ORDER; j < (uint32_t)k; ++j) {
+        off = end;
+
+        while((off = find_below(j, off)) != POOL_NONE && off >= src) {
+            bit_clear(j, off);
+            bit_set(j, dst + (off - src));
+        }
+    }
+
+    /* The destination is now in use in the same way the source was, and the
+       source is empty. */
+    bit_clear(k, dst);
+    block_free(src, k);
+
+    return moved;
+}
+
+size_t pvr_mem_compact(size_t max_bytes) {
+    uint32_t lo, hi, buddy;
+    size_t moved = 0;
+    int k;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!pool.base)
+        return 0;
+
+    for(k = POOL_MIN_ORDER; k < POOL_MAX_ORDER && moved < max_bytes; ++k) {
+        hi = pool.size;
+
+        while(ORD(k)->count >= 2 && moved < max_bytes) {
+            lo = find_low(k);
+
+            /* Find the highest free block whose buddy we can empty out. */
+            for(;;) {
+                hi = find_below(k, hi);
+
+                if(hi == POOL_NONE || hi <= lo)
+                    break;
+
+                buddy = hi ^ (1UL << k);
+
+                if(pool_movable(buddy, k))
+                    break;
+            }
+
+            if(hi == POOL_NONE || hi <= lo)
+                break;
+
+            moved += pool_move(lo, buddy, k);
+
+            /* The merge may have freed something above us, so start over
+               from the top. */
+            hi = pool.size;
+        }
+    }
+
+    pool.moved += moved;
+    return moved;
+}
+
+static void pool_stats_int(pvr_mem_pool_stats_t *st) {
+    int k;
+
+    memset(st, 0, sizeof(*st));
+
+    st->size = pool.size;
+    st->used = pool.used;
+    st->requested = pool.requested;
+    st->handles = pool.handles;
+    st->moved = pool.moved;
+    st->moves = pool.moves;
+
+    for(k = POOL_MIN_ORDER; k <= POOL_MAX_ORDER; ++k) {
+        st->free_blocks[k - POOL_MIN_ORDER] = ORD(k)->count;
+        st->free_count += ORD(k)->count;
+
+        if(ORD(k)->count)
+            st->largest_free = 1UL << k;
+    }
+
+    st->free = pool.size - pool.used;
+
+    if(st->free)
+        st->fragmentation = 100 - (uint32_t)((uint64_t)st->largest_free *
+                                             100 / st->free);
+}
+
+int pvr_mem_pool_stats(pvr_mem_pool_stats_t *st) {
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!pool.base) {
+        errno = ENXIO;
+        return -1;
+    }
+
+    pool_stats_int(st);
+    return 0;
+}
+
+void pvr_int_mem_pool_print(void) {
+    pvr_mem_pool_stats_t st;
+    int k;
+
+    mutex_lock_scoped(&pool_mutex);
+
+    if(!pool.base)
+        return;
+
+    pool_stats_int(&st);
+
+    printf("relocatable pool at %08lx:\n", (unsigned long)pool.base);
+    printf("  size %lu, %lu handles using %lu (%lu requested)\n",
+           (unsigned long)st.size, (unsigned long)st.handles,
+           (unsigned long)st.used, (unsigned long)st.requested);
+    printf("  free %lu in %lu blocks, largest %lu, fragmentation %lu%%\n",
+           (unsigned long)st.free, (unsigned long)st.free_count,
+           (unsigned long)st.largest_free, (unsigned long)st.fragmentation);
+    printf("  free blocks by size:");
+
+    for(k = POOL_MIN_ORDER; k <= POOL_MAX_ORDER; ++k) {
+        if(st.free_blocks[k - POOL_MIN_ORDER])
+            printf(" %lu x %lu", (unsigned long)st.free_blocks[k - POOL_MIN_ORDER],
+                   1UL << k);
+    }
+
+    printf("\n  compaction moved %lu blocks, %llu bytes\n",
+           (unsigned long)st.moves, (unsigned long long)st.moved);
+}
@@ -79,6 +79,47 @@ int pvr_get_stats(pvr_stats_t *stat) {
     return 0;
 }
 
+int pvr_get_opb_stats(pvr_opb_stats_t *stat) {
+    volatile pvr_ta_buffers_t *buf;
+    int i;
+
+    if(!pvr_state.valid)
+        return -1;
+
+    assert(stat != NULL);
+
+    buf = pvr_state.ta_buffers + pvr_state.ta_target;
+
+    for(i = 0; i < PVR_OPB_COUNT; i++) {
+        stat->bin_size[i] = pvr_state.opb_size[i];
+        stat->overflow_used[i] = pvr_state.opb_used[i];
+        stat->overflow_used_max[i] = pvr_state.opb_used_max[i];
+    }
+
+    stat->tiles = pvr_state.tw * pvr_state.th;
+    stat->overflow_size = buf->opb_size * buf->opb_overflow_count;
+    stat->overflow_total = pvr_state.opb_used_total;
+    stat->overflow_total_max = pvr_state.opb_used_total_max;
+    stat->out_of_memory = pvr_state.opb_outofmem;
+    stat->frames = pvr_state.opb_frames;
+
+    return 0;
+}
+
+void pvr_reset_opb_stats(void) {
+    int i;
+
+    for(i = 0; i < PVR_OPB_COUNT; i++) {
+        pvr_state.opb_used[i] = 0;
+        pvr_state.opb_used_max[i] = 0;
+    }
+
+    pvr_state.opb_used_total = 0;
+    pvr_state.opb_used_total_max = 0;
+    pvr_state.opb_outofmem = 0;
+    pvr_state.opb_frames = 0;
+}
+
 int pvr_vertex_dma_enabled(void) {
     return pvr_state.dma_mode;
 }
@@ -108,7 +149,7 @@ uint32_t pvr_txr_get_stride(void) {
 
 /* Update statistical counters */
 void pvr_sync_stats(int event) {
-    uint64_t t;
+    uint64_t t = 0;
     volatile pvr_ta_buffers_t *buf;
 
     if(event == PVR_SYNC_VBLANK) {
@@ -132,6 +173,14 @@ void pvr_sync_stats(int event) {
                 if(pvr_state.vtx_buf_used > pvr_state.vtx_buf_used_max)
                     pvr_state.vtx_buf_used_max = pvr_state.vtx_buf_used;
 
+                pvr_state.opb_used_total = pvr_state.opb_pos -
+                                           (buf->opb + buf->opb_size);
+
+                if(pvr_state.opb_used_total > pvr_state.opb_used_total_max)
+                    pvr_state.opb_used_total_max = pvr_state.opb_used_total;
+
+                pvr_state.opb_frames++;
+
                 break;
 
             case PVR_SYNC_RNDSTART:
@@ -157,6 +206,28 @@ void pvr_sync_stats(int event) {
                 break;
         }
     }
+
+    if(pvr_state.telemetry)
+        pvr_int_telemetry_sync(event, t);
+}
+
+/* The TA hands out overflow blocks in the order it needs them, and lists are
+   sent to it one at a time, so whatever it took since the last list finished
+   was for this one. */
+void pvr_sync_opb_stats(int list) {
+    uint32 pos;
+
+    pos = PVR_GET(PVR_TA_OPB_POS) << 2;
+
+    if(pos < pvr_state.opb_pos)
+        pos = pvr_state.opb_pos;
+
+    pvr_state.opb_used[list] = pos - pvr_state.opb_pos;
+
+    if(pvr_state.opb_used[list] > pvr_state.opb_used_max[list])
+        pvr_state.opb_used_max[list] = pvr_state.opb_used[list];
+
+    pvr_state.opb_pos = pos;
 }
 
 /* Synchronize the viewed page with what's in pvr_state */
@@ -182,11 +253,14 @@ void pvr_sync_reg_buffer(void) {
     PVR_SET(PVR_TA_VERTBUF_END,     buf->vertex + buf->vertex_size);
 
     /* Misc config parameters */
-    PVR_SET(PVR_TILEMAT_CFG,        pvr_state.tsize_const);     /* Tile count: (H/32-1) << 16 | (W/32-1) */
+    PVR_SET(PVR_TILEMAT_CFG,        pvr_state.ta_tsize);        /* Tile count: (H/32-1) << 16 | (W/32-1) */
     PVR_SET(PVR_OPB_CFG,            pvr_state.list_reg_mask);   /* List enables */
     PVR_SET(PVR_TA_INIT,            PVR_TA_INIT_GO);            /* Confirm settings */
     (void)PVR_GET(PVR_TA_INIT);
 
+    /* Overflow blocks are handed out from the start of the overflow space */
+    pvr_state.opb_pos = buf->opb + buf->opb_size;
+
 #if 0
     printf("== SYNC REG BUFFER:\n");
     printf("TA_OL_BASE: %08lx\nTA_OL_LIMIT: %08lx\nTA_NEXT_OPB: %08lx\n",
@@ -0,0 +1,340 @@
+/* KallistiOS ##version##
+
+   pvr_pace.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <kos/thread.h>
+#include <arch/irq.h>
+#include <arch/timer.h>
+#include <dc/maple.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_fence.h>
+#include <dc/pvr/pvr_pace.h>
+#include "pvr_internal.h"
+
+/*
+
+   Frame pacing
+
+   Please see ../../include/dc/pvr/pvr_pace.h for more info on this API!
+
+   Vertical blanks are counted by pvr_state.vbl_count; a frame is meant for
+   the count it should be flipped to at. The time of the last vertical blank
+   and the time between them are kept, so that the time of any vertical blank
+   to come can be worked out.
+
+   Frames that have been ended but not shown yet are kept in a ring, by the
+   fence of their scene. At each vertical blank, after the PVR's handler has
+   had its chance to flip, the ones that have been shown are taken off the
+   ring and counted as on time or late. A late frame holds up the ones after
+   it, so their vertical blanks are moved back as far as need be. A frame that's
+   flipped to late is taken off when its render is done.
+
+*/
+
+/* Frames that can be kept track of between being ended and shown. */
+#define FLIGHT_MAX  4
+
+/* Frames that the longest CPU and render times are taken over. */
+#define HIST_LEN    8
+
+/* Time between vertical blanks to assume until it has been measured. */
+#define PERIOD_DEFAULT  16683334ULL
+
+/* Spin, rather than sleep, for the last of a wait. */
+#define SPIN_NS     1500000ULL
+
+/* Most time to wait for a Maple poll to be answered. */
+#define POLL_NS     3000000ULL
+
+static struct {
+    int                 active;
+    pvr_pace_params_t   params;
+
+    /* The last vertical blank, and the time between them, in ns. */
+    uint32              vbl_count;
+    uint64              vbl_time;
+    uint64              period;
+
+    /* Vertical blank the frame being built is meant for, and when it was
+       begun. */
+    uint32              target;
+    uint64              begin_time;
+    int                 building;
+
+    struct {
+        pvr_fence_t fence;
+        uint32      target;
+    } flight[FLIGHT_MAX];
+    unsigned int        flight_head, flight_count;
+
+    uint32              cpu_hist[HIST_LEN];
+    uint32              rnd_hist[HIST_LEN];
+    unsigned int        cpu_pos, rnd_pos;
+
+    pvr_pace_stats_t    st;
+} pace;
+
+static uint32 hist_max(const uint32 *h) {
+    uint32 m = 0;
+    int i;
+
+    for(i = 0; i < HIST_LEN; i++)
+        if(h[i] > m)
+            m = h[i];
+
+    return m;
+}
+
+int pvr_pace_init(const pvr_pace_params_t *params) {
+    if(!pvr_state.valid || !params || params->interval < 1 ||
+       params->interval > 4) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    irq_disable_scoped();
+
+    if(!pace.active) {
+        pace.vbl_count = pvr_state.vbl_count;
+        pace.vbl_time = timer_ns_gettime64();
+        pace.period = PERIOD_DEFAULT;
+        pace.target = pace.vbl_count;
+    }
+
+    pace.params = *params;
+    pace.flight_head = pace.flight_count = 0;
+    pace.building = 0;
+    pace.cpu_pos = pace.rnd_pos = 0;
+    memset(pace.cpu_hist, 0, sizeof(pace.cpu_hist));
+    memset(pace.rnd_hist, 0, sizeof(pace.rnd_hist));
+    memset(&pace.st, 0, sizeof(pace.st));
+    pace.active = 1;
+
+    return 0;
+}
+
+void pvr_pace_shutdown(void) {
+    pace.active = 0;
+}
+
+/* Wait until the given time: sleeping for most of it, as the scheduler only
+   has millisecond resolution, and passing for the rest. */
+static void pace_wait_until(uint64 t) {
+    uint64 now;
+
+    while((now = timer_ns_gettime64()) < t) {
+        if(t - now > SPIN_NS)
+            thd_sleep((t - now - SPIN_NS) / 1000000 + 1);
+        else
+            thd_pass();
+    }
+}
+
+int pvr_pace_begin(void) {
+    uint64 start, vt, period, est, now, t;
+    uint32 cnt, interval, k, n;
+    int rv;
+
+    if(!pace.active) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    start = timer_ns_gettime64();
+    rv = pvr_wait_ready();
+    interval = pace.params.interval;
+
+    /* How long the frame is likely to take, from the worst of late. */
+    est = (uint64)(hist_max(pace.cpu_hist) + hist_max(pace.rnd_hist) +
+                   pace.params.margin_us) * 1000;
+
+    {
+        irq_disable_scoped();
+
+        cnt = pace.vbl_count;
+        vt = pace.vbl_time;
+        period = pace.period;
+        now = timer_ns_gettime64();
+
+        /* The first vertical blank the frame could make. Without just in
+           time starts, that's taken to be the next one. */
+        k = 1;
+
+        if(pace.params.jit && now + est > vt)
+            k = (now + est - vt + period - 1) / period;
+
+        if(!k)
+            k = 1;
+
+        /* Frames go on every interval vertical blanks, unless that has
+           become too soon; then the rate starts over from the next one that
+           can be made. */
+        pace.target += interval;
+
+        if((int32)(pace.target - (cnt + k)) < 0)
+            pace.target = cnt + k;
+
+        /* When to start the frame: just in time for its vertical blank, or
+           at the one the frame before it was meant for. */
+        t = now;
+        n = pace.target - cnt;
+
+        if(pace.params.jit) {
+            if(n * period > est)
+                t = vt + n * period - est;
+        }
+        else if(n > interval) {
+            t = vt + (n - interval) * period;
+        }
+
+        pace.st.frames++;
+        pace.building = 1;
+    }
+
+    pace_wait_until(t);
+    pace.begin_time = timer_ns_gettime64();
+
+    /* Get fresh input, as the frame is about to use it. */
+    if(pace.params.jit && pace.params.poll_functions &&
+       !maple_poll(pace.params.poll_functions)) {
+        t = pace.begin_time + POLL_NS;
+
+        while(maple_state.dma_in_progress && timer_ns_gettime64() < t)
+            thd_pass();
+    }
+
+    pace.st.wait_us = (pace.begin_time - start) / 1000;
+
+    return rv;
+}
+
+void pvr_pace_end(void) {
+    unsigned int i;
+    uint32 cpu;
+
+    if(!pace.active)
+        return;
+
+    cpu = (timer_ns_gettime64() - pace.begin_time) / 1000;
+
+    irq_disable_scoped();
+
+    pace.building = 0;
+    pace.cpu_hist[pace.cpu_pos] = cpu;
+    pace.cpu_pos = (pace.cpu_pos + 1) % HIST_LEN;
+    pace.st.cpu_us = cpu;
+
+    /* If the ring is full, the oldest frame is forgotten about. */
+    if(pace.flight_count == FLIGHT_MAX) {
+        pace.flight_head = (pace.flight_head + 1) % FLIGHT_MAX;
+        pace.flight_count--;
+    }
+
+    i = (pace.flight_head + pace.flight_count++) % FLIGHT_MAX;
+    pace.flight[i].fence = pvr_scene_fence();
+    pace.flight[i].target = pace.target;
+}
+
+void pvr_pace_stats(pvr_pace_stats_t *st) {
+    irq_disable_scoped();
+
+    *st = pace.st;
+    st->cpu_max_us = hist_max(pace.cpu_hist);
+    st->render_max_us = hist_max(pace.rnd_hist);
+    st->vbl_period_us = pace.period / 1000;
+}
+
+/* Is a at or after b? Sequence numbers wrap, so compare the difference. */
+static inline bool seq_reached(uint32 a, uint32 b) {
+    return (int32)(a - b) >= 0;
+}
+
+void pvr_int_pace_vblank(void) {
+    uint64 now = timer_ns_gettime64(), d;
+    uint32 prev, interval = pace.params.interval;
+    unsigned int i, j;
+    int32 late;
+
+    if(!pace.active)
+        return;
+
+    /* Follow the time between vertical blanks, skipping any that look like
+       some were missed, or the mode changed. */
+    d = now - pace.vbl_time;
+
+    if(pvr_state.vbl_count - pace.vbl_count == 1 && d > pace.period / 2 &&
+       d < pace.period * 3 / 2)
+        pace.period = (pace.period * 7 + d) / 8;
+
+    pace.vbl_count = pvr_state.vbl_count;
+    pace.vbl_time = now;
+
+    /* Count the frames that were just shown. */
+    while(pace.flight_count &&
+          seq_reached(pvr_state.fence_disp, pace.flight[pace.flight_head].fence)) {
+        late = pace.vbl_count - pace.flight[pace.flight_head].target;
+
+        pace.flight_head = (pace.flight_head + 1) % FLIGHT_MAX;
+        pace.flight_count--;
+
+        if(late <= 0) {
+            pace.st.on_time++;
+            continue;
+        }
+
+        pace.st.late++;
+        pace.st.missed_vbls += late;
+
+        /* The frames after it can't be shown until they've been rendered
+           after it, so move them back as far as they need to go. */
+        prev = pace.vbl_count;
+
+        for(i = 0; i < pace.flight_count; i++) {
+            j = (pace.flight_head + i) % FLIGHT_MAX;
+
+            if((int32)(pace.flight[j].target - (prev + interval)) < 0)
+                pace.flight[j].target = prev + interval;
+
+            prev = pace.flight[j].target;
+        }
+
+        /* Likewise for the frame being built, if there is one. */
+        if(pace.building)
+            prev += interval;
+
+        if((int32)(pace.target - prev) < 0)
+            pace.target = prev;
+    }
+}
+
+bool pvr_int_pace_render_done(void) {
+    uint32 rnd;
+
+    if(!pace.active || pvr_state.was_to_texture)
+        return false;
+
+    rnd = pvr_state.rnd_last_len / 1000;
+    pace.rnd_hist[pace.rnd_pos] = rnd;
+    pace.rnd_pos = (pace.rnd_pos + 1) % HIST_LEN;
+    pace.st.render_us = rnd;
+
+    /* Flip now if this is the oldest frame waiting, its vertical blank has
+       just gone by, and it's not too long after that. */
+    if(!pace.params.late_flip_us || !pace.flight_count ||
+       pace.flight[pace.flight_head].fence != pvr_state.rnd_frame ||
+       pace.flight[pace.flight_head].target != pace.vbl_count ||
+       timer_ns_gettime64() - pace.vbl_time >=
+       (uint64)pace.params.late_flip_us * 1000)
+        return false;
+
+    pace.st.late_flips++;
+    pace.flight_head = (pace.flight_head + 1) % FLIGHT_MAX;
+    pace.flight_count--;
+
+    return true;
+}
@@ -2,10 +2,14 @@
 
    pvr_palette.c
    (C)2002 Megan Potter
+   Copyright (C) 2026 The KOS Team and contributors
 
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <arch/irq.h>
 #include <dc/pvr.h>
 #include "pvr_internal.h"
 
@@ -21,3 +25,166 @@ void pvr_set_pal_format(pvr_palfmt_t fmt) {
     PVR_SET(PVR_PALETTE_CFG, fmt);
 }
 
+/*
+
+   Palette banks
+
+   Please see ../../include/dc/pvr/pvr_pal.h for more info on this API!
+
+   The table is handed out in blocks of 16 entries, one bit each in a 64-bit
+   mask. 16-entry banks are taken from the end of the table and 256-entry ones
+   from the start, so that the small ones don't break up the room for the big
+   ones.
+
+   Entries are set in a copy of the table in RAM, and a mask of the blocks
+   that were set is kept. Committing copies those blocks to a second copy,
+   the one that the interrupt handlers write out to the PVR; this way, a
+   commit that comes while a palette is being changed still gets all of the
+   changes from before it, and none from after.
+
+*/
+
+#define PAL_ENTRIES     1024
+#define PAL_BLOCK       16
+#define PAL_BLOCKS      (PAL_ENTRIES / PAL_BLOCK)
+
+/* Blocks allocated, and the size of the bank starting at each one. */
+static uint64 bank_used;
+static uint16 bank_size[PAL_BLOCKS];
+
+/* The table as it's being set, and the blocks set since the last commit. */
+static uint32 pal_staged[PAL_ENTRIES];
+static uint64 staged_mask;
+
+/* The table as committed, and the blocks still to write out. */
+static uint32 pal_pending[PAL_ENTRIES];
+static volatile uint64 pending_mask;
+
+static inline uint64 block_mask(unsigned int first, unsigned int count) {
+    return (count == PAL_BLOCKS ? ~0ULL : ((1ULL << count) - 1)) << first;
+}
+
+int pvr_pal_bank_alloc(unsigned int size) {
+    unsigned int blocks, b;
+    int rv = -1;
+
+    if(size != 16 && size != 256) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    blocks = size / PAL_BLOCK;
+
+    irq_disable_scoped();
+
+    if(blocks == 1) {
+        for(b = PAL_BLOCKS; b-- > 0;) {
+            if(!(bank_used & block_mask(b, 1))) {
+                rv = b;
+                break;
+            }
+        }
+    }
+    else {
+        for(b = 0; b < PAL_BLOCKS; b += blocks) {
+            if(!(bank_used & block_mask(b, blocks))) {
+                rv = b;
+                break;
+            }
+        }
+    }
+
+    if(rv < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    bank_used |= block_mask(rv, blocks);
+    bank_size[rv] = size;
+
+    return rv * PAL_BLOCK;
+}
+
+void pvr_pal_bank_free(int base) {
+    unsigned int b;
+
+    if(base < 0 || base >= PAL_ENTRIES || (base % PAL_BLOCK))
+        return;
+
+    b = base / PAL_BLOCK;
+
+    irq_disable_scoped();
+
+    if(!bank_size[b])
+        return;
+
+    bank_used &= ~block_mask(b, bank_size[b] / PAL_BLOCK);
+    bank_size[b] = 0;
+}
+
+void pvr_pal_stage(uint32_t idx, uint32_t value) {
+    assert(idx < PAL_ENTRIES);
+
+    pal_staged[idx] = value;
+    staged_mask |= 1ULL << (idx / PAL_BLOCK);
+}
+
+void pvr_pal_stage_range(uint32_t idx, const uint32_t *values, size_t count) {
+    assert(idx + count <= PAL_ENTRIES);
+
+    if(!count)
+        return;
+
+    memcpy(pal_staged + idx, values, count * sizeof(uint32));
+    staged_mask |= block_mask(idx / PAL_BLOCK,
+                              (idx + count - 1) / PAL_BLOCK - idx / PAL_BLOCK + 1);
+}
+
+/* Write out the committed blocks. Interrupts must be disabled. */
+static void pal_apply(void) {
+    uint64 m = pending_mask;
+    unsigned int b, i;
+
+    pending_mask = 0;
+
+    for(b = 0; m; b++, m >>= 1) {
+        if(!(m & 1))
+            continue;
+
+        for(i = b * PAL_BLOCK; i < (b + 1) * PAL_BLOCK; i++)
+            PVR_SET(PVR_PALETTE_TABLE_BASE + 4 * i, pal_pending[i]);
+    }
+}
+
+void pvr_pal_commit(void) {
+    uint64 staged = staged_mask, m;
+    unsigned int b;
+
+    if(!staged)
+        return;
+
+    staged_mask = 0;
+
+    irq_disable_scoped();
+
+    for(b = 0, m = staged; m; b++, m >>= 1) {
+        if(m & 1)
+            memcpy(pal_pending + b * PAL_BLOCK, pal_staged + b * PAL_BLOCK,
+                   PAL_BLOCK * sizeof(uint32));
+    }
+
+    pending_mask |= staged;
+
+    /* Without the PVR's interrupts, nothing is rendering either. */
+    if(!pvr_state.valid)
+        pal_apply();
+}
+
+bool pvr_pal_pending(void) {
+    return pending_mask != 0;
+}
+
+void pvr_int_pal_apply(void) {
+    if(pending_mask)
+        pal_apply();
+}
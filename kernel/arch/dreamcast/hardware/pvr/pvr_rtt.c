@@ -0,0 +1,201 @@
+/* KallistiOS ##version##
+
+   pvr_rtt.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <errno.h>
+#include <arch/irq.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_rtt.h>
+#include "pvr_internal.h"
+
+/*
+
+   Render targets
+
+   Please see ../../include/dc/pvr/pvr_rtt.h for more info on this API!
+
+   Each scene is tagged with the target it's for (pvr_state.next_rtt, one
+   more than the target, or 0 for the screen or a plain render to texture).
+   When the TA is taken for the scene, the tag moves to pvr_state.ta_rtt,
+   and the TA buffer's tile matrix and the TA's tile count are set for the
+   scene's size; when its render starts, the tag moves on to
+   pvr_state.rnd_rtt, which is how the interrupt handlers know whose times
+   they have.
+
+*/
+
+typedef struct {
+    pvr_ptr_t   txr;
+    uint32      w, h;
+    bool        used;
+    pvr_fence_t fence;
+    pvr_rtt_stats_t stats;
+} rtt_target_t;
+
+static rtt_target_t targets[PVR_RTT_MAX_TARGETS];
+
+static struct {
+    int             target;
+    pvr_rtt_draw_t  draw;
+    void            *data;
+} jobs[PVR_RTT_MAX_JOBS];
+
+static int n_jobs;
+
+static inline bool valid_target(int target) {
+    return target >= 0 && target < PVR_RTT_MAX_TARGETS && targets[target].used;
+}
+
+int pvr_rtt_target(pvr_ptr_t txr, uint32_t w, uint32_t h) {
+    int i;
+
+    if(pvr_state.fsaa || !w || !h || (w & 31) || (h & 31) ||
+       w > (uint32)pvr_state.w || h > (uint32)pvr_state.h) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for(i = 0; i < PVR_RTT_MAX_TARGETS; i++) {
+        if(!targets[i].used) {
+            targets[i].txr = txr;
+            targets[i].w = w;
+            targets[i].h = h;
+            targets[i].fence = 0;
+            targets[i].stats = (pvr_rtt_stats_t){ 0 };
+            targets[i].used = true;
+            return i;
+        }
+    }
+
+    errno = ENOSPC;
+    return -1;
+}
+
+void pvr_rtt_target_free(int target) {
+    if(valid_target(target))
+        targets[target].used = false;
+}
+
+int pvr_rtt_queue(int target, pvr_rtt_draw_t draw, void *data) {
+    if(!valid_target(target)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(n_jobs >= PVR_RTT_MAX_JOBS) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    jobs[n_jobs].target = target;
+    jobs[n_jobs].draw = draw;
+    jobs[n_jobs].data = data;
+    n_jobs++;
+
+    return 0;
+}
+
+int pvr_rtt_flush(void) {
+    rtt_target_t *t;
+    uint32 rx, ry;
+    int i, n = 0;
+
+    for(i = 0; i < n_jobs; i++) {
+        /* The target may have been freed since the job was queued. */
+        if(!valid_target(jobs[i].target))
+            continue;
+
+        t = targets + jobs[i].target;
+        rx = t->w;
+        ry = t->h;
+
+        pvr_wait_ready();
+        pvr_scene_begin_txr(t->txr, &rx, &ry);
+        pvr_state.next_rtt = jobs[i].target + 1;
+
+        jobs[i].draw(jobs[i].target, jobs[i].data);
+
+        pvr_scene_finish();
+        t->fence = pvr_scene_fence();
+        n++;
+    }
+
+    n_jobs = 0;
+
+    return n;
+}
+
+pvr_fence_t pvr_rtt_fence(int target) {
+    return valid_target(target) ? targets[target].fence : 0;
+}
+
+int pvr_rtt_stats(int target, pvr_rtt_stats_t *st) {
+    if(!valid_target(target))
+        return -1;
+
+    irq_disable_scoped();
+    *st = targets[target].stats;
+
+    return 0;
+}
+
+/* Called by pvr_init(). */
+void pvr_int_rtt_reset(void) {
+    int i;
+
+    for(i = 0; i < PVR_RTT_MAX_TARGETS; i++)
+        targets[i].used = false;
+
+    n_jobs = 0;
+}
+
+/* Called when the TA is taken for a scene, while it's idle. */
+void pvr_int_rtt_setup(void) {
+    int tw = pvr_state.tw, th = pvr_state.th;
+    uint32 tsize;
+
+    pvr_state.ta_rtt = pvr_state.next_rtt;
+
+    if(pvr_state.ta_rtt) {
+        tw = targets[pvr_state.ta_rtt - 1].w / 32;
+        th = targets[pvr_state.ta_rtt - 1].h / 32;
+    }
+
+    pvr_layout_tile_matrix(pvr_state.ta_target, tw, th);
+
+    /* The TA was set up for the last scene's size when its render started. */
+    tsize = ((th - 1) << 16) | (tw - 1);
+
+    if(tsize != pvr_state.ta_tsize) {
+        pvr_state.ta_tsize = tsize;
+        pvr_sync_reg_buffer();
+    }
+}
+
+/* All of the lists of the TA's scene are in. */
+void pvr_int_rtt_reg_done(void) {
+    pvr_rtt_stats_t *st;
+
+    if(!pvr_state.ta_rtt)
+        return;
+
+    st = &targets[pvr_state.ta_rtt - 1].stats;
+    st->reg_last = pvr_state.reg_last_len;
+    st->reg_total += pvr_state.reg_last_len;
+}
+
+/* The render is done. */
+void pvr_int_rtt_render_done(void) {
+    pvr_rtt_stats_t *st;
+
+    if(!pvr_state.rnd_rtt)
+        return;
+
+    st = &targets[pvr_state.rnd_rtt - 1].stats;
+    st->renders++;
+    st->rnd_last = pvr_state.rnd_last_len;
+    st->rnd_total += pvr_state.rnd_last_len;
+}
@@ -14,6 +14,7 @@
 #include <kos/thread.h>
 #include <dc/pvr.h>
 #include <dc/sq.h>
+#include <dc/pvr/pvr_fence.h>
 #include "pvr_internal.h"
 
 /*
@@ -24,6 +25,16 @@
 
 */
 
+/* Space handed out by pvr_list_reserve(), and not committed yet */
+static struct {
+    uint8   *ptr;
+    size_t  size;
+    bool    ext;
+} pvr_resv[PVR_OPB_COUNT];
+
+/* End of list marker, for lists that end with a command buffer */
+static const uint8 pvr_eol_marker[32] __attribute__((aligned(32)));
+
 void *pvr_set_vertbuf(pvr_list_t list, void *buffer, size_t len) {
     void *oldbuf;
 
@@ -58,39 +69,38 @@ void *pvr_set_vertbuf(pvr_list_t list, void *buffer, size_t len) {
     return oldbuf;
 }
 
-void *pvr_vertbuf_tail(pvr_list_t list) {
-    uint8 *bufbase;
+void *pvr_set_vertbuf_ext(pvr_list_t list, void *buffer, size_t len) {
+    void *oldbuf;
 
-    // Check the validity of the request.
-    assert(list < PVR_OPB_COUNT);
+    // Same rules as for the main buffer.
     assert(pvr_state.dma_mode);
+    assert(list < PVR_OPB_COUNT);
+    assert(pvr_state.lists_enabled & BIT(list));
+    assert(!(((ptr_t)buffer) & 31));
+    assert(!(len & 63));
 
-    // Get the buffer base.
-    bufbase = pvr_state.dma_buffers[pvr_state.ram_target].base[list];
-    assert(bufbase);
-
-    // Return the current end of the buffer.
-    return bufbase + pvr_state.dma_buffers[pvr_state.ram_target].ptr[list];
-}
+    oldbuf = pvr_state.dma_buffers[0].ext_base[list];
 
-void pvr_vertbuf_written(pvr_list_t list, size_t amt) {
-    uint32 val;
+    // A NULL buffer removes the extension buffer.
+    if(!buffer)
+        len = 0;
 
-    // Check the validity of the request.
-    assert(list < PVR_OPB_COUNT);
-    assert(pvr_state.dma_mode);
+    pvr_state.dma_buffers[0].ext_base[list] = (uint8 *)buffer;
+    pvr_state.dma_buffers[0].ext_ptr[list] = 0;
+    pvr_state.dma_buffers[0].ext_size[list] = len / 2;
+    pvr_state.dma_buffers[1].ext_base[list] = buffer ? ((uint8 *)buffer) + len / 2 : NULL;
+    pvr_state.dma_buffers[1].ext_ptr[list] = 0;
+    pvr_state.dma_buffers[1].ext_size[list] = len / 2;
 
-    // Change the current end of the buffer.
-    val = pvr_state.dma_buffers[pvr_state.ram_target].ptr[list];
-    val += amt;
-    assert(val < pvr_state.dma_buffers[pvr_state.ram_target].size[list]);
-    pvr_state.dma_buffers[pvr_state.ram_target].ptr[list] = val;
+    return oldbuf;
 }
 
+static int pvr_wait_ta_ready(void);
+
 static void pvr_start_ta_rendering(void) {
     // Make sure to wait until the TA is ready to start rendering a new scene
     if(!pvr_state.ta_checked_ready) {
-        pvr_wait_ready();
+        pvr_wait_ta_ready();
 
         // If using a single vertex buffer, we have to wait until the PVR is
         // done rendering to use the TA again.
@@ -101,6 +111,8 @@ static void pvr_start_ta_rendering(void) {
         pvr_state.curr_to_texture = pvr_state.next_to_texture;
         pvr_state.to_txr_rp = pvr_state.next_to_txr_rp;
         pvr_state.to_txr_addr = pvr_state.next_to_txr_addr;
+        pvr_state.ta_frame = pvr_state.frame_seq;
+        pvr_int_rtt_setup();
 
         // Starting from that point, we consider that the Tile Accelerator
         // might be busy.
@@ -114,16 +126,32 @@ void pvr_scene_begin(void) {
     int i;
 
     pvr_state.next_to_texture = 0;
+    pvr_state.next_rtt = 0;
     pvr_state.ta_checked_ready = 0;
     pvr_state.lists_closed = 0;
+    pvr_state.frame_seq++;
+
+    // Free textures that the last frames were done with.
+    pvr_fence_collect();
 
     // Get general stuff ready.
     pvr_state.list_reg_open = -1;
+    pvr_int_batch_reset();
+    pvr_int_sprite_batch_reset();
+
+    if(pvr_state.telemetry)
+        pvr_int_telemetry_begin();
+
+    if(pvr_state.capture)
+        pvr_int_capture_begin();
 
     // Clear these out in case we're using DMA.
     if(pvr_state.dma_mode) {
         for(i = 0; i < PVR_OPB_COUNT; i++) {
             pvr_state.dma_buffers[pvr_state.ram_target].ptr[i] = 0;
+            pvr_state.dma_buffers[pvr_state.ram_target].ext_ptr[i] = 0;
+            pvr_state.dma_buffers[pvr_state.ram_target].chain_count[i] = 0;
+            pvr_resv[i].size = 0;
         }
 
         pvr_sync_stats(PVR_SYNC_BUFSTART);
@@ -215,6 +243,10 @@ int pvr_list_finish(void) {
 
 #endif  /* !NDEBUG */
 
+    /* Send anything the batching layers have held back for this list */
+    pvr_int_batch_finish(pvr_state.list_reg_open);
+    pvr_int_sprite_batch_finish(pvr_state.list_reg_open);
+
     /* Check for immediate submission:
        A. If we are not in DMA mode, we must be submitting polygons
           immediately.
@@ -264,6 +296,12 @@ int pvr_prim(const void *data, size_t size) {
 
         /* Immediately send data via SQs. */
         sq_fast_cpy(SQ_MASK_DEST(PVR_TA_INPUT), data, size >> 5);
+
+        if(pvr_state.telemetry)
+            pvr_int_telemetry_count(pvr_state.list_reg_open, data, size);
+
+        if(pvr_state.capture)
+            pvr_int_capture_data(pvr_state.list_reg_open, data, size);
     }
     /* Defer data to RAM buffer for DMA-ing later. */
     else return pvr_list_prim(pvr_state.list_reg_open, data, size);
@@ -271,7 +309,11 @@ int pvr_prim(const void *data, size_t size) {
     return 0;
 }
 
-int pvr_list_prim(pvr_list_t list, const void *data, size_t size) {
+/* Find room for size bytes at the end of a list's DMA data, leaving keep
+   bytes free after it. Once a list has spilled over into its extension
+   buffer, everything after that has to go there too, to stay in order. */
+static uint8 *pvr_vertbuf_room(pvr_list_t list, size_t size, size_t keep,
+                               bool *ext) {
     volatile pvr_dma_buffers_t * b;
 
     b = pvr_state.dma_buffers + pvr_state.ram_target;
@@ -279,18 +321,126 @@ int pvr_list_prim(pvr_list_t list, const void *data, size_t size) {
     /* Ensure we associated a DMA vertex buffer with this list type. */
     assert(b->base[list]);
 
+    if(!b->ext_ptr[list] && b->ptr[list] + size + keep <= b->size[list]) {
+        *ext = false;
+        return b->base[list] + b->ptr[list];
+    }
+
+    if(b->ext_base[list] &&
+       b->ext_ptr[list] + size + keep <= b->ext_size[list]) {
+        *ext = true;
+        return b->ext_base[list] + b->ext_ptr[list];
+    }
+
+    return NULL;
+}
+
+static void pvr_vertbuf_advance(pvr_list_t list, size_t size, bool ext) {
+    volatile pvr_dma_buffers_t * b;
+
+    b = pvr_state.dma_buffers + pvr_state.ram_target;
+
+    if(ext)
+        b->ext_ptr[list] += size;
+    else
+        b->ptr[list] += size;
+}
+
+void *pvr_vertbuf_tail(pvr_list_t list) {
+    uint8 *rv;
+    bool ext;
+
+    // Check the validity of the request.
+    assert(list < PVR_OPB_COUNT);
+    assert(pvr_state.dma_mode);
+
+    // Return the current end of the list, which is in the extension buffer
+    // once the list has spilled over into it.
+    rv = pvr_vertbuf_room(list, 0, 32, &ext);
+    assert(rv);
+
+    return rv;
+}
+
+void pvr_vertbuf_written(pvr_list_t list, size_t amt) {
+    bool ext, end_ext;
+    uint8 *end;
+
+    // Check the validity of the request.
+    assert(list < PVR_OPB_COUNT);
+    assert(pvr_state.dma_mode);
+
+    // The data went wherever pvr_vertbuf_tail() pointed, and has to have
+    // left room for the end of list marker there.
+    pvr_vertbuf_room(list, 0, 32, &ext);
+    end = pvr_vertbuf_room(list, amt, 32, &end_ext);
+    assert(end && end_ext == ext);
+    (void)end;
+    (void)end_ext;
+
+    // Change the current end of the buffer.
+    pvr_vertbuf_advance(list, amt, ext);
+}
+
+void *pvr_list_reserve(pvr_list_t list, size_t size) {
+    uint8 *rv;
+    bool ext;
+
+    assert(list < PVR_OPB_COUNT);
+    assert(pvr_state.dma_mode);
+
+    /* Ensure data size is multiple of 32-bytes. */
+    assert(!(size & 31));
+
+    /* The last 32 bytes are kept for the end of list marker. */
+    if(!(rv = pvr_vertbuf_room(list, size, 32, &ext))) {
+        dbglog(DBG_WARNING, "pvr_list_reserve: no room for %u bytes in "
+               "list %u\n", (unsigned)size, (unsigned)list);
+        pvr_resv[list].size = 0;
+        return NULL;
+    }
+
+    pvr_resv[list].ptr = rv;
+    pvr_resv[list].size = size;
+    pvr_resv[list].ext = ext;
+
+    return rv;
+}
+
+int pvr_list_commit(pvr_list_t list, size_t size) {
+    assert(list < PVR_OPB_COUNT);
+
     /* Ensure data size is multiple of 32-bytes. */
     assert(!(size & 31));
+
+    if(size > pvr_resv[list].size) {
+        dbglog(DBG_ERROR, "pvr_list_commit: committing %u bytes to list %u "
+               "with only %u reserved\n", (unsigned)size, (unsigned)list,
+               (unsigned)pvr_resv[list].size);
+        return -1;
+    }
+
+    pvr_vertbuf_advance(list, size, pvr_resv[list].ext);
+    pvr_resv[list].size = 0;
+
+    return 0;
+}
+
+int pvr_list_prim(pvr_list_t list, const void *data, size_t size) {
+    void *dst;
+
     /* Ensure at least 4-byte alignment. */
     assert(!((uintptr_t)data & 0x3));
 
     /* Ensure we won't overflow the vertex buffer. */
-    assert(b->ptr[list] + size <= b->size[list]);
+    dst = pvr_list_reserve(list, size);
+    assert(dst);
 
-    memcpy(b->base[list] + b->ptr[list], data, size);
-    b->ptr[list] += size;
+    if(!dst)
+        return -1;
 
-    return 0;
+    memcpy(dst, data, size);
+    return pvr_list_commit(list, size);
 }
 
 void pvr_dr_init(pvr_dr_state_t *vtx_buf_ptr) {
@@ -316,6 +466,8 @@ int pvr_list_flush(pvr_list_t list) {
 int pvr_scene_finish(void) {
     int i, o;
     volatile pvr_dma_buffers_t * b;
+    uint8 *dst;
+    bool ext;
 
     /* Release Store Queues if they are used */
     if(pvr_state.dr_used) {
@@ -329,6 +481,16 @@ int pvr_scene_finish(void) {
         // add a zero-marker to the end of each list.
         b = pvr_state.dma_buffers + pvr_state.ram_target;
 
+        /* Lists with a vertex buffer are never closed with pvr_list_finish(),
+           so send anything the batching layers have held back for them now,
+           before the blank headers and end of list markers. */
+        for(i = 0; i < PVR_OPB_COUNT; i++) {
+            if((pvr_state.lists_enabled & BIT(i)) && b->base[i]) {
+                pvr_int_batch_finish(i);
+                pvr_int_sprite_batch_finish(i);
+            }
+        }
+
         for(i = 0; i < PVR_OPB_COUNT; i++) {
             /* We never enabled the list globally with pvr_init() - skip it */
             if(!(pvr_state.lists_enabled & BIT(i)))
@@ -348,19 +510,36 @@ int pvr_scene_finish(void) {
                 continue;
 
             // Make sure there's at least one primitive in each.
-            if(b->ptr[i] == 0) {
-                pvr_blank_polyhdr_buf(i, (pvr_poly_hdr_t*)(b->base[i]));
-                b->ptr[i] += 32;
+            if(b->ptr[i] == 0 && b->ext_ptr[i] == 0 && !b->chain_count[i]) {
+                dst = pvr_vertbuf_room(i, 32, 32, &ext);
+                assert(dst);
+                pvr_blank_polyhdr_buf(i, (pvr_poly_hdr_t*)dst);
+                pvr_vertbuf_advance(i, 32, ext);
             }
 
-            // Put a zero-marker on the end.
-            memset(b->base[i] + b->ptr[i], 0, 32);
-            b->ptr[i] += 32;
+            // Put a zero-marker on the end. If the list ends with command
+            // buffers, it's chained on after them.
+            if(b->chain_count[i]) {
+                b->chain_base[i][b->chain_count[i]] = pvr_eol_marker;
+                b->chain_size[i][b->chain_count[i]] = 32;
+                b->chain_count[i]++;
+                continue;
+            }
 
-            // Verify that there is no overrun.
-            assert(b->ptr[i] <= b->size[i]);
+            // Otherwise, there is always room for it, as pvr_list_reserve()
+            // keeps the last 32 bytes free.
+            dst = pvr_vertbuf_room(i, 32, 0, &ext);
+            assert(dst);
+            memset(dst, 0, 32);
+            pvr_vertbuf_advance(i, 32, ext);
         }
 
+        if(pvr_state.telemetry)
+            pvr_int_telemetry_finish();
+
+        if(pvr_state.capture)
+            pvr_int_capture_finish();
+
         pvr_start_ta_rendering();
 
         // Flip buffers and mark them complete.
@@ -378,6 +557,9 @@ int pvr_scene_finish(void) {
         if(pvr_state.list_reg_open != -1)
             pvr_list_finish();
 
+        if(pvr_state.telemetry)
+            pvr_int_telemetry_finish();
+
         /* If any lists weren't submitted, then submit blank ones now */
         for(i = 0; i < PVR_OPB_COUNT; i++) {
             if((pvr_state.lists_enabled & BIT(i))
@@ -387,13 +569,18 @@ int pvr_scene_finish(void) {
                 pvr_list_finish();
             }
         }
+
+        if(pvr_state.capture)
+            pvr_int_capture_finish();
     }
 
+    pvr_state.finish_seq = pvr_state.frame_seq;
+
     /* Ok, now it's just a matter of waiting for the interrupt... */
     return 0;
 }
 
-int pvr_wait_ready(void) {
+static int pvr_wait_ta_ready(void) {
     int flags, t = 0;
 
     assert(pvr_state.valid);
@@ -424,10 +611,22 @@ int pvr_wait_ready(void) {
     return 0;
 }
 
+int pvr_wait_ready(void) {
+    assert(pvr_state.valid);
+
+    // With three frames in flight, the RAM buffer for the next scene is free
+    // as soon as the last one is finished; pvr_scene_finish() waits for the
+    // TA instead.
+    if(pvr_state.pipeline_depth > 2)
+        return 0;
+
+    return pvr_wait_ta_ready();
+}
+
 int pvr_check_ready(void) {
     assert(pvr_state.valid);
 
-    if(!pvr_state.ta_busy)
+    if(!pvr_state.ta_busy || pvr_state.pipeline_depth > 2)
         return 0;
     else
         return -1;
@@ -0,0 +1,393 @@
+/* KallistiOS ##version##
+
+   pvr_sprite_batch.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <errno.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_batch.h>
+#include <dc/pvr/pvr_sprite_batch.h>
+#include "pvr_internal.h"
+
+/*
+
+   Sprite batching
+
+   Please see ../../include/dc/pvr/pvr_sprite_batch.h for more info on this
+   API!
+
+   Sprites are kept in the order they were added, and never move. What gets
+   sorted is a key for each one (list, then layer, then state, from the top
+   byte down) and its index, with an LSD radix sort a byte at a time. All
+   four byte histograms are counted in one go first; a byte that is the same
+   for every key (which the list and layer bytes usually are, and the top
+   byte of the state nearly always is) then gets no pass at all.
+
+   Once a list is sent, its keys are cut out of the sorted array, so that the
+   next list sent doesn't need sorting again unless more sprites were added.
+
+*/
+
+/* Sprites sent per pvr_list_reserve() in DMA mode. */
+#define DMA_CHUNK   64
+
+static pvr_sprite_txr_t *sprites;
+static uint32_t max_sprites, n_sprites;
+
+static pvr_sprite_hdr_t *states;
+static uint8_t *state_list;
+static uint32_t max_states, n_states;
+static uint32_t generation;
+
+/* Sort keys and sprite indices, and the same again for the sort to move
+   them back and forth between. */
+static uint32_t *keys, *keys_tmp;
+static uint16_t *idx, *idx_tmp;
+static uint32_t n_keys;
+static bool sorted;
+
+static uint32_t hist[4][256];
+
+static pvr_sprite_batch_stats_t stats;
+
+int pvr_sprite_batch_init(const pvr_sprite_batch_params_t *params) {
+    pvr_sprite_batch_shutdown();
+
+    if(params->max_sprites > 65536 || params->max_states > 65536) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    sprites = memalign(32, params->max_sprites * sizeof(pvr_sprite_txr_t));
+    states = memalign(32, params->max_states * sizeof(pvr_sprite_hdr_t));
+    state_list = malloc(params->max_states);
+    keys = malloc(params->max_sprites * sizeof(uint32_t));
+    keys_tmp = malloc(params->max_sprites * sizeof(uint32_t));
+    idx = malloc(params->max_sprites * sizeof(uint16_t));
+    idx_tmp = malloc(params->max_sprites * sizeof(uint16_t));
+
+    if(!sprites || !states || !state_list || !keys || !keys_tmp || !idx ||
+       !idx_tmp) {
+        pvr_sprite_batch_shutdown();
+        errno = ENOMEM;
+        return -1;
+    }
+
+    max_sprites = params->max_sprites;
+    max_states = params->max_states;
+    sorted = true;
+
+    return 0;
+}
+
+void pvr_sprite_batch_shutdown(void) {
+    free(sprites);
+    free(states);
+    free(state_list);
+    free(keys);
+    free(keys_tmp);
+    free(idx);
+    free(idx_tmp);
+
+    sprites = NULL;
+    states = NULL;
+    state_list = NULL;
+    keys = keys_tmp = NULL;
+    idx = idx_tmp = NULL;
+    max_sprites = n_sprites = n_keys = 0;
+    max_states = n_states = 0;
+    ++generation;
+}
+
+int pvr_sprite_batch_state(const pvr_sprite_hdr_t *hdr) {
+    if(n_states >= max_states)
+        return -1;
+
+    states[n_states] = *hdr;
+    state_list[n_states] = (hdr->cmd & PVR_TA_CMD_TYPE_MASK) >>
+                           PVR_TA_CMD_TYPE_SHIFT;
+
+    return n_states++;
+}
+
+int pvr_sprite_batch_set_state(int state, const pvr_sprite_hdr_t *hdr) {
+    if(state < 0 || (uint32_t)state >= n_states)
+        return -1;
+
+    states[state] = *hdr;
+    state_list[state] = (hdr->cmd & PVR_TA_CMD_TYPE_MASK) >>
+                        PVR_TA_CMD_TYPE_SHIFT;
+
+    return 0;
+}
+
+uint32_t pvr_sprite_batch_generation(void) {
+    return generation;
+}
+
+void pvr_sprite_batch_clear_states(void) {
+    ++generation;
+    n_states = 0;
+    n_sprites = n_keys = 0;
+    sorted = true;
+}
+
+pvr_sprite_txr_t *pvr_sprite_batch_alloc(int state, uint8_t layer) {
+    pvr_sprite_txr_t *spr;
+
+    if(n_sprites >= max_sprites || state < 0 || (uint32_t)state >= n_states) {
+        ++stats.dropped;
+        return NULL;
+    }
+
+    keys[n_keys] = (state_list[state] << 24) | (layer << 16) | state;
+    idx[n_keys++] = n_sprites;
+    sorted = false;
+
+    spr = sprites + n_sprites++;
+    spr->flags = PVR_CMD_VERTEX_EOL;
+
+    return spr;
+}
+
+int pvr_sprite_batch_add(int state, uint8_t layer,
+                         const pvr_sprite_txr_t *spr) {
+    pvr_sprite_txr_t *dst = pvr_sprite_batch_alloc(state, layer);
+
+    if(!dst)
+        return -1;
+
+    *dst = *spr;
+    dst->flags = PVR_CMD_VERTEX_EOL;
+
+    return 0;
+}
+
+int pvr_sprite_batch_rect(int state, uint8_t layer, float x, float y,
+                          float w, float h, float z, float u0, float v0,
+                          float u1, float v1) {
+    pvr_sprite_txr_t *spr = pvr_sprite_batch_alloc(state, layer);
+
+    if(!spr)
+        return -1;
+
+    spr->ax = x;
+    spr->ay = y;
+    spr->az = z;
+    spr->bx = x + w;
+    spr->by = y;
+    spr->bz = z;
+    spr->cx = x + w;
+    spr->cy = y + h;
+    spr->cz = z;
+    spr->dx = x;
+    spr->dy = y + h;
+    spr->auv = PVR_PACK_16BIT_UV(u0, v0);
+    spr->buv = PVR_PACK_16BIT_UV(u1, v0);
+    spr->cuv = PVR_PACK_16BIT_UV(u1, v1);
+
+    return 0;
+}
+
+static void sort_keys(void) {
+    uint32_t *kt;
+    uint16_t *it;
+    uint32_t i, k, sum, c;
+    int d;
+
+    memset(hist, 0, sizeof(hist));
+
+    for(i = 0; i < n_keys; i++) {
+        k = keys[i];
+        hist[0][k & 0xff]++;
+        hist[1][(k >> 8) & 0xff]++;
+        hist[2][(k >> 16) & 0xff]++;
+        hist[3][k >> 24]++;
+    }
+
+    for(d = 0; d < 4; d++) {
+        /* Everything has the same digit here, so it's already in order. */
+        if(hist[d][(keys[0] >> (d * 8)) & 0xff] == n_keys)
+            continue;
+
+        for(i = 0, sum = 0; i < 256; i++) {
+            c = hist[d][i];
+            hist[d][i] = sum;
+            sum += c;
+        }
+
+        for(i = 0; i < n_keys; i++) {
+            k = keys[i];
+            c = hist[d][(k >> (d * 8)) & 0xff]++;
+            keys_tmp[c] = k;
+            idx_tmp[c] = idx[i];
+        }
+
+        kt = keys;
+        keys = keys_tmp;
+        keys_tmp = kt;
+        it = idx;
+        idx = idx_tmp;
+        idx_tmp = it;
+
+        ++stats.sort_passes;
+    }
+
+    sorted = true;
+}
+
+/* Copy 32 bytes to the TA through a store queue. */
+static inline void dr_send(pvr_dr_state_t *dr, const void *src) {
+    uint32_t *d = (uint32_t *)pvr_dr_target(*dr);
+    const uint32_t *s = (const uint32_t *)src;
+
+    d[0] = s[0];
+    d[1] = s[1];
+    d[2] = s[2];
+    d[3] = s[3];
+    d[4] = s[4];
+    d[5] = s[5];
+    d[6] = s[6];
+    d[7] = s[7];
+    pvr_dr_commit(d);
+}
+
+static void send_direct(uint32_t first, uint32_t end) {
+    pvr_dr_state_t dr;
+    const pvr_sprite_txr_t *spr;
+    uint32_t i, state = ~0;
+
+    pvr_dr_init(&dr);
+
+    for(i = first; i < end; i++) {
+        if((keys[i] & 0xffff) != state) {
+            state = keys[i] & 0xffff;
+            dr_send(&dr, states + state);
+            ++stats.headers;
+        }
+
+        spr = sprites + idx[i];
+
+        if(i + 1 < end)
+            __builtin_prefetch(sprites + idx[i + 1]);
+
+        dr_send(&dr, spr);
+        dr_send(&dr, (const uint8_t *)spr + 32);
+    }
+}
+
+/* While telemetry or a capture is running, go through pvr_prim() instead, so
+   that they see what's sent. */
+static void send_prim(uint32_t first, uint32_t end) {
+    uint32_t i, state = ~0;
+
+    for(i = first; i < end; i++) {
+        if((keys[i] & 0xffff) != state) {
+            state = keys[i] & 0xffff;
+            pvr_prim(states + state, sizeof(pvr_sprite_hdr_t));
+            ++stats.headers;
+        }
+
+        pvr_prim(sprites + idx[i], sizeof(pvr_sprite_txr_t));
+    }
+}
+
+static int send_dma(pvr_list_t list, uint32_t first, uint32_t end) {
+    uint8_t *dst;
+    uint32_t i, n, state;
+    size_t size;
+
+    for(i = first; i < end; ) {
+        state = keys[i] & 0xffff;
+
+        /* Up to DMA_CHUNK sprites of the same state, with their header */
+        for(n = 1; n < DMA_CHUNK && i + n < end; n++)
+            if((keys[i + n] & 0xffff) != state)
+                break;
+
+        size = sizeof(pvr_sprite_hdr_t) + n * sizeof(pvr_sprite_txr_t);
+
+        if(!(dst = pvr_list_reserve(list, size)))
+            return -1;
+
+        memcpy(dst, states + state, sizeof(pvr_sprite_hdr_t));
+        dst += sizeof(pvr_sprite_hdr_t);
+
+        for(; n; n--, i++, dst += sizeof(pvr_sprite_txr_t))
+            memcpy(dst, sprites + idx[i], sizeof(pvr_sprite_txr_t));
+
+        pvr_list_commit(list, size);
+        ++stats.headers;
+    }
+
+    return 0;
+}
+
+int pvr_sprite_batch_submit(pvr_list_t list) {
+    uint32_t first, end;
+    bool dma;
+    int rv = 0;
+
+    if(!n_keys || list >= PVR_OPB_COUNT)
+        return 0;
+
+    dma = pvr_state.dma_mode &&
+          pvr_state.dma_buffers[pvr_state.ram_target].base[list];
+
+    if(!dma && pvr_state.list_reg_open != (int)list)
+        return -1;
+
+    if(!sorted)
+        sort_keys();
+
+    /* Find this list's keys; they're all together, in list order. */
+    for(first = 0; first < n_keys; first++)
+        if((keys[first] >> 24) >= list)
+            break;
+
+    for(end = first; end < n_keys; end++)
+        if((keys[end] >> 24) != list)
+            break;
+
+    if(first == end)
+        return 0;
+
+    if(dma)
+        rv = send_dma(list, first, end);
+    else if(pvr_state.telemetry || pvr_state.capture)
+        send_prim(first, end);
+    else
+        send_direct(first, end);
+
+    stats.sprites += end - first;
+    pvr_batch_invalidate(list);
+
+    /* Cut them out; what's left is still in order. */
+    memmove(keys + first, keys + end, (n_keys - end) * sizeof(uint32_t));
+    memmove(idx + first, idx + end, (n_keys - end) * sizeof(uint16_t));
+    n_keys -= end - first;
+
+    return rv;
+}
+
+void pvr_sprite_batch_stats(pvr_sprite_batch_stats_t *st) {
+    *st = stats;
+}
+
+/* Called by pvr_scene_begin(): anything left over was for a list that was
+   already finished. */
+void pvr_int_sprite_batch_reset(void) {
+    n_sprites = n_keys = 0;
+    sorted = true;
+}
+
+/* Called by pvr_list_finish(), while the list can still be submitted to, and
+   by pvr_scene_finish() for lists with a DMA vertex buffer. */
+void pvr_int_sprite_batch_finish(pvr_list_t list) {
+    pvr_sprite_batch_submit(list);
+}
@@ -0,0 +1,466 @@
+/* KallistiOS ##version##
+
+   pvr_telemetry.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arch/irq.h>
+#include <arch/timer.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_telemetry.h>
+#include <kos/fs.h>
+#include <kos/regfield.h>
+#include "pvr_internal.h"
+
+/*
+
+   Frame records
+
+   Please see ../../include/dc/pvr/pvr_telemetry.h for more info on this API!
+
+   Frames are numbered as pvr_scene_begin() is called, and a frame's record
+   lives in slot (frame % count) of the ring. A frame is in up to three places
+   at once: being built, being registered by the TA, and being rendered, so
+   each of those has its own frame number here, and the interrupt handlers
+   fill in the record for whichever frame they're about. A record is complete
+   once the frame has been shown (or rendered, if it went to a texture), and
+   stays valid until its slot comes around again.
+
+*/
+
+static pvr_frame_record_t *recs;
+static uint32 rec_count;
+
+/* Frames being built, registered and rendered, and the last one done. */
+static uint32 build_frame, reg_frame, rnd_frame, done_frame;
+
+static uint32 vbl_since_flip;
+static size_t vram_last;
+
+/* Where we're up to in the stream for each list: how many bytes of the
+   current vertex or header are left, and how big vertices are. */
+static uint32 scan_skip[PVR_OPB_COUNT];
+static uint32 scan_vsize[PVR_OPB_COUNT];
+
+static inline pvr_frame_record_t *rec_get(uint32 frame) {
+    return recs + (frame % rec_count);
+}
+
+int pvr_telemetry_init(size_t frames) {
+    pvr_frame_record_t *r;
+    int o;
+
+    if(frames < 4) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pvr_telemetry_shutdown();
+
+    if(!(r = calloc(frames, sizeof(pvr_frame_record_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    o = irq_disable();
+    recs = r;
+    rec_count = frames;
+    build_frame = reg_frame = rnd_frame = done_frame = 0;
+    vbl_since_flip = 0;
+    vram_last = 0;
+    pvr_state.telemetry = 1;
+    irq_restore(o);
+
+    return 0;
+}
+
+void pvr_telemetry_shutdown(void) {
+    pvr_frame_record_t *r;
+    int o;
+
+    o = irq_disable();
+    pvr_state.telemetry = 0;
+    r = recs;
+    recs = NULL;
+    rec_count = 0;
+    irq_restore(o);
+
+    free(r);
+}
+
+size_t pvr_telemetry_read(pvr_frame_record_t *out, size_t max) {
+    uint32 first, f;
+    size_t n = 0;
+    int o;
+
+    o = irq_disable();
+
+    if(recs) {
+        /* The slot of the frame being built has already been reused. */
+        first = build_frame >= rec_count ? build_frame - rec_count + 1 : 1;
+
+        if(done_frame >= first && done_frame - first + 1 > max)
+            first = done_frame - max + 1;
+
+        for(f = first; f <= done_frame; ++f)
+            out[n++] = *rec_get(f);
+    }
+
+    irq_restore(o);
+
+    return n;
+}
+
+/* Count what's in a piece of a list's TA stream. This needs to know how big
+   each vertex is, which comes from the header before it; see the TA
+   parameter formats in the PVR documentation. */
+static void scan_stream(int list, const uint8 *data, size_t size,
+                        pvr_frame_record_t *r) {
+    uint32 cmd, n;
+    bool tex, twovol;
+    int col;
+
+    r->list_bytes[list] += size;
+
+    for(; size >= 32; data += 32, size -= 32) {
+        if(scan_skip[list]) {
+            scan_skip[list] -= 32;
+            continue;
+        }
+
+        cmd = *(const uint32 *)data;
+        n = 32;
+
+        switch(cmd >> 29) {
+            case 4:     /* Polygon or modifier volume header */
+                r->list_hdrs[list]++;
+
+                if(list == PVR_OPB_OM || list == PVR_OPB_TM) {
+                    scan_vsize[list] = 64;
+                    break;
+                }
+
+                tex = cmd & PVR_TA_CMD_TXRENABLE;
+                col = FIELD_GET(cmd, PVR_TA_CMD_CLRFMT);
+                twovol = (cmd & PVR_TA_CMD_MODIFIER) &&
+                         (cmd & PVR_TA_CMD_MODIFIERMODE);
+
+                /* Intensity with face colors that don't fit in 32 bytes */
+                if(col == 2 && (twovol || (cmd & PVR_TA_CMD_SPECULAR)))
+                    n = 64;
+
+                if(tex && (twovol || col == 1))
+                    scan_vsize[list] = 64;
+                else
+                    scan_vsize[list] = 32;
+
+                break;
+
+            case 5:     /* Sprite header */
+                r->list_hdrs[list]++;
+                scan_vsize[list] = 64;
+                break;
+
+            case 7:     /* Vertex */
+                if(cmd & BIT(28))
+                    r->list_prims[list]++;
+
+                n = scan_vsize[list] ? scan_vsize[list] : 32;
+                break;
+        }
+
+        scan_skip[list] = n - 32;
+    }
+}
+
+void pvr_int_telemetry_count(int list, const void *data, size_t size) {
+    if(recs)
+        scan_stream(list, data, size, rec_get(build_frame));
+}
+
+void pvr_int_telemetry_begin(void) {
+    pvr_frame_record_t *r;
+    size_t avail;
+    int o, i;
+
+    avail = pvr_mem_available();
+
+    o = irq_disable();
+
+    if(recs) {
+        r = rec_get(++build_frame);
+        memset(r, 0, sizeof(*r));
+        r->frame = build_frame;
+        r->begin = timer_ns_gettime64();
+        r->vram_free = avail;
+        r->vram_delta = vram_last ? (int32)(avail - vram_last) : 0;
+    }
+
+    irq_restore(o);
+
+    vram_last = avail;
+
+    for(i = 0; i < PVR_OPB_COUNT; i++)
+        scan_skip[i] = scan_vsize[i] = 0;
+}
+
+void pvr_int_telemetry_finish(void) {
+    volatile pvr_dma_buffers_t * b;
+    pvr_frame_record_t *r;
+    int i, j;
+
+    if(!recs)
+        return;
+
+    r = rec_get(build_frame);
+    r->finish = timer_ns_gettime64();
+
+    if(!pvr_state.dma_mode)
+        return;
+
+    /* Everything in the vertex buffers is counted in one go, here. */
+    b = pvr_state.dma_buffers + pvr_state.ram_target;
+
+    for(i = 0; i < PVR_OPB_COUNT; i++) {
+        if(!b->base[i])
+            continue;
+
+        scan_stream(i, b->base[i], b->ptr[i], r);
+
+        if(b->ext_ptr[i])
+            scan_stream(i, b->ext_base[i], b->ext_ptr[i], r);
+
+        for(j = 0; j < b->chain_count[i]; j++)
+            scan_stream(i, b->chain_base[i][j], b->chain_size[i][j], r);
+    }
+}
+
+void pvr_int_telemetry_stall(uint64 ns) {
+    if(recs)
+        rec_get(build_frame)->dma_stall += ns;
+}
+
+/* Called from pvr_sync_stats(), often in an interrupt. */
+void pvr_int_telemetry_sync(int event, uint64 t) {
+    pvr_frame_record_t *r;
+
+    if(!recs)
+        return;
+
+    switch(event) {
+        case PVR_SYNC_VBLANK:
+            vbl_since_flip++;
+            break;
+
+        case PVR_SYNC_REGSTART:
+            reg_frame = build_frame;
+            rec_get(reg_frame)->reg_start = t;
+            break;
+
+        case PVR_SYNC_REGDONE:
+            r = rec_get(reg_frame);
+            r->reg_end = t;
+            r->vtx_buf_used = pvr_state.vtx_buf_used;
+            break;
+
+        case PVR_SYNC_RNDSTART:
+            rnd_frame = reg_frame;
+            rec_get(rnd_frame)->rnd_start = t;
+            break;
+
+        case PVR_SYNC_RNDDONE:
+            rec_get(rnd_frame)->rnd_end = t;
+
+            /* There's no page flip to wait for. */
+            if(pvr_state.was_to_texture)
+                done_frame = rnd_frame;
+
+            break;
+
+        case PVR_SYNC_PAGEFLIP:
+            r = rec_get(rnd_frame);
+            r->flip = t;
+            r->vblanks = vbl_since_flip;
+            vbl_since_flip = 0;
+            done_frame = rnd_frame;
+            break;
+    }
+}
+
+/* Export */
+
+/* Times in the export are in microseconds, since the first frame began. */
+#define US(t, base)     ((t) ? (long long)(((t) - (base)) / 1000) : -1LL)
+
+static int write_str(file_t f, const char *str) {
+    size_t len = strlen(str);
+
+    return fs_write(f, str, len) == (ssize_t)len ? 0 : -1;
+}
+
+static int export_csv(file_t f, const pvr_frame_record_t *r, size_t n) {
+    char line[512];
+    uint64 base = r[0].begin;
+    size_t i;
+
+    if(write_str(f, "frame,vblanks,begin_us,finish_us,reg_start_us,"
+                 "reg_end_us,rnd_start_us,rnd_end_us,flip_us,dma_stall_us,"
+                 "op_bytes,om_bytes,tp_bytes,tm_bytes,pt_bytes,"
+                 "op_hdrs,om_hdrs,tp_hdrs,tm_hdrs,pt_hdrs,"
+                 "op_prims,om_prims,tp_prims,tm_prims,pt_prims,"
+                 "vtx_buf_used,vram_free,vram_delta\n"))
+        return -1;
+
+    for(i = 0; i < n; ++i, ++r) {
+        snprintf(line, sizeof(line),
+                 "%lu,%lu,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lu,"
+                 "%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,"
+                 "%lu,%lu,%lu,%lu,%lu,%lu,%lu,%ld\n",
+                 (unsigned long)r->frame, (unsigned long)r->vblanks,
+                 US(r->begin, base), US(r->finish, base),
+                 US(r->reg_start, base), US(r->reg_end, base),
+                 US(r->rnd_start, base), US(r->rnd_end, base),
+                 US(r->flip, base), (unsigned long)(r->dma_stall / 1000),
+                 (unsigned long)r->list_bytes[0], (unsigned long)r->list_bytes[1],
+                 (unsigned long)r->list_bytes[2], (unsigned long)r->list_bytes[3],
+                 (unsigned long)r->list_bytes[4],
+                 (unsigned long)r->list_hdrs[0], (unsigned long)r->list_hdrs[1],
+                 (unsigned long)r->list_hdrs[2], (unsigned long)r->list_hdrs[3],
+                 (unsigned long)r->list_hdrs[4],
+                 (unsigned long)r->list_prims[0], (unsigned long)r->list_prims[1],
+                 (unsigned long)r->list_prims[2], (unsigned long)r->list_prims[3],
+                 (unsigned long)r->list_prims[4],
+                 (unsigned long)r->vtx_buf_used, (unsigned long)r->vram_free,
+                 (long)r->vram_delta);
+
+        if(write_str(f, line))
+            return -1;
+    }
+
+    return 0;
+}
+
+/* One complete event ("X") on a track, if both ends of it happened. */
+static int trace_span(file_t f, const char *name, int tid, uint64 start,
+                      uint64 end, uint64 base, uint32 frame) {
+    char line[256];
+
+    if(!start || end < start)
+        return 0;
+
+    snprintf(line, sizeof(line),
+             ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+             "\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%lu}}",
+             name, tid, US(start, base), (long long)((end - start) / 1000),
+             (unsigned long)frame);
+
+    return write_str(f, line);
+}
+
+static int export_trace(file_t f, const pvr_frame_record_t *r, size_t n) {
+    static const char *const tracks[] = {
+        "SH4 scene", "TA registration", "Render", "Display"
+    };
+    char line[384];
+    uint64 base = r[0].begin;
+    size_t i;
+
+    if(write_str(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                 "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"args\":{\"name\":\"PVR\"}}"))
+        return -1;
+
+    for(i = 0; i < sizeof(tracks) / sizeof(tracks[0]); ++i) {
+        snprintf(line, sizeof(line),
+                 ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", (int)i + 1,
+                 tracks[i]);
+
+        if(write_str(f, line))
+            return -1;
+    }
+
+    for(i = 0; i < n; ++i, ++r) {
+        if(trace_span(f, "scene", 1, r->begin, r->finish, base, r->frame) ||
+           trace_span(f, "registration", 2, r->reg_start, r->reg_end, base,
+                      r->frame) ||
+           trace_span(f, "render", 3, r->rnd_start, r->rnd_end, base,
+                      r->frame))
+            return -1;
+
+        if(r->flip) {
+            snprintf(line, sizeof(line),
+                     ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+                     "\"tid\":4,\"ts\":%lld,\"args\":{\"frame\":%lu,"
+                     "\"vblanks\":%lu}}",
+                     r->vblanks > 1 ? "slip" : "flip", US(r->flip, base),
+                     (unsigned long)r->frame, (unsigned long)r->vblanks);
+
+            if(write_str(f, line))
+                return -1;
+        }
+
+        snprintf(line, sizeof(line),
+                 ",\n{\"name\":\"TA bytes\",\"ph\":\"C\",\"pid\":1,"
+                 "\"ts\":%lld,\"args\":{\"op\":%lu,\"om\":%lu,\"tp\":%lu,"
+                 "\"tm\":%lu,\"pt\":%lu}}"
+                 ",\n{\"name\":\"DMA stall us\",\"ph\":\"C\",\"pid\":1,"
+                 "\"ts\":%lld,\"args\":{\"stall\":%lu}}"
+                 ",\n{\"name\":\"VRAM free\",\"ph\":\"C\",\"pid\":1,"
+                 "\"ts\":%lld,\"args\":{\"free\":%lu}}",
+                 US(r->begin, base), (unsigned long)r->list_bytes[0],
+                 (unsigned long)r->list_bytes[1], (unsigned long)r->list_bytes[2],
+                 (unsigned long)r->list_bytes[3], (unsigned long)r->list_bytes[4],
+                 US(r->begin, base), (unsigned long)(r->dma_stall / 1000),
+                 US(r->begin, base), (unsigned long)r->vram_free);
+
+        if(write_str(f, line))
+            return -1;
+    }
+
+    return write_str(f, "\n]}\n");
+}
+
+int pvr_telemetry_export(const char *fn, int format) {
+    pvr_frame_record_t *r;
+    size_t n;
+    file_t f;
+    int rv;
+
+    if(!rec_count)
+        return -1;
+
+    if(!(r = malloc(rec_count * sizeof(pvr_frame_record_t))))
+        return -1;
+
+    if(!(n = pvr_telemetry_read(r, rec_count))) {
+        free(r);
+        return -1;
+    }
+
+    f = fs_open(fn, O_WRONLY | O_CREAT | O_TRUNC);
+
+    if(f < 0) {
+        dbglog(DBG_ERROR, "pvr_telemetry_export: can't open '%s'\n", fn);
+        free(r);
+        return -1;
+    }
+
+    if(format == PVR_TELEMETRY_TRACE)
+        rv = export_trace(f, r, n);
+    else
+        rv = export_csv(f, r, n);
+
+    if(rv)
+        dbglog(DBG_ERROR, "pvr_telemetry_export: error writing '%s'\n", fn);
+
+    fs_close(f);
+    free(r);
+
+    return rv;
+}
@@ -8,7 +8,10 @@
 #include <assert.h>
 #include <dc/pvr.h>
 #include <dc/sq.h>
+#include <arch/cache.h>
+#include <stdlib.h>
 #include <string.h>
+#include <malloc.h>
 #include "pvr_internal.h"
 
 /*
@@ -35,111 +38,404 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32 count) {
 
 #define MIN(a, b) ( (a)<(b)? (a):(b) )
 
+/*
+   Twiddled textures are stored in Morton order: the bits of the x and y
+   coordinates of a texel are interleaved (with y in the lowest bit) to get its
+   index in the texture. Rectangular textures are stored as a row (or column)
+   of square ones, one after another.
+
+   The loader works on tiles of 8x8 texels. Within each square, the tiles are
+   themselves in Morton order, and each one is a contiguous 32, 64 or 128 bytes
+   of the output. So a tile can be gathered from the source image and written
+   straight out to VRAM through the store queues 32 bytes at a time, without
+   ever working out where an individual texel goes. The order of the 2x2 texel
+   quads within a tile only depends on the pitch of the source image, so that
+   part is done once per texture, up front.
+
+   Textures too small to hold a whole tile (which only happens for the index
+   data of tiny VQ textures) go through the old texel-at-a-time code instead.
+*/
+
+/* Source formats the tile loader knows about. The 32bpp ones are converted
+   down to the named 16bpp format on the way through. */
+#define TW_4BPP     0
+#define TW_8BPP     1
+#define TW_16BPP    2
+#define TW_4444     3
+#define TW_1555     4
+#define TW_565      5
+
+/* Undo TWIDTAB: gather the even bits of x into the low half. */
+static inline uint32 twid_compact(uint32 x) {
+    x &= 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0f0f0f0f;
+    x = (x | (x >> 4)) & 0x00ff00ff;
+    x = (x | (x >> 8)) & 0x0000ffff;
+    return x;
+}
+
+/* Source bits per texel for each format */
+static inline int twid_src_bpp(int fmt) {
+    switch(fmt) {
+        case TW_4BPP:
+            return 4;
+        case TW_8BPP:
+            return 8;
+        case TW_16BPP:
+            return 16;
+        default:
+            return 32;
+    }
+}
+
+static inline uint32 twid_conv(uint32 p, int fmt) {
+    switch(fmt) {
+        case TW_4444:
+            return ((p >> 16) & 0xf000) | ((p >> 12) & 0x0f00) |
+                   ((p >> 8) & 0x00f0) | ((p >> 4) & 0x000f);
+        case TW_1555:
+            return ((p >> 16) & 0x8000) | ((p >> 9) & 0x7c00) |
+                   ((p >> 6) & 0x03e0) | ((p >> 3) & 0x001f);
+        default:
+            return ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) |
+                   ((p >> 3) & 0x001f);
+    }
+}
+
+/* Twiddle one 8x8 tile from s into the store queue at d. qoff holds the
+   offsets of the 16 quads of the tile, in output order. Since fmt is always a
+   constant, each caller ends up with its own copy of the loop. */
+static __always_inline uint32 *twid_tile(uint32 *d, const uint8 *s,
+                                         int32 pitch, const int32 *qoff,
+                                         int fmt) {
+    const uint8 *q;
+    uint32 a, b;
+    int i, j;
+
+    switch(fmt) {
+        case TW_4BPP:
+            /* 16 quads, each one 16 bits: one store queue's worth */
+            for(j = 0; j < 8; j++) {
+                q = s + qoff[j * 2];
+                a = q[0] | (q[pitch] << 8);
+                q = s + qoff[j * 2 + 1];
+                b = q[0] | (q[pitch] << 8);
+                a = (a & 0x0f) | ((a >> 4) & 0xf0) | ((a << 4) & 0xf00) |
+                    (a & 0xf000);
+                b = (b & 0x0f) | ((b >> 4) & 0xf0) | ((b << 4) & 0xf00) |
+                    (b & 0xf000);
+                d[j] = a | (b << 16);
+            }
+
+            sq_flush(d);
+            d += 8;
+            break;
+
+        case TW_8BPP:
+            /* 16 quads, each one 32 bits */
+            for(i = 0; i < 16; i += 8) {
+                for(j = 0; j < 8; j++) {
+                    q = s + qoff[i + j];
+                    d[j] = q[0] | (q[pitch] << 8) | (q[1] << 16) |
+                           ((uint32)q[pitch + 1] << 24);
+                }
+
+                sq_flush(d);
+                d += 8;
+            }
+            break;
+
+        case TW_16BPP:
+            /* 16 quads, each one 64 bits */
+            for(i = 0; i < 16; i += 4) {
+                for(j = 0; j < 4; j++) {
+                    q = s + qoff[i + j];
+                    d[j * 2] = *(const uint16 *)q |
+                               ((uint32)*(const uint16 *)(q + pitch) << 16);
+                    d[j * 2 + 1] = *(const uint16 *)(q + 2) |
+                                   ((uint32)*(const uint16 *)(q + pitch + 2) << 16);
+                }
+
+                sq_flush(d);
+                d += 8;
+            }
+            break;
+
+        default:
+            for(i = 0; i < 16; i += 4) {
+                for(j = 0; j < 4; j++) {
+                    q = s + qoff[i + j];
+                    d[j * 2] = twid_conv(*(const uint32 *)q, fmt) |
+                               (twid_conv(*(const uint32 *)(q + pitch), fmt) << 16);
+                    d[j * 2 + 1] = twid_conv(*(const uint32 *)(q + 4), fmt) |
+                                   (twid_conv(*(const uint32 *)(q + pitch + 4), fmt) << 16);
+                }
+
+                sq_flush(d);
+                d += 8;
+            }
+            break;
+    }
+
+    return d;
+}
+
+/* Twiddle a whole texture (w and h both at least 8) into VRAM. src points at
+   the first row to be loaded, and pitch is the distance between rows in bytes
+   (negative to flip the texture over). */
+static __always_inline void twid_load(const uint8 *src, pvr_ptr_t dst,
+                                      uint32 w, uint32 h, int32 pitch,
+                                      int fmt) {
+    uint32 min, blocks, tiles, b, t, sbpp, tbytes, left;
+    int32 qoff[16], boff;
+    const uint8 *bsrc, *s;
+    uintptr_t dest;
+    uint32 *d;
+
+    sbpp = twid_src_bpp(fmt);
+    tbytes = (sbpp == 32 ? 16 : sbpp) * 64 / 8;
+
+    /* Work out where each quad of a tile comes from in the source */
+    for(t = 0; t < 16; t++)
+        qoff[t] = (int32)(twid_compact(t) * 2) * pitch +
+                  (int32)(twid_compact(t >> 1) * 2 * sbpp / 8);
+
+    min = MIN(w, h);
+    blocks = (w > h ? w : h) / min;
+    tiles = (min / 8) * (min / 8);
+
+    /* Each square block is one step along x or y in the source */
+    if(w > h)
+        boff = (int32)(min * sbpp / 8);
+    else
+        boff = (int32)min * pitch;
+
+    dest = ((uintptr_t)dst & 0xffffff) | PVR_TA_TEX_MEM;
+    d = sq_lock((void *)dest);
+    left = 0x8000;
+
+    for(b = 0, bsrc = src; b < blocks; b++, bsrc += boff) {
+        for(t = 0; t < tiles; t++) {
+            /* Don't go more than 1MiB without relocking, as sq_cpy() does */
+            if(left < tbytes / 32) {
+                sq_unlock();
+                d = sq_lock((void *)dest);
+                left = 0x8000;
+            }
+
+            s = bsrc + (int32)(twid_compact(t) * 8) * pitch +
+                (int32)(twid_compact(t >> 1) * 8 * sbpp / 8);
+            d = twid_tile(d, s, pitch, qoff, fmt);
+            dest += tbytes;
+            left -= tbytes / 32;
+        }
+    }
+
+    sq_unlock();
+}
+
+/* The old way of doing it, a texel (or two) at a time, for textures that are
+   smaller than a tile in either direction. */
+static void twid_load_slow(const uint8 *src, pvr_ptr_t dst, uint32 w,
+                           uint32 h, int32 pitch, int fmt) {
+    uint32 x, y, min, mask, blk;
+    const uint8 *r0, *r1;
+    uint16 *vtex = (uint16 *)dst;
+
+    min = MIN(w, h);
+    mask = min - 1;
+
+#define TWID(xx, yy) (TWIDOUT((xx) & mask, (yy) & mask) + blk)
+
+    for(y = 0; y < h; y += 2) {
+        r0 = src + (int32)y * pitch;
+        r1 = r0 + pitch;
+
+        for(x = 0; x < w; x += 2) {
+            blk = (x / min + y / min) * min * min;
+
+            switch(fmt) {
+                case TW_4BPP:
+                    vtex[TWID(x, y) / 4] =
+                        (r0[x / 2] & 15) | ((r1[x / 2] & 15) << 4) |
+                        ((r0[x / 2] >> 4) << 8) | ((r1[x / 2] >> 4) << 12);
+                    break;
+
+                case TW_8BPP:
+                    vtex[TWID(x, y) / 2] = r0[x] | (r1[x] << 8);
+                    vtex[TWID(x + 1, y) / 2] = r0[x + 1] | (r1[x + 1] << 8);
+                    break;
+
+                case TW_16BPP:
+                    vtex[TWID(x, y)] = ((const uint16 *)r0)[x];
+                    vtex[TWID(x + 1, y)] = ((const uint16 *)r0)[x + 1];
+                    vtex[TWID(x, y + 1)] = ((const uint16 *)r1)[x];
+                    vtex[TWID(x + 1, y + 1)] = ((const uint16 *)r1)[x + 1];
+                    break;
+
+                default:
+                    vtex[TWID(x, y)] = twid_conv(((const uint32 *)r0)[x], fmt);
+                    vtex[TWID(x + 1, y)] = twid_conv(((const uint32 *)r0)[x + 1], fmt);
+                    vtex[TWID(x, y + 1)] = twid_conv(((const uint32 *)r1)[x], fmt);
+                    vtex[TWID(x + 1, y + 1)] = twid_conv(((const uint32 *)r1)[x + 1], fmt);
+                    break;
+            }
+        }
+    }
+
+#undef TWID
+}
+
+static void twid_dispatch(const void *src, pvr_ptr_t dst, uint32 w, uint32 h,
+                          int invert, int fmt) {
+    const uint8 *s = (const uint8 *)src;
+    int32 pitch;
+
+    pitch = (int32)(w * twid_src_bpp(fmt) / 8);
+
+    /* Flipping it over is just a matter of walking the rows backwards */
+    if(invert) {
+        s += (h - 1) * pitch;
+        pitch = -pitch;
+    }
+
+    if(w < 8 || h < 8) {
+        twid_load_slow(s, dst, w, h, pitch, fmt);
+        return;
+    }
+
+    switch(fmt) {
+        case TW_4BPP:
+            twid_load(s, dst, w, h, pitch, TW_4BPP);
+            break;
+        case TW_8BPP:
+            twid_load(s, dst, w, h, pitch, TW_8BPP);
+            break;
+        case TW_16BPP:
+            twid_load(s, dst, w, h, pitch, TW_16BPP);
+            break;
+        case TW_4444:
+            twid_load(s, dst, w, h, pitch, TW_4444);
+            break;
+        case TW_1555:
+            twid_load(s, dst, w, h, pitch, TW_1555);
+            break;
+        default:
+            twid_load(s, dst, w, h, pitch, TW_565);
+            break;
+    }
+}
+
+/* Compress a texture and load it. The encoder works in main RAM, so the
+   whole thing has to be staged there first. */
+static void txr_load_vq(const void *src, pvr_ptr_t dst, uint32 w, uint32 h,
+                        uint32 flags) {
+    size_t size, whole;
+    const uint16 *s;
+    uint16 *d;
+    void *buf;
+
+    size = pvr_txr_vq_size(w, h, flags & PVR_TXRLOAD_VQ_MIPMAP);
+
+    if(!(buf = memalign(32, size))) {
+        dbglog(DBG_ERROR, "pvr_txr_load_ex: out of memory for VQ encoding\n");
+        return;
+    }
+
+    if(pvr_txr_vq_encode(src, buf, w, h, flags, 0) < 0) {
+        dbglog(DBG_ERROR, "pvr_txr_load_ex: can't VQ encode %lux%lu texture\n",
+               w, h);
+        free(buf);
+        return;
+    }
+
+    /* The size is always even, but with mipmaps it's not a multiple of 32, so
+       the end has to be done by hand. */
+    whole = size & ~31;
+    pvr_txr_load(buf, dst, whole);
+
+    s = (const uint16 *)((uint8 *)buf + whole);
+    d = (uint16 *)((uint8 *)dst + whole);
+
+    for(size = (size - whole) / 2; size; size--)
+        *d++ = *s++;
+
+    free(buf);
+}
+
 /*
    Load texture data from an SH-4 buffer into PVR RAM, twiddling it
    in the process.
 
-   This is a modified version of Vincent Penne's general twiddling
-   function. The texture can be 16bpp, 8bpp, or 4bpp (i.e., paletted).
-   The rectangle does not need to be a square (not tested with h>w, but
-   this is just a matter of a rotation by PI/2 and UV swapping).
+   The texture can be 16bpp, 8bpp, or 4bpp (i.e., paletted), or 32bpp ARGB8888
+   which is converted to one of the 16bpp formats along the way. It can also
+   be a VQ texture with a linear (not yet twiddled) index map, in which case
+   the codebook is copied as-is and the index map is twiddled.
+   The rectangle does not need to be a square.
 
    - w and h must be a power of 2
    - flags must be a logical OR of the various texture loading
      flags available:
-       PVR_TXRLOAD_4BPP, _8BPP, _16BPP, _32BPP (not supported yet)
-       PVR_TXRLOAD_VQ (not supported yet)
-       PVR_TXRLOAD_INVERT
+       PVR_TXRLOAD_4BPP, _8BPP, _16BPP*, _32BPP*
+       PVR_TXRLOAD_FMT_VQ
+       PVR_TXRLOAD_VQ_LOAD, PVR_TXRLOAD_VQ_MIPMAP
+       PVR_TXRLOAD_INVERT_Y
 
 */
 void pvr_txr_load_ex(const void *src, pvr_ptr_t dst, uint32 w, uint32 h,
                      uint32 flags) {
-    uint32 x, y, yout, min, mask, bpp, invert;
+    int fmt, invert;
 
     /* Make sure we're attempting something we can do */
     switch(flags & PVR_TXRLOAD_FMT_MASK) {
         case PVR_TXRLOAD_4BPP:
-            bpp = 4;
+            fmt = TW_4BPP;
             break;
         case PVR_TXRLOAD_8BPP:
-            bpp = 8;
+            fmt = TW_8BPP;
             break;
         case PVR_TXRLOAD_16BPP:
-            bpp = 16;
+        case PVR_TXRLOAD_16BPP_RGB565:
+        case PVR_TXRLOAD_16BPP_ARGB1555:
+        case PVR_TXRLOAD_16BPP_ARGB4444:
+            fmt = TW_16BPP;
+            break;
+        case PVR_TXRLOAD_32BPP_ARGB4444:
+            fmt = TW_4444;
+            break;
+        case PVR_TXRLOAD_32BPP_ARGB1555:
+            fmt = TW_1555;
+            break;
+        case PVR_TXRLOAD_32BPP_RGB565:
+            fmt = TW_565;
             break;
         default:
             assert_msg(0, "Invalid format specifier in `flags'");
-            bpp = 8;
+            fmt = TW_8BPP;
     }
 
-    assert_msg(!(flags & PVR_TXRLOAD_VQ_LOAD), "VQ compression on the fly not supported yet");
     invert = (flags & PVR_TXRLOAD_INVERT_Y) ? 1 : 0;
 
-    min = MIN(w, h);
-    mask = min - 1;
+    if(flags & PVR_TXRLOAD_VQ_LOAD) {
+        assert_msg(fmt != TW_4BPP && fmt != TW_8BPP,
+                   "VQ compression of paletted textures not supported");
+        txr_load_vq(src, dst, w, h, flags);
+        return;
+    }
 
-    switch(bpp) {
-        case 4: {
-            uint8 * pixels;
-            uint16 * vtex;
-            pixels = (uint8 *) src;
-            vtex = (uint16*)dst;
-
-            for(y = 0; y < h; y += 2) {
-                if(!invert)
-                    yout = y;
-                else
-                    yout = ((h - 1) - y);
-
-                for(x = 0; x < w; x += 2) {
-                    vtex[TWIDOUT((x & mask) / 2, (yout & mask) / 2) +
-                         (x / min + yout / min)*min * min / 4] =
-                             (pixels[(x + y * w) >> 1] & 15) | ((pixels[(x + (y + 1) * w) >> 1] & 15) << 4) |
-                             ((pixels[(x + y * w) >> 1] >> 4) << 8) | ((pixels[(x + (y + 1) * w) >> 1] >> 4) << 12);
-                }
-            }
-        }
-        break;
-        case 8: {
-            uint8 * pixels;
-            uint16 * vtex;
-            pixels = (uint8 *) src;
-            vtex = (uint16*)dst;
-
-            for(y = 0; y < h; y += 2) {
-                if(!invert)
-                    yout = y;
-                else
-                    yout = ((h - 1) - y);
-
-                for(x = 0; x < w; x++) {
-                    vtex[TWIDOUT((yout & mask) / 2, x & mask) +
-                         (x / min + yout / min)*min * min / 2] =
-                             pixels[y * w + x] | (pixels[(y + 1) * w + x] << 8);
-                }
-            }
-        }
-        break;
-        case 16: {
-            uint16 * pixels;
-            uint16 * vtex;
-            pixels = (uint16 *) src;
-            vtex = (uint16*)dst;
-
-            for(y = 0; y < h; y++) {
-                if(!invert)
-                    yout = y;
-                else
-                    yout = ((h - 1) - y);
-
-                for(x = 0; x < w; x++) {
-                    vtex[TWIDOUT(x & mask, yout & mask) +
-                         (x / min + yout / min)*min * min] = pixels[y * w + x];
-                }
-            }
-        }
-        break;
+    if(flags & PVR_TXRLOAD_FMT_VQ) {
+        /* The codebook goes in unchanged, and then the index map is an 8bpp
+           texture of its own, a quarter of the size. The 2x2 blocks in the
+           codebook can't be flipped over, so neither can the texture. */
+        assert_msg(!invert, "Inverted VQ loading not supported");
+        pvr_txr_load(src, dst, 2048);
+        twid_dispatch((const uint8 *)src + 2048, (pvr_ptr_t)((uint8 *)dst + 2048),
+                      w / 2, h / 2, 0, TW_8BPP);
+        return;
     }
+
+    twid_dispatch(src, dst, w, h, invert, fmt);
 }
 
 /* Load a KOS Platform Independent Image (subject to restraint checking) */
@@ -150,6 +446,7 @@ void pvr_txr_load_kimg(const kos_img_t *img, pvr_ptr_t dst, uint32 flags) {
     fmt = KOS_IMG_FMT_I(img->fmt) & KOS_IMG_FMT_MASK;
     assert_msg(fmt == KOS_IMG_FMT_RGB565 || fmt == KOS_IMG_FMT_ARGB4444
                || fmt == KOS_IMG_FMT_ARGB1555
+               || fmt == KOS_IMG_FMT_ARGB8888
                || fmt == KOS_IMG_FMT_PAL4BPP
                || fmt == KOS_IMG_FMT_PAL8BPP, "Unsupported format in input kos_img_t");
 
@@ -164,9 +461,16 @@ void pvr_txr_load_kimg(const kos_img_t *img, pvr_ptr_t dst, uint32 flags) {
     /* Convert it to a PVR image type */
     switch(fmt) {
         case KOS_IMG_FMT_RGB565:
+            fmt = PVR_TXRLOAD_16BPP_RGB565;
+            break;
         case KOS_IMG_FMT_ARGB4444:
+            fmt = PVR_TXRLOAD_16BPP_ARGB4444;
+            break;
         case KOS_IMG_FMT_ARGB1555:
-            fmt = PVR_TXRLOAD_16BPP;
+            fmt = PVR_TXRLOAD_16BPP_ARGB1555;
+            break;
+        case KOS_IMG_FMT_ARGB8888:
+            fmt = PVR_TXRLOAD_32BPP_ARGB4444;
             break;
         case KOS_IMG_FMT_PAL4BPP:
             fmt = PVR_TXRLOAD_4BPP;
@@ -185,6 +489,8 @@ void pvr_txr_load_kimg(const kos_img_t *img, pvr_ptr_t dst, uint32 flags) {
             (KOS_IMG_FMT_D(img->fmt) & PVR_TXRLOAD_FMT_TWIDDLED)) {
         if(flags & PVR_TXRLOAD_INVERT_Y)
             assert_msg(0, "Inverted, non-twiddled loading not supported yet");
+        else if(fmt == PVR_TXRLOAD_32BPP_ARGB4444)
+            assert_msg(0, "32bpp images must be twiddled while loading");
         else {
             /* We only enable DMA here for now since it sort of changes things
                to have to allocate an intermediary buffer. */
@@ -0,0 +1,373 @@
+/* KallistiOS ##version##
+
+   pvr_tnl.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_tnl.h>
+#include <dc/matrix.h>
+#include <dc/sq.h>
+#include "pvr_internal.h"
+
+/*
+
+   Transform and clip
+
+   Please see ../../include/dc/pvr/pvr_tnl.h for more info on this API!
+
+   Each strip is transformed once without the divide to find its outcodes.
+   Whole strips that can be accepted are then sent through mat_transform_sq(),
+   which is as fast as it gets. The rest are walked a triangle at a time in C,
+   which is much slower, but only ever happens to the few strips that are
+   crossing the near plane.
+
+   Triangles that don't need clipping are put back together into strips as
+   they come. Since a strip's odd triangles are wound the other way, a strip
+   that has to be restarted on an odd triangle starts with a repeated vertex,
+   which keeps the winding (and so culling) right.
+
+*/
+
+/* Vertices sent through mat_transform_sq() at once. This keeps the store
+   queue address within the TA's input area, and reservations in the DMA
+   buffers small. */
+#define TNL_CHUNK   64
+
+/* Vertices built up by the clipping path before being sent. */
+#define TNL_BATCH   32
+
+/* A vertex after transformation, before the divide. */
+typedef struct {
+    float x, y, z, w;
+    float u, v;
+    uint32 argb, oargb;
+    uint32 code;
+} tnl_vert_t;
+
+typedef struct {
+    pvr_vertex_t buf[TNL_BATCH];
+    int n;
+    bool open;              /* Is the last vertex in buf in an unfinished strip? */
+    int err;
+} tnl_out_t;
+
+static float vp_x0, vp_y0, vp_x1, vp_y1;
+static float near_w = 0.01f;
+static pvr_tnl_stats_t stats;
+
+static tnl_out_t tnl_out __attribute__((aligned(32)));
+static pvr_vertex_t tnl_bounce[TNL_CHUNK] __attribute__((aligned(32)));
+
+/* Where this call's vertices are going. */
+static pvr_list_t tnl_list;
+static bool tnl_dma;
+
+void pvr_tnl_set_viewport(float x0, float y0, float x1, float y1) {
+    vp_x0 = x0;
+    vp_y0 = y0;
+    vp_x1 = x1;
+    vp_y1 = y1;
+}
+
+void pvr_tnl_set_near(float w) {
+    assert(w > 0.0f);
+    near_w = w;
+}
+
+void pvr_tnl_get_stats(pvr_tnl_stats_t *out) {
+    *out = stats;
+}
+
+void pvr_tnl_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void pvr_int_tnl_reset(void) {
+    pvr_tnl_reset_stats();
+    pvr_tnl_set_viewport(0.0f, 0.0f, pvr_state.w, pvr_state.h);
+}
+
+/* Send finished vertices to the list. */
+static int tnl_emit(const pvr_vertex_t *v, int n) {
+    void *dst;
+
+    if(tnl_dma) {
+        if(!(dst = pvr_list_reserve(tnl_list, n * 32)))
+            return -1;
+
+        memcpy(dst, v, n * 32);
+        pvr_list_commit(tnl_list, n * 32);
+    }
+    else {
+        pvr_prim(v, n * 32);
+    }
+
+    stats.vertices_out += n;
+    return 0;
+}
+
+/* Transform and send a strip that needs no clipping. */
+static int tnl_emit_strip(const pvr_vertex_t *v, int n) {
+    pvr_vertex_t *dst;
+    int c;
+
+    for(; n > 0; n -= c, v += c) {
+        c = n > TNL_CHUNK ? TNL_CHUNK : n;
+
+        if(tnl_dma) {
+            if(!(dst = pvr_list_reserve(tnl_list, c * 32)))
+                return -1;
+
+            mat_transform_sq((void *)v, dst, c);
+            pvr_list_commit(tnl_list, c * 32);
+        }
+        else if(pvr_state.telemetry || pvr_state.capture) {
+            /* Data that goes straight to the TA isn't seen by frame records
+               or captures, so go through pvr_prim() while they're on. */
+            mat_transform_sq((void *)v, tnl_bounce, c);
+            pvr_prim(tnl_bounce, c * 32);
+        }
+        else {
+            mat_transform_sq((void *)v, SQ_MASK_DEST(PVR_TA_INPUT), c);
+        }
+
+        stats.vertices_out += c;
+    }
+
+    return 0;
+}
+
+static inline void tnl_transform(const pvr_vertex_t *in, tnl_vert_t *out) {
+    float x = in->x, y = in->y, z = in->z, w = 1.0f;
+    uint32 c = 0;
+
+    mat_trans_nodiv(x, y, z, w);
+
+    if(w < near_w)
+        c |= PVR_TNL_NEAR;
+
+    /* These are in homogeneous space, so they hold even behind the camera. */
+    if(x < vp_x0 * w)
+        c |= PVR_TNL_LEFT;
+    else if(x > vp_x1 * w)
+        c |= PVR_TNL_RIGHT;
+
+    if(y < vp_y0 * w)
+        c |= PVR_TNL_TOP;
+    else if(y > vp_y1 * w)
+        c |= PVR_TNL_BOTTOM;
+
+    out->x = x;
+    out->y = y;
+    out->z = z;
+    out->w = w;
+    out->code = c;
+}
+
+/* Add a vertex to the strip being built by the clipping path. */
+static void out_vert(tnl_out_t *o, const tnl_vert_t *t) {
+    pvr_vertex_t *v;
+    float iw;
+
+    /* Keep the last vertex back, as it might turn out to end the strip. */
+    if(o->n == TNL_BATCH) {
+        o->err |= tnl_emit(o->buf, TNL_BATCH - 1);
+        o->buf[0] = o->buf[TNL_BATCH - 1];
+        o->n = 1;
+    }
+
+    v = o->buf + o->n++;
+    iw = 1.0f / t->w;
+    v->flags = PVR_CMD_VERTEX;
+    v->x = t->x * iw;
+    v->y = t->y * iw;
+    v->z = iw;
+    v->u = t->u;
+    v->v = t->v;
+    v->argb = t->argb;
+    v->oargb = t->oargb;
+    o->open = true;
+}
+
+static void out_end(tnl_out_t *o) {
+    if(o->open) {
+        o->buf[o->n - 1].flags = PVR_CMD_VERTEX_EOL;
+        o->open = false;
+    }
+}
+
+static uint32 lerp_color(uint32 a, uint32 b, float t) {
+    uint32 rv = 0;
+    int s, ca, cb;
+
+    for(s = 0; s < 32; s += 8) {
+        ca = (a >> s) & 0xff;
+        cb = (b >> s) & 0xff;
+        rv |= (uint32)(ca + (int)((cb - ca) * t)) << s;
+    }
+
+    return rv;
+}
+
+/* Clip one triangle against the near plane, and send what's left as a strip
+   of its own. */
+static void clip_tri(tnl_out_t *o, const tnl_vert_t *a, const tnl_vert_t *b,
+                     const tnl_vert_t *c) {
+    const tnl_vert_t *in[3] = { a, b, c };
+    const tnl_vert_t *p, *q;
+    tnl_vert_t out[4];
+    int i, m = 0;
+    bool pin, qin;
+    float t;
+
+    for(i = 0; i < 3; i++) {
+        p = in[i];
+        q = in[(i + 1) % 3];
+        pin = !(p->code & PVR_TNL_NEAR);
+        qin = !(q->code & PVR_TNL_NEAR);
+
+        if(pin)
+            out[m++] = *p;
+
+        if(pin != qin) {
+            t = (near_w - p->w) / (q->w - p->w);
+            out[m].x = p->x + (q->x - p->x) * t;
+            out[m].y = p->y + (q->y - p->y) * t;
+            out[m].z = p->z + (q->z - p->z) * t;
+            out[m].w = near_w;
+            out[m].u = p->u + (q->u - p->u) * t;
+            out[m].v = p->v + (q->v - p->v) * t;
+            out[m].argb = lerp_color(p->argb, q->argb, t);
+            out[m].oargb = lerp_color(p->oargb, q->oargb, t);
+            m++;
+        }
+    }
+
+    /* A triangle stays a triangle, or becomes a quad, which goes in as a
+       strip in the order 0, 1, 3, 2. */
+    out_vert(o, out);
+    out_vert(o, out + 1);
+
+    if(m == 4)
+        out_vert(o, out + 3);
+
+    out_vert(o, out + 2);
+    out_end(o);
+    stats.tris_clipped++;
+}
+
+/* Take a strip that crosses the near plane a triangle at a time. */
+static int tnl_split_strip(const pvr_vertex_t *v, int n) {
+    tnl_out_t *o = &tnl_out;
+    tnl_vert_t r[3];
+    const tnl_vert_t *a, *b, *c;
+    int i, t;
+
+    o->n = 0;
+    o->open = false;
+    o->err = 0;
+
+    for(i = 0; i < n; i++) {
+        c = r + (i % 3);
+        tnl_transform(v + i, r + (i % 3));
+        r[i % 3].u = v[i].u;
+        r[i % 3].v = v[i].v;
+        r[i % 3].argb = v[i].argb;
+        r[i % 3].oargb = v[i].oargb;
+
+        if(i < 2)
+            continue;
+
+        a = r + ((i - 2) % 3);
+        b = r + ((i - 1) % 3);
+        t = i - 2;
+
+        if(a->code & b->code & c->code) {
+            out_end(o);
+            stats.tris_rejected++;
+        }
+        else if(!((a->code | b->code | c->code) & PVR_TNL_NEAR)) {
+            if(!o->open) {
+                if(t & 1)
+                    out_vert(o, a);
+
+                out_vert(o, a);
+                out_vert(o, b);
+            }
+
+            out_vert(o, c);
+        }
+        else {
+            out_end(o);
+
+            /* Odd triangles are wound the other way. */
+            if(t & 1)
+                clip_tri(o, b, a, c);
+            else
+                clip_tri(o, a, b, c);
+        }
+    }
+
+    out_end(o);
+
+    if(o->n)
+        o->err |= tnl_emit(o->buf, o->n);
+
+    return o->err ? -1 : 0;
+}
+
+int pvr_tnl_submit(pvr_list_t list, const pvr_vertex_t *verts, size_t count) {
+    tnl_vert_t t;
+    uint32 and_code, or_code;
+    size_t i, j, end;
+    int n, rv = 0;
+
+    assert(list < PVR_OPB_COUNT);
+    assert(!((uintptr_t)verts & 3));
+
+    tnl_list = list;
+    tnl_dma = pvr_state.dma_mode &&
+              pvr_state.dma_buffers[pvr_state.ram_target].base[list];
+
+    if(!tnl_dma && pvr_state.list_reg_open != (int)list) {
+        dbglog(DBG_WARNING, "pvr_tnl_submit: list %u is not open\n",
+               (unsigned)list);
+        return -1;
+    }
+
+    stats.vertices_in += count;
+
+    for(i = 0; i < count && !rv; i = end + 1) {
+        for(end = i; end < count - 1; end++)
+            if(verts[end].flags == PVR_CMD_VERTEX_EOL)
+                break;
+
+        n = end - i + 1;
+        and_code = ~0;
+        or_code = 0;
+
+        for(j = i; j <= end; j++) {
+            tnl_transform(verts + j, &t);
+            and_code &= t.code;
+            or_code |= t.code;
+        }
+
+        if(n < 3 || and_code) {
+            stats.strips_rejected++;
+        }
+        else if(!(or_code & PVR_TNL_NEAR)) {
+            stats.strips_accepted++;
+            rv = tnl_emit_strip(verts + i, n);
+        }
+        else {
+            stats.strips_split++;
+            rv = tnl_split_strip(verts + i, n);
+        }
+    }
+
+    return rv;
+}
@@ -0,0 +1,567 @@
+/* KallistiOS ##version##
+
+   pvr_txr_cache.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <errno.h>
+#include <sys/queue.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_txr_cache.h>
+#include <kos/fs.h>
+#include <kos/cond.h>
+#include <kos/mutex.h>
+#include <kos/thread.h>
+#include "pvr_internal.h"
+
+/*
+
+   VRAM texture residency cache
+
+   Each registered texture has an entry in a fixed size table, and its ID is
+   its index in that table. An entry moves through these states:
+
+     IDLE      registered, but not in VRAM
+     QUEUED    waiting in the worker's queue
+     LOADING   being read and uploaded by the worker
+     RESIDENT  in VRAM
+     DYING     removed, with its VRAM freed once the PVR can't be using it
+
+   The worker takes entries off the queue one at a time. It reads the data
+   (from the file, or straight from main RAM), then waits until the upload
+   fits in what's left of this frame's budget, makes room in VRAM if need be,
+   and DMAs it across. The cache lock is dropped while reading and uploading,
+   so lookups don't wait on the disc; an entry that is LOADING belongs to the
+   worker, and removing it only marks it to be thrown away when the worker is
+   done with it.
+
+   Eviction picks the resident texture with the oldest last use, as long as
+   that was at least min_age frames ago. With only a few thousand textures at
+   most, a scan of the table is cheap next to the upload that follows it.
+
+*/
+
+#define TC_FREE     0
+#define TC_IDLE     1
+#define TC_QUEUED   2
+#define TC_LOADING  3
+#define TC_RESIDENT 4
+#define TC_DYING    5
+
+typedef struct tc_ent {
+    int             state;
+    bool            dead;       /* Removed while LOADING */
+    char            *fn;        /* File to load from, or NULL */
+    const void      *data;      /* Data in RAM, if no file */
+    uint32_t        offset;
+    uint32_t        size;
+    pvr_txr_cache_txr_t txr;
+    uint32_t        last_used;  /* Frame number */
+    TAILQ_ENTRY(tc_ent) queue;
+} tc_ent_t;
+
+static TAILQ_HEAD(tc_queue, tc_ent) tc_queue;
+
+static tc_ent_t *tc_ents;
+static size_t tc_count;
+static size_t tc_vram_size, tc_budget;
+static uint32_t tc_min_age;
+static uint32_t tc_frame;
+static uint32_t tc_frame_bytes;
+static uint32_t tc_vram_used;
+static bool tc_quit;
+
+static pvr_txr_cache_txr_t tc_placeholder;
+static pvr_txr_cache_stats_t tc_stats;
+
+static kthread_t *tc_thd;
+static mutex_t tc_mutex = MUTEX_INITIALIZER;
+static condvar_t tc_work_cv = COND_INITIALIZER;
+static condvar_t tc_frame_cv = COND_INITIALIZER;
+
+#define TC_SIZE(s)  (((s) + 31) & ~31)
+
+static tc_ent_t *tc_get(int id) {
+    if(!tc_ents || id < 0 || (size_t)id >= tc_count)
+        return NULL;
+
+    if(tc_ents[id].state == TC_FREE || tc_ents[id].state == TC_DYING ||
+       tc_ents[id].dead)
+        return NULL;
+
+    return tc_ents + id;
+}
+
+static void tc_release(tc_ent_t *e) {
+    free(e->fn);
+    e->fn = NULL;
+    e->data = NULL;
+    e->dead = false;
+    e->state = TC_FREE;
+}
+
+static void tc_free_vram(tc_ent_t *e) {
+    pvr_mem_free(e->txr.ptr);
+    tc_vram_used -= TC_SIZE(e->size);
+    e->txr.ptr = NULL;
+}
+
+static void tc_enqueue(tc_ent_t *e) {
+    e->state = TC_QUEUED;
+    TAILQ_INSERT_TAIL(&tc_queue, e, queue);
+    ++tc_stats.queued;
+    cond_signal(&tc_work_cv);
+}
+
+/* Evict the least recently used texture that's old enough. Returns 0 if there
+   wasn't one. */
+static int tc_evict(void) {
+    tc_ent_t *e, *best = NULL;
+    size_t i;
+
+    for(i = 0; i < tc_count; ++i) {
+        e = tc_ents + i;
+
+        if(e->state != TC_RESIDENT || tc_frame - e->last_used < tc_min_age)
+            continue;
+
+        if(!best || (int32_t)(e->last_used - best->last_used) < 0)
+            best = e;
+    }
+
+    if(!best)
+        return 0;
+
+    tc_free_vram(best);
+    best->state = TC_IDLE;
+    ++tc_stats.evictions;
+    --tc_stats.resident;
+    return 1;
+}
+
+/* Is there anything that will be evictable later on? */
+static int tc_any_resident(void) {
+    size_t i;
+
+    for(i = 0; i < tc_count; ++i) {
+        if(tc_ents[i].state == TC_RESIDENT || tc_ents[i].state == TC_DYING)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Find room in VRAM for the texture, evicting others and waiting for them to
+   age as need be. Called with the lock held. */
+static pvr_ptr_t tc_alloc(uint32_t size) {
+    pvr_ptr_t rv;
+
+    if(tc_vram_size && size > tc_vram_size)
+        return NULL;
+
+    while(!tc_quit) {
+        if(!tc_vram_size || tc_vram_used + size <= tc_vram_size) {
+            if((rv = pvr_mem_malloc(size)) != NULL) {
+                tc_vram_used += size;
+                return rv;
+            }
+        }
+
+        if(tc_evict())
+            continue;
+
+        /* Nothing can go yet. If nothing ever will, give up. */
+        if(!tc_any_resident())
+            return NULL;
+
+        cond_wait(&tc_frame_cv, &tc_mutex);
+    }
+
+    return NULL;
+}
+
+/* Read in a texture's data, without the lock held. Returns a buffer that is
+   suitable for DMA, which may be the data itself. */
+static void *tc_read(const tc_ent_t *e, uint32_t size) {
+    void *buf;
+    file_t fd;
+
+    if(!e->fn && !((uintptr_t)e->data & 31) && size == e->size)
+        return (void *)e->data;
+
+    if(!(buf = memalign(32, size)))
+        return NULL;
+
+    if(!e->fn) {
+        memcpy(buf, e->data, e->size);
+        return buf;
+    }
+
+    if((fd = fs_open(e->fn, O_RDONLY)) < 0) {
+        dbglog(DBG_ERROR, "pvr_txr_cache: can't open %s\n", e->fn);
+        free(buf);
+        return NULL;
+    }
+
+    if(fs_seek(fd, e->offset, SEEK_SET) != (off_t)e->offset ||
+       fs_read(fd, buf, e->size) != (ssize_t)e->size) {
+        dbglog(DBG_ERROR, "pvr_txr_cache: can't read %s\n", e->fn);
+        fs_close(fd);
+        free(buf);
+        return NULL;
+    }
+
+    fs_close(fd);
+    return buf;
+}
+
+static void *tc_worker(void *param) {
+    tc_ent_t *e;
+    pvr_ptr_t dst;
+    void *buf;
+    uint32_t size;
+    int rv;
+
+    (void)param;
+
+    mutex_lock(&tc_mutex);
+
+    for(;;) {
+        while(!tc_quit && TAILQ_EMPTY(&tc_queue))
+            cond_wait(&tc_work_cv, &tc_mutex);
+
+        if(tc_quit)
+            break;
+
+        e = TAILQ_FIRST(&tc_queue);
+        TAILQ_REMOVE(&tc_queue, e, queue);
+        --tc_stats.queued;
+        e->state = TC_LOADING;
+        size = TC_SIZE(e->size);
+
+        mutex_unlock(&tc_mutex);
+        buf = tc_read(e, size);
+        mutex_lock(&tc_mutex);
+
+        dst = NULL;
+
+        if(buf && !e->dead) {
+            /* Wait for the budget, unless this frame hasn't uploaded anything
+               yet (so that big textures still go through). */
+            while(!tc_quit && tc_budget && tc_frame_bytes &&
+                  tc_frame_bytes + size > tc_budget)
+                cond_wait(&tc_frame_cv, &tc_mutex);
+
+            if(!e->dead)
+                dst = tc_alloc(size);
+        }
+
+        if(dst) {
+            tc_frame_bytes += size;
+            mutex_unlock(&tc_mutex);
+
+            mutex_lock((mutex_t *)&pvr_state.dma_lock);
+            rv = pvr_txr_load_dma(buf, dst, size, true, NULL, 0);
+            mutex_unlock((mutex_t *)&pvr_state.dma_lock);
+
+            mutex_lock(&tc_mutex);
+
+            if(rv) {
+                /* The DMA was busy with somebody else's transfer. Give the
+                   room back; the texture is loaded again when next used. */
+                pvr_mem_free(dst);
+                tc_vram_used -= size;
+                tc_frame_bytes -= size;
+                dst = NULL;
+            }
+            else {
+                e->txr.ptr = dst;
+                ++tc_stats.uploads;
+                tc_stats.bytes_uploaded += size;
+            }
+        }
+
+        if(buf != e->data)
+            free(buf);
+
+        if(e->dead) {
+            /* Removed while we were busy with it. */
+            if(dst) {
+                e->state = TC_DYING;
+                e->last_used = tc_frame;
+            }
+            else
+                tc_release(e);
+        }
+        else if(dst) {
+            e->state = TC_RESIDENT;
+            ++tc_stats.resident;
+        }
+        else {
+            if(!tc_quit) {
+                dbglog(DBG_WARNING, "pvr_txr_cache: couldn't load texture %d\n",
+                       (int)(e - tc_ents));
+                ++tc_stats.errors;
+            }
+
+            e->state = TC_IDLE;
+        }
+    }
+
+    mutex_unlock(&tc_mutex);
+    return NULL;
+}
+
+int pvr_txr_cache_init(const pvr_txr_cache_params_t *params) {
+    kthread_attr_t attr = { 0 };
+
+    mutex_lock_scoped(&tc_mutex);
+
+    if(tc_ents) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    if(!params->max_textures) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(!(tc_ents = calloc(params->max_textures, sizeof(tc_ent_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    tc_count = params->max_textures;
+    tc_vram_size = params->vram_size;
+    tc_budget = params->frame_budget;
+    tc_min_age = params->min_age < 2 ? 2 : params->min_age;
+    tc_frame = tc_min_age;
+    tc_frame_bytes = 0;
+    tc_vram_used = 0;
+    tc_quit = false;
+    memset(&tc_stats, 0, sizeof(tc_stats));
+    TAILQ_INIT(&tc_queue);
+
+    attr.label = "pvr_txr_cache";
+    attr.prio = PRIO_DEFAULT;
+
+    if(!(tc_thd = thd_create_ex(&attr, tc_worker, NULL))) {
+        free(tc_ents);
+        tc_ents = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+void pvr_txr_cache_shutdown(void) {
+    size_t i;
+
+    mutex_lock(&tc_mutex);
+
+    if(!tc_ents) {
+        mutex_unlock(&tc_mutex);
+        return;
+    }
+
+    tc_quit = true;
+    cond_broadcast(&tc_work_cv);
+    cond_broadcast(&tc_frame_cv);
+    mutex_unlock(&tc_mutex);
+
+    thd_join(tc_thd, NULL);
+
+    mutex_lock(&tc_mutex);
+
+    for(i = 0; i < tc_count; ++i) {
+        if(tc_ents[i].txr.ptr)
+            tc_free_vram(tc_ents + i);
+
+        tc_release(tc_ents + i);
+    }
+
+    free(tc_ents);
+    tc_ents = NULL;
+    tc_thd = NULL;
+    mutex_unlock(&tc_mutex);
+}
+
+static int tc_add(const char *fn, const void *data, uint32_t offset,
+                  size_t size, uint16_t w, uint16_t h, uint32_t fmt) {
+    tc_ent_t *e;
+    size_t i;
+
+    mutex_lock_scoped(&tc_mutex);
+
+    if(!tc_ents || !size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for(i = 0; i < tc_count && tc_ents[i].state != TC_FREE; ++i)
+        ;
+
+    if(i == tc_count) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    e = tc_ents + i;
+
+    if(fn && !(e->fn = strdup(fn))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    e->data = data;
+    e->offset = offset;
+    e->size = size;
+    e->txr.ptr = NULL;
+    e->txr.w = w;
+    e->txr.h = h;
+    e->txr.fmt = fmt;
+    e->last_used = 0;
+    e->dead = false;
+    e->state = TC_IDLE;
+
+    return (int)i;
+}
+
+int pvr_txr_cache_add_file(const char *fn, uint32_t offset, size_t size,
+                           uint16_t w, uint16_t h, uint32_t fmt) {
+    return tc_add(fn, NULL, offset, size, w, h, fmt);
+}
+
+int pvr_txr_cache_add_mem(const void *data, size_t size, uint16_t w,
+                          uint16_t h, uint32_t fmt) {
+    return tc_add(NULL, data, 0, size, w, h, fmt);
+}
+
+int pvr_txr_cache_remove(int id) {
+    tc_ent_t *e;
+
+    mutex_lock_scoped(&tc_mutex);
+
+    if(!(e = tc_get(id)))
+        return -1;
+
+    switch(e->state) {
+        case TC_QUEUED:
+            TAILQ_REMOVE(&tc_queue, e, queue);
+            --tc_stats.queued;
+            tc_release(e);
+            break;
+
+        case TC_LOADING:
+            e->dead = true;
+            break;
+
+        case TC_RESIDENT:
+            /* Keep the VRAM until the PVR is done with it. */
+            e->state = TC_DYING;
+            --tc_stats.resident;
+            break;
+
+        default:
+            tc_release(e);
+            break;
+    }
+
+    return 0;
+}
+
+void pvr_txr_cache_set_placeholder(pvr_ptr_t ptr, uint16_t w, uint16_t h,
+                                   uint32_t fmt) {
+    mutex_lock_scoped(&tc_mutex);
+
+    tc_placeholder.ptr = ptr;
+    tc_placeholder.w = w;
+    tc_placeholder.h = h;
+    tc_placeholder.fmt = fmt;
+}
+
+int pvr_txr_cache_get(int id, pvr_txr_cache_txr_t *rv) {
+    tc_ent_t *e;
+
+    mutex_lock_scoped(&tc_mutex);
+
+    if(!(e = tc_get(id)))
+        return -1;
+
+    ++tc_stats.lookups;
+    e->last_used = tc_frame;
+
+    if(e->state == TC_RESIDENT) {
+        ++tc_stats.hits;
+        *rv = e->txr;
+        return 1;
+    }
+
+    if(e->state == TC_IDLE)
+        tc_enqueue(e);
+
+    *rv = tc_placeholder;
+    return 0;
+}
+
+int pvr_txr_cache_prefetch(int id) {
+    tc_ent_t *e;
+
+    mutex_lock_scoped(&tc_mutex);
+
+    if(!(e = tc_get(id)))
+        return -1;
+
+    if(e->state == TC_IDLE) {
+        /* Don't let it get evicted again before it's been used. */
+        e->last_used = tc_frame;
+        tc_enqueue(e);
+    }
+
+    return 0;
+}
+
+void pvr_txr_cache_frame(void) {
+    size_t i;
+
+    mutex_lock_scoped(&tc_mutex);
+
+    if(!tc_ents)
+        return;
+
+    ++tc_frame;
+    tc_stats.frame_bytes = tc_frame_bytes;
+    tc_frame_bytes = 0;
+
+    /* Removed textures can go once they're old enough. */
+    for(i = 0; i < tc_count; ++i) {
+        tc_ent_t *e = tc_ents + i;
+
+        if(e->state == TC_DYING && tc_frame - e->last_used >= tc_min_age) {
+            tc_free_vram(e);
+            tc_release(e);
+        }
+    }
+
+    cond_broadcast(&tc_frame_cv);
+}
+
+int pvr_txr_cache_stats(pvr_txr_cache_stats_t *st) {
+    mutex_lock_scoped(&tc_mutex);
+
+    if(!tc_ents)
+        return -1;
+
+    *st = tc_stats;
+    st->resident_bytes = tc_vram_used;
+    st->frame = tc_frame;
+    return 0;
+}
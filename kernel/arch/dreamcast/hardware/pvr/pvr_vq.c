@@ -0,0 +1,555 @@
+/* KallistiOS ##version##
+
+   pvr_vq.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dc/pvr.h>
+
+/*
+
+   Runtime VQ texture compression
+
+   A VQ texture is a codebook of 256 entries of 2x2 texels each, followed by
+   one byte for each 2x2 block of the texture saying which entry to use. The
+   output here is laid out the same way as that of `vqenc -t` (and `vqenc -t
+   -m` for mipmaps) and pvrtex: the codebook, then a padding byte if there are
+   mipmaps, then the twiddled index data for each level, smallest first.
+
+   The codebook is built with plain k-means (Lloyd's algorithm) on a sample of
+   the texture's blocks, for a fixed number of iterations. Everything is done
+   in integers on 8-bit components, and the search for the nearest codebook
+   entry keeps the codebook sorted by the sum of each entry's components. An
+   entry whose sum differs from the block's by d must be at least d*d/16 away
+   from it, so the search starts at the entry with the closest sum, works
+   outwards, and stops in each direction once that bound passes the best
+   distance found so far. On real images this only looks at a small part of
+   the codebook for each block, and the whole codebook stays in the cache.
+
+*/
+
+#define VQ_CODES        256
+#define VQ_DIM          16      /* 2x2 texels, ARGB each */
+#define VQ_SAMPLE_MAX   4096    /* Most blocks used to train the codebook */
+#define VQ_ITERATIONS   8       /* Default number of k-means iterations */
+
+/* Source formats */
+#define VQ_RGB565       0
+#define VQ_ARGB1555     1
+#define VQ_ARGB4444     2
+#define VQ_ARGB8888     3
+
+/* One 2x2 block, texels in twiddled order: (0,0), (0,1), (1,0), (1,1) */
+typedef struct {
+    uint8 v[VQ_DIM];
+} vq_vec_t;
+
+typedef struct {
+    const uint8 *data;
+    uint32 w, h;
+    int fmt;
+    int invert;
+} vq_img_t;
+
+typedef struct {
+    vq_vec_t code[VQ_CODES];    /* Kept sorted by sum */
+    uint16 sum[VQ_CODES];
+    int count;
+
+    /* k-means accumulators */
+    uint32 acc[VQ_CODES][VQ_DIM];
+    uint32 cnt[VQ_CODES];
+
+    vq_vec_t sample[VQ_SAMPLE_MAX];
+    uint16 ssum[VQ_SAMPLE_MAX];
+    int nsample;
+} vq_work_t;
+
+static uint32 vq_texel(const vq_img_t *img, uint32 x, uint32 y) {
+    uint32 p, a, r, g, b;
+
+    if(img->invert)
+        y = img->h - 1 - y;
+
+    if(img->fmt == VQ_ARGB8888)
+        return ((const uint32 *)img->data)[y * img->w + x];
+
+    p = ((const uint16 *)img->data)[y * img->w + x];
+
+    switch(img->fmt) {
+        case VQ_RGB565:
+            a = 0xff;
+            r = (p >> 11) & 0x1f;
+            g = (p >> 5) & 0x3f;
+            b = p & 0x1f;
+            r = (r << 3) | (r >> 2);
+            g = (g << 2) | (g >> 4);
+            b = (b << 3) | (b >> 2);
+            break;
+
+        case VQ_ARGB1555:
+            a = (p & 0x8000) ? 0xff : 0;
+            r = (p >> 10) & 0x1f;
+            g = (p >> 5) & 0x1f;
+            b = p & 0x1f;
+            r = (r << 3) | (r >> 2);
+            g = (g << 3) | (g >> 2);
+            b = (b << 3) | (b >> 2);
+            break;
+
+        default:
+            a = ((p >> 12) & 0xf) * 0x11;
+            r = ((p >> 8) & 0xf) * 0x11;
+            g = ((p >> 4) & 0xf) * 0x11;
+            b = (p & 0xf) * 0x11;
+            break;
+    }
+
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+/* Fetch the block with its top-left corner at (x, y), returning its sum */
+static int vq_block(const vq_img_t *img, uint32 x, uint32 y, vq_vec_t *q) {
+    uint32 t[4];
+    int i, j, sum = 0;
+
+    t[0] = vq_texel(img, x, y);
+    t[1] = vq_texel(img, x, y + 1);
+    t[2] = vq_texel(img, x + 1, y);
+    t[3] = vq_texel(img, x + 1, y + 1);
+
+    for(i = 0; i < 4; i++) {
+        for(j = 0; j < 4; j++) {
+            q->v[i * 4 + j] = (t[i] >> (24 - j * 8)) & 0xff;
+            sum += q->v[i * 4 + j];
+        }
+    }
+
+    return sum;
+}
+
+/* Squared distance between two blocks. If the first half alone is already at
+   least limit, don't bother with the rest. */
+static inline uint32 vq_dist(const uint8 *a, const uint8 *b, uint32 limit) {
+    uint32 d = 0;
+    int i, t;
+
+    for(i = 0; i < VQ_DIM / 2; i++) {
+        t = a[i] - b[i];
+        d += t * t;
+    }
+
+    if(d >= limit)
+        return d;
+
+    for(; i < VQ_DIM; i++) {
+        t = a[i] - b[i];
+        d += t * t;
+    }
+
+    return d;
+}
+
+static int vq_nearest(const vq_work_t *wk, const vq_vec_t *q, int qsum,
+                      uint32 *rdist) {
+    int lo, hi, mid, best = 0, ds, lo_done = 0, hi_done = 0;
+    uint32 bd = 0x0fffffff, d;
+
+    /* Find the first entry with a sum at least qsum */
+    lo = 0;
+    hi = wk->count;
+
+    while(lo < hi) {
+        mid = (lo + hi) / 2;
+
+        if(wk->sum[mid] < qsum)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    hi = lo;
+    lo = lo - 1;
+
+    while(!lo_done || !hi_done) {
+        if(!hi_done) {
+            if(hi >= wk->count) {
+                hi_done = 1;
+            }
+            else {
+                ds = wk->sum[hi] - qsum;
+
+                if((uint32)(ds * ds) >= (bd << 4)) {
+                    hi_done = 1;
+                }
+                else {
+                    d = vq_dist(q->v, wk->code[hi].v, bd);
+
+                    if(d < bd) {
+                        bd = d;
+                        best = hi;
+                    }
+
+                    hi++;
+                }
+            }
+        }
+
+        if(!lo_done) {
+            if(lo < 0) {
+                lo_done = 1;
+            }
+            else {
+                ds = qsum - wk->sum[lo];
+
+                if((uint32)(ds * ds) >= (bd << 4)) {
+                    lo_done = 1;
+                }
+                else {
+                    d = vq_dist(q->v, wk->code[lo].v, bd);
+
+                    if(d < bd) {
+                        bd = d;
+                        best = lo;
+                    }
+
+                    lo--;
+                }
+            }
+        }
+    }
+
+    if(rdist)
+        *rdist = bd;
+
+    return best;
+}
+
+/* Put the codebook back in order of sum. It's almost always nearly sorted
+   already, so an insertion sort does fine. */
+static void vq_sort(vq_work_t *wk) {
+    vq_vec_t c;
+    uint16 s;
+    int i, j;
+
+    for(i = 1; i < wk->count; i++) {
+        s = wk->sum[i];
+
+        if(s >= wk->sum[i - 1])
+            continue;
+
+        c = wk->code[i];
+
+        for(j = i; j > 0 && wk->sum[j - 1] > s; j--) {
+            wk->code[j] = wk->code[j - 1];
+            wk->sum[j] = wk->sum[j - 1];
+        }
+
+        wk->code[j] = c;
+        wk->sum[j] = s;
+    }
+}
+
+static int vq_sum(const vq_vec_t *q) {
+    int i, s = 0;
+
+    for(i = 0; i < VQ_DIM; i++)
+        s += q->v[i];
+
+    return s;
+}
+
+static void vq_train(vq_work_t *wk, int iterations) {
+    int i, j, k, n = wk->nsample, changed, worst;
+    uint32 d, wd, seed = 0x1234567;
+    vq_vec_t c;
+
+    /* Start out with entries spread evenly through the sample */
+    wk->count = n < VQ_CODES ? n : VQ_CODES;
+
+    for(i = 0; i < wk->count; i++) {
+        j = (int)(((uint32)i * n + n / 2) / wk->count);
+        wk->code[i] = wk->sample[j];
+        wk->sum[i] = wk->ssum[j];
+    }
+
+    vq_sort(wk);
+
+    /* If there aren't more blocks than entries, we're done already */
+    if(n <= VQ_CODES)
+        return;
+
+    while(iterations-- > 0) {
+        memset(wk->acc, 0, sizeof(wk->acc));
+        memset(wk->cnt, 0, sizeof(wk->cnt));
+        worst = 0;
+        wd = 0;
+
+        for(i = 0; i < n; i++) {
+            k = vq_nearest(wk, wk->sample + i, wk->ssum[i], &d);
+
+            for(j = 0; j < VQ_DIM; j++)
+                wk->acc[k][j] += wk->sample[i].v[j];
+
+            wk->cnt[k]++;
+
+            if(d > wd) {
+                wd = d;
+                worst = i;
+            }
+        }
+
+        /* Move each entry to the middle of its blocks */
+        changed = 0;
+
+        for(k = 0; k < wk->count; k++) {
+            if(wk->cnt[k]) {
+                for(j = 0; j < VQ_DIM; j++)
+                    c.v[j] = (wk->acc[k][j] + wk->cnt[k] / 2) / wk->cnt[k];
+            }
+            else {
+                /* Nobody wanted this one, so give it to the block that's
+                   worst off (or a random one, after the first). */
+                c = wk->sample[worst];
+                seed = seed * 1103515245 + 12345;
+                worst = (seed >> 8) % n;
+            }
+
+            if(memcmp(&c, wk->code + k, sizeof(c))) {
+                wk->code[k] = c;
+                wk->sum[k] = vq_sum(&c);
+                changed = 1;
+            }
+        }
+
+        if(!changed)
+            break;
+
+        vq_sort(wk);
+    }
+}
+
+static uint16 vq_pack(const uint8 *t, int fmt) {
+    uint32 a = t[0], r = t[1], g = t[2], b = t[3];
+
+    switch(fmt) {
+        case PVR_TXRLOAD_32BPP_ARGB1555:
+        case PVR_TXRLOAD_16BPP_ARGB1555:
+            return ((a >= 0x80) << 15) | (((r * 31 + 127) / 255) << 10) |
+                   (((g * 31 + 127) / 255) << 5) | ((b * 31 + 127) / 255);
+        case PVR_TXRLOAD_32BPP_ARGB4444:
+        case PVR_TXRLOAD_16BPP_ARGB4444:
+            return (((a * 15 + 127) / 255) << 12) |
+                   (((r * 15 + 127) / 255) << 8) |
+                   (((g * 15 + 127) / 255) << 4) | ((b * 15 + 127) / 255);
+        default:
+            return (((r * 31 + 127) / 255) << 11) |
+                   (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255);
+    }
+}
+
+/* Interleave the bits of x and y, with y in the lowest bit */
+static uint32 vq_twiddle(uint32 x, uint32 y) {
+    uint32 rv = 0, i;
+
+    for(i = 0; (x | y) >> i; i++)
+        rv |= (((y >> i) & 1) << (2 * i)) | (((x >> i) & 1) << (2 * i + 1));
+
+    return rv;
+}
+
+/* Write out the (twiddled) indices for one level */
+static void vq_indices(const vq_work_t *wk, const vq_img_t *img, uint8 *out) {
+    uint32 bw = img->w / 2, bh = img->h / 2, min, x, y;
+    vq_vec_t q;
+    int s;
+
+    min = bw < bh ? bw : bh;
+
+    for(y = 0; y < bh; y++) {
+        for(x = 0; x < bw; x++) {
+            s = vq_block(img, x * 2, y * 2, &q);
+            out[vq_twiddle(x & (min - 1), y & (min - 1)) +
+                (x / min + y / min) * min * min] =
+                vq_nearest(wk, &q, s, NULL);
+        }
+    }
+}
+
+/* Halve an image in each direction, into ARGB8888 */
+static void vq_downscale(const vq_img_t *src, uint32 *dst) {
+    uint32 x, y, t[4], i, c, w = src->w / 2, h = src->h / 2;
+
+    for(y = 0; y < h; y++) {
+        for(x = 0; x < w; x++) {
+            t[0] = vq_texel(src, x * 2, y * 2);
+            t[1] = vq_texel(src, x * 2 + 1, y * 2);
+            t[2] = vq_texel(src, x * 2, y * 2 + 1);
+            t[3] = vq_texel(src, x * 2 + 1, y * 2 + 1);
+
+            for(i = 0, c = 0; i < 32; i += 8) {
+                c |= ((((t[0] >> i) & 0xff) + ((t[1] >> i) & 0xff) +
+                       ((t[2] >> i) & 0xff) + ((t[3] >> i) & 0xff) + 2) / 4) << i;
+            }
+
+            dst[y * w + x] = c;
+        }
+    }
+}
+
+size_t pvr_txr_vq_size(uint32_t w, uint32_t h, int mipmap) {
+    size_t rv = 2048 + (w / 2) * (h / 2);
+
+    if(mipmap) {
+        /* The padding byte, and then every level down to 2x2 */
+        rv++;
+
+        while(w > 2) {
+            w /= 2;
+            rv += (w / 2) * (w / 2);
+        }
+    }
+
+    return rv;
+}
+
+int pvr_txr_vq_encode(const void *src, void *dst, uint32_t w, uint32_t h,
+                      uint32_t flags, int iterations) {
+    vq_work_t *wk;
+    vq_img_t levels[11];
+    uint32 *mips = NULL, *mp;
+    uint8 *out;
+    uint16 *cb;
+    size_t total, acc, mipsize;
+    int fmt, i, j, nlevels, mipmap;
+    uint32 x, y, seed = 0x1234567;
+
+    switch(flags & PVR_TXRLOAD_FMT_MASK) {
+        case PVR_TXRLOAD_16BPP:
+        case PVR_TXRLOAD_16BPP_RGB565:
+            fmt = VQ_RGB565;
+            break;
+        case PVR_TXRLOAD_16BPP_ARGB1555:
+            fmt = VQ_ARGB1555;
+            break;
+        case PVR_TXRLOAD_16BPP_ARGB4444:
+            fmt = VQ_ARGB4444;
+            break;
+        case PVR_TXRLOAD_32BPP_ARGB4444:
+        case PVR_TXRLOAD_32BPP_ARGB1555:
+        case PVR_TXRLOAD_32BPP_RGB565:
+            fmt = VQ_ARGB8888;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    mipmap = (flags & PVR_TXRLOAD_VQ_MIPMAP) ? 1 : 0;
+
+    /* Sizes must be powers of two, from 8 to 1024, and mipmapped textures
+       have to be square. */
+    if(w < 8 || h < 8 || w > 1024 || h > 1024 || (w & (w - 1)) ||
+       (h & (h - 1)) || (mipmap && w != h)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(iterations <= 0)
+        iterations = VQ_ITERATIONS;
+
+    if(!(wk = (vq_work_t *)malloc(sizeof(vq_work_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* Set up each level we're going to encode, largest first */
+    levels[0].data = (const uint8 *)src;
+    levels[0].w = w;
+    levels[0].h = h;
+    levels[0].fmt = fmt;
+    levels[0].invert = (flags & PVR_TXRLOAD_INVERT_Y) ? 1 : 0;
+    nlevels = 1;
+
+    if(mipmap && w > 2) {
+        mipsize = 0;
+
+        for(x = w / 2; x >= 2; x /= 2)
+            mipsize += x * x;
+
+        if(!(mips = (uint32 *)malloc(mipsize * sizeof(uint32)))) {
+            free(wk);
+            errno = ENOMEM;
+            return -1;
+        }
+
+        for(mp = mips, x = w / 2; x >= 2; mp += x * x, x /= 2) {
+            vq_downscale(levels + nlevels - 1, mp);
+            levels[nlevels].data = (const uint8 *)mp;
+            levels[nlevels].w = x;
+            levels[nlevels].h = x;
+            levels[nlevels].fmt = VQ_ARGB8888;
+            levels[nlevels].invert = 0;
+            nlevels++;
+        }
+    }
+
+    /* Take a sample of blocks from all of the levels: one from a random spot
+       in each of VQ_SAMPLE_MAX equal slices of the list of all blocks. Taking
+       the same spot in each slice would line up with the rows of the
+       texture, and miss everything in between. */
+    for(i = 0, total = 0; i < nlevels; i++)
+        total += (levels[i].w / 2) * (levels[i].h / 2);
+
+    wk->nsample = total < VQ_SAMPLE_MAX ? total : VQ_SAMPLE_MAX;
+
+    for(j = 0; j < wk->nsample; j++) {
+        acc = (size_t)j * total / wk->nsample;
+        seed = seed * 1103515245 + 12345;
+        acc += (seed >> 8) % (((size_t)(j + 1) * total / wk->nsample) - acc);
+
+        for(i = 0; acc >= (levels[i].w / 2) * (levels[i].h / 2); i++)
+            acc -= (levels[i].w / 2) * (levels[i].h / 2);
+
+        x = acc % (levels[i].w / 2);
+        y = acc / (levels[i].w / 2);
+        wk->ssum[j] = vq_block(levels + i, x * 2, y * 2, wk->sample + j);
+    }
+
+    vq_train(wk, iterations);
+
+    /* Write out the codebook. Each entry's texels are already in twiddled
+       order, so they just go straight out. */
+    cb = (uint16 *)dst;
+
+    for(i = 0; i < VQ_CODES; i++) {
+        if(i < wk->count) {
+            cb[i * 4 + 0] = vq_pack(wk->code[i].v + 0, flags & PVR_TXRLOAD_FMT_MASK);
+            cb[i * 4 + 1] = vq_pack(wk->code[i].v + 4, flags & PVR_TXRLOAD_FMT_MASK);
+            cb[i * 4 + 2] = vq_pack(wk->code[i].v + 8, flags & PVR_TXRLOAD_FMT_MASK);
+            cb[i * 4 + 3] = vq_pack(wk->code[i].v + 12, flags & PVR_TXRLOAD_FMT_MASK);
+        }
+        else {
+            cb[i * 4 + 0] = cb[i * 4 + 1] = cb[i * 4 + 2] = cb[i * 4 + 3] = 0;
+        }
+    }
+
+    out = (uint8 *)dst + 2048;
+
+    /* Then the levels, smallest first, after the 1x1 level's padding byte */
+    if(mipmap)
+        *out++ = 0;
+
+    for(i = nlevels - 1; i >= 0; i--) {
+        vq_indices(wk, levels + i, out);
+        out += (levels[i].w / 2) * (levels[i].h / 2);
+    }
+
+    free(mips);
+    free(wk);
+    return 0;
+}
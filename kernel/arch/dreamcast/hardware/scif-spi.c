@@ -177,6 +177,70 @@ void scif_spi_write_byte(uint8 b) {
     SCSPTR2 = tmp;
 }
 
+/* Clock out one byte, without touching the clock line after the last bit. This
+   is the same sequence as scif_spi_write_byte(), but it gets inlined into the
+   block transfer functions below so there's no call overhead per byte. */
+static inline __attribute__((always_inline)) void spi_send(uint16 tmp,
+                                                           uint8 b) {
+    uint8 bit;
+
+    SCSPTR2 = tmp | (bit = (b >> 7) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+    SCSPTR2 = tmp | (bit = (b >> 6) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+    SCSPTR2 = tmp | (bit = (b >> 5) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+    SCSPTR2 = tmp | (bit = (b >> 4) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+    SCSPTR2 = tmp | (bit = (b >> 3) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+    SCSPTR2 = tmp | (bit = (b >> 2) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+    SCSPTR2 = tmp | (bit = (b >> 1) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+    SCSPTR2 = tmp | (bit = (b >> 0) & 0x01);
+    SCSPTR2 = tmp | bit | PTR2_CTSDT;
+    SD_WAIT();
+}
+
+void scif_spi_write_data(const uint8 *buffer, size_t len) {
+    uint16 tmp = scsptr2 & ~PTR2_CTSDT & ~PTR2_SPB2DT;
+    const uint32 *ptr;
+    uint32 data;
+
+    /* Less optimized version for unaligned buffers or lengths not divisible by
+       four. */
+    if((((uint32)buffer) & 0x03) || (len & 0x03)) {
+        while(len--) {
+            spi_send(tmp, *buffer++);
+        }
+
+        SCSPTR2 = tmp;
+        return;
+    }
+
+    /* Otherwise, grab a whole word at a time, so we only touch memory once for
+       every 32 clocks. */
+    ptr = (const uint32 *)buffer;
+
+    for(; len > 0; len -= 4) {
+        data = *ptr++;
+        spi_send(tmp, (uint8)data);
+        spi_send(tmp, (uint8)(data >> 8));
+        spi_send(tmp, (uint8)(data >> 16));
+        spi_send(tmp, (uint8)(data >> 24));
+    }
+
+    SCSPTR2 = tmp;
+}
+
 uint8 scif_spi_read_byte(void) {
     uint8 b = 0xff;
     uint16 tmp = (scsptr2 & ~PTR2_CTSDT) | PTR2_SPB2DT;
@@ -14,9 +14,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* For CRC16-CCITT */
-#include <kos/net.h>
-
 #include <kos/blockdev.h>
 #include <kos/dbglog.h>
 
@@ -86,19 +83,68 @@ uint8 sd_crc7(const uint8 *data, int size, uint8 crc) {
     return crc & (0x7f << 1);
 }
 
+/* Tables for a slice-by-8 CRC16-CCITT (polynomial 0x1021, no reflection),
+   filled in by sd_crc16_init(). crc16_table[0] is the usual byte-at-a-time
+   table, and each crc16_table[k][b] is the CRC of the byte b followed by k zero
+   bytes. That lets us fold eight bytes of data into the CRC at once. */
+static uint16 crc16_table[8][256];
+
+static void sd_crc16_init(void) {
+    int i, j, k;
+    uint16 crc;
+
+    for(i = 0; i < 256; ++i) {
+        crc = i << 8;
+
+        for(j = 0; j < 8; ++j)
+            crc = (crc << 1) ^ ((crc & 0x8000) ? 0x1021 : 0);
+
+        crc16_table[0][i] = crc;
+    }
+
+    for(k = 1; k < 8; ++k) {
+        for(i = 0; i < 256; ++i) {
+            crc = crc16_table[k - 1][i];
+            crc16_table[k][i] = (crc << 8) ^ crc16_table[0][crc >> 8];
+        }
+    }
+}
+
+static uint16 sd_crc16(const uint8 *data, size_t size) {
+    uint16 crc = 0;
+
+    while(size >= 8) {
+        crc = crc16_table[7][(crc >> 8) ^ data[0]] ^
+              crc16_table[6][(crc & 0xff) ^ data[1]] ^
+              crc16_table[5][data[2]] ^ crc16_table[4][data[3]] ^
+              crc16_table[3][data[4]] ^ crc16_table[2][data[5]] ^
+              crc16_table[1][data[6]] ^ crc16_table[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+
+    while(size--)
+        crc = (crc << 8) ^ crc16_table[0][(crc >> 8) ^ *data++];
+
+    return crc;
+}
+
+/* Clock in one byte from the card, while keeping the data line to the card
+   high. This is what the card expects while we're waiting on it, and it's a bit
+   quicker than doing a full read/write of 0xFF. */
+static inline uint8 sd_read_byte(int slow) {
+    return slow ? scif_spi_slow_rw_byte(0xFF) : scif_spi_read_byte();
+}
+
 static int sd_send_cmd(uint8 cmd, uint32 arg, int slow) {
-    uint8 (*dfunc)(uint8 data) = &scif_spi_rw_byte;
     uint8 rv;
     int i = 0;
     uint8 pkt[6];
 
-    if(slow)
-        dfunc = &scif_spi_slow_rw_byte;
-
     /* Wait for the SD card to be ready to accept our command... */
-    dfunc(0xFF);
+    sd_read_byte(slow);
     do {
-        rv = dfunc(0xFF);
+        rv = sd_read_byte(slow);
         ++i;
     } while(rv != 0xFF && i < MAX_RETRIES);
 
@@ -115,21 +161,22 @@ static int sd_send_cmd(uint8 cmd, uint32 arg, int slow) {
     pkt[5] = sd_crc7(pkt, 5, 0) | 0x01;
 
     /* Write out the packet to the device */
-    dfunc(pkt[0]);
-    dfunc(pkt[1]);
-    dfunc(pkt[2]);
-    dfunc(pkt[3]);
-    dfunc(pkt[4]);
-    dfunc(pkt[5]);
+    if(slow) {
+        for(i = 0; i < 6; ++i)
+            scif_spi_slow_rw_byte(pkt[i]);
+    }
+    else {
+        scif_spi_write_data(pkt, 6);
+    }
 
     /* Ignore the first byte after sending a CMD12 */
     if(cmd == CMD(12))
-        dfunc(0xFF);
+        sd_read_byte(slow);
 
     /* Wait for a response */
     i = 0;
     do {
-        rv = dfunc(0xFF);
+        rv = sd_read_byte(slow);
         ++i;
     } while((rv & 0x80) && i < 20);
 
@@ -191,6 +238,9 @@ int sd_init(void) {
 
     byte_mode = is_mmc = 0;
 
+    if(!crc16_table[0][1])
+        sd_crc16_init();
+
     if(scif_spi_init())
         return -1;
 
@@ -309,9 +359,11 @@ static int read_data(size_t bytes, uint8 *buf) {
     uint16 crc;
     int i = 0;
 
-    /* This should come back in 100ms at worst... */
+    /* This should come back in 100ms at worst... Anything other than 0xFF here
+       is either the start token or an error token, so stop as soon as we see
+       something. */
     do {
-        byte = scif_spi_rw_byte(0xFF);
+        byte = scif_spi_read_byte();
         ++i;
     } while(byte == 0xFF && i < READ_RETRIES);
 
@@ -322,10 +374,11 @@ static int read_data(size_t bytes, uint8 *buf) {
     scif_spi_read_data(buf, bytes);
 
     /* Read in the trailing CRC */
-    crc = (scif_spi_read_byte() << 8) | scif_spi_read_byte();
+    crc = scif_spi_read_byte() << 8;
+    crc |= scif_spi_read_byte();
 
     /* Return success if the CRC matches */
-    return crc != net_crc16ccitt(buf, bytes, 0);
+    return crc != sd_crc16(buf, bytes);
 }
 
 int sd_read_blocks(uint32 block, size_t count, uint8 *buf) {
@@ -390,12 +443,11 @@ static int write_data(uint8 tag, size_t bytes, const uint8 *buf) {
     uint8 rv;
     int i = 0;
     uint16 crc;
-    const uint8 *ptr = buf;
 
     /* Wait for the card to be ready for our data */
-    scif_spi_rw_byte(0xFF);
+    scif_spi_read_byte();
     do {
-        rv = scif_spi_rw_byte(0xFF);
+        rv = scif_spi_read_byte();
         ++i;
     } while(rv != 0xFF && i < WRITE_RETRIES);
 
@@ -405,10 +457,8 @@ static int write_data(uint8 tag, size_t bytes, const uint8 *buf) {
     scif_spi_write_byte(tag);
 
     /* Send the data. */
-    crc = net_crc16ccitt(buf, bytes, 0);
-    while(bytes--) {
-        scif_spi_write_byte(*ptr++);
-    }
+    crc = sd_crc16(buf, bytes);
+    scif_spi_write_data(buf, bytes);
 
     /* Write out the block's crc */
     scif_spi_write_byte((uint8)(crc >> 8));
@@ -479,9 +529,9 @@ int sd_write_blocks(uint32 block, size_t count, const uint8 *buf) {
         }
 
         /* Write the end data token. */
-        scif_spi_rw_byte(0xFF);
+        scif_spi_read_byte();
         do {
-            byte = scif_spi_rw_byte(0xFF);
+            byte = scif_spi_read_byte();
             ++i;
         } while(byte != 0xFF && i < WRITE_RETRIES);
 
@@ -18,6 +18,13 @@
     To actually use the framebuffer device, pass "fb" as the parameter to
     dbgio_dev_select().
 
+    Writing doesn't draw anything straight away. The text is kept as a grid of
+    characters, and the framebuffer is brought up to date by a thread woken at
+    vertical blank, or by dbgio_flush(). Only the characters that changed are
+    drawn then, and scrolling moves the framebuffer once, however many lines
+    went by. Before the video mode has been set up, text is drawn as it is
+    written (outside of interrupts).
+
     \author Lawrence Sebald
 */
 
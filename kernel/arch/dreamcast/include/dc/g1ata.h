@@ -351,6 +351,84 @@ int g1_ata_read_lba(uint64_t sector, size_t count, void *buf);
 int g1_ata_read_lba_dma(uint64_t sector, size_t count, void *buf,
                         int block);
 
+/** \brief   Queued DMA read request.
+    \ingroup g1ata
+
+    This structure describes one read for g1_ata_queue_read_dma(). The request
+    is owned by the caller, and must stay valid until it has completed (that
+    is, until its callback has been called).
+
+    \headerfile dc/g1ata.h
+*/
+typedef struct g1_ata_req {
+    uint64_t sector;            /**< \brief The sector to start reading from. */
+    size_t count;               /**< \brief The number of sectors to read. */
+    void *buf;                  /**< \brief 32-byte aligned output buffer. */
+
+    /** \brief  Completion callback (may be NULL).
+
+        This is called from the G1 DMA interrupt handler once the request has
+        finished, so it must not block. It may submit more requests with
+        g1_ata_queue_read_dma().
+
+        \param  req         The request that finished.
+        \param  status      0 on success, or -EIO if an error occurred.
+    */
+    void (*callback)(struct g1_ata_req *req, int status);
+    void *data;                 /**< \brief Caller data, for the callback. */
+
+    /** \brief  Request status.
+
+        Set to 1 when the request is queued, and to the same value passed to the
+        callback when it finishes, so it can be polled instead of using a
+        callback. */
+    volatile int status;
+
+    /** \cond */
+    struct g1_ata_req *next;
+    /** \endcond */
+} g1_ata_req_t;
+
+/** \brief   Queue an asynchronous DMA read with Linear Block Addressing.
+    \ingroup g1ata
+
+    This function adds a read to the queue of DMA requests for the slave device
+    on the G1 ATA bus and returns immediately. When each request finishes, the
+    DMA interrupt handler reports its completion and starts the next queued
+    request right away, so the bus is never idle while there is work queued up.
+    This lets a caller overlap processing of the data from one request with
+    the transfer of the next one, for instance:
+
+    \code
+    // Queue up both halves, then decompress the first while the second loads.
+    g1_ata_queue_read_dma(&req[0]);
+    g1_ata_queue_read_dma(&req[1]);
+    while(req[0].status > 0) thd_pass();
+    decompress(req[0].buf);
+    \endcode
+
+    The G1 ATA bus is locked from when the first request in the queue starts
+    until the queue drains, so any other access to the bus (including GD-ROM
+    access) will wait for the queue to finish. Don't mix queued requests with
+    other G1 ATA calls from the same thread.
+
+    \param  req             The request to queue. The sector, count, buf and
+                            callback fields must be filled in.
+    \return                 0 on success. < 0 on failure, setting errno as
+                            appropriate.
+
+    \par    Error Conditions:
+    \em     EFAULT - req or its buffer was NULL or the buffer was unaligned \n
+    \em     ENXIO - ATA support not initialized or no device attached \n
+    \em     EOVERFLOW - one or more of the requested sectors is out of the
+                        range of the disk, or the request is too large to be
+                        done in a single ATA command \n
+    \em     ENOTSUP - LBA mode not supported by the device \n
+    \em     EPERM - device does not support DMA \n
+    \em     EAGAIN - called from an interrupt while the bus was in use
+*/
+int g1_ata_queue_read_dma(g1_ata_req_t *req);
+
 /** \brief   Write one or more disk sectors with Linear Block Addressing (LBA).
     \ingroup g1ata
 
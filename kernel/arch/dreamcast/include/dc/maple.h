@@ -798,6 +798,23 @@ void maple_vbl_irq_hnd(uint32 code, void *data);
 */
 void maple_dma_irq_hnd(uint32 code, void *data);
 
+/** \brief   Poll devices now.
+    \ingroup maple
+
+    Devices are normally polled at every VBL, so what's read from them can be
+    most of a frame old by the time it's used. This sends the same requests
+    straight away, for the drivers of the given functions, so that a program
+    can get fresh input just before it needs it. The replies come in once the
+    DMA is done (see maple_dma_in_progress()).
+
+    \param  functions       The function codes of the drivers to poll (one or
+                            more MAPLE_FUNCs ORed together).
+    \retval 0               On success.
+    \retval -1              If a DMA is already in progress (errno is set to
+                            EAGAIN).
+*/
+int maple_poll(uint32 functions);
+
 /**************************************************************************/
 /* maple_enum.c */
 
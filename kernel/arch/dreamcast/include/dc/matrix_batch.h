@@ -0,0 +1,203 @@
+/* KallistiOS ##version##
+
+   dc/matrix_batch.h
+   Copyright (C) 2026 The KOS Team and contributors
+
+*/
+
+/** \file    dc/matrix_batch.h
+    \brief   Matrix and vector operations on arrays.
+    \ingroup math_batch
+
+    This file contains functions that run the SH4's matrix and vector
+    instructions over whole arrays at once, for skinning, lighting and
+    culling, where doing it one vector at a time from C costs more in loads,
+    stores and calls than in math.
+
+    \see    dc/matrix.h
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_MATRIX_BATCH_H
+#define __DC_MATRIX_BATCH_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+
+#include <dc/matrix.h>
+
+/** \defgroup math_batch    Batches
+    \brief                  Matrix and vector operations on arrays
+    \ingroup                math_matrices
+
+    Most of these use the internal matrix (XMTRX) one way or another. Those
+    that don't take it as an input still load it with their own matrices, so
+    whatever was in it beforehand is lost; mat_store() it first if it's
+    needed afterwards.
+
+    @{
+*/
+
+/** \brief  Bone weights for one skinned vertex.
+
+    Up to four bones can affect a vertex. Unused slots must have a weight of
+    0, and come after all of the used ones. The weights of the used ones
+    should add up to 1.
+
+    \headerfile dc/matrix_batch.h
+*/
+typedef struct mat_skin_weights {
+    uint8_t bone[4];            /**< \brief Index of each bone in the palette */
+    float   weight[4];          /**< \brief Weight of each bone */
+} mat_skin_weights_t;
+
+/** \brief  Skin points by a matrix palette.
+
+    Each point is transformed by the matrices of the bones that affect it,
+    and the results are blended by the bones' weights. The W of each input
+    point is ignored and taken as 1; the W of each output point is the
+    blended W.
+
+    A matrix is only loaded when the bone changes, so vertices with a single
+    bone are at their fastest when grouped by bone; each extra bone costs a
+    matrix load. With a single bone of weight 1 per vertex, this transforms
+    each point by a matrix of its own.
+
+    \param  palette         The bone matrices (see mat_quat_palette()).
+    \param  in              The points to transform.
+    \param  weights         The bone weights of each point.
+    \param  out             Where to put the skinned points. This may be the
+                            same as \p in.
+    \param  count           The number of points.
+
+    \note                   This overwrites the internal matrix.
+*/
+void mat_skin_points(const matrix_t *palette, const vector_t *in,
+                     const mat_skin_weights_t *weights, vector_t *out,
+                     int count);
+
+/** \brief  Transform normals by the internal matrix and renormalize them.
+
+    Each normal is transformed as a direction (with a W of 0, so the
+    translation in the internal matrix has no effect), then scaled back to a
+    length of 1 with FSRRA. The W of each output normal is 0.
+
+    The matrix should be a rotation, with or without a uniform scale. For
+    anything else, load the inverse transpose instead.
+
+    \param  in              The normals to transform.
+    \param  out             Where to put the transformed normals. This may be
+                            the same as \p in.
+    \param  count           The number of normals.
+*/
+void mat_transform_normals(const vector_t *in, vector_t *out, int count);
+
+/** \brief  Build a matrix palette from quaternions and positions.
+
+    Each quaternion (x, y, z, w, which should have a length of 1) and
+    position is turned into a rotation-then-translation matrix, which is then
+    multiplied onto the internal matrix, and stored. Loading the identity
+    first gives the bone matrices alone; loading a model view matrix first
+    gives a palette that skins straight into view space.
+
+    \param  out             Where to put the matrices.
+    \param  rot             The rotation of each bone, as a quaternion.
+    \param  pos             The position of each bone (W is ignored), or NULL
+                            for no translation.
+    \param  count           The number of matrices.
+*/
+void mat_quat_palette(matrix_t *out, const vector_t *rot, const vector_t *pos,
+                      int count);
+
+/** \brief  A view frustum, set up for batch culling.
+
+    The six planes are stored in the form the matrix unit needs to test four
+    of them at once. Set this up with mat_frustum_extract().
+
+    \headerfile dc/matrix_batch.h
+*/
+typedef struct mat_frustum {
+    matrix_t planes[2];         /**< \brief Plane equations, four at a time */
+    matrix_t abs_planes[2];     /**< \brief The same, with each term positive */
+} mat_frustum_t;
+
+/** \brief  An axis-aligned bounding box, for culling.
+
+    \headerfile dc/matrix_batch.h
+*/
+typedef struct mat_aabb {
+    vector_t center;            /**< \brief The center of the box (W ignored) */
+    vector_t extent;            /**< \brief Half the size of the box on each
+                                            axis (W ignored) */
+} mat_aabb_t;
+
+/** \name    Culling results
+    \brief   What mat_cull_spheres() and mat_cull_aabbs() say about each bound.
+    @{
+*/
+#define MAT_CULL_OUTSIDE    0   /**< \brief Entirely outside the frustum */
+#define MAT_CULL_INTERSECT  1   /**< \brief Partly inside the frustum */
+#define MAT_CULL_INSIDE     2   /**< \brief Entirely inside the frustum */
+/** @} */
+
+/** \brief  Find the view frustum of a matrix.
+
+    This takes a matrix that goes from the space the bounds are in to before
+    the perspective divide: a projection matrix times a model view matrix, or
+    the full matrix set up with mat_perspective() and mat_lookat(). The
+    rectangle is where X / W and Y / W end up on the screen: -1 to 1 for a
+    GL style projection, or the screen size in pixels if the screen view
+    transform is included. The near and far planes are given as distances in
+    W, which is the distance from the camera for all of the usual
+    projections.
+
+    \param  f               The frustum to set up.
+    \param  m               The matrix.
+    \param  x0              The left edge, after the divide.
+    \param  y0              The top (or bottom) edge, after the divide.
+    \param  x1              The right edge, after the divide.
+    \param  y1              The bottom (or top) edge, after the divide.
+    \param  near_w          The W of the near plane.
+    \param  far_w           The W of the far plane.
+*/
+void mat_frustum_extract(mat_frustum_t *f, const matrix_t *m, float x0,
+                         float y0, float x1, float y1, float near_w,
+                         float far_w);
+
+/** \brief  Cull an array of bounding spheres.
+
+    \param  f               The frustum to cull against.
+    \param  spheres         The spheres: the center in X, Y and Z, and the
+                            radius in W.
+    \param  result          Where to put the result for each sphere, one of
+                            the \ref MAT_CULL_OUTSIDE "culling results".
+    \param  count           The number of spheres.
+    \return                 The number of spheres that aren't outside.
+
+    \note                   This overwrites the internal matrix.
+*/
+int mat_cull_spheres(const mat_frustum_t *f, const vector_t *spheres,
+                     uint8_t *result, int count);
+
+/** \brief  Cull an array of axis-aligned bounding boxes.
+
+    \param  f               The frustum to cull against.
+    \param  boxes           The boxes.
+    \param  result          Where to put the result for each box, one of the
+                            \ref MAT_CULL_OUTSIDE "culling results".
+    \param  count           The number of boxes.
+    \return                 The number of boxes that aren't outside.
+
+    \note                   This overwrites the internal matrix.
+*/
+int mat_cull_aabbs(const mat_frustum_t *f, const mat_aabb_t *boxes,
+                   uint8_t *result, int count);
+
+/** @} */
+
+__END_DECLS
+
+#endif  /* __DC_MATRIX_BATCH_H */
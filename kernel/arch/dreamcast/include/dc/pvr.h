@@ -1166,6 +1166,10 @@ void *pvr_set_vertbuf(pvr_list_t list, void *buffer, size_t len);
     this buffer by the user program directly; however, make sure to call
     pvr_vertbuf_written() to notify the system of any such changes.
 
+    Once the list's main buffer is full, this points into its extension buffer
+    (see pvr_set_vertbuf_ext()) instead. There is no bounds checking on what is
+    written here; pvr_list_reserve() is the checked way of doing the same.
+
     \param  list            The primitive list to get the buffer for.
 
     \return                 The tail of that list's buffer.
@@ -1184,6 +1188,67 @@ void *pvr_vertbuf_tail(pvr_list_t list);
 */
 void pvr_vertbuf_written(pvr_list_t list, size_t amt);
 
+/** \brief   Set up an extension vertex buffer for one of the list types.
+    \ingroup pvr_list_mgmt
+
+    The extension buffer is used once a list's main buffer (set with
+    pvr_set_vertbuf()) fills up in a frame, instead of failing. When the list
+    is sent to the TA, its data in the main buffer is sent first, followed by
+    the data in the extension buffer. This lets the main buffer be sized for a
+    typical frame, with the extension only being touched by the odd busy one.
+
+    The same rules apply to this buffer as to the main one: it is split in two
+    for double buffering, and it should only be changed between frames.
+
+    \param  list            The primitive list to set the buffer for.
+    \param  buffer          The location of the buffer in main RAM (32-byte
+                            aligned), or NULL to remove the extension buffer.
+    \param  len             The length of the buffer. This must be a multiple of
+                            64.
+
+    \return                 The old buffer location (if any)
+*/
+void *pvr_set_vertbuf_ext(pvr_list_t list, void *buffer, size_t len);
+
+/** \brief   Reserve space in a list's DMA vertex buffer to write to directly.
+    \ingroup pvr_list_mgmt
+
+    This is a checked version of pvr_vertbuf_tail(). It returns a pointer to
+    where the next size bytes of the list's data go, so that vertices can be
+    written there in place rather than being built somewhere else and copied
+    in by pvr_list_prim(). Once they have been written, call pvr_list_commit()
+    with the number of bytes actually used (which may be less than what was
+    reserved).
+
+    If the list's main buffer doesn't have room, the space comes from its
+    extension buffer (see pvr_set_vertbuf_ext()), if it has one. The last 32
+    bytes of each buffer are always kept free for the end of list marker that
+    pvr_scene_finish() adds.
+
+    Only one reservation per list can be outstanding at a time; reserving again
+    without committing throws the first reservation away.
+
+    \param  list            The primitive list to reserve space in.
+    \param  size            The number of bytes to reserve. Must be a multiple
+                            of 32.
+
+    \return                 A 32-byte aligned pointer to the space, or NULL if
+                            there isn't enough room left in this frame.
+*/
+void *pvr_list_reserve(pvr_list_t list, size_t size);
+
+/** \brief   Commit data written to space from pvr_list_reserve().
+    \ingroup pvr_list_mgmt
+
+    \param  list            The primitive list the space was reserved in.
+    \param  size            The number of bytes written. Must be a multiple of
+                            32, and no more than was reserved.
+
+    \retval 0               On success.
+    \retval -1              If size is larger than the reservation.
+*/
+int pvr_list_commit(pvr_list_t list, size_t size);
+
 /** \brief   Begin collecting data for a frame of 3D output to the off-screen
              frame buffer.
     \ingroup pvr_scene_mgmt
@@ -1309,7 +1374,26 @@ void pvr_dr_init(pvr_dr_state_t *vtx_buf_ptr);
     \param  addr            The address returned by pvr_dr_target(), after you
                             have written the primitive to it.
 */
+#ifndef PVR_DR_CAPTURE
 #define pvr_dr_commit(addr) sq_flush(addr)
+#else
+#define pvr_dr_commit(addr) ({ \
+        pvr_dr_capture(addr); \
+        sq_flush(addr); \
+    })
+#endif
+
+/** \brief  Record a Direct Rendering primitive in a frame capture.
+
+    With PVR_DR_CAPTURE defined, pvr_dr_commit() calls this first, so that
+    primitives sent with Direct Rendering show up in pvr_capture_frame()
+    files. It reads the primitive back out of the Store Queue, so it is only
+    worth the time while debugging.
+
+    \param  addr            The address returned by pvr_dr_target(), after you
+                            have written the primitive to it.
+*/
+void pvr_dr_capture(void *addr);
 
 /** \brief  Finish work with Direct Rendering.
 
@@ -1384,6 +1468,9 @@ int pvr_scene_finish(void);
     essentially waits until a rendered frame is complete and a vertical blank
     happens.
 
+    With a pipeline depth of 3 (see pvr_set_pipeline_depth()), this returns
+    straight away, and pvr_scene_finish() does the waiting instead.
+
     \retval 0               On success. A new scene can be started now.
     \retval -1              On error. Something is probably very wrong...
 */
@@ -0,0 +1,194 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_batch.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_batch.h
+    \brief      Polygon header caching, deduplication and state sorting.
+    \ingroup    pvr_batch
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_BATCH_H
+#define __DC_PVR_PVR_BATCH_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <dc/pvr.h>
+
+/** \defgroup pvr_batch  Batching
+    \brief              Cutting down on redundant polygon headers
+    \ingroup            pvr_primitives
+
+    Drawing a mesh usually means compiling a polygon context into a header,
+    then sending the header and the vertices. When consecutive draws use the
+    same state, every header after the first is 32 bytes of TA bandwidth (and
+    object list space) spent on nothing. This is a submission layer on top of
+    pvr_prim() and pvr_list_prim() that does away with them:
+
+    - pvr_poly_hdr_cache() keeps compiled headers in a small cache keyed by
+      the polygon context, so a context only needs compiling once.
+    - pvr_batch_hdr() and pvr_batch_draw() remember the last header sent to
+      each list, and skip sending a header identical to it.
+    - If pvr_batch_init() has been called with room for it, draws to the
+      opaque and punch-through lists are held back and sorted by header
+      before they are sent, so that draws with the same state end up next to
+      each other and share one header. Draw order doesn't matter in those
+      lists, as the PVR sorts them by depth itself.
+
+    Held back draws are sent when the list is closed with pvr_list_finish()
+    (or by pvr_scene_finish(), for lists with a DMA vertex buffer), or earlier
+    with pvr_batch_flush().
+
+    The layer only knows about headers sent through it. If you send a header
+    to a list some other way in the middle of a scene (with pvr_prim() or the
+    direct rendering API), call pvr_batch_invalidate() afterwards.
+*/
+
+/** \brief   Parameters for the batching layer.
+    \ingroup pvr_batch
+
+    \headerfile dc/pvr/pvr_batch.h
+*/
+typedef struct pvr_batch_params {
+    /** \brief Number of entries in the header cache (rounded up to a power of
+               two; 0 for no cache). Each takes 256 bytes. */
+    size_t hdr_cache_size;
+
+    /** \brief Most draws held back for sorting in each of the opaque and
+               punch-through lists (0 to disable sorting). */
+    size_t max_draws;
+
+    /** \brief Bytes of vertex data that can be held back for sorting, shared
+               by both lists. */
+    size_t vertex_buf_size;
+} pvr_batch_params_t;
+
+/** \brief   Statistics about the batching layer.
+    \ingroup pvr_batch
+
+    \headerfile dc/pvr/pvr_batch.h
+*/
+typedef struct pvr_batch_stats {
+    uint64_t hdrs_sent;         /**< \brief Headers sent to the TA. */
+    uint64_t hdrs_skipped;      /**< \brief Headers not sent, as they were
+                                            identical to the last one. */
+    uint64_t bytes_saved;       /**< \brief TA bytes saved by skipping them. */
+    uint64_t cache_hits;        /**< \brief Header cache hits. */
+    uint64_t cache_misses;      /**< \brief Header cache misses (compiles). */
+    uint64_t draws_sorted;      /**< \brief Draws held back and sorted. */
+    uint64_t draws_direct;      /**< \brief Sortable draws sent directly, as
+                                            there was no room to hold them. */
+} pvr_batch_stats_t;
+
+/** \brief   Set up the header cache and draw sorting.
+    \ingroup pvr_batch
+
+    Header deduplication works without calling this; the header cache and
+    sorting need the memory this allocates.
+
+    \param  params          Parameters for the batching layer.
+    \retval 0               On success.
+    \retval -1              On error (errno is set to ENOMEM).
+*/
+int pvr_batch_init(const pvr_batch_params_t *params);
+
+/** \brief   Free everything allocated by pvr_batch_init().
+    \ingroup pvr_batch
+
+    Any held back draws are thrown away.
+*/
+void pvr_batch_shutdown(void);
+
+/** \brief   Look up the compiled header for a polygon context.
+    \ingroup pvr_batch
+
+    This returns the same header pvr_poly_compile() would make from the
+    context, compiling it only if it isn't in the cache already. The context
+    is compared as a whole, so make sure every field is set (as the
+    pvr_poly_cxt_*() functions do).
+
+    \param  cxt             The polygon context.
+    \return                 The compiled header. It stays valid until the
+                            cache slot is reused by another context, so use it
+                            right away. Without a cache, it is valid until the
+                            next call.
+*/
+const pvr_poly_hdr_t *pvr_poly_hdr_cache(const pvr_poly_cxt_t *cxt);
+
+/** \brief   Empty the header cache.
+    \ingroup pvr_batch
+*/
+void pvr_poly_hdr_cache_clear(void);
+
+/** \brief   Send a header to a list, unless it's already in effect.
+    \ingroup pvr_batch
+
+    The list must either be the one currently open, or have a DMA vertex
+    buffer.
+
+    \param  list            The list to send to.
+    \param  hdr             The header (32 bytes).
+    \retval 1               If the header was sent.
+    \retval 0               If it was identical to the last header sent to
+                            the list, and so wasn't.
+    \retval -1              If the list can't be submitted to right now.
+*/
+int pvr_batch_hdr(pvr_list_t list, const pvr_poly_hdr_t *hdr);
+
+/** \brief   Draw a primitive with the given state.
+    \ingroup pvr_batch
+
+    This sends the header (if it isn't already in effect) followed by the
+    vertex data. For the opaque and punch-through lists, if sorting is enabled,
+    both are copied and held back to be sorted instead.
+
+    \param  list            The list to draw to.
+    \param  hdr             The header (32 bytes).
+    \param  verts           The vertex data.
+    \param  size            The size of the vertex data in bytes (a multiple
+                            of 32).
+    \retval 0               On success.
+    \retval -1              If the list can't be submitted to right now.
+*/
+int pvr_batch_draw(pvr_list_t list, const pvr_poly_hdr_t *hdr,
+                   const void *verts, size_t size);
+
+/** \brief   Send any held back draws for a list.
+    \ingroup pvr_batch
+
+    This is done for you when the list is finished. The list must either be
+    the one currently open, or have a DMA vertex buffer.
+
+    \param  list            The list to flush.
+    \retval 0               On success.
+    \retval -1              If the list can't be submitted to right now.
+*/
+int pvr_batch_flush(pvr_list_t list);
+
+/** \brief   Forget the last header sent to a list.
+    \ingroup pvr_batch
+
+    Call this after sending a header to the list without going through this
+    layer, so that the next header is sent no matter what. This is done for
+    every list by pvr_scene_begin().
+
+    \param  list            The list.
+*/
+void pvr_batch_invalidate(pvr_list_t list);
+
+/** \brief   Get statistics about the batching layer.
+    \ingroup pvr_batch
+
+    \param  st              Used to return the statistics.
+*/
+void pvr_batch_stats(pvr_batch_stats_t *st);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_BATCH_H */
@@ -0,0 +1,170 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_bfont.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_bfont.h
+    \brief      Drawing the BIOS font with the PVR.
+    \ingroup    pvr_bfont
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_BFONT_H
+#define __DC_PVR_PVR_BFONT_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <kos/cdefs.h>
+#include <dc/pvr.h>
+
+/** \defgroup pvr_bfont     BIOS Font Text
+    \brief                  Drawing text in the BIOS font as sprites
+    \ingroup                pvr_primitives
+
+    The bfont_draw_* functions in dc/biosfont.h draw text into a framebuffer
+    with the CPU, a pixel at a time, every time. This draws the same text
+    with the PVR instead: each glyph is a textured sprite, sent through the
+    \ref pvr_sprite_batch "sprite batcher", so a whole screen of text costs
+    little more than filling in a vertex per character.
+
+    Glyphs are copied out of the BIOS font into a texture (the atlas) the
+    first time they're drawn, and stay there until the room is needed for
+    another. The atlas is made of 32x32 cells, each of which holds two
+    half-width characters, or one full-width character or icon. When it's
+    full, the glyph that was drawn longest ago is replaced, once the last
+    frame that drew it has been rendered; a glyph can't be added if every
+    one in the atlas is still in use (it's then left out, and counted in
+    \ref pvr_bfont_stats_t.dropped).
+
+    Strings are laid out like bfont_draw_str(): they can use the encoding set
+    with bfont_set_encoding(), newlines, tabs, and the \\diXX and \\viXX
+    escapes for Dreamcast and VMU icons. The text is tinted with a color,
+    and each color used takes a sprite batcher state; up to
+    \ref PVR_BFONT_MAX_COLORS can be used.
+
+    The sprite batcher must have been set up with pvr_sprite_batch_init()
+    first. If its states are cleared, or it's set up again, the colors are
+    registered again the next time they're used.
+*/
+
+/** \brief   Most colors text can be drawn in.
+    \ingroup pvr_bfont
+*/
+#define PVR_BFONT_MAX_COLORS    16
+
+/** \brief   Text drawing parameters.
+    \ingroup pvr_bfont
+
+    \headerfile dc/pvr/pvr_bfont.h
+*/
+typedef struct pvr_bfont_params {
+    /** \brief Width of the atlas in pixels: a power of two, from 32 to 1024.
+               The atlas is ARGB4444, so 512x256 takes 256KB of VRAM and
+               holds up to 256 half-width characters. */
+    uint32_t atlas_w;
+
+    /** \brief Height of the atlas in pixels: a power of two, from 32 to
+               1024. */
+    uint32_t atlas_h;
+
+    /** \brief The list to draw in (\ref PVR_LIST_TR_POLY or
+               \ref PVR_LIST_PT_POLY). */
+    pvr_list_t list;
+
+    /** \brief The sprite batcher layer to draw in. */
+    uint8_t layer;
+} pvr_bfont_params_t;
+
+/** \brief   Text drawing statistics.
+    \ingroup pvr_bfont
+
+    \headerfile dc/pvr/pvr_bfont.h
+*/
+typedef struct pvr_bfont_stats {
+    uint64_t glyphs;            /**< \brief Glyphs drawn. */
+    uint64_t loads;             /**< \brief Glyphs copied into the atlas. */
+    uint64_t evictions;         /**< \brief Glyphs thrown out of the atlas
+                                            to make room. */
+    uint64_t dropped;           /**< \brief Glyphs left out, as there was no
+                                            room in the atlas, no state for
+                                            the color, or no room in the
+                                            sprite batcher. */
+} pvr_bfont_stats_t;
+
+/** \brief   Set up text drawing.
+    \ingroup pvr_bfont
+
+    This allocates the atlas in texture memory. If text drawing was already
+    set up, it's shut down first.
+
+    \param  params          The parameters.
+    \retval 0               On success.
+    \retval -1              On error (errno is set to EINVAL if a parameter
+                            won't do, or ENOMEM if out of memory).
+*/
+int pvr_bfont_init(const pvr_bfont_params_t *params);
+
+/** \brief   Shut down text drawing.
+    \ingroup pvr_bfont
+
+    The atlas is freed once the last frame to draw text has been rendered,
+    so this must be called before pvr_shutdown().
+*/
+void pvr_bfont_shutdown(void);
+
+/** \brief   Draw a string.
+    \ingroup pvr_bfont
+
+    This must be called between pvr_scene_begin() and the finish of the
+    list the text is drawn in.
+
+    \param  x               The left edge of the text, in pixels.
+    \param  y               The top edge of the text, in pixels.
+    \param  z               The depth of the text (1/w).
+    \param  argb            The color of the text.
+    \param  str             The string.
+    \return                 The x coordinate just after the last character.
+*/
+float pvr_bfont_draw(float x, float y, float z, uint32_t argb,
+                     const char *str);
+
+/** \brief   Draw a formatted string.
+    \ingroup pvr_bfont
+
+    \param  x               The left edge of the text, in pixels.
+    \param  y               The top edge of the text, in pixels.
+    \param  z               The depth of the text (1/w).
+    \param  argb            The color of the text.
+    \param  fmt             The format string.
+    \param  ...             The arguments for the format string.
+    \return                 The x coordinate just after the last character.
+
+    \sa pvr_bfont_draw()
+*/
+float pvr_bfont_draw_fmt(float x, float y, float z, uint32_t argb,
+                         const char *fmt, ...) __printflike(5, 6);
+
+/** \brief   Measure a string.
+    \ingroup pvr_bfont
+
+    \param  str             The string.
+    \return                 The width of its widest line, in pixels.
+*/
+float pvr_bfont_width(const char *str);
+
+/** \brief   Get the text drawing statistics.
+    \ingroup pvr_bfont
+
+    These count up from pvr_bfont_init().
+
+    \param  st              Used to return the statistics.
+*/
+void pvr_bfont_stats(pvr_bfont_stats_t *st);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_BFONT_H */
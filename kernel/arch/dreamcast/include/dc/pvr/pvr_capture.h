@@ -0,0 +1,146 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_capture.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_capture.h
+    \brief      Recording a frame's TA stream to a file.
+    \ingroup    pvr_capture
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_CAPTURE_H
+#define __DC_PVR_PVR_CAPTURE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/** \defgroup pvr_capture  Frame Capture
+    \brief                Recording a frame for looking at offline
+    \ingroup              pvr_stats
+
+    pvr_capture_frame() records everything sent to the TA in the next scene,
+    along with the PVR settings needed to make sense of it, and writes it to a
+    file when the scene is finished. The pvrcap tool in utils/ reads these
+    files on the host, and rasterizes them the way the PVR would, to measure
+    overdraw and how full the tile bins get without needing the hardware.
+
+    Data is recorded as it goes through pvr_prim(), pvr_list_prim(),
+    command buffers and the DMA vertex buffers. Direct rendering writes
+    straight to the store queues, so it is only recorded if the program is
+    built with PVR_DR_CAPTURE defined, which makes pvr_dr_commit() call
+    pvr_dr_capture() first. pvr_send_to_ta() is not recorded.
+
+    \section pvr_capture_fmt File format
+
+    Everything is little-endian 32-bit words. The file starts with a header
+    of three words: the magic number PVR_CAPTURE_MAGIC, the version
+    (PVR_CAPTURE_VERSION) and flags (PVR_CAPTURE_TRUNCATED). Chunks follow,
+    each a word giving its ID, a word giving the size of its payload in
+    bytes, then the payload:
+
+    - PVR_CAPTURE_REGS: a pvr_capture_regs_t.
+    - PVR_CAPTURE_PALT: the palette format, then the 1024 palette entries.
+    - PVR_CAPTURE_LIST: the list (PVR_LIST_*), then TA data sent to it, in
+      the order it was sent. A list can have more than one chunk.
+    - PVR_CAPTURE_VRAM: the offset in texture memory (as in a pvr_ptr_t),
+      then texture memory from there on.
+    - PVR_CAPTURE_END: no payload, always last.
+*/
+
+/** \brief   Make a chunk ID from four characters.
+    \ingroup pvr_capture
+*/
+#define PVR_CAPTURE_ID(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | \
+     ((uint32_t)(d) << 24))
+
+/** \name    Capture file constants
+    \ingroup pvr_capture
+    @{
+*/
+#define PVR_CAPTURE_MAGIC       PVR_CAPTURE_ID('P', 'V', 'R', 'C')  /**< \brief File magic */
+#define PVR_CAPTURE_VERSION     1                                   /**< \brief Format version */
+#define PVR_CAPTURE_TRUNCATED   0x00000001  /**< \brief Ran out of room, data is missing */
+
+#define PVR_CAPTURE_REGS        PVR_CAPTURE_ID('R', 'E', 'G', 'S')  /**< \brief Settings chunk */
+#define PVR_CAPTURE_PALT        PVR_CAPTURE_ID('P', 'A', 'L', 'T')  /**< \brief Palette chunk */
+#define PVR_CAPTURE_LIST        PVR_CAPTURE_ID('L', 'I', 'S', 'T')  /**< \brief TA data chunk */
+#define PVR_CAPTURE_VRAM        PVR_CAPTURE_ID('V', 'R', 'A', 'M')  /**< \brief Texture memory chunk */
+#define PVR_CAPTURE_END         PVR_CAPTURE_ID('E', 'N', 'D', ' ')  /**< \brief End of file */
+/** @} */
+
+/** \brief   Also record texture memory.
+    \ingroup pvr_capture
+
+    Pass this to pvr_capture_frame() to add everything from the start of
+    texture memory to the end of VRAM, so textures can be drawn on the host.
+    This makes the file several megabytes larger.
+*/
+#define PVR_CAPTURE_TEXTURES    0x00000001
+
+/** \brief   PVR settings recorded with a frame.
+    \ingroup pvr_capture
+
+    \headerfile dc/pvr/pvr_capture.h
+*/
+typedef struct pvr_capture_regs {
+    uint32_t width;             /**< \brief Screen width in pixels */
+    uint32_t height;            /**< \brief Screen height in pixels */
+    uint32_t tiles_x;           /**< \brief Screen width in tiles */
+    uint32_t tiles_y;           /**< \brief Screen height in tiles */
+    uint32_t fsaa;              /**< \brief Non-zero if horizontal FSAA is on */
+    uint32_t lists_enabled;     /**< \brief (1 << list) for each enabled list */
+    uint32_t opb_size[5];       /**< \brief Tile bin size in bytes, per list */
+    uint32_t opb_overflow_count;    /**< \brief Extra sets of bins for overflow */
+    uint32_t bg_color;          /**< \brief Background color (RGB) */
+    uint32_t zclip;             /**< \brief Background plane depth (float bits) */
+    uint32_t pclip_x;           /**< \brief Pixel clip, right << 16 | left */
+    uint32_t pclip_y;           /**< \brief Pixel clip, bottom << 16 | top */
+    uint32_t presort;           /**< \brief Non-zero if translucent autosort is off */
+    uint32_t to_texture;        /**< \brief Non-zero if rendering to a texture */
+    uint32_t dma_mode;          /**< \brief Non-zero if vertex DMA is on */
+    uint32_t texture_base;      /**< \brief Start of texture memory */
+    uint32_t txr_stride;        /**< \brief PVR_TXR_STRIDE_MULT */
+    uint32_t pt_alpha_ref;      /**< \brief PVR_PT_ALPHA_REF */
+    uint32_t cheap_shadow;      /**< \brief PVR_CHEAP_SHADOW */
+} pvr_capture_regs_t;
+
+/** \brief   Record the next scene to a file.
+    \ingroup pvr_capture
+
+    Recording starts at the next pvr_scene_begin(), and the file is written
+    by pvr_scene_finish(), which takes a while longer than usual for that
+    frame. TA data is kept in a buffer of max_bytes until then; anything sent
+    after the buffer fills up is left out, and the file is marked as
+    truncated.
+
+    \param  fn              The file to write. The name is copied.
+    \param  max_bytes       The size of the buffer for TA data.
+    \param  flags           PVR_CAPTURE_TEXTURES, or 0.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EBUSY - a capture is already pending \n
+    \em     ENOMEM - out of memory
+*/
+int pvr_capture_frame(const char *fn, size_t max_bytes, int flags);
+
+/** \brief   Check whether a capture is still to be written.
+    \ingroup pvr_capture
+
+    \return                 True from pvr_capture_frame() until the file has
+                            been written.
+*/
+bool pvr_capture_pending(void);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_CAPTURE_H */
@@ -0,0 +1,174 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_cmdbuf.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_cmdbuf.h
+    \brief      Command buffers for building lists from several threads.
+    \ingroup    pvr_cmdbuf
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_CMDBUF_H
+#define __DC_PVR_PVR_CMDBUF_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stddef.h>
+#include <dc/pvr.h>
+
+/** \defgroup pvr_cmdbuf  Command Buffers
+    \brief              Building a scene from more than one thread
+    \ingroup            pvr_list_mgmt
+
+    Only one thread can submit to the PVR at once: pvr_list_begin(),
+    pvr_prim() and pvr_list_prim() all work on global state. A command buffer
+    is a piece of a list held in main RAM that belongs to whoever is filling
+    it, so any number of threads can each fill their own at the same time,
+    without any locking.
+
+    When they are done, the thread building the scene attaches the command
+    buffers to lists with pvr_list_cmdbuf(). Lists are always sent in the
+    order command buffers are attached to them, whichever thread finished
+    first, so the frame comes out the same every time.
+
+    In DMA mode, attached command buffers aren't copied. pvr_scene_finish()
+    chains them onto the end of the list, after anything in the list's own
+    vertex buffer, and the DMA sends them straight from where they are. A
+    command buffer therefore has two halves, like the DMA vertex buffers, and
+    pvr_cmdbuf_begin() picks the one that isn't being sent while the current
+    scene is being built. Lists submitted directly work too: in that case the
+    command buffer is sent to the TA as soon as it is attached.
+
+    A frame built this way goes:
+
+    - pvr_scene_begin() (on the main thread).
+    - pvr_cmdbuf_begin() for each command buffer.
+    - Worker threads fill their command buffers.
+    - Once they've all finished, pvr_list_cmdbuf() for each command buffer, in
+      the order they should be drawn in.
+    - pvr_scene_finish().
+*/
+
+/** \brief   Most command buffers that can be attached to one list per scene.
+    \ingroup pvr_cmdbuf
+*/
+#define PVR_CMDBUF_CHAIN_MAX    16
+
+/** \brief   A command buffer.
+    \ingroup pvr_cmdbuf
+
+    Treat the contents as private; they are here so that command buffers can
+    be allocated anywhere.
+
+    \headerfile dc/pvr/pvr_cmdbuf.h
+*/
+typedef struct pvr_cmdbuf {
+    uint8_t *base[2];       /**< \brief The two halves of the buffer. */
+    size_t  size;           /**< \brief Size of each half. */
+    uint8_t *cur;           /**< \brief The half being filled. */
+    size_t  ptr;            /**< \brief Bytes written to it so far. */
+    size_t  resv;           /**< \brief Bytes reserved and not committed. */
+} pvr_cmdbuf_t;
+
+/** \brief   Set up a command buffer.
+    \ingroup pvr_cmdbuf
+
+    The buffer is split in two halves, which take turns being filled, so each
+    half is how much can go in the command buffer in one scene. It stays in
+    use until the command buffer isn't needed any more (and the last scene it
+    was in has been sent). The command buffer starts out empty.
+
+    \param  cb              The command buffer.
+    \param  buffer          The memory to use, aligned to 32 bytes.
+    \param  len             The size of the memory, a multiple of 64 bytes.
+    \retval 0               On success.
+    \retval -1              If the buffer isn't aligned or sized right.
+*/
+int pvr_cmdbuf_init(pvr_cmdbuf_t *cb, void *buffer, size_t len);
+
+/** \brief   Empty a command buffer, to fill it for the current scene.
+    \ingroup pvr_cmdbuf
+
+    Call this after pvr_scene_begin(). This picks the half of the buffer the
+    scene being built gets to use.
+
+    \param  cb              The command buffer.
+*/
+void pvr_cmdbuf_begin(pvr_cmdbuf_t *cb);
+
+/** \brief   Reserve space at the end of a command buffer to write to.
+    \ingroup pvr_cmdbuf
+
+    This works like pvr_list_reserve(): write vertices and headers straight
+    into the space, then call pvr_cmdbuf_commit() with how much was written.
+
+    \param  cb              The command buffer.
+    \param  size            The size to reserve, a multiple of 32 bytes.
+    \return                 A 32-byte aligned pointer to the space, or NULL if
+                            the command buffer is full.
+*/
+void *pvr_cmdbuf_reserve(pvr_cmdbuf_t *cb, size_t size);
+
+/** \brief   Commit data written to space from pvr_cmdbuf_reserve().
+    \ingroup pvr_cmdbuf
+
+    \param  cb              The command buffer.
+    \param  size            How much was written, a multiple of 32 bytes no
+                            larger than what was reserved.
+    \retval 0               On success.
+    \retval -1              If more was committed than reserved.
+*/
+int pvr_cmdbuf_commit(pvr_cmdbuf_t *cb, size_t size);
+
+/** \brief   Add primitive data to a command buffer.
+    \ingroup pvr_cmdbuf
+
+    \param  cb              The command buffer.
+    \param  data            The data to add, aligned to 4 bytes.
+    \param  size            The size of the data, a multiple of 32 bytes.
+    \retval 0               On success.
+    \retval -1              If the command buffer is full.
+*/
+int pvr_cmdbuf_prim(pvr_cmdbuf_t *cb, const void *data, size_t size);
+
+/** \brief   Get how much is in a command buffer.
+    \ingroup pvr_cmdbuf
+
+    \param  cb              The command buffer.
+    \return                 The number of bytes committed since
+                            pvr_cmdbuf_begin().
+*/
+static inline size_t pvr_cmdbuf_used(const pvr_cmdbuf_t *cb) {
+    return cb->ptr;
+}
+
+/** \brief   Attach a command buffer to the end of a list.
+    \ingroup pvr_cmdbuf
+
+    This must be called from the thread building the scene, once the command
+    buffer has been filled. Nothing may be written to the command buffer
+    after this, until it is begun again for the next scene.
+
+    If the list has a DMA vertex buffer, the command buffer is sent after the
+    list's own vertices, and after any command buffers attached to it before.
+    Otherwise, the list must be the one currently open, and the command
+    buffer is sent to the TA right away.
+
+    An empty command buffer is accepted and ignored.
+
+    \param  list            The list to attach to.
+    \param  cb              The command buffer.
+    \retval 0               On success.
+    \retval -1              If the list can't be submitted to right now, or
+                            already has PVR_CMDBUF_CHAIN_MAX command buffers.
+*/
+int pvr_list_cmdbuf(pvr_list_t list, const pvr_cmdbuf_t *cb);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_CMDBUF_H */
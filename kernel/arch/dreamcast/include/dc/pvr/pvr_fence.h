@@ -0,0 +1,162 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_fence.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_fence.h
+    \brief      Frame fences and pipeline depth.
+    \ingroup    pvr_fence
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_FENCE_H
+#define __DC_PVR_PVR_FENCE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <dc/pvr.h>
+
+/** \defgroup pvr_fence     Fences
+    \brief                  Finding out how far along a frame is
+    \ingroup                pvr_scene_mgmt
+
+    Each scene started with pvr_scene_begin() (or pvr_scene_begin_txr()) gets
+    a fence, which says how far the hardware has got with it: whether the TA
+    has taken all of its lists, whether it has been rendered, and whether it
+    has been displayed. A fence can be polled, or waited on, at any time after
+    its scene is finished.
+
+    The main use for them is knowing when something the frame used can be
+    changed or thrown away. A texture that was drawn with in frame N can't be
+    freed until frame N has been rendered, as the PVR reads it during the
+    render; pvr_mem_free_after() does that for you, by holding on to the
+    texture until the fence is reached.
+
+    Frames go through the stages in order, and so do fences: if a fence has
+    reached a stage, so have all of the fences before it.
+*/
+
+/** \brief   A frame fence.
+    \ingroup pvr_fence
+
+    This is the frame's sequence number. Zero is a fence that has always been
+    reached.
+*/
+typedef uint32_t pvr_fence_t;
+
+/** \brief   Frame stages.
+    \ingroup pvr_fence
+*/
+typedef enum pvr_fence_stage {
+    PVR_FENCE_TA_DONE,          /**< \brief The TA has taken all of the lists
+                                            (vertex buffers can be reused) */
+    PVR_FENCE_RENDER_DONE,      /**< \brief The frame has been rendered
+                                            (its textures can be changed) */
+    PVR_FENCE_DISPLAYED         /**< \brief The frame is on the screen (for a
+                                            render to texture, the texture is
+                                            ready, and every frame before it
+                                            has been displayed) */
+} pvr_fence_stage_t;
+
+/** \brief   Get the fence of the current scene.
+    \ingroup pvr_fence
+
+    This is valid from pvr_scene_begin() on, and stays the same until the
+    next one.
+
+    \return                 The fence.
+*/
+pvr_fence_t pvr_scene_fence(void);
+
+/** \brief   Check if a fence has reached a stage.
+    \ingroup pvr_fence
+
+    \param  fence           The fence.
+    \param  stage           The stage.
+    \return                 True if it has.
+*/
+bool pvr_fence_reached(pvr_fence_t fence, pvr_fence_stage_t stage);
+
+/** \brief   Wait for a fence to reach a stage.
+    \ingroup pvr_fence
+
+    \param  fence           The fence.
+    \param  stage           The stage.
+    \param  timeout         The longest to wait, in milliseconds, or 0 to wait
+                            for as long as it takes.
+    \retval 0               Once the fence has reached the stage.
+    \retval -1              On error (errno is set to ETIMEDOUT if it timed
+                            out, or EDEADLK if the fence's scene hasn't been
+                            finished yet).
+*/
+int pvr_fence_wait(pvr_fence_t fence, pvr_fence_stage_t stage, int timeout);
+
+/** \brief   Free texture memory once a frame is done with it.
+    \ingroup pvr_fence
+
+    The memory is freed with pvr_mem_free() once the fence reaches
+    \ref PVR_FENCE_RENDER_DONE; straight away, if it already has. Memory
+    waiting to be freed is checked at each pvr_scene_begin(), and by
+    pvr_fence_collect().
+
+    Up to 256 frees can be waiting at once. Past that, this waits for the
+    oldest one's fence, and frees it, to make room.
+
+    \param  chunk           The memory to free.
+    \param  fence           The fence of the last frame to use it.
+*/
+void pvr_mem_free_after(pvr_ptr_t chunk, pvr_fence_t fence);
+
+/** \brief   Free texture memory whose fences have been reached.
+    \ingroup pvr_fence
+
+    This is done at every pvr_scene_begin() anyway; it's only needed to get
+    memory back while no scenes are being drawn.
+
+    \return                 The number of chunks freed.
+*/
+int pvr_fence_collect(void);
+
+/** \brief   Set how many frames can be in flight at once.
+    \ingroup pvr_fence
+
+    With a depth of 2 (the default), pvr_wait_ready() waits for the TA to
+    take the last frame, so building a frame overlaps with rendering the one
+    before it, but not with sending it to the TA.
+
+    A depth of 3 is only possible in vertex DMA mode. pvr_wait_ready() and
+    pvr_check_ready() then only make sure there is a free RAM vertex buffer
+    (which there always is once pvr_scene_finish() has returned), so the next
+    frame can be built while the last one is still being sent to the TA, and
+    the one before that is still rendering. The wait for the TA moves into
+    pvr_scene_finish(), which waits for the TA to take the last frame before
+    starting the DMA of this one. Lists without a DMA vertex buffer still
+    wait for the TA in pvr_list_begin(), as they're sent to it directly.
+    There are only two TA and frame buffers, so the extra frame is held in
+    RAM rather than queued on the PVR.
+
+    The pipeline should be empty when this is changed (call it before the
+    first scene, or after waiting for the last scene's fence).
+
+    \param  depth           2 or 3.
+    \retval 0               On success.
+    \retval -1              On error (errno is set to EINVAL if the depth isn't
+                            possible).
+*/
+int pvr_set_pipeline_depth(int depth);
+
+/** \brief   Get how many frames can be in flight at once.
+    \ingroup pvr_fence
+
+    \return                 The pipeline depth, 2 or 3.
+*/
+int pvr_get_pipeline_depth(void);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_FENCE_H */
@@ -102,9 +102,189 @@ void pvr_mem_print_list(void);
 
     This prints out statistics like what malloc_stats() provides. Also, if
     KM_DBG is enabled in pvr_mem.c, it prints the list of allocated blocks.
+
+    Along with those, it prints how fragmented the pool is: the number of free
+    chunks and the space in them, and the same for the relocatable pool (see
+    \ref pvr_mem_pool) if one has been set up.
 */
 void pvr_mem_stats(void);
 
+/** \defgroup pvr_mem_pool   Relocatable Pool
+    \brief                   Handle-based VRAM allocation with compaction
+    \ingroup                 pvr_vram
+
+    A program that loads and frees textures of different sizes for a long time
+    (streaming them in as a level goes by, for instance) will eventually find
+    that pvr_mem_malloc() fails even though there is plenty of VRAM free, as the
+    free space has been split up into pieces that are each too small.
+
+    The relocatable pool is an alternative for this sort of use. A part of VRAM
+    is set aside with pvr_mem_pool_init(), and handed out by a buddy allocator
+    in power-of-two sized blocks from 32 bytes up, which fits the sizes of
+    textures (without mipmaps) exactly. Blocks are referred to by a handle
+    rather than an address, so that pvr_mem_compact() can move them around to
+    put the free space back together.
+
+    Since the address of a block may change whenever pvr_mem_compact() is
+    called, you need to look it up with pvr_mem_hptr() after each compaction
+    (and recompile any polygon headers that refer to it). Blocks that must stay
+    where they are can be pinned with pvr_mem_hlock().
+*/
+
+/** \brief   log2 of the smallest block size in the relocatable pool.
+    \ingroup pvr_mem_pool
+*/
+#define PVR_MEM_POOL_MIN_ORDER  5
+
+/** \brief   Number of block sizes in the relocatable pool (32 bytes to 8MB).
+    \ingroup pvr_mem_pool
+*/
+#define PVR_MEM_POOL_ORDERS     19
+
+/** \brief   Handle to a block in the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    Zero is never a valid handle.
+*/
+typedef uint32_t pvr_mem_handle_t;
+
+/** \brief   Statistics about the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    \headerfile dc/pvr/pvr_mem.h
+*/
+typedef struct pvr_mem_pool_stats {
+    size_t size;            /**< \brief Size of the pool. */
+    size_t used;            /**< \brief Bytes in allocated blocks. */
+    size_t requested;       /**< \brief Bytes asked for by the allocations. */
+    size_t free;            /**< \brief Bytes free. */
+    size_t largest_free;    /**< \brief Size of the largest free block. */
+    uint32_t free_count;    /**< \brief Number of free blocks. */
+    uint32_t handles;       /**< \brief Number of blocks allocated. */
+
+    /** \brief Percentage of the free space not in the largest free block.
+        
+        This is 0 when all of the free space is in one block, and gets closer
+        to 100 as it gets split up into lots of small ones.
+    */
+    uint32_t fragmentation;
+
+    /** \brief Number of free blocks of each size, smallest first. */
+    uint32_t free_blocks[PVR_MEM_POOL_ORDERS];
+
+    uint64_t moved;         /**< \brief Bytes moved by pvr_mem_compact(). */
+    uint32_t moves;         /**< \brief Blocks moved by pvr_mem_compact(). */
+} pvr_mem_pool_stats_t;
+
+/** \brief   Set aside a part of VRAM for the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    The pool is allocated with pvr_mem_malloc(), and the bookkeeping for it
+    (around 8 bytes of main RAM for each kilobyte of pool) with malloc(). It
+    goes away along with everything else when pvr_mem_reset() is called, or
+    when the PVR is shut down.
+
+    \param  size            The size of the pool in bytes. It does not need to
+                            be a power of two, but no single block can be
+                            larger than the largest power of two within it.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EEXIST - the pool has already been set up \n
+    \em     EINVAL - size is smaller than 32 bytes or larger than 8MB \n
+    \em     ENOMEM - not enough VRAM or main RAM
+*/
+int pvr_mem_pool_init(size_t size);
+
+/** \brief   Free the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    All handles to blocks in the pool become invalid.
+*/
+void pvr_mem_pool_shutdown(void);
+
+/** \brief   Allocate a block from the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    The size is rounded up to the next power of two (and at least 32 bytes).
+
+    \param  size            The number of bytes to allocate.
+    \return                 A handle to the block, or 0 on error (with errno
+                            set to EINVAL if there is no pool or size is bad,
+                            or ENOMEM if there is no free block large enough).
+*/
+pvr_mem_handle_t pvr_mem_halloc(size_t size);
+
+/** \brief   Free a block in the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    \param  h               The handle to free. This frees the block even if
+                            it is locked.
+*/
+void pvr_mem_hfree(pvr_mem_handle_t h);
+
+/** \brief   Look up where a block in the relocatable pool is.
+    \ingroup pvr_mem_pool
+
+    The pointer stays valid until the next call to pvr_mem_compact() (unless
+    the block is locked).
+
+    \param  h               The handle to look up.
+    \return                 The block's address in VRAM, or NULL if the handle
+                            isn't valid.
+*/
+pvr_ptr_t pvr_mem_hptr(pvr_mem_handle_t h);
+
+/** \brief   Pin a block in the relocatable pool in place.
+    \ingroup pvr_mem_pool
+
+    A locked block will not be moved by pvr_mem_compact(). Locks nest, so the
+    block stays in place until pvr_mem_hunlock() has been called as many times
+    as this.
+
+    \param  h               The handle to lock.
+    \return                 The block's address in VRAM, or NULL if the handle
+                            isn't valid.
+*/
+pvr_ptr_t pvr_mem_hlock(pvr_mem_handle_t h);
+
+/** \brief   Unpin a block in the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    \param  h               The handle to unlock.
+*/
+void pvr_mem_hunlock(pvr_mem_handle_t h);
+
+/** \brief   Defragment the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    This moves unlocked blocks towards the start of the pool to merge free
+    blocks into bigger ones, until there is nothing left to merge or the given
+    number of bytes has been moved. Blocks are moved by reading them back into
+    main RAM and sending them out again by DMA, which is not fast, so a small
+    budget on each frame is usually best.
+
+    The PVR must not be using any of the blocks in the pool while this runs, so
+    call it between frames, after pvr_wait_render_done(). Afterwards, look up
+    the address of each block again with pvr_mem_hptr().
+
+    \param  max_bytes       The most bytes to move. A move that is started is
+                            finished, so this may be exceeded by one block.
+    \return                 The number of bytes moved.
+*/
+size_t pvr_mem_compact(size_t max_bytes);
+
+/** \brief   Get statistics about the relocatable pool.
+    \ingroup pvr_mem_pool
+
+    \param  st              Used to return the statistics.
+    \retval 0               On success.
+    \retval -1              If the pool hasn't been set up (errno is set to
+                            ENXIO).
+*/
+int pvr_mem_pool_stats(pvr_mem_pool_stats_t *st);
+
 __END_DECLS
 
 #endif /* __DC_PVR_PVR_MEM_H */
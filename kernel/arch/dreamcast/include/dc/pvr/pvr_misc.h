@@ -180,6 +180,71 @@ typedef struct pvr_stats {
 */
 int pvr_get_stats(pvr_stats_t *stat);
 
+/** \brief   PVR object pointer buffer statistics structure.
+    \ingroup pvr_stats
+
+    This structure holds statistics about how much of the object pointer
+    buffers (the tile bins set up from pvr_init_params_t::opb_sizes) the TA
+    has been using. Each tile starts out with one bin per list. When a tile's
+    bin fills up, the TA chains another block onto it from the overflow space
+    (whose size is set by pvr_init_params_t::opb_overflow_count), and if that
+    runs out too, geometry goes missing.
+
+    The arrays are indexed by list (PVR_LIST_*).
+*/
+typedef struct pvr_opb_stats {
+    uint32_t bin_size[5];           /**< \brief Size of each tile's bin in bytes, per list (0 if disabled) */
+    uint32_t overflow_used[5];      /**< \brief Overflow bytes used by each list in the last frame */
+    uint32_t overflow_used_max[5];  /**< \brief Most overflow bytes used by each list in one frame */
+    uint32_t tiles;                 /**< \brief Number of tiles (and so bins per list) */
+    uint32_t overflow_size;         /**< \brief Size of the overflow space in bytes */
+    uint32_t overflow_total;        /**< \brief Overflow bytes used in the last frame */
+    uint32_t overflow_total_max;    /**< \brief Most overflow bytes used in one frame */
+    uint32_t out_of_memory;         /**< \brief Times the TA ran out of overflow space */
+    uint32_t frames;                /**< \brief Frames measured */
+} pvr_opb_stats_t;
+
+/** \brief   Get the object pointer buffer statistics from the PVR.
+    \ingroup pvr_stats
+
+    The counters are kept since pvr_init() or the last call to
+    pvr_reset_opb_stats().
+
+    \param  stat            The statistics structure to fill in. Must not be
+                            NULL
+    \retval 0               On success
+    \retval -1              If the PVR is not initialized
+*/
+int pvr_get_opb_stats(pvr_opb_stats_t *stat);
+
+/** \brief   Reset the object pointer buffer statistics.
+    \ingroup pvr_stats
+
+    Call this once a scene has been set up, to measure it on its own.
+*/
+void pvr_reset_opb_stats(void);
+
+/** \brief   Suggest object pointer buffer sizes from the statistics.
+    \ingroup pvr_stats
+
+    This fills in the opb_sizes and opb_overflow_count fields of the given
+    parameters from the usage measured so far, leaving the rest alone. Pass in
+    a copy of the parameters given to pvr_init(), run the game through its
+    heaviest scenes, then use the result the next time the PVR is initialized.
+    Any VRAM no longer spent on overflow space is left for textures.
+
+    Only overflow can be measured, so bins are made bigger for lists that
+    overflow a lot, but never smaller. The overflow space is sized for the
+    largest use seen, plus a margin of 25%. If the TA ran out of space, the
+    suggestion is always for more than there is now.
+
+    \param  params          The parameters to update.
+    \retval 0               On success
+    \retval -1              If the PVR is not initialized, or no frames have
+                            been measured
+*/
+int pvr_suggest_opb_sizes(pvr_init_params_t *params);
+
 /** \defgroup pvr_txr_stride    Texture Stride Management
     \brief                      Configuration and retrieval of texture stride settings in VRAM.
     \ingroup                    pvr
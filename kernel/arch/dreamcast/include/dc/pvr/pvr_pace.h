@@ -0,0 +1,165 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_pace.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_pace.h
+    \brief      Frame pacing.
+    \ingroup    pvr_pace
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_PACE_H
+#define __DC_PVR_PVR_PACE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \defgroup pvr_pace      Frame Pacing
+    \brief                  Showing frames at a steady rate, with little lag
+    \ingroup                pvr_scene_mgmt
+
+    Left to itself, the PVR flips to each frame at the first vertical blank
+    after it's rendered, and a program starts its next frame as soon as
+    pvr_wait_ready() lets it. The frame pacer takes over deciding when a frame
+    is started, and keeps track of when it's shown.
+
+    Each frame is meant to be shown at a given vertical blank: every one, or
+    every second one, and so on (the interval). A frame is begun with
+    pvr_pace_begin() instead of pvr_wait_ready(), and ended with
+    pvr_pace_end() just after pvr_scene_finish(). The time between the two is
+    the frame's CPU time, and the time the PVR takes to render it is its
+    render time; both are kept for the last few frames.
+
+    Without just in time starts, a frame is begun right after the vertical
+    blank that the one before it was meant for, so that frames aren't shown
+    at more than the chosen rate. With them, pvr_pace_begin() waits until
+    there is only just enough time left before the frame's vertical blank for
+    the longest CPU and render times seen lately, plus a margin. The program
+    then reads its input and runs its logic as late as it can, which cuts the
+    lag between the player pressing a button and seeing the result. The
+    controllers (or any other Maple devices) can also be polled right then
+    rather than at the last vertical blank, see maple_poll().
+
+    When a frame's render finishes just too late for its vertical blank,
+    the PVR would keep the old frame on the screen for a whole extra one;
+    at 60Hz, a program that misses now and again would keep dropping to
+    30Hz. With late flips, a frame whose render is done within a set time
+    after its vertical blank is flipped to straight away instead. The
+    screen then tears near the top for that one frame, which is usually
+    less noticeable than the stutter.
+
+    The frame pacer needs the PVR to be set up with pvr_init(), and must be
+    shut down before pvr_shutdown(). Frames can't be paced while rendering
+    to a texture with pvr_scene_begin_txr() (use the render target queue
+    instead).
+*/
+
+/** \brief   Frame pacing parameters.
+    \ingroup pvr_pace
+
+    \headerfile dc/pvr/pvr_pace.h
+*/
+typedef struct pvr_pace_params {
+    /** \brief Vertical blanks per frame, from 1 to 4: 1 for 60Hz (50Hz in
+               PAL modes), 2 for 30Hz, and so on. */
+    unsigned int interval;
+
+    /** \brief How long after its vertical blank a frame can still be flipped
+               to, in microseconds, or 0 to never flip late. A few
+               milliseconds keeps the tear in the top part of the screen. */
+    unsigned int late_flip_us;
+
+    /** \brief Start frames just in time for their vertical blank. */
+    bool jit;
+
+    /** \brief Time to leave spare when starting just in time, in
+               microseconds. */
+    unsigned int margin_us;
+
+    /** \brief Maple functions (MAPLE_FUNC_*) to poll when a frame starts
+               just in time, or 0 to rely on the polls at vertical blank. */
+    uint32_t poll_functions;
+} pvr_pace_params_t;
+
+/** \brief   Frame pacing statistics.
+    \ingroup pvr_pace
+
+    The counts are from pvr_pace_init(), the times are for the last frame
+    and the longest of the last few.
+
+    \headerfile dc/pvr/pvr_pace.h
+*/
+typedef struct pvr_pace_stats {
+    uint32_t frames;            /**< \brief Frames begun. */
+    uint32_t on_time;           /**< \brief Frames shown at their vertical
+                                            blank. */
+    uint32_t late;              /**< \brief Frames shown after their
+                                            vertical blank. */
+    uint32_t missed_vbls;       /**< \brief Vertical blanks that the late
+                                            frames missed, in all. */
+    uint32_t late_flips;        /**< \brief Frames flipped to after their
+                                            vertical blank, with a tear. */
+    uint32_t cpu_us;            /**< \brief CPU time of the last frame. */
+    uint32_t cpu_max_us;        /**< \brief Longest recent CPU time. */
+    uint32_t render_us;         /**< \brief Render time of the last frame. */
+    uint32_t render_max_us;     /**< \brief Longest recent render time. */
+    uint32_t wait_us;           /**< \brief Time pvr_pace_begin() last
+                                            waited for, including the PVR. */
+    uint32_t vbl_period_us;     /**< \brief Time between vertical blanks. */
+} pvr_pace_stats_t;
+
+/** \brief   Start pacing frames.
+    \ingroup pvr_pace
+
+    If frames were already being paced, the new parameters are used from the
+    next frame on, and the statistics start over.
+
+    \param  params          The parameters.
+    \retval 0               On success.
+    \retval -1              On error (errno is set to EINVAL if a parameter
+                            won't do, or the PVR isn't set up).
+*/
+int pvr_pace_init(const pvr_pace_params_t *params);
+
+/** \brief   Stop pacing frames.
+    \ingroup pvr_pace
+*/
+void pvr_pace_shutdown(void);
+
+/** \brief   Begin a frame.
+    \ingroup pvr_pace
+
+    This waits for the PVR to be ready for a new scene, as pvr_wait_ready()
+    does, and then for the time the frame should be started. Input should be
+    read and the frame's logic run after this returns, and the scene then
+    built as usual.
+
+    \retval 0               On success.
+    \retval -1              If frames aren't being paced (errno is set to
+                            EINVAL), or the PVR timed out.
+*/
+int pvr_pace_begin(void);
+
+/** \brief   End a frame.
+    \ingroup pvr_pace
+
+    This must be called after pvr_scene_finish(), for each pvr_pace_begin().
+*/
+void pvr_pace_end(void);
+
+/** \brief   Get the frame pacing statistics.
+    \ingroup pvr_pace
+
+    \param  st              Used to return the statistics.
+*/
+void pvr_pace_stats(pvr_pace_stats_t *st);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_PACE_H */
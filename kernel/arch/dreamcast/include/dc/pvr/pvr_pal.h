@@ -25,6 +25,8 @@
 #define __DC_PVR_PVR_PALETTE_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
 #include <sys/cdefs.h>
 __BEGIN_DECLS
@@ -81,11 +83,96 @@ void pvr_set_pal_format(pvr_palfmt_t fmt);
 
     \param  idx             The index to set to (0-1023)
     \param  value           The color value to set in that palette entry
+
+    \sa pvr_pal_stage()
 */
 static inline void pvr_set_pal_entry(uint32_t idx, uint32_t value) {
     PVR_SET(PVR_PALETTE_TABLE_BASE + 4 * idx, value);
 }
 
+/** \defgroup pvr_pal_bank  Palette Banks
+    \brief                  Sharing the palette table, and changing it
+                            between renders
+    \ingroup                pvr_pal_mgmt
+
+    A paletted texture uses one part of the palette table: 16 entries for a
+    4-bit texture, or 256 for an 8-bit one. These can be handed out as banks,
+    so that different parts of a program don't have to agree on who uses
+    which part.
+
+    Setting entries with pvr_set_pal_entry() changes the table straight away,
+    even while the PVR is rendering a frame with it, so a palette animation
+    can end up with half of a frame in the old colors. Entries set with
+    pvr_pal_stage() are only kept in RAM instead. pvr_pal_commit() then has
+    them all written to the table at once, from the PVR's interrupt handlers,
+    at the next vertical blank if nothing is being rendered then, or else
+    just before the next render starts. Every render after that one sees all
+    of the changes, and none before it sees any. Before pvr_init(), the
+    changes are written out straight away.
+
+    Staging and committing should only be done from one thread at a time.
+    Entries set with pvr_set_pal_entry() in between can be overwritten by
+    the next commit, if they're in a 16-entry block that has staged changes.
+*/
+
+/** \brief   Allocate a palette bank.
+    \ingroup pvr_pal_bank
+
+    A bank of 16 entries starts at a multiple of 16, for use with
+    \ref PVR_TXRFMT_4BPP_PAL (with base / 16), and one of 256 entries at a
+    multiple of 256, for \ref PVR_TXRFMT_8BPP_PAL (with base / 256).
+
+    \param  size            The number of entries, 16 or 256.
+    \return                 The index of the bank's first entry, or -1 on
+                            error (errno is set to EINVAL if the size isn't
+                            16 or 256, or ENOMEM if there's no room left).
+*/
+int pvr_pal_bank_alloc(unsigned int size);
+
+/** \brief   Free a palette bank.
+    \ingroup pvr_pal_bank
+
+    \param  base            The index of the bank's first entry, as returned
+                            by pvr_pal_bank_alloc().
+*/
+void pvr_pal_bank_free(int base);
+
+/** \brief   Set a palette entry at the next commit.
+    \ingroup pvr_pal_bank
+
+    \param  idx             The index to set (0-1023).
+    \param  value           The color value for that entry, as for
+                            pvr_set_pal_entry().
+*/
+void pvr_pal_stage(uint32_t idx, uint32_t value);
+
+/** \brief   Set a run of palette entries at the next commit.
+    \ingroup pvr_pal_bank
+
+    \param  idx             The index of the first entry to set.
+    \param  values          The color values.
+    \param  count           The number of entries to set.
+*/
+void pvr_pal_stage_range(uint32_t idx, const uint32_t *values, size_t count);
+
+/** \brief   Commit staged palette entries.
+    \ingroup pvr_pal_bank
+
+    Everything staged since the last commit is written out to the table
+    before the next render starts. This doesn't wait for that.
+
+    \sa pvr_pal_pending()
+*/
+void pvr_pal_commit(void);
+
+/** \brief   Check for committed palette entries not written out yet.
+    \ingroup pvr_pal_bank
+
+    \retval true            If a commit is still waiting to be written out.
+    \retval false           If everything committed is in the table.
+*/
+bool pvr_pal_pending(void);
+
 __END_DECLS 
 
 #endif  /* __DC_PVR_PVR_PALETTE_H */
@@ -135,6 +135,7 @@ __BEGIN_DECLS
 #define PVR_UNK_0110            0x0110  /**< \brief ?? -- write 0x93f39 for now */
 #define PVR_UNK_0114            0x0114  /**< \brief ?? -- write 0x200000 for now */
 #define PVR_UNK_0118            0x0118  /**< \brief ?? -- write 0x8040 for now */
+#define PVR_PT_ALPHA_REF        0x011c  /**< \brief Punch-through alpha test reference */
 
 #define PVR_TA_OPB_START        0x0124  /**< \brief Object Pointer Buffer start for TA usage */
 #define PVR_TA_VERTBUF_START    0x0128  /**< \brief Vertex buffer start for TA usage */
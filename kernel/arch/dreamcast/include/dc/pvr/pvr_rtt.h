@@ -0,0 +1,166 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_rtt.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_rtt.h
+    \brief      Queued renders to texture.
+    \ingroup    pvr_rtt
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_RTT_H
+#define __DC_PVR_PVR_RTT_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_fence.h>
+
+/** \defgroup pvr_rtt   Render Targets
+    \brief              Several renders to texture a frame
+    \ingroup            pvr_scene_mgmt
+
+    pvr_scene_begin_txr() renders a scene the size of the screen into a
+    texture. Shadow maps, reflections and the like usually want something
+    smaller, and several of them a frame, each with its own scene.
+
+    A render target is a texture that scenes can be rendered into, at its own
+    size. Each render into it is queued up as a job, with a function that
+    draws the scene (opening and finishing lists as usual), and
+    pvr_rtt_flush() then runs all of the jobs in the queue one after another,
+    before the screen's scene is begun.
+
+    Only as many tiles as the target needs are registered and rendered, with
+    a tile matrix laid out for its size. Each of the two TA buffers keeps the
+    last layout it was given, so renders into targets of the same size one
+    after another, or every other frame, don't lay it out again.
+
+    Renders to texture don't wait for a page flip, so each job's render is
+    started by the PVR interrupt as soon as its lists are in and the last
+    render is done, back to back; the next job is drawn and sent to the TA
+    while the last one renders.
+
+    Targets can't be used with FSAA.
+*/
+
+/** \brief   Most render targets at once.
+    \ingroup pvr_rtt
+*/
+#define PVR_RTT_MAX_TARGETS 16
+
+/** \brief   Most jobs waiting at once.
+    \ingroup pvr_rtt
+*/
+#define PVR_RTT_MAX_JOBS    16
+
+/** \brief   Draw the scene of a job.
+    \ingroup pvr_rtt
+
+    This is called between the scene's begin and finish, and should draw it
+    the usual way.
+
+    \param  target          The target being rendered into.
+    \param  data            The data passed to pvr_rtt_queue().
+*/
+typedef void (*pvr_rtt_draw_t)(int target, void *data);
+
+/** \brief   Render target statistics.
+    \ingroup pvr_rtt
+
+    Times are in nanoseconds, measured the same way as in pvr_stats_t.
+
+    \headerfile dc/pvr/pvr_rtt.h
+*/
+typedef struct pvr_rtt_stats {
+    uint32_t renders;           /**< \brief Renders done into the target */
+    uint64_t reg_last;          /**< \brief Registration time of the last,
+                                            in nanoseconds */
+    uint64_t rnd_last;          /**< \brief Render time of the last, in
+                                            nanoseconds */
+    uint64_t reg_total;         /**< \brief Registration time of all of
+                                            them, in nanoseconds */
+    uint64_t rnd_total;         /**< \brief Render time of all of them, in
+                                            nanoseconds */
+} pvr_rtt_stats_t;
+
+/** \brief   Set up a texture as a render target.
+    \ingroup pvr_rtt
+
+    The texture must be RGB565 or ARGB1555 (whatever the screen is in),
+    non-twiddled, and \p w pixels across.
+
+    \param  txr             The texture.
+    \param  w               The width, a multiple of 32, at most the width of
+                            the screen.
+    \param  h               The height, a multiple of 32, at most the height of
+                            the screen.
+    \return                 The target, or -1 on error (errno is set to EINVAL
+                            if the size won't do or FSAA is on, or ENOSPC if
+                            there are too many targets).
+*/
+int pvr_rtt_target(pvr_ptr_t txr, uint32_t w, uint32_t h);
+
+/** \brief   Stop using a render target.
+    \ingroup pvr_rtt
+
+    Jobs already queued for it are still run. The texture isn't freed.
+
+    \param  target          The target.
+*/
+void pvr_rtt_target_free(int target);
+
+/** \brief   Queue a render into a target.
+    \ingroup pvr_rtt
+
+    \param  target          The target.
+    \param  draw            The function that draws the scene.
+    \param  data            Passed to \p draw.
+    \retval 0               On success.
+    \retval -1              On error (errno is set to EINVAL if there's no such
+                            target, or ENOSPC if the queue is full).
+*/
+int pvr_rtt_queue(int target, pvr_rtt_draw_t draw, void *data);
+
+/** \brief   Run the queued jobs.
+    \ingroup pvr_rtt
+
+    Each job is a scene of its own, so this must be called between scenes.
+    It returns once the last one has been finished; the renders carry on in
+    the background. Use pvr_rtt_fence() to find out when a target is done.
+
+    Jobs for targets that have been freed since they were queued are dropped.
+
+    \return                 The number of jobs run.
+*/
+int pvr_rtt_flush(void);
+
+/** \brief   Get the fence of the last render into a target.
+    \ingroup pvr_rtt
+
+    Wait for this to reach \ref PVR_FENCE_RENDER_DONE before reading the
+    texture from the CPU; the PVR itself can draw with it in any later
+    scene.
+
+    \param  target          The target.
+    \return                 The fence (0 if nothing has been rendered into it).
+*/
+pvr_fence_t pvr_rtt_fence(int target);
+
+/** \brief   Get the statistics of a render target.
+    \ingroup pvr_rtt
+
+    \param  target          The target.
+    \param  st              Used to return the statistics.
+    \retval 0               On success.
+    \retval -1              If there's no such target.
+*/
+int pvr_rtt_stats(int target, pvr_rtt_stats_t *st);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_RTT_H */
@@ -0,0 +1,218 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_sprite_batch.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_sprite_batch.h
+    \brief      Sorted, batched sprite submission.
+    \ingroup    pvr_sprite_batch
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_SPRITE_BATCH_H
+#define __DC_PVR_PVR_SPRITE_BATCH_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stddef.h>
+#include <dc/pvr.h>
+
+/** \defgroup pvr_sprite_batch  Sprite Batching
+    \brief                     Drawing thousands of sprites a frame
+    \ingroup                   pvr_primitives
+
+    Drawing a sprite the usual way means sending its header, then its
+    vertex, with a pvr_prim() call (and a copy) for each. For a 2D game with
+    thousands of sprites, most of those headers are the same as the one
+    before, and the calls cost more than the data.
+
+    The sprite batcher takes sprites in any order over the course of a frame,
+    each with a state (a sprite header registered ahead of time, which says
+    what texture, blending and list it uses) and a layer. When a list is
+    finished, its sprites are radix sorted by layer and then state, and sent
+    with a single header for each run of sprites with the same state. In
+    direct mode, they're written straight to the TA through the store queues
+    (the same way as the direct rendering API); if the list has a DMA vertex
+    buffer, they're written into that.
+
+    Sprites in the same layer and state stay in the order they were added.
+    Sprites in the same layer with different states don't, which doesn't
+    matter for the opaque and punch-through lists, but does for overlapping
+    sprites in the translucent list without autosort. Put those in different
+    layers (lower layers are drawn first).
+
+    Sprites are sent when their list is closed with pvr_list_finish() (or by
+    pvr_scene_finish(), for lists with a DMA vertex buffer), or earlier with
+    pvr_sprite_batch_submit(). They're thrown away at the next
+    pvr_scene_begin() if not. Headers are sent around the \ref pvr_batch
+    "batching layer", so its idea of the last header sent to the list is
+    reset afterwards.
+*/
+
+/** \brief   Parameters for the sprite batcher.
+    \ingroup pvr_sprite_batch
+
+    \headerfile dc/pvr/pvr_sprite_batch.h
+*/
+typedef struct pvr_sprite_batch_params {
+    /** \brief Most sprites that can be held in a frame, in all lists
+               (at most 65536). Each takes 76 bytes. */
+    size_t max_sprites;
+
+    /** \brief Most states that can be registered (at most 65536). Each takes
+               32 bytes. */
+    size_t max_states;
+} pvr_sprite_batch_params_t;
+
+/** \brief   Sprite batcher statistics.
+    \ingroup pvr_sprite_batch
+
+    \headerfile dc/pvr/pvr_sprite_batch.h
+*/
+typedef struct pvr_sprite_batch_stats {
+    uint64_t sprites;           /**< \brief Sprites sent. */
+    uint64_t headers;           /**< \brief Headers sent (runs of sprites). */
+    uint64_t dropped;           /**< \brief Sprites that didn't fit. */
+    uint64_t sort_passes;       /**< \brief Radix passes done (passes over
+                                            a digit that is the same for every
+                                            sprite are skipped). */
+} pvr_sprite_batch_stats_t;
+
+/** \brief   Set up the sprite batcher.
+    \ingroup pvr_sprite_batch
+
+    Registered states are forgotten.
+
+    \param  params          Sizes of things.
+    \retval 0               On success.
+    \retval -1              On error (errno is set to ENOMEM, or EINVAL if
+                            the sizes are too big).
+*/
+int pvr_sprite_batch_init(const pvr_sprite_batch_params_t *params);
+
+/** \brief   Free everything allocated by pvr_sprite_batch_init().
+    \ingroup pvr_sprite_batch
+*/
+void pvr_sprite_batch_shutdown(void);
+
+/** \brief   Register a sprite state.
+    \ingroup pvr_sprite_batch
+
+    The state is a compiled sprite header, from pvr_sprite_compile(). The
+    list it's for is taken from the header.
+
+    \param  hdr             The header.
+    \return                 The state number, to pass to
+                            pvr_sprite_batch_add(), or -1 if there's no room
+                            for it.
+*/
+int pvr_sprite_batch_state(const pvr_sprite_hdr_t *hdr);
+
+/** \brief   Change a registered state.
+    \ingroup pvr_sprite_batch
+
+    This should be done before any sprites are added with the state in the
+    frame: sprites that already have been are still sorted into the list the
+    state was for before.
+
+    \param  state           The state number.
+    \param  hdr             The new header.
+    \retval 0               On success.
+    \retval -1              If there's no such state.
+*/
+int pvr_sprite_batch_set_state(int state, const pvr_sprite_hdr_t *hdr);
+
+/** \brief   Get the state generation.
+    \ingroup pvr_sprite_batch
+
+    This changes every time the registered states are forgotten, by
+    pvr_sprite_batch_clear_states(), pvr_sprite_batch_init() or
+    pvr_sprite_batch_shutdown(). Code that keeps state numbers around can
+    compare it with the value from when they were registered, to tell whether
+    they're still good.
+
+    \return                 The current generation.
+*/
+uint32_t pvr_sprite_batch_generation(void);
+
+/** \brief   Forget all registered states.
+    \ingroup pvr_sprite_batch
+
+    Sprites held for this frame are thrown away too.
+*/
+void pvr_sprite_batch_clear_states(void);
+
+/** \brief   Add a sprite, to be filled in by the caller.
+    \ingroup pvr_sprite_batch
+
+    This returns the sprite's vertex, so that it can be written in place
+    without a copy. The flags are already set; fill in everything else.
+
+    \param  state           The state to draw the sprite with.
+    \param  layer           The layer to draw it in.
+    \return                 The sprite's vertex, or NULL if there's no room.
+*/
+pvr_sprite_txr_t *pvr_sprite_batch_alloc(int state, uint8_t layer);
+
+/** \brief   Add a sprite.
+    \ingroup pvr_sprite_batch
+
+    \param  state           The state to draw the sprite with.
+    \param  layer           The layer to draw it in.
+    \param  spr             The sprite's vertex. The flags are ignored.
+    \retval 0               On success.
+    \retval -1              If there's no room for it.
+*/
+int pvr_sprite_batch_add(int state, uint8_t layer,
+                         const pvr_sprite_txr_t *spr);
+
+/** \brief   Add an axis-aligned sprite.
+    \ingroup pvr_sprite_batch
+
+    \param  state           The state to draw the sprite with.
+    \param  layer           The layer to draw it in.
+    \param  x               The left edge, in pixels.
+    \param  y               The top edge, in pixels.
+    \param  w               The width, in pixels.
+    \param  h               The height, in pixels.
+    \param  z               The depth (1/w).
+    \param  u0              The left texture coordinate.
+    \param  v0              The top texture coordinate.
+    \param  u1              The right texture coordinate.
+    \param  v1              The bottom texture coordinate.
+    \retval 0               On success.
+    \retval -1              If there's no room for it.
+*/
+int pvr_sprite_batch_rect(int state, uint8_t layer, float x, float y,
+                          float w, float h, float z, float u0, float v0,
+                          float u1, float v1);
+
+/** \brief   Send the sprites held for a list.
+    \ingroup pvr_sprite_batch
+
+    This is done for you when the list is finished. The list must either be
+    the one currently open, or have a DMA vertex buffer.
+
+    \param  list            The list.
+    \retval 0               On success.
+    \retval -1              If the list can't be submitted to right now, or
+                            its DMA vertex buffer is full.
+*/
+int pvr_sprite_batch_submit(pvr_list_t list);
+
+/** \brief   Get the sprite batcher statistics.
+    \ingroup pvr_sprite_batch
+
+    These count up from pvr_sprite_batch_init().
+
+    \param  st              Used to return the statistics.
+*/
+void pvr_sprite_batch_stats(pvr_sprite_batch_stats_t *st);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_SPRITE_BATCH_H */
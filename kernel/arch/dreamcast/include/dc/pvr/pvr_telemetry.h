@@ -0,0 +1,142 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_telemetry.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_telemetry.h
+    \brief      Per-frame PVR timing and throughput records.
+    \ingroup    pvr_telemetry
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_TELEMETRY_H
+#define __DC_PVR_PVR_TELEMETRY_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** \defgroup pvr_telemetry  Frame Records
+    \brief                  Detailed per-frame timing, for finding frame spikes
+    \ingroup                pvr_stats
+
+    pvr_get_stats() gives figures for the last frame only, which makes the odd
+    slow frame hard to catch. Once pvr_telemetry_init() is called, a record is
+    kept of each of the last few hundred (or however many) frames instead:
+    when each stage of the frame started and ended, what went to the TA, and
+    what happened to VRAM. pvr_telemetry_export() writes them out for looking
+    at offline, either as CSV or as a trace that can be loaded into a Chrome
+    style trace viewer (such as chrome://tracing or Perfetto). With dcload,
+    writing to a file under /pc puts it straight on the host.
+
+    What went to each list is counted as it is submitted through pvr_prim(),
+    pvr_list_prim(), command buffers and the DMA vertex buffers. Data written
+    with the direct rendering API (pvr_dr_*) goes straight from the store
+    queues to the TA without passing through anything that could look at it,
+    so it is not counted: the list_bytes, list_hdrs and list_prims fields
+    will be low (or 0) for any list drawn that way. vtx_buf_used still covers
+    everything the TA took in.
+
+    To have their data counted, the \ref pvr_tnl "transform and clip" and
+    \ref pvr_sprite_batch "sprite batching" layers switch from the direct
+    rendering API to pvr_prim() while telemetry is on. pvr_prim() copies
+    through the store queues too, but with a bit more overhead, so frames that
+    use them take slightly longer to build than without telemetry.
+
+    All times are in nanoseconds, as returned by timer_ns_gettime64(). A time
+    is 0 if that stage hasn't happened (for instance, there's no page flip for
+    a frame rendered to a texture).
+*/
+
+/** \brief   The record of one frame.
+    \ingroup pvr_telemetry
+
+    The list arrays are indexed by list (PVR_LIST_*).
+
+    \headerfile dc/pvr/pvr_telemetry.h
+*/
+typedef struct pvr_frame_record {
+    uint32_t frame;             /**< \brief Frame number, counting from 1 */
+    uint32_t vblanks;           /**< \brief VBlanks since the previous page flip
+                                            (more than 1 is a missed frame) */
+    uint64_t begin;             /**< \brief When pvr_scene_begin() was called */
+    uint64_t finish;            /**< \brief When pvr_scene_finish() was called */
+    uint64_t reg_start;         /**< \brief When the TA started taking data */
+    uint64_t reg_end;           /**< \brief When the TA had all of the lists */
+    uint64_t rnd_start;         /**< \brief When rendering started */
+    uint64_t rnd_end;           /**< \brief When rendering finished */
+    uint64_t flip;              /**< \brief When the frame was shown */
+    uint64_t dma_stall;         /**< \brief Time pvr_scene_finish() spent waiting
+                                            for the DMA channel */
+    uint32_t list_bytes[5];     /**< \brief Bytes sent to each list */
+    uint32_t list_hdrs[5];      /**< \brief Polygon, sprite and modifier volume
+                                            headers sent to each list */
+    uint32_t list_prims[5];     /**< \brief Strips, sprites and modifier volume
+                                            triangles sent to each list */
+    uint32_t vtx_buf_used;      /**< \brief Bytes of the TA vertex buffer used */
+    uint32_t vram_free;         /**< \brief Free texture memory at the start of
+                                            the frame */
+    int32_t  vram_delta;        /**< \brief Change in free texture memory since
+                                            the previous frame */
+} pvr_frame_record_t;
+
+/** \brief   Export as comma separated values, one frame per line.
+    \ingroup pvr_telemetry
+*/
+#define PVR_TELEMETRY_CSV       0
+
+/** \brief   Export as a Chrome trace event JSON file.
+    \ingroup pvr_telemetry
+*/
+#define PVR_TELEMETRY_TRACE     1
+
+/** \brief   Start keeping frame records.
+    \ingroup pvr_telemetry
+
+    Any records already kept are thrown away.
+
+    \param  frames          How many frames to keep records of (at least 4).
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - frames is less than 4 \n
+    \em     ENOMEM - out of memory
+*/
+int pvr_telemetry_init(size_t frames);
+
+/** \brief   Stop keeping frame records, and free them.
+    \ingroup pvr_telemetry
+*/
+void pvr_telemetry_shutdown(void);
+
+/** \brief   Copy out the frame records.
+    \ingroup pvr_telemetry
+
+    Only frames that have made it all the way through the pipeline are
+    copied, oldest first.
+
+    \param  recs            Where to copy the records to.
+    \param  max             The most records to copy.
+    \return                 The number of records copied.
+*/
+size_t pvr_telemetry_read(pvr_frame_record_t *recs, size_t max);
+
+/** \brief   Write the frame records to a file.
+    \ingroup pvr_telemetry
+
+    \param  fn              The file to write to.
+    \param  format          PVR_TELEMETRY_CSV or PVR_TELEMETRY_TRACE.
+    \retval 0               On success.
+    \retval -1              If there are no records, or on error writing
+                            the file.
+*/
+int pvr_telemetry_export(const char *fn, int format);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_TELEMETRY_H */
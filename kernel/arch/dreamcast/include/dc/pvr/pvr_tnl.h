@@ -0,0 +1,140 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_tnl.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_tnl.h
+    \brief      Transforming, clipping and submitting vertex strips.
+    \ingroup    pvr_tnl
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_TNL_H
+#define __DC_PVR_PVR_TNL_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <dc/pvr.h>
+
+/** \defgroup pvr_tnl  Transform and Clip
+    \brief            Submitting 3D strips with near plane clipping
+    \ingroup          pvr_list_mgmt
+
+    mat_transform_sq() is the fastest way to get 3D vertices to the TA, but it
+    has no answer for geometry that crosses the near plane: a vertex behind
+    the camera ends up with a negative 1/w and the triangle is drawn inside
+    out. pvr_tnl_submit() deals with that. It takes strips of pvr_vertex_t in
+    object space, as mat_transform_sq() does, and looks at each strip as a
+    whole first:
+
+    - If all of it is off the same side of the screen, or behind the near
+      plane, nothing is sent (trivial reject).
+    - If none of it is behind the near plane, it goes straight through
+      mat_transform_sq() (trivial accept). Anything off the sides of the
+      screen is left for the PVR to clip.
+    - Otherwise, it's taken a triangle at a time. Triangles in front of the
+      near plane are sent as strips still, and triangles that cross it are
+      clipped against it (Sutherland-Hodgman), with UVs and colors
+      interpolated, and sent as a strip of their own.
+
+    The matrix used is the one loaded in XMTRX, which should take vertices all
+    the way to the screen, as for mat_transform_sq() (for instance, the screen
+    view, projection and model view matrices multiplied together). The near
+    plane is a plane of constant W after that transform.
+
+    Vertices go to wherever the list is going: into its DMA vertex buffer, if
+    it has one, or straight to the TA through the store queues, in which case
+    the list has to be open. Either way, the polygon header has to be sent
+    first as usual.
+*/
+
+/** \name    Outcodes
+    \brief   Which side of the view volume a vertex is outside of.
+    \ingroup pvr_tnl
+    @{
+*/
+#define PVR_TNL_LEFT    0x01    /**< \brief Left of the viewport */
+#define PVR_TNL_RIGHT   0x02    /**< \brief Right of the viewport */
+#define PVR_TNL_TOP     0x04    /**< \brief Above the viewport */
+#define PVR_TNL_BOTTOM  0x08    /**< \brief Below the viewport */
+#define PVR_TNL_NEAR    0x10    /**< \brief In front of the near plane */
+/** @} */
+
+/** \brief   Transform and clip statistics.
+    \ingroup pvr_tnl
+
+    \headerfile dc/pvr/pvr_tnl.h
+*/
+typedef struct pvr_tnl_stats {
+    uint32_t vertices_in;       /**< \brief Vertices passed in */
+    uint32_t vertices_out;      /**< \brief Vertices sent to the PVR */
+    uint32_t strips_accepted;   /**< \brief Strips sent whole */
+    uint32_t strips_rejected;   /**< \brief Strips thrown away whole */
+    uint32_t strips_split;      /**< \brief Strips taken a triangle at a time */
+    uint32_t tris_clipped;      /**< \brief Triangles clipped to the near plane */
+    uint32_t tris_rejected;     /**< \brief Triangles thrown away from split strips */
+} pvr_tnl_stats_t;
+
+/** \brief   Set the rectangle strips are rejected against.
+    \ingroup pvr_tnl
+
+    Strips entirely outside of this rectangle are thrown away. This defaults
+    to the whole screen. It does not clip anything; the PVR does that.
+
+    \param  x0              Left edge, in pixels.
+    \param  y0              Top edge, in pixels.
+    \param  x1              Right edge, in pixels.
+    \param  y1              Bottom edge, in pixels.
+*/
+void pvr_tnl_set_viewport(float x0, float y0, float x1, float y1);
+
+/** \brief   Set the near clipping plane.
+    \ingroup pvr_tnl
+
+    Vertices with a transformed W smaller than this are behind the near
+    plane. It defaults to 0.01, and must be more than 0.
+
+    \param  w               The W of the near plane.
+*/
+void pvr_tnl_set_near(float w);
+
+/** \brief   Transform, clip and submit strips.
+    \ingroup pvr_tnl
+
+    Strips are as in pvr_vertex_t: each ends with a vertex whose flags are
+    PVR_CMD_VERTEX_EOL, and all others have PVR_CMD_VERTEX. The x, y and z of
+    each vertex are in object space; everything else is copied as it is (or
+    interpolated, for vertices made by clipping).
+
+    \param  list            The list to submit to.
+    \param  verts           The vertices (at least 4-byte aligned).
+    \param  count           The number of vertices.
+    \retval 0               On success.
+    \retval -1              If the list isn't open and has no DMA buffer, or
+                            its DMA buffer is full.
+*/
+int pvr_tnl_submit(pvr_list_t list, const pvr_vertex_t *verts, size_t count);
+
+/** \brief   Get the transform and clip statistics.
+    \ingroup pvr_tnl
+
+    These count up from pvr_init(), or the last pvr_tnl_reset_stats().
+
+    \param  stats           Where to put them.
+*/
+void pvr_tnl_get_stats(pvr_tnl_stats_t *stats);
+
+/** \brief   Reset the transform and clip statistics.
+    \ingroup pvr_tnl
+*/
+void pvr_tnl_reset_stats(void);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_TNL_H */
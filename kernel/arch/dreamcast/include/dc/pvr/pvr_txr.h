@@ -25,6 +25,7 @@
 #define __DC_PVR_PVR_TEXTURE_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include <sys/cdefs.h>
 __BEGIN_DECLS
@@ -63,9 +64,17 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32_t count);
 #define PVR_TXRLOAD_4BPP            0x01    /**< \brief 4BPP format */
 #define PVR_TXRLOAD_8BPP            0x02    /**< \brief 8BPP format */
 #define PVR_TXRLOAD_16BPP           0x03    /**< \brief 16BPP format */
+#define PVR_TXRLOAD_32BPP_ARGB4444  0x04    /**< \brief 32BPP ARGB8888, loaded as ARGB4444 */
+#define PVR_TXRLOAD_32BPP_ARGB1555  0x05    /**< \brief 32BPP ARGB8888, loaded as ARGB1555 */
+#define PVR_TXRLOAD_32BPP_RGB565    0x06    /**< \brief 32BPP ARGB8888, loaded as RGB565 */
+#define PVR_TXRLOAD_32BPP           PVR_TXRLOAD_32BPP_ARGB4444  /**< \brief 32BPP format */
+#define PVR_TXRLOAD_16BPP_RGB565    0x07    /**< \brief 16BPP format, RGB565 */
+#define PVR_TXRLOAD_16BPP_ARGB1555  0x08    /**< \brief 16BPP format, ARGB1555 */
+#define PVR_TXRLOAD_16BPP_ARGB4444  0x09    /**< \brief 16BPP format, ARGB4444 */
 #define PVR_TXRLOAD_FMT_MASK        0x0f    /**< \brief Bits used for basic formats */
 
-#define PVR_TXRLOAD_VQ_LOAD         0x10    /**< \brief Do VQ encoding (not supported yet, if ever) */
+#define PVR_TXRLOAD_VQ_LOAD         0x10    /**< \brief Do VQ encoding */
+#define PVR_TXRLOAD_VQ_MIPMAP       0x100   /**< \brief Add mipmaps when VQ encoding */
 #define PVR_TXRLOAD_INVERT_Y        0x20    /**< \brief Invert the Y axis while loading */
 #define PVR_TXRLOAD_FMT_VQ          0x40    /**< \brief Texture is already VQ encoded */
 #define PVR_TXRLOAD_FMT_TWIDDLED    0x80    /**< \brief Texture is already twiddled */
@@ -82,11 +91,27 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32_t count);
     This function loads a texture to the PVR's RAM with the specified set of
     flags. It will currently always twiddle the data, whether you ask it to or
     not, and many of the parameters are just plain not supported at all...
-    Pretty much the only supported flag, other than the format ones is the
-    PVR_TXRLOAD_INVERT_Y one.
+    Other than the format ones, the only supported flags are
+    PVR_TXRLOAD_INVERT_Y, PVR_TXRLOAD_FMT_VQ, PVR_TXRLOAD_VQ_LOAD and
+    PVR_TXRLOAD_VQ_MIPMAP.
 
-    This will be slower than using pvr_txr_load() in pretty much all cases, so
-    unless you need to twiddle your texture, just use that instead.
+    32bpp source data is in ARGB8888 format (one 32-bit word per texel), and is
+    converted to the 16bpp format named in the flags as it is loaded, so the
+    texture takes up the same amount of VRAM as a 16bpp one.
+
+    With PVR_TXRLOAD_FMT_VQ, the source must be a 2048 byte codebook followed by
+    (w / 2) * (h / 2) bytes of indices in row order. The codebook is copied as
+    it is, and the indices are twiddled. VQ textures can't be inverted.
+
+    With PVR_TXRLOAD_VQ_LOAD, the (16bpp or 32bpp) source is compressed with
+    pvr_txr_vq_encode() before it is loaded, so dst only needs to have room
+    for pvr_txr_vq_size() bytes. Plain PVR_TXRLOAD_16BPP data is taken to be
+    RGB565 here; use one of the more specific 16bpp formats for anything else.
+
+    The data is twiddled in 8x8 texel tiles and written out to VRAM through the
+    store queues, so the destination must be 32-byte aligned. Even so, this
+    will be slower than using pvr_txr_load(), so unless you need to twiddle
+    your texture, just use that instead.
 
     \param  src             The location to copy from.
     \param  dst             The location to copy to.
@@ -99,6 +124,53 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32_t count);
 void pvr_txr_load_ex(const void *src, pvr_ptr_t dst,
                      uint32_t w, uint32_t h, uint32_t flags);
 
+/** \brief   Find out how big a VQ compressed texture is.
+    \ingroup pvr_txr_mgmt
+
+    \param  w               The width of the texture, in pixels.
+    \param  h               The height of the texture, in pixels.
+    \param  mipmap          Non-zero if the texture has mipmaps.
+    \return                 The size of the texture in bytes, including the
+                            codebook.
+*/
+size_t pvr_txr_vq_size(uint32_t w, uint32_t h, int mipmap);
+
+/** \brief   VQ compress a texture.
+    \ingroup pvr_txr_mgmt
+
+    This function compresses a 16bpp or 32bpp texture into a VQ texture with a
+    full 256 entry codebook, about an eighth of the size of the original. The
+    codebook is built by running k-means on (a sample of) the texture's 2x2
+    blocks for a fixed number of iterations, so the time taken is predictable,
+    but the quality won't be as good as that of the offline tools.
+
+    The output is laid out the same way as the output of `vqenc -t` (and
+    `vqenc -t -m` with mipmaps) and pvrtex: the codebook, followed by the
+    twiddled index data, ready to be loaded with pvr_txr_load(). Use
+    \ref PVR_TXRFMT_VQ_ENABLE (and \ref PVR_TXRFMT_TWIDDLED) with the format
+    in the flags when drawing with it.
+
+    \param  src             The texture to compress.
+    \param  dst             Where to put the result. This must have room for
+                            pvr_txr_vq_size() bytes.
+    \param  w               The width of the texture, in pixels.
+    \param  h               The height of the texture, in pixels.
+    \param  flags           One of the 16bpp or 32bpp format flags, and
+                            optionally PVR_TXRLOAD_VQ_MIPMAP and/or
+                            PVR_TXRLOAD_INVERT_Y.
+    \param  iterations      The number of k-means iterations to do, or 0 for
+                            the default (8).
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - the format or size is not supported (w and h must be
+                     powers of two from 8 to 1024, and equal for mipmaps) \n
+    \em     ENOMEM - out of memory
+*/
+int pvr_txr_vq_encode(const void *src, void *dst, uint32_t w, uint32_t h,
+                      uint32_t flags, int iterations);
+
 /** \brief   Load a KOS Platform Independent Image (subject to constraint
              checking).
     \ingroup pvr_txr_mgmt
@@ -126,7 +198,11 @@ void pvr_txr_load_ex(const void *src, pvr_ptr_t dst,
                             \ref PVR_TXRLOAD_INVERT_Y in the flags.
     \note                   DMA and Store Queue based loading is not available
                             from this function if it twiddles the texture while
-                            loading.
+                            loading (the twiddler always writes through the
+                            Store Queues itself).
+    \note                   KOS_IMG_FMT_ARGB8888 images are converted to
+                            ARGB4444 while they are twiddled, and cannot be
+                            loaded without twiddling.
 */
 void pvr_txr_load_kimg(const kos_img_t *img, pvr_ptr_t dst, uint32_t flags);
 
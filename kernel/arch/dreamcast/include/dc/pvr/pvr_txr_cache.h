@@ -0,0 +1,233 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_txr_cache.h
+   Copyright (C) 2026 The KOS Team and contributors
+*/
+
+/** \file       dc/pvr/pvr_txr_cache.h
+    \brief      VRAM texture residency cache.
+    \ingroup    pvr_txr_cache
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_PVR_PVR_TXR_CACHE_H
+#define __DC_PVR_PVR_TXR_CACHE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <dc/pvr.h>
+
+/** \defgroup pvr_txr_cache  Residency Cache
+    \brief                  Streaming textures in and out of VRAM
+    \ingroup                pvr_txr_mgmt
+
+    The texture cache keeps track of a set of textures that may be much larger
+    than VRAM, and keeps the ones that are in use resident. Each texture is
+    registered once with the location of its data (a file, or a buffer in main
+    RAM) and is referred to by an ID after that.
+
+    Every frame, look up the textures you draw with pvr_txr_cache_get(). A
+    texture that isn't in VRAM is queued to be loaded by a worker thread, and in
+    the meantime you get a placeholder texture to draw with instead. The worker
+    reads the data and DMAs it to VRAM, uploading no more than a set number of
+    bytes each frame so that loading doesn't steal all of the bus bandwidth.
+    When VRAM runs out, the textures that have gone unused the longest are
+    evicted to make room.
+
+    Call pvr_txr_cache_frame() once per frame, after pvr_scene_finish(). It
+    moves the frame counter on, and that is what eviction and the upload budget
+    are based on. A texture is never evicted until it has gone unused for a few
+    frames, so that the PVR is done rendering with it.
+
+    Texture data is uploaded as-is, so it must already be in the format the
+    PVR expects (twiddled, VQ compressed and so on, to match the format given
+    when it was registered).
+*/
+
+/** \brief   Parameters for the texture cache.
+    \ingroup pvr_txr_cache
+
+    \headerfile dc/pvr/pvr_txr_cache.h
+*/
+typedef struct pvr_txr_cache_params {
+    /** \brief Maximum number of textures that can be registered. */
+    size_t max_textures;
+
+    /** \brief Most VRAM the cache may use, in bytes (0 for no limit, other
+               than how much pvr_mem_malloc() can find). */
+    size_t vram_size;
+
+    /** \brief Most bytes uploaded in one frame (0 for no limit). A texture
+               larger than this is uploaded in a frame by itself. */
+    size_t frame_budget;
+
+    /** \brief Frames a texture must go unused before it can be evicted. Values
+               smaller than 2 are treated as 2. */
+    unsigned int min_age;
+} pvr_txr_cache_params_t;
+
+/** \brief   A texture looked up from the cache.
+    \ingroup pvr_txr_cache
+
+    Either the texture asked for, or the placeholder if it isn't resident yet.
+    Use the fields to fill in a polygon context.
+
+    \headerfile dc/pvr/pvr_txr_cache.h
+*/
+typedef struct pvr_txr_cache_txr {
+    pvr_ptr_t ptr;          /**< \brief Texture address in VRAM. */
+    uint32_t fmt;           /**< \brief Texture format (PVR_TXRFMT_*). */
+    uint16_t w;             /**< \brief Texture width. */
+    uint16_t h;             /**< \brief Texture height. */
+} pvr_txr_cache_txr_t;
+
+/** \brief   Statistics about the texture cache.
+    \ingroup pvr_txr_cache
+
+    \headerfile dc/pvr/pvr_txr_cache.h
+*/
+typedef struct pvr_txr_cache_stats {
+    uint64_t lookups;       /**< \brief Calls to pvr_txr_cache_get(). */
+    uint64_t hits;          /**< \brief Lookups that found the texture resident. */
+    uint64_t uploads;       /**< \brief Textures uploaded. */
+    uint64_t bytes_uploaded;    /**< \brief Total bytes uploaded. */
+    uint32_t frame_bytes;   /**< \brief Bytes uploaded in the last frame. */
+    uint32_t evictions;     /**< \brief Textures evicted to make room. */
+    uint32_t errors;        /**< \brief Textures that could not be loaded. */
+    uint32_t resident;      /**< \brief Textures in VRAM. */
+    uint32_t resident_bytes;    /**< \brief VRAM used by the cache. */
+    uint32_t queued;        /**< \brief Textures waiting to be loaded. */
+    uint32_t frame;         /**< \brief Frame counter. */
+} pvr_txr_cache_stats_t;
+
+/** \brief   Initialize the texture cache.
+    \ingroup pvr_txr_cache
+
+    This starts the worker thread. The PVR must already be initialized.
+
+    \param  params          Cache parameters.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EEXIST - the cache is already initialized \n
+    \em     EINVAL - max_textures is 0 \n
+    \em     ENOMEM - out of memory
+*/
+int pvr_txr_cache_init(const pvr_txr_cache_params_t *params);
+
+/** \brief   Shut down the texture cache.
+    \ingroup pvr_txr_cache
+
+    This waits for the worker to finish what it's doing, then frees all of the
+    textures the cache has in VRAM. The placeholder is not freed.
+*/
+void pvr_txr_cache_shutdown(void);
+
+/** \brief   Register a texture to be loaded from a file.
+    \ingroup pvr_txr_cache
+
+    \param  fn              The file to load from. The name is copied.
+    \param  offset          Where in the file the texture data starts.
+    \param  size            The size of the texture data in bytes.
+    \param  w               The width of the texture.
+    \param  h               The height of the texture.
+    \param  fmt             The texture format (PVR_TXRFMT_*).
+    \return                 The texture's ID, or -1 on error (with errno set to
+                            ENOSPC if max_textures are already registered).
+*/
+int pvr_txr_cache_add_file(const char *fn, uint32_t offset, size_t size,
+                           uint16_t w, uint16_t h, uint32_t fmt);
+
+/** \brief   Register a texture to be loaded from main RAM.
+    \ingroup pvr_txr_cache
+
+    The data is not copied, so it must stay where it is until the texture is
+    removed. It is fastest if it is 32-byte aligned.
+
+    \param  data            The texture data.
+    \param  size            The size of the texture data in bytes.
+    \param  w               The width of the texture.
+    \param  h               The height of the texture.
+    \param  fmt             The texture format (PVR_TXRFMT_*).
+    \return                 The texture's ID, or -1 on error.
+*/
+int pvr_txr_cache_add_mem(const void *data, size_t size, uint16_t w,
+                          uint16_t h, uint32_t fmt);
+
+/** \brief   Forget about a texture.
+    \ingroup pvr_txr_cache
+
+    If the texture is resident, its VRAM is freed after min_age frames, so it
+    is safe to remove a texture that was drawn in the frame being rendered.
+
+    \param  id              The texture to remove.
+    \retval 0               On success.
+    \retval -1              If the ID is not valid.
+*/
+int pvr_txr_cache_remove(int id);
+
+/** \brief   Set the placeholder texture.
+    \ingroup pvr_txr_cache
+
+    The placeholder is returned by pvr_txr_cache_get() for textures that aren't
+    resident yet. It belongs to the caller, and isn't managed by the cache.
+
+    \param  ptr             Placeholder texture address in VRAM.
+    \param  w               Placeholder width.
+    \param  h               Placeholder height.
+    \param  fmt             Placeholder format (PVR_TXRFMT_*).
+*/
+void pvr_txr_cache_set_placeholder(pvr_ptr_t ptr, uint16_t w, uint16_t h,
+                                   uint32_t fmt);
+
+/** \brief   Look up a texture to draw with this frame.
+    \ingroup pvr_txr_cache
+
+    This marks the texture as used in this frame. If it isn't resident, it is
+    queued to be loaded, and the placeholder is returned instead.
+
+    \param  id              The texture to look up.
+    \param  rv              Used to return the texture (or the placeholder).
+    \retval 1               If the texture is resident.
+    \retval 0               If the placeholder was returned.
+    \retval -1              If the ID is not valid.
+*/
+int pvr_txr_cache_get(int id, pvr_txr_cache_txr_t *rv);
+
+/** \brief   Queue a texture to be loaded without using it.
+    \ingroup pvr_txr_cache
+
+    Use this to get textures that will be needed soon loaded ahead of time.
+    This does not count as a lookup in the statistics.
+
+    \param  id              The texture to load.
+    \retval 0               On success.
+    \retval -1              If the ID is not valid.
+*/
+int pvr_txr_cache_prefetch(int id);
+
+/** \brief   Move on to the next frame.
+    \ingroup pvr_txr_cache
+
+    Call this once per frame, after pvr_scene_finish(). It ages the textures
+    and resets the upload budget.
+*/
+void pvr_txr_cache_frame(void);
+
+/** \brief   Get statistics about the texture cache.
+    \ingroup pvr_txr_cache
+
+    \param  st              Used to return the statistics.
+    \retval 0               On success.
+    \retval -1              If the cache is not initialized.
+*/
+int pvr_txr_cache_stats(pvr_txr_cache_stats_t *st);
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_TXR_CACHE_H */
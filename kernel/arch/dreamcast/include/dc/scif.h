@@ -206,6 +206,18 @@ uint8 scif_spi_read_byte(void);
 */
 void scif_spi_read_data(uint8 *buffer, size_t len);
 
+/** \brief  Write a block of data to the SPI device.
+
+    This function writes data to the SPI device, ignoring anything that comes
+    back from it. Timing follows that of the scif_spi_write_byte() function, but
+    without the overhead of a function call for each byte. If the buffer is
+    aligned and len is divisible by 4, further optimizations are applied.
+
+    \param  buffer          Buffer of data to write.
+    \param  len             Number of bytes to write to the device.
+*/
+void scif_spi_write_data(const uint8 *buffer, size_t len);
+
 /** @} */
 
 __END_DECLS
@@ -0,0 +1,134 @@
+/* KallistiOS ##version##
+
+   dc/vid_capture.h
+   Copyright (C) 2026 The KOS Team and contributors
+
+*/
+
+/** \file    dc/vid_capture.h
+    \brief   Continuous capture of the screen to files.
+    \ingroup video_capture
+
+    \author The KOS Team and contributors
+*/
+
+#ifndef __DC_VID_CAPTURE_H
+#define __DC_VID_CAPTURE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+
+/** \defgroup video_capture Capture
+    \brief                  Saving what's on the screen, frame after frame
+    \ingroup                video_display
+
+    vid_screen_shot() converts and writes the whole framebuffer on the
+    calling thread, which stalls the program for as long as that takes. This
+    is meant for capturing many frames in a row, while the program goes on
+    running at full speed.
+
+    Each frame is copied out of VRAM by the SH4's DMA controller (channel 3)
+    into one of a ring of buffers in main RAM, as it is. A worker thread of
+    lower priority than the default then compresses the buffers in order, as
+    QOI images (a simple lossless format, see https://qoiformat.org), and
+    writes each to a file of its own. The worker only runs while every thread
+    of higher priority is waiting, e.g. in pvr_wait_ready().
+
+    Frames are grabbed at vertical blank, every so many of them, or whenever
+    vid_capture_frame() is called. If there's no free buffer, as the worker
+    hasn't caught up, the frame is dropped. What can be kept up with depends
+    mostly on how fast the files can be written; /pc is a lot slower than an
+    SD card.
+
+    The pixels are copied out of the framebuffer that's being displayed. With
+    the PVR, the frame that's on the screen isn't rendered into until it has
+    been flipped away from, so grabs at vertical blank (if capture was started
+    after pvr_init()) always get a whole frame.
+*/
+
+/** \brief   Capture settings.
+    \ingroup video_capture
+
+    \headerfile dc/vid_capture.h
+*/
+typedef struct vid_capture_params {
+    /** \brief  Where to write the frames.
+
+        A printf() format, with one conversion for the frame number (an
+        unsigned int, counting from 0), e.g. "/pc/frame%05u.qoi".
+    */
+    const char *path;
+
+    /** \brief  Number of RAM buffers (at least 2).
+
+        Each takes as much memory as the framebuffer.
+    */
+    unsigned int buffers;
+
+    /** \brief  Vertical blanks between grabs.
+
+        1 grabs every frame, 2 every other one, and so on. 0 only grabs frames
+        when vid_capture_frame() is called.
+    */
+    unsigned int interval;
+} vid_capture_params_t;
+
+/** \brief   Capture statistics.
+    \ingroup video_capture
+
+    \headerfile dc/vid_capture.h
+*/
+typedef struct vid_capture_stats {
+    uint32_t grabbed;           /**< \brief Frames copied out of VRAM */
+    uint32_t dropped;           /**< \brief Frames skipped, with no free buffer */
+    uint32_t written;           /**< \brief Frames written out */
+    uint32_t errors;            /**< \brief Frames that couldn't be written */
+    uint64_t bytes_in;          /**< \brief Bytes of framebuffer written out */
+    uint64_t bytes_out;         /**< \brief Bytes of files written */
+} vid_capture_stats_t;
+
+/** \brief   Start capturing.
+    \ingroup video_capture
+
+    The video mode mustn't change while capturing.
+
+    \param  params          The settings.
+    \retval 0               On success.
+    \retval -1              On error (errno is set to EEXIST if capture has
+                            already been started, EINVAL if a setting won't do,
+                            or ENOMEM if out of memory).
+*/
+int vid_capture_start(const vid_capture_params_t *params);
+
+/** \brief   Stop capturing.
+    \ingroup video_capture
+
+    This waits for every frame that has been grabbed to be written out.
+*/
+void vid_capture_stop(void);
+
+/** \brief   Grab the frame on the screen now.
+    \ingroup video_capture
+
+    This only starts the copy, and returns straight away. It's best called
+    just after vertical blank (e.g. just after pvr_wait_ready()), so that the
+    copy is done before the PVR can flip away from the frame.
+
+    \retval 0               On success.
+    \retval -1              On error (errno is set to EAGAIN if there's no free
+                            buffer, or EINVAL if capture hasn't been started).
+*/
+int vid_capture_frame(void);
+
+/** \brief   Get the capture statistics.
+    \ingroup video_capture
+
+    \param  stats           Used to return the statistics.
+*/
+void vid_capture_stats(vid_capture_stats_t *stats);
+
+__END_DECLS
+
+#endif  /* __DC_VID_CAPTURE_H */
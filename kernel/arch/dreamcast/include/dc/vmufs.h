@@ -282,6 +282,25 @@ int vmufs_fat_free(vmu_root_t * root, uint16 * fat);
 */
 int vmufs_dir_free(vmu_root_t * root, vmu_dir_t * dir);
 
+/** \brief  Throw away the cached filesystem metadata for a VMU.
+
+    The high-level functions below keep a copy of the root block, FAT and
+    directory of each VMU in memory, so they don't have to read them all back
+    in for every operation. This function discards that copy, so that it will
+    be read from the VMU again the next time it is needed. Any changes that
+    have not been written back yet are lost.
+
+    You don't normally need to call this yourself. It is done automatically
+    when a VMU is unplugged and when vmufs_root_write(), vmufs_dir_write() or
+    vmufs_fat_write() are called. You only need it if you modify the
+    filesystem some other way (i.e, by calling vmu_block_write() directly).
+
+    This function is safe to call from an interrupt.
+
+    \param  dev             The VMU to invalidate.
+*/
+void vmufs_invalidate(maple_device_t * dev);
+
 /** \brief  Lock the vmufs mutex.
 
     This should be done before you attempt any low-level ops.
@@ -382,6 +401,55 @@ int vmufs_delete(maple_device_t * dev, const char * fn);
 int vmufs_free_blocks(maple_device_t * dev);
 
 
+/** \brief  Write back any pending changes to a VMU's FAT and directory.
+
+    Normally, each call to vmufs_write() or vmufs_delete() writes the changed
+    FAT and directory blocks back to the VMU before it returns, so there is
+    nothing for this function to do. Inside of a batch (see
+    vmufs_batch_begin()), this can be used to write everything done so far
+    back to the VMU without ending the batch.
+
+    \param  dev             The VMU to sync.
+    \retval 0               On success.
+    \retval -1              If the FAT could not be written (or dev is not
+                            usable).
+    \retval -2              If the directory could not be written.
+*/
+int vmufs_sync(maple_device_t * dev);
+
+/** \brief  Start a batch of changes to a VMU.
+
+    Until the matching call to vmufs_batch_end(), vmufs_write() and
+    vmufs_delete() will only update the in-memory copy of the VMU's FAT and
+    directory, and will not write them back to the VMU. This saves a lot of
+    time when writing or deleting several files at once, as the (shared) FAT
+    and directory blocks only get written once at the end.
+
+    The catch is that if the VMU is unplugged (or the power goes out) before
+    the batch ends, none of the files written during the batch will show up,
+    and any files deleted or overwritten during the batch may be damaged.
+    Batches may be nested, in which case only the outermost vmufs_batch_end()
+    writes anything back.
+
+    \param  dev             The VMU to start a batch on.
+    \retval 0               On success.
+    \retval -1              If the VMU could not be read.
+*/
+int vmufs_batch_begin(maple_device_t * dev);
+
+/** \brief  Finish a batch of changes to a VMU.
+
+    This writes back everything changed since the matching call to
+    vmufs_batch_begin(), if this ends the outermost batch.
+
+    \param  dev             The VMU to end the batch on.
+    \retval 0               On success.
+    \retval -1              If the FAT could not be written (or dev is not
+                            usable).
+    \retval -2              If the directory could not be written.
+*/
+int vmufs_batch_end(maple_device_t * dev);
+
 /** \brief  Initialize vmufs.
 
     Must be called before anything else is useful.
@@ -392,7 +460,8 @@ int vmufs_init(void);
 
 /** \brief  Shutdown vmufs.
 
-    Must be called after everything is finished.
+    Must be called after everything is finished. Any changes left over from an
+    unfinished batch are written back to their VMUs.
 */
 int vmufs_shutdown(void);
 
@@ -0,0 +1,283 @@
+/* KallistiOS ##version##
+
+   matrix_batch.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   Matrix and vector operations on arrays
+*/
+
+#include <dc/fmath.h>
+#include <dc/matrix.h>
+#include <dc/matrix_batch.h>
+
+/* Boxes culled per pass; see mat_cull_aabbs(). */
+#define CULL_BLOCK  32
+
+void mat_skin_points(const matrix_t *palette, const vector_t *in,
+                     const mat_skin_weights_t *weights, vector_t *out,
+                     int count) {
+    float x, y, z, w, ox, oy, oz, ow, wt;
+    int i, j, bone, loaded = -1;
+
+    for(i = 0; i < count; i++, in++, out++, weights++) {
+        ox = oy = oz = ow = 0.0f;
+
+        for(j = 0; j < 4; j++) {
+            wt = weights->weight[j];
+
+            if(wt == 0.0f)
+                break;
+
+            bone = weights->bone[j];
+
+            if(bone != loaded) {
+                mat_load(palette + bone);
+                loaded = bone;
+            }
+
+            x = in->x;
+            y = in->y;
+            z = in->z;
+            w = 1.0f;
+            mat_trans_nodiv(x, y, z, w);
+
+            ox += x * wt;
+            oy += y * wt;
+            oz += z * wt;
+            ow += w * wt;
+        }
+
+        out->x = ox;
+        out->y = oy;
+        out->z = oz;
+        out->w = ow;
+    }
+}
+
+void mat_transform_normals(const vector_t *in, vector_t *out, int count) {
+    float x, y, z, w, l;
+    int i;
+
+    for(i = 0; i < count; i++, in++, out++) {
+        x = in->x;
+        y = in->y;
+        z = in->z;
+        w = 0.0f;
+        mat_trans_nodiv(x, y, z, w);
+
+        l = fipr_magnitude_sqr(x, y, z, 0.0f);
+
+        if(l > 0.0f) {
+            l = frsqrt(l);
+            x *= l;
+            y *= l;
+            z *= l;
+        }
+
+        out->x = x;
+        out->y = y;
+        out->z = z;
+        out->w = 0.0f;
+    }
+}
+
+/* Transform one column of a matrix by the internal matrix. */
+static inline void trans_col(float *col, float x, float y, float z, float w) {
+    mat_trans_nodiv(x, y, z, w);
+    col[0] = x;
+    col[1] = y;
+    col[2] = z;
+    col[3] = w;
+}
+
+void mat_quat_palette(matrix_t *out, const vector_t *rot, const vector_t *pos,
+                      int count) {
+    float qx, qy, qz, qw, xx, yy, zz, xy, xz, yz, wx, wy, wz;
+    int i;
+
+    for(i = 0; i < count; i++, out++, rot++) {
+        qx = rot->x;
+        qy = rot->y;
+        qz = rot->z;
+        qw = rot->w;
+
+        xx = qx * qx * 2.0f;
+        yy = qy * qy * 2.0f;
+        zz = qz * qz * 2.0f;
+        xy = qx * qy * 2.0f;
+        xz = qx * qz * 2.0f;
+        yz = qy * qz * 2.0f;
+        wx = qw * qx * 2.0f;
+        wy = qw * qy * 2.0f;
+        wz = qw * qz * 2.0f;
+
+        trans_col((*out)[0], 1.0f - yy - zz, xy + wz, xz - wy, 0.0f);
+        trans_col((*out)[1], xy - wz, 1.0f - xx - zz, yz + wx, 0.0f);
+        trans_col((*out)[2], xz + wy, yz - wx, 1.0f - xx - yy, 0.0f);
+
+        if(pos) {
+            trans_col((*out)[3], pos->x, pos->y, pos->z, 1.0f);
+            pos++;
+        }
+        else {
+            trans_col((*out)[3], 0.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+}
+
+/* Store plane p (a * x + b * y + c * z + d >= 0 inside) into its slot in the
+   frustum. Plane 4 * k + r goes in row r of planes[k], so that FTRV gives the
+   distance to four planes at once. */
+static void set_plane(mat_frustum_t *f, int p, float a, float b, float c,
+                      float d) {
+    float l = fipr_magnitude_sqr(a, b, c, 0.0f);
+    int k = p >> 2, r = p & 3;
+
+    /* Scale the plane so that distances come out in the units of the bounds,
+       for the sphere radius to make sense. */
+    if(l > 0.0f) {
+        l = frsqrt(l);
+        a *= l;
+        b *= l;
+        c *= l;
+        d *= l;
+    }
+
+    f->planes[k][0][r] = a;
+    f->planes[k][1][r] = b;
+    f->planes[k][2][r] = c;
+    f->planes[k][3][r] = d;
+    f->abs_planes[k][0][r] = a < 0.0f ? -a : a;
+    f->abs_planes[k][1][r] = b < 0.0f ? -b : b;
+    f->abs_planes[k][2][r] = c < 0.0f ? -c : c;
+    f->abs_planes[k][3][r] = 0.0f;
+}
+
+void mat_frustum_extract(mat_frustum_t *f, const matrix_t *m, float x0,
+                         float y0, float x1, float y1, float near_w,
+                         float far_w) {
+    const float (*c)[4] = *m;
+    int i;
+
+    /* Row i of the matrix is (c[0][i], c[1][i], c[2][i], c[3][i]). The point
+       is inside when x0 * W <= X <= x1 * W, and so on. */
+    set_plane(f, 0, c[0][0] - x0 * c[0][3], c[1][0] - x0 * c[1][3],
+              c[2][0] - x0 * c[2][3], c[3][0] - x0 * c[3][3]);
+    set_plane(f, 1, x1 * c[0][3] - c[0][0], x1 * c[1][3] - c[1][0],
+              x1 * c[2][3] - c[2][0], x1 * c[3][3] - c[3][0]);
+    set_plane(f, 2, c[0][1] - y0 * c[0][3], c[1][1] - y0 * c[1][3],
+              c[2][1] - y0 * c[2][3], c[3][1] - y0 * c[3][3]);
+    set_plane(f, 3, y1 * c[0][3] - c[0][1], y1 * c[1][3] - c[1][1],
+              y1 * c[2][3] - c[2][1], y1 * c[3][3] - c[3][1]);
+    set_plane(f, 4, c[0][3], c[1][3], c[2][3], c[3][3] - near_w);
+    set_plane(f, 5, -c[0][3], -c[1][3], -c[2][3], far_w - c[3][3]);
+
+    /* The last two rows test the near and far planes a second time, which
+       is cheaper than testing for them being empty. */
+    for(i = 0; i < 4; i++) {
+        f->planes[1][i][2] = f->planes[1][i][0];
+        f->planes[1][i][3] = f->planes[1][i][1];
+        f->abs_planes[1][i][2] = f->abs_planes[1][i][0];
+        f->abs_planes[1][i][3] = f->abs_planes[1][i][1];
+    }
+}
+
+/* Combine the result of testing against four planes with what was found
+   before. */
+static inline uint8_t cull_merge(uint8_t prev, float d0, float d1, float d2,
+                                 float d3, float e0, float e1, float e2,
+                                 float e3) {
+    if(d0 < -e0 || d1 < -e1 || d2 < -e2 || d3 < -e3)
+        return MAT_CULL_OUTSIDE;
+
+    if(prev == MAT_CULL_INSIDE && d0 >= e0 && d1 >= e1 && d2 >= e2 &&
+       d3 >= e3)
+        return MAT_CULL_INSIDE;
+
+    return MAT_CULL_INTERSECT;
+}
+
+int mat_cull_spheres(const mat_frustum_t *f, const vector_t *spheres,
+                     uint8_t *result, int count) {
+    float x, y, z, w, r;
+    int i, k, rv = 0;
+
+    /* One pass for each set of four planes, so the matrix is only loaded
+       twice. */
+    for(k = 0; k < 2; k++) {
+        mat_load(&f->planes[k]);
+
+        for(i = 0; i < count; i++) {
+            if(k && result[i] == MAT_CULL_OUTSIDE)
+                continue;
+
+            x = spheres[i].x;
+            y = spheres[i].y;
+            z = spheres[i].z;
+            w = 1.0f;
+            r = spheres[i].w;
+            mat_trans_nodiv(x, y, z, w);
+
+            result[i] = cull_merge(k ? result[i] : MAT_CULL_INSIDE,
+                                   x, y, z, w, r, r, r, r);
+        }
+    }
+
+    for(i = 0; i < count; i++)
+        rv += result[i] != MAT_CULL_OUTSIDE;
+
+    return rv;
+}
+
+int mat_cull_aabbs(const mat_frustum_t *f, const mat_aabb_t *boxes,
+                   uint8_t *result, int count) {
+    vector_t d[CULL_BLOCK];
+    float x, y, z, w;
+    int i, k, n, base, rv = 0;
+
+    /* Each test needs the distance from the center to the planes, and the
+       extent of the box along their normals, which come from different
+       matrices. Find the distances for a block of boxes first, then the
+       extents, to keep the number of matrix loads down. */
+    for(base = 0; base < count; base += CULL_BLOCK) {
+        n = count - base < CULL_BLOCK ? count - base : CULL_BLOCK;
+
+        for(k = 0; k < 2; k++) {
+            mat_load(&f->planes[k]);
+
+            for(i = 0; i < n; i++) {
+                x = boxes[base + i].center.x;
+                y = boxes[base + i].center.y;
+                z = boxes[base + i].center.z;
+                w = 1.0f;
+                mat_trans_nodiv(x, y, z, w);
+                d[i].x = x;
+                d[i].y = y;
+                d[i].z = z;
+                d[i].w = w;
+            }
+
+            mat_load(&f->abs_planes[k]);
+
+            for(i = 0; i < n; i++) {
+                if(k && result[base + i] == MAT_CULL_OUTSIDE)
+                    continue;
+
+                x = boxes[base + i].extent.x;
+                y = boxes[base + i].extent.y;
+                z = boxes[base + i].extent.z;
+                w = 0.0f;
+                mat_trans_nodiv(x, y, z, w);
+
+                result[base + i] =
+                    cull_merge(k ? result[base + i] : MAT_CULL_INSIDE,
+                               d[i].x, d[i].y, d[i].z, d[i].w, x, y, z, w);
+            }
+        }
+    }
+
+    for(i = 0; i < count; i++)
+        rv += result[i] != MAT_CULL_OUTSIDE;
+
+    return rv;
+}
@@ -2,33 +2,214 @@
 
    util/fb_console.c
    Copyright (C) 2009 Lawrence Sebald
+   Copyright (C) 2026 The KOS Team and contributors
 
 */
 
 #include <string.h>
 #include <errno.h>
 #include <kos/dbgio.h>
+#include <kos/mutex.h>
+#include <kos/worker_thread.h>
+#include <arch/irq.h>
 #include <dc/fb_console.h>
 #include <dc/biosfont.h>
 #include <dc/video.h>
+#include <dc/vblank.h>
+#include <dc/sq.h>
 
 /* This is a very simple dbgio interface for doing debug to the framebuffer with
    the biosfont functionality. Basically, this was written to aid in debugging
    the network stack, and I figured other people would probably get some use out
    of it as well. */
 
+/* Writing a character only puts it in a grid of character cells, which is
+   a ring of lines so that scrolling is just moving the top of the ring. The
+   grid is drawn later on, by a worker thread woken at vertical blank (or by
+   dbgio_flush()): the framebuffer is scrolled once for all the lines that went
+   by since the last time, and then only the cells that are different from
+   what's on the screen are drawn. Inside an interrupt or with interrupts
+   disabled (a panic, or an exception being reported), the worker won't get
+   to run, so the grid is drawn right away, without the store queues. */
+
 static uint16 *fb;
 static int fb_w, fb_h;
-static int cur_x, cur_y;
 static int min_x, min_y, max_x, max_y;
 
 #define FONT_CHAR_WIDTH 12
 #define FONT_CHAR_HEIGHT 24
 
+/* Largest grid that's kept, enough for 1152x1152. Anything past it isn't
+   used. */
+#define MAX_COLS 96
+#define MAX_ROWS 48
+
+/* What's in a cell that has never been drawn: "nothing written" in the grid,
+   or "not known" for what's on the screen. */
+#define CELL_EMPTY      0x00
+#define CELL_UNKNOWN    0xff
+
+/* The grid, as a ring of lines starting at top, and the cursor (on the
+   screen, not in the ring). Only changed with interrupts disabled. */
+static uint8 text[MAX_ROWS * MAX_COLS];
+static uint8 dirty[MAX_ROWS];
+static int cols, rows, top;
+static int cur_col, cur_row;
+static int scrolled;
+
+/* What's on the screen, by line, and where it was drawn. Only used with
+   draw_lock held. */
+static uint8 shown[MAX_ROWS * MAX_COLS];
+static uint8 snap[MAX_ROWS * MAX_COLS];
+static uint8 snap_dirty[MAX_ROWS];
+static uint16 *shown_t;
+static mutex_t draw_lock = MUTEX_INITIALIZER;
+
+static kthread_worker_t *worker;
+static int vbl_hnd = -1;
+
 static int fb_detected(void) {
     return 1;
 }
 
+/* Whether the worker can't be relied on, and nothing can be waited for. */
+static int fb_atomic(void) {
+    return irq_inside_int() || (irq_get_sr() & 0xf0);
+}
+
+/* Move lines [from, rows) of the screen up to start at line to. */
+static void fb_move_lines(uint16 *t, int to, int from) {
+    uint16 *dst = t + (min_y + to * FONT_CHAR_HEIGHT) * fb_w;
+    uint16 *src = t + (min_y + from * FONT_CHAR_HEIGHT) * fb_w;
+    size_t len = (rows - from) * FONT_CHAR_HEIGHT * fb_w * 2;
+
+    /* The store queues only write to aligned blocks, and copy forwards, which
+       is fine as dst is before src. */
+    if(t == vram_s && !((uintptr_t)dst & 31) && !((uintptr_t)src & 3) &&
+       !(len & 31) && !fb_atomic())
+        sq_cpy(dst, src, len);
+    else
+        memmove(dst, src, len);
+}
+
+static void fb_clear_lines(uint16 *t, int first, int count) {
+    uint16 *dst = t + (min_y + first * FONT_CHAR_HEIGHT) * fb_w;
+    size_t len = count * FONT_CHAR_HEIGHT * fb_w * 2;
+
+    if(t == vram_s && !((uintptr_t)dst & 31) && !(len & 31) && !fb_atomic())
+        sq_set(dst, 0, len);
+    else
+        memset(dst, 0, len);
+}
+
+/* Bring the screen up to date with the grid. If wait is 0 and someone else is
+   drawing, this leaves it to them. wait must be 0 if fb_atomic(). */
+static void fb_draw(int wait) {
+    irq_mask_t old;
+    uint16 *t;
+    uint8 c;
+    int r, col, i, n, all;
+
+    if(wait)
+        mutex_lock(&draw_lock);
+    else if(mutex_trylock(&draw_lock))
+        return;
+
+    t = fb ? fb : vram_s;
+
+    /* If the target moved (e.g. vram_s after a flip), what's there isn't
+       known any more, and every line has to be drawn again. */
+    all = t != shown_t;
+
+    /* Take a copy of the lines that changed, so that writers never wait on
+       the drawing. */
+    old = irq_disable();
+
+    n = scrolled;
+    scrolled = 0;
+
+    for(r = 0; r < rows; r++) {
+        snap_dirty[r] = dirty[r] || all;
+        dirty[r] = 0;
+
+        if(snap_dirty[r])
+            memcpy(snap + r * cols, text + ((top + r) % rows) * cols, cols);
+    }
+
+    irq_restore(old);
+
+    if(all) {
+        memset(shown, CELL_UNKNOWN, sizeof(shown));
+        shown_t = t;
+        n = 0;
+    }
+
+    /* Scroll what's on the screen once, however many lines it was. */
+    if(n) {
+        if(n < rows) {
+            fb_move_lines(t, 0, n);
+            memmove(shown, shown + n * cols, (rows - n) * cols);
+        }
+        else {
+            n = rows;
+        }
+
+        fb_clear_lines(t, rows - n, n);
+        memset(shown + (rows - n) * cols, CELL_EMPTY, n * cols);
+    }
+
+    for(r = 0; r < rows; r++) {
+        if(!snap_dirty[r])
+            continue;
+
+        for(col = 0; col < cols; col++) {
+            i = r * cols + col;
+            c = snap[i];
+
+            if(c == shown[i] || (c == CELL_EMPTY && shown[i] == CELL_UNKNOWN))
+                continue;
+
+            bfont_draw(t + (min_y + r * FONT_CHAR_HEIGHT) * fb_w + min_x +
+                       col * FONT_CHAR_WIDTH, fb_w, 1,
+                       c == CELL_EMPTY ? ' ' : c);
+            shown[i] = c;
+        }
+    }
+
+    mutex_unlock(&draw_lock);
+}
+
+static void fb_worker(void *data) {
+    (void)data;
+    fb_draw(1);
+}
+
+static void fb_vblank(uint32 code, void *data) {
+    int r;
+
+    (void)code;
+    (void)data;
+
+    if(scrolled) {
+        thd_worker_wakeup(worker);
+        return;
+    }
+
+    for(r = 0; r < rows; r++) {
+        if(dirty[r]) {
+            thd_worker_wakeup(worker);
+            return;
+        }
+    }
+}
+
+/* Get what was written onto the screen: at the next vertical blank if the
+   worker is running and will get to run, otherwise now. */
+static void fb_kick(void) {
+    if(!worker || fb_atomic())
+        fb_draw(0);
+}
+
 static int fb_init(void) {
     bfont_set_encoding(BFONT_CODE_ISO8859_1);
 
@@ -38,10 +219,36 @@ static int fb_init(void) {
     else
         dbgio_fb_set_target(NULL, vid_mode->width, vid_mode->height, 32, 32);
 
+    /* Once the video mode is set, vertical blank and threads are up too. Until
+       then, everything is drawn as soon as it's written. */
+    if(vid_mode && !worker) {
+        worker = thd_worker_create(fb_worker, NULL);
+
+        if(worker) {
+            thd_set_label(thd_worker_get_thread(worker), "[fb_console]");
+            vbl_hnd = vblank_handler_add(fb_vblank, NULL);
+
+            if(vbl_hnd < 0) {
+                thd_worker_destroy(worker);
+                worker = NULL;
+            }
+        }
+    }
+
     return 0;
 }
 
 static int fb_shutdown(void) {
+    if(worker) {
+        vblank_handler_remove(vbl_hnd);
+        vbl_hnd = -1;
+
+        thd_worker_destroy(worker);
+        worker = NULL;
+
+        fb_draw(!fb_atomic());
+    }
+
     return 0;
 }
 
@@ -55,49 +262,81 @@ static int fb_read(void) {
     return -1;
 }
 
-static int fb_write(int c) {
-    uint16 *t = fb;
+/* Go to the start of the next line, scrolling the grid if that's off the
+   bottom. Interrupts must be disabled. */
+static void fb_newline(void) {
+    int r;
 
-    if(!t)
-        t = vram_s;
+    cur_col = 0;
 
-    if(c != '\n') {
-        bfont_draw(t + cur_y * fb_w + cur_x, fb_w, 1, c);
-        cur_x += FONT_CHAR_WIDTH;
-    }
+    if(++cur_row < rows)
+        return;
 
-    /* If we have a newline or we've gone past the end of the line, advance down
-       one line. */
-    if(c == '\n' || cur_x + FONT_CHAR_WIDTH > max_x) {
-        cur_y += FONT_CHAR_HEIGHT;
-        cur_x = min_x;
-
-        /* If going down a line put us over the edge of the screen, move
-           everything up a line, fixing the problem. */
-        if(cur_y + FONT_CHAR_HEIGHT > max_y) {
-            memcpy(t + min_y * fb_w, t + (min_y + FONT_CHAR_HEIGHT) * fb_w,
-                    (cur_y - min_y - FONT_CHAR_HEIGHT) * fb_w * 2);
-            cur_y -= FONT_CHAR_HEIGHT;
-            memset(t + cur_y * fb_w, 0, FONT_CHAR_HEIGHT * fb_w * 2);
-        }
+    cur_row = rows - 1;
+    top = (top + 1) % rows;
+    memset(text + ((top + cur_row) % rows) * cols, CELL_EMPTY, cols);
+
+    if(scrolled < rows)
+        scrolled++;
+
+    /* Every line is somewhere else on the screen now. */
+    for(r = 0; r < rows; r++)
+        dirty[r] = 1;
+}
+
+static void fb_put(int c) {
+    if(!rows || !cols)
+        return;
+
+    if(c == '\n') {
+        fb_newline();
+        return;
     }
 
+    /* Writing a cell as empty would leave what was there before. */
+    if((uint8)c == CELL_EMPTY)
+        c = ' ';
+
+    text[((top + cur_row) % rows) * cols + cur_col] = (uint8)c;
+    dirty[cur_row] = 1;
+
+    /* If we've gone past the end of the line, advance down one line. */
+    if(++cur_col >= cols)
+        fb_newline();
+}
+
+static int fb_write(int c) {
+    irq_mask_t old = irq_disable();
+
+    fb_put(c);
+
+    irq_restore(old);
+    fb_kick();
+
     return 1;
 }
 
 static int fb_flush(void) {
+    fb_draw(!fb_atomic());
+
     return 0;
 }
 
 static int fb_write_buffer(const uint8 *data, int len, int xlat) {
+    irq_mask_t old;
     int rv = len;
 
     (void)xlat;
 
+    old = irq_disable();
+
     while(len--) {
-        fb_write((int)(*data++));
+        fb_put((int)(*data++));
     }
 
+    irq_restore(old);
+    fb_kick();
+
     return rv;
 }
 
@@ -122,6 +361,15 @@ dbgio_handler_t dbgio_fb = {
 };
 
 void dbgio_fb_set_target(uint16 *t, int w, int h, int borderx, int bordery) {
+    irq_mask_t old;
+    int locked = !fb_atomic();
+
+    /* Don't pull the target out from under a draw. */
+    if(locked)
+        mutex_lock(&draw_lock);
+
+    old = irq_disable();
+
     /* Set up all the new parameters. */
     fb = t;
 
@@ -131,6 +379,32 @@ void dbgio_fb_set_target(uint16 *t, int w, int h, int borderx, int bordery) {
     min_y = bordery;
     max_x = fb_w - borderx;
     max_y = fb_h - bordery;
-    cur_x = min_x;
-    cur_y = min_y;
+
+    cols = (max_x - min_x) / FONT_CHAR_WIDTH;
+    rows = (max_y - min_y) / FONT_CHAR_HEIGHT;
+
+    if(cols < 0)
+        cols = 0;
+    else if(cols > MAX_COLS)
+        cols = MAX_COLS;
+
+    if(rows < 0)
+        rows = 0;
+    else if(rows > MAX_ROWS)
+        rows = MAX_ROWS;
+
+    /* Start over with an empty grid, drawn over whatever is there. */
+    memset(text, CELL_EMPTY, sizeof(text));
+    memset(dirty, 0, sizeof(dirty));
+    memset(shown, CELL_EMPTY, sizeof(shown));
+    shown_t = fb ? fb : vram_s;
+    top = 0;
+    cur_col = 0;
+    cur_row = 0;
+    scrolled = 0;
+
+    irq_restore(old);
+
+    if(locked)
+        mutex_unlock(&draw_lock);
 }
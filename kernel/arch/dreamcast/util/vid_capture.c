@@ -0,0 +1,442 @@
+/* KallistiOS ##version##
+
+   vid_capture.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <errno.h>
+#include <dc/video.h>
+#include <dc/vblank.h>
+#include <dc/vid_capture.h>
+#include <kos/fs.h>
+#include <kos/dbglog.h>
+#include <kos/genwait.h>
+#include <kos/thread.h>
+#include <arch/irq.h>
+#include <arch/cache.h>
+#include <arch/dmac.h>
+
+/*
+
+   Screen capture
+
+   Please see ../include/dc/vid_capture.h for more info on this API!
+
+   Each buffer in the ring is FREE, being filled by the DMA, READY to be
+   written out, or being written out by the worker. Grabs (at vertical blank,
+   or from vid_capture_frame()) fill the buffers in ring order, and the worker
+   writes them out in the same order, so the frames come out in the order
+   they were grabbed. A grab that finds the next buffer isn't FREE drops the
+   frame. Grabs happen with interrupts disabled, and the DMA completion
+   interrupt marks the buffer READY and wakes the worker.
+
+   The worker only ever reads the buffers, so their cache lines are never
+   dirty and can't be written back over what the DMA puts there; it
+   invalidates them before reading each new frame.
+
+*/
+
+#define CAP_FREE    0
+#define CAP_DMA     1
+#define CAP_READY   2
+#define CAP_WRITING 3
+
+/* Size of the chunks the compressed image is written out in */
+#define CAP_OUT_SIZE    (32 * 1024)
+
+typedef struct {
+    uint8_t         *data;
+    volatile int    state;
+    unsigned int    frame;
+} cap_buf_t;
+
+static cap_buf_t *cap_bufs;
+static unsigned int cap_count;
+static unsigned int cap_grab_next, cap_write_next;
+static unsigned int cap_frame;
+static unsigned int cap_interval, cap_vbl_count;
+static int cap_vbl_handle = -1;
+static char *cap_path;
+static bool cap_quit;
+static kthread_t *cap_thd;
+
+static uint32_t cap_w, cap_h, cap_size;
+static vid_pixel_mode_t cap_pm;
+
+static vid_capture_stats_t cap_stats;
+
+static uint8_t cap_out[CAP_OUT_SIZE];
+static size_t cap_out_len;
+
+static void cap_dma_done(void *data);
+
+static dma_config_t cap_dma_config = {
+    .channel = DMA_CHANNEL_3,
+    .request = DMA_REQUEST_AUTO_MEM_TO_MEM,
+    .unit_size = DMA_UNITSIZE_32BYTE,
+    .src_mode = DMA_ADDRMODE_INCREMENT,
+    .dst_mode = DMA_ADDRMODE_INCREMENT,
+    .transmit_mode = DMA_TRANSMITMODE_CYCLE_STEAL,
+    .callback = cap_dma_done
+};
+
+/* Called with interrupts disabled. */
+static int cap_grab(void) {
+    cap_buf_t *b = cap_bufs + cap_grab_next;
+
+    if(b->state != CAP_FREE) {
+        ++cap_stats.dropped;
+        return -1;
+    }
+
+    b->state = CAP_DMA;
+
+    if(dma_transfer(&cap_dma_config, hw_to_dma_addr((uintptr_t)b->data),
+                    hw_to_dma_addr((uintptr_t)vram_l), cap_size, b) < 0) {
+        b->state = CAP_FREE;
+        ++cap_stats.dropped;
+        return -1;
+    }
+
+    b->frame = cap_frame++;
+    cap_grab_next = (cap_grab_next + 1) % cap_count;
+    ++cap_stats.grabbed;
+
+    return 0;
+}
+
+static void cap_dma_done(void *data) {
+    cap_buf_t *b = (cap_buf_t *)data;
+
+    b->state = CAP_READY;
+    genwait_wake_all((void *)&cap_bufs);
+}
+
+static void cap_vblank(uint32 code, void *data) {
+    (void)code;
+    (void)data;
+
+    if(++cap_vbl_count >= cap_interval) {
+        cap_vbl_count = 0;
+        cap_grab();
+    }
+}
+
+/* QOI encoding, see https://qoiformat.org/qoi-specification.pdf */
+
+#define QOI_OP_INDEX    0x00
+#define QOI_OP_DIFF     0x40
+#define QOI_OP_LUMA     0x80
+#define QOI_OP_RUN      0xc0
+#define QOI_OP_RGB      0xfe
+
+static int cap_flush(file_t f) {
+    if(fs_write(f, cap_out, cap_out_len) != (ssize_t)cap_out_len)
+        return -1;
+
+    cap_stats.bytes_out += cap_out_len;
+    cap_out_len = 0;
+
+    return 0;
+}
+
+static inline void put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* Get pixel i of the frame, as 0x00rrggbb. */
+static inline uint32_t cap_pixel(const uint8_t *src, uint32_t i) {
+    uint32_t p;
+
+    switch(cap_pm) {
+        case PM_RGB555:
+            p = ((const uint16_t *)src)[i];
+            return ((p & 0x7c00) << 9) | ((p & 0x03e0) << 6) |
+                   ((p & 0x001f) << 3);
+        case PM_RGB565:
+            p = ((const uint16_t *)src)[i];
+            return ((p & 0xf800) << 8) | ((p & 0x07e0) << 5) |
+                   ((p & 0x001f) << 3);
+        case PM_RGB888P:
+            src += i * 3;
+            return (src[2] << 16) | (src[1] << 8) | src[0];
+        default:
+            return ((const uint32_t *)src)[i] & 0xffffff;
+    }
+}
+
+static int cap_encode(file_t f, const uint8_t *src) {
+    uint32_t index[64];
+    uint32_t px, prev = 0, i, n = cap_w * cap_h;
+    unsigned int run = 0, h;
+    int8_t dr, dg, db;
+    int dr_dg, db_dg;
+    uint8_t *o;
+
+    /* The decoder's index starts out as transparent black, which no pixel
+       here matches, so start with every entry empty. */
+    memset(index, 0xff, sizeof(index));
+
+    memcpy(cap_out, "qoif", 4);
+    put32(cap_out + 4, cap_w);
+    put32(cap_out + 8, cap_h);
+    cap_out[12] = 3;            /* RGB */
+    cap_out[13] = 0;            /* sRGB */
+    cap_out_len = 14;
+
+    for(i = 0; i < n; i++) {
+        /* Room for the longest op, and the end marker */
+        if(cap_out_len > CAP_OUT_SIZE - 16 && cap_flush(f) < 0)
+            return -1;
+
+        o = cap_out + cap_out_len;
+        px = cap_pixel(src, i);
+
+        if(px == prev) {
+            if(++run == 62 || i == n - 1) {
+                *o = QOI_OP_RUN | (run - 1);
+                cap_out_len++;
+                run = 0;
+            }
+
+            continue;
+        }
+
+        if(run) {
+            *o++ = QOI_OP_RUN | (run - 1);
+            cap_out_len++;
+            run = 0;
+        }
+
+        /* Alpha is always 255, which adds 255 * 11 to the hash. */
+        h = ((px >> 16) * 3 + ((px >> 8) & 0xff) * 5 + (px & 0xff) * 7 +
+             255 * 11) % 64;
+
+        if(index[h] == px) {
+            *o = QOI_OP_INDEX | h;
+            cap_out_len++;
+        }
+        else {
+            index[h] = px;
+
+            dr = (int8_t)((px >> 16) - (prev >> 16));
+            dg = (int8_t)((px >> 8) - (prev >> 8));
+            db = (int8_t)(px - prev);
+            dr_dg = dr - dg;
+            db_dg = db - dg;
+
+            if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 &&
+               db >= -2 && db <= 1) {
+                *o = QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) |
+                     (db + 2);
+                cap_out_len++;
+            }
+            else if(dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                    db_dg >= -8 && db_dg <= 7) {
+                o[0] = QOI_OP_LUMA | (dg + 32);
+                o[1] = ((dr_dg + 8) << 4) | (db_dg + 8);
+                cap_out_len += 2;
+            }
+            else {
+                o[0] = QOI_OP_RGB;
+                o[1] = px >> 16;
+                o[2] = px >> 8;
+                o[3] = px;
+                cap_out_len += 4;
+            }
+        }
+
+        prev = px;
+    }
+
+    /* End marker */
+    memcpy(cap_out + cap_out_len, "\0\0\0\0\0\0\0\1", 8);
+    cap_out_len += 8;
+
+    return cap_flush(f);
+}
+
+static void cap_write(cap_buf_t *b) {
+    char fn[256];
+    file_t f;
+
+    dcache_inval_range((uintptr_t)b->data, cap_size);
+
+    snprintf(fn, sizeof(fn), cap_path, b->frame);
+
+    f = fs_open(fn, O_WRONLY | O_TRUNC);
+    if(f < 0) {
+        dbglog(DBG_ERROR, "vid_capture: can't open output file '%s'\n", fn);
+        ++cap_stats.errors;
+        return;
+    }
+
+    if(cap_encode(f, b->data) < 0) {
+        dbglog(DBG_ERROR, "vid_capture: can't write data to output file '%s'\n",
+               fn);
+        ++cap_stats.errors;
+    }
+    else {
+        ++cap_stats.written;
+        cap_stats.bytes_in += cap_size;
+    }
+
+    fs_close(f);
+}
+
+static void *cap_worker(void *param) {
+    cap_buf_t *b;
+    int old;
+
+    (void)param;
+
+    for(;;) {
+        b = cap_bufs + cap_write_next;
+
+        /* On the way out, carry on until every grabbed frame is written. */
+        old = irq_disable();
+
+        while(b->state != CAP_READY && !(cap_quit && b->state == CAP_FREE))
+            genwait_wait((void *)&cap_bufs, "vid_capture", 0, NULL);
+
+        if(b->state == CAP_READY)
+            b->state = CAP_WRITING;
+
+        irq_restore(old);
+
+        if(b->state != CAP_WRITING)
+            break;
+
+        cap_write(b);
+
+        b->state = CAP_FREE;
+        cap_write_next = (cap_write_next + 1) % cap_count;
+    }
+
+    return NULL;
+}
+
+static void cap_free(void) {
+    unsigned int i;
+
+    for(i = 0; i < cap_count; i++)
+        free(cap_bufs[i].data);
+
+    free(cap_bufs);
+    free(cap_path);
+    cap_bufs = NULL;
+    cap_path = NULL;
+}
+
+int vid_capture_start(const vid_capture_params_t *params) {
+    kthread_attr_t attr = { 0 };
+    unsigned int i;
+
+    if(cap_bufs) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    if(!params->path || params->buffers < 2 || vid_mode->pm > PM_RGB0888) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    cap_w = vid_mode->width;
+    cap_h = vid_mode->height;
+    cap_pm = vid_mode->pm;
+
+    /* The DMA moves 32 bytes at a time. */
+    cap_size = (cap_w * cap_h * vid_pmode_bpp[cap_pm] + 31) & ~31;
+
+    cap_count = params->buffers;
+    cap_grab_next = cap_write_next = 0;
+    cap_frame = 0;
+    cap_interval = params->interval;
+    cap_vbl_count = 0;
+    cap_quit = false;
+    memset(&cap_stats, 0, sizeof(cap_stats));
+
+    if(!(cap_bufs = calloc(cap_count, sizeof(cap_buf_t))) ||
+       !(cap_path = strdup(params->path)))
+        goto nomem;
+
+    for(i = 0; i < cap_count; i++) {
+        if(!(cap_bufs[i].data = memalign(32, cap_size)))
+            goto nomem;
+
+        /* Drop anything malloc() left dirty in the cache. */
+        dcache_inval_range((uintptr_t)cap_bufs[i].data, cap_size);
+    }
+
+    attr.label = "vid_capture";
+    attr.prio = PRIO_DEFAULT + 1;
+
+    if(!(cap_thd = thd_create_ex(&attr, cap_worker, NULL)))
+        goto nomem;
+
+    if(cap_interval &&
+       (cap_vbl_handle = vblank_handler_add(cap_vblank, NULL)) < 0) {
+        vid_capture_stop();
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+
+nomem:
+    cap_free();
+    errno = ENOMEM;
+    return -1;
+}
+
+void vid_capture_stop(void) {
+    int old;
+
+    if(!cap_bufs)
+        return;
+
+    if(cap_vbl_handle >= 0) {
+        vblank_handler_remove(cap_vbl_handle);
+        cap_vbl_handle = -1;
+    }
+
+    old = irq_disable();
+    cap_quit = true;
+    genwait_wake_all((void *)&cap_bufs);
+    irq_restore(old);
+
+    thd_join(cap_thd, NULL);
+    cap_thd = NULL;
+
+    cap_free();
+}
+
+int vid_capture_frame(void) {
+    irq_disable_scoped();
+
+    if(!cap_bufs) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(cap_grab() < 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return 0;
+}
+
+void vid_capture_stats(vid_capture_stats_t *stats) {
+    irq_disable_scoped();
+    *stats = cap_stats;
+}
@@ -0,0 +1,515 @@
+/* KallistiOS ##version##
+
+   blockdev_cache.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+*/
+
+/*
+
+This module implements a block device that sits on top of another block device
+and caches its blocks. See kos/blockdev_cache.h for an overview.
+
+The cache is a fixed array of slots, each holding one device block. Slots are
+kept on an LRU list and in a hash table keyed on the block number. Dirty slots
+are never written out one at a time: whenever a dirty slot needs to be evicted
+(or the device is flushed), every dirty slot is written out in one sweep, in
+ascending block order starting from where the last sweep left off. Adjacent
+blocks in the sweep are copied to a bounce buffer and written with a single
+request.
+
+Nothing in here touches any hardware, so this can be tested on the host by
+wrapping a block device that reads and writes a disk image file.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/queue.h>
+
+#include <kos/mutex.h>
+#include <kos/blockdev_cache.h>
+
+#define SLOT_VALID  1
+#define SLOT_DIRTY  2
+
+typedef struct bdc_slot {
+    TAILQ_ENTRY(bdc_slot) lru;
+    struct bdc_slot *hnext;
+    uint64_t block;
+    uint32_t flags;
+    uint8_t *data;
+} bdc_slot_t;
+
+TAILQ_HEAD(bdc_lru, bdc_slot);
+
+typedef struct bdc {
+    kos_blockdev_t dev;         /* The device being cached */
+    mutex_t lock;
+
+    size_t bs;                  /* Bytes per block */
+    size_t nslots;
+    size_t readahead;
+    size_t merge_max;
+    uint32_t hmask;
+
+    bdc_slot_t *slots;
+    bdc_slot_t **hash;
+    bdc_slot_t **sorted;        /* Scratch space for sorting dirty slots */
+    struct bdc_lru lru;
+
+    uint8_t *data;              /* Storage for all the slots */
+    uint8_t *rabuf;             /* Read-ahead buffer */
+    uint8_t *wbuf;              /* Bounce buffer for merged writes */
+
+    uint64_t nblocks;
+    uint64_t seq_next;          /* Where a sequential read would start */
+    uint64_t head;              /* Where the last flush ended */
+
+    blockdev_cache_stats_t st;
+} bdc_t;
+
+static inline uint32_t hash_block(bdc_t *c, uint64_t block) {
+    return ((uint32_t)block ^ (uint32_t)(block >> 32)) & c->hmask;
+}
+
+static bdc_slot_t *lookup(bdc_t *c, uint64_t block) {
+    bdc_slot_t *s = c->hash[hash_block(c, block)];
+
+    while(s && s->block != block)
+        s = s->hnext;
+
+    return s;
+}
+
+static void hash_remove(bdc_t *c, bdc_slot_t *s) {
+    bdc_slot_t **p = &c->hash[hash_block(c, s->block)];
+
+    while(*p != s)
+        p = &(*p)->hnext;
+
+    *p = s->hnext;
+}
+
+static inline void touch(bdc_t *c, bdc_slot_t *s) {
+    TAILQ_REMOVE(&c->lru, s, lru);
+    TAILQ_INSERT_HEAD(&c->lru, s, lru);
+}
+
+static int dev_read(bdc_t *c, uint64_t block, size_t count, void *buf) {
+    ++c->st.dev_reads;
+    c->st.blocks_read += count;
+    return c->dev.read_blocks(&c->dev, block, count, buf);
+}
+
+static int dev_write(bdc_t *c, uint64_t block, size_t count, const void *buf) {
+    ++c->st.dev_writes;
+    c->st.blocks_written += count;
+    return c->dev.write_blocks(&c->dev, block, count, buf);
+}
+
+static int slot_cmp(const void *a, const void *b) {
+    const bdc_slot_t *sa = *(const bdc_slot_t * const *)a;
+    const bdc_slot_t *sb = *(const bdc_slot_t * const *)b;
+
+    if(sa->block < sb->block)
+        return -1;
+
+    return sa->block > sb->block;
+}
+
+/* Write out every dirty slot. */
+static int flush_dirty(bdc_t *c) {
+    size_t i, k, n = 0, start, run;
+    bdc_slot_t *s;
+    const uint8_t *buf;
+
+    for(i = 0; i < c->nslots; ++i) {
+        if(c->slots[i].flags & SLOT_DIRTY)
+            c->sorted[n++] = &c->slots[i];
+    }
+
+    if(!n)
+        return 0;
+
+    qsort(c->sorted, n, sizeof(bdc_slot_t *), &slot_cmp);
+
+    /* Pick up where the last sweep ended, and wrap around to the lowest
+       block once we reach the end. */
+    for(start = 0; start < n && c->sorted[start]->block < c->head; ++start) {
+    }
+
+    if(start == n)
+        start = 0;
+
+    for(i = 0; i < n; i += run) {
+        s = c->sorted[(start + i) % n];
+
+        for(run = 1; i + run < n && run < c->merge_max; ++run) {
+            if(c->sorted[(start + i + run) % n]->block != s->block + run)
+                break;
+        }
+
+        if(run == 1) {
+            buf = s->data;
+        }
+        else {
+            for(k = 0; k < run; ++k)
+                memcpy(c->wbuf + k * c->bs, c->sorted[(start + i + k) % n]->data,
+                       c->bs);
+
+            buf = c->wbuf;
+        }
+
+        if(dev_write(c, s->block, run, buf))
+            return -1;
+
+        for(k = 0; k < run; ++k)
+            c->sorted[(start + i + k) % n]->flags &= ~SLOT_DIRTY;
+
+        c->head = s->block + run;
+    }
+
+    return 0;
+}
+
+/* Grab the least recently used slot and assign it to the given block. */
+static bdc_slot_t *get_slot(bdc_t *c, uint64_t block) {
+    bdc_slot_t *s = TAILQ_LAST(&c->lru, bdc_lru);
+
+    if((s->flags & SLOT_DIRTY) && flush_dirty(c))
+        return NULL;
+
+    if(s->flags & SLOT_VALID)
+        hash_remove(c, s);
+
+    s->block = block;
+    s->flags = SLOT_VALID;
+    s->hnext = c->hash[hash_block(c, block)];
+    c->hash[hash_block(c, block)] = s;
+    touch(c, s);
+
+    return s;
+}
+
+static int bdc_init(kos_blockdev_t *d) {
+    bdc_t *c = (bdc_t *)d->dev_data;
+
+    if(c->dev.init && c->dev.init(&c->dev))
+        return -1;
+
+    c->nblocks = c->dev.count_blocks(&c->dev);
+    return 0;
+}
+
+/* Forget everything that is cached, other than dirty blocks. */
+static void invalidate(bdc_t *c) {
+    size_t i;
+
+    for(i = 0; i < c->nslots; ++i) {
+        if((c->slots[i].flags & SLOT_VALID) &&
+           !(c->slots[i].flags & SLOT_DIRTY)) {
+            hash_remove(c, &c->slots[i]);
+            c->slots[i].flags = 0;
+            TAILQ_REMOVE(&c->lru, &c->slots[i], lru);
+            TAILQ_INSERT_TAIL(&c->lru, &c->slots[i], lru);
+        }
+    }
+
+    c->seq_next = c->head = 0;
+}
+
+static int bdc_shutdown(kos_blockdev_t *d) {
+    bdc_t *c = (bdc_t *)d->dev_data;
+    int rv;
+
+    /* Filesystems shut their device down when they're unmounted and init() it
+       again if they're remounted, so this only writes everything out. The
+       memory is released by blockdev_cache_free(). Whatever is on the device
+       may change while it's shut down, so drop the cached copies too. */
+    mutex_lock(&c->lock);
+    rv = flush_dirty(c);
+    invalidate(c);
+    mutex_unlock(&c->lock);
+
+    if(c->dev.shutdown && c->dev.shutdown(&c->dev))
+        rv = -1;
+
+    return rv;
+}
+
+static int bdc_read_blocks(kos_blockdev_t *d, uint64_t block, size_t count,
+                           void *buf) {
+    bdc_t *c = (bdc_t *)d->dev_data;
+    uint8_t *out = (uint8_t *)buf;
+    size_t i = 0, k, n, total;
+    bdc_slot_t *s;
+    int seq, rv = 0;
+
+    mutex_lock(&c->lock);
+
+    seq = (block == c->seq_next);
+    c->seq_next = block + count;
+
+    while(i < count) {
+        if((s = lookup(c, block + i))) {
+            memcpy(out + i * c->bs, s->data, c->bs);
+            touch(c, s);
+            ++c->st.hits;
+            ++i;
+            continue;
+        }
+
+        /* Find the whole run of blocks we don't have, so they can be read in
+           one go. */
+        for(n = 1; i + n < count && !lookup(c, block + i + n); ++n) {
+        }
+
+        c->st.misses += n;
+
+        if(seq && n < c->readahead && i + n == count) {
+            /* Read past the end of the request into the read-ahead buffer, as
+               the caller is likely to want those blocks next. Stop at the
+               first block we already have: it may be dirty, and if making room
+               below wrote it out and evicted it, the copy we read would be
+               stale. */
+            for(total = n; total < c->readahead &&
+                block + i + total < c->nblocks &&
+                !lookup(c, block + i + total); ++total) {
+            }
+
+            if(dev_read(c, block + i, total, c->rabuf)) {
+                rv = -1;
+                break;
+            }
+
+            memcpy(out + i * c->bs, c->rabuf, n * c->bs);
+
+            for(k = 0; k < total; ++k) {
+                if(!(s = get_slot(c, block + i + k))) {
+                    rv = -1;
+                    break;
+                }
+
+                memcpy(s->data, c->rabuf + k * c->bs, c->bs);
+            }
+
+            if(rv)
+                break;
+
+            c->st.readahead += total - n;
+        }
+        else {
+            if(dev_read(c, block + i, n, out + i * c->bs)) {
+                rv = -1;
+                break;
+            }
+
+            /* Don't let big reads flush out everything else in the cache. */
+            if(n <= c->nslots / 2) {
+                for(k = 0; k < n; ++k) {
+                    if(!(s = get_slot(c, block + i + k))) {
+                        rv = -1;
+                        break;
+                    }
+
+                    memcpy(s->data, out + (i + k) * c->bs, c->bs);
+                }
+
+                if(rv)
+                    break;
+            }
+        }
+
+        i += n;
+    }
+
+    mutex_unlock(&c->lock);
+    return rv;
+}
+
+static int bdc_write_blocks(kos_blockdev_t *d, uint64_t block, size_t count,
+                            const void *buf) {
+    bdc_t *c = (bdc_t *)d->dev_data;
+    const uint8_t *in = (const uint8_t *)buf;
+    bdc_slot_t *s;
+    size_t i;
+    int rv = 0;
+
+    /* Catch this here, otherwise the error wouldn't show up until the block
+       was flushed. */
+    if(block + count > c->nblocks) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mutex_lock(&c->lock);
+
+    if(count > c->merge_max) {
+        /* Big writes go straight to the device. Anything we have cached in the
+           range is now out of date, so update it. */
+        if(!(rv = dev_write(c, block, count, buf))) {
+            for(i = 0; i < count; ++i) {
+                if((s = lookup(c, block + i))) {
+                    memcpy(s->data, in + i * c->bs, c->bs);
+                    s->flags &= ~SLOT_DIRTY;
+                }
+            }
+        }
+    }
+    else {
+        for(i = 0; i < count; ++i) {
+            if(!(s = lookup(c, block + i)) && !(s = get_slot(c, block + i))) {
+                rv = -1;
+                break;
+            }
+
+            memcpy(s->data, in + i * c->bs, c->bs);
+            s->flags |= SLOT_DIRTY;
+            touch(c, s);
+        }
+    }
+
+    mutex_unlock(&c->lock);
+    return rv;
+}
+
+static uint64_t bdc_count_blocks(kos_blockdev_t *d) {
+    bdc_t *c = (bdc_t *)d->dev_data;
+
+    return c->dev.count_blocks(&c->dev);
+}
+
+static int bdc_flush(kos_blockdev_t *d) {
+    bdc_t *c = (bdc_t *)d->dev_data;
+    int rv;
+
+    mutex_lock(&c->lock);
+
+    if(!(rv = flush_dirty(c)) && c->dev.flush)
+        rv = c->dev.flush(&c->dev);
+
+    mutex_unlock(&c->lock);
+    return rv;
+}
+
+static kos_blockdev_t bdc_blockdev = {
+    NULL,                   /* dev_data */
+    0,                      /* l_block_size (filled in from the device) */
+    &bdc_init,              /* init */
+    &bdc_shutdown,          /* shutdown */
+    &bdc_read_blocks,       /* read_blocks */
+    &bdc_write_blocks,      /* write_blocks */
+    &bdc_count_blocks,      /* count_blocks */
+    &bdc_flush              /* flush */
+};
+
+int blockdev_cache_wrap(kos_blockdev_t *rv, const kos_blockdev_t *dev,
+                        size_t blocks, size_t readahead) {
+    bdc_t *c;
+    size_t i, hsize;
+
+    if(!rv || !dev) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if(!blocks) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(!(c = (bdc_t *)calloc(1, sizeof(bdc_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for(hsize = 1; hsize < blocks; hsize <<= 1) {
+    }
+
+    memcpy(&c->dev, dev, sizeof(kos_blockdev_t));
+    c->bs = (size_t)1 << dev->l_block_size;
+    c->nslots = blocks;
+    c->readahead = readahead;
+    c->merge_max = BLOCKDEV_CACHE_MERGE_MAX;
+    c->hmask = hsize - 1;
+    c->nblocks = dev->count_blocks(&c->dev);
+
+    c->slots = (bdc_slot_t *)calloc(blocks, sizeof(bdc_slot_t));
+    c->hash = (bdc_slot_t **)calloc(hsize, sizeof(bdc_slot_t *));
+    c->sorted = (bdc_slot_t **)malloc(blocks * sizeof(bdc_slot_t *));
+    c->data = (uint8_t *)malloc(blocks * c->bs);
+    c->wbuf = (uint8_t *)malloc(c->merge_max * c->bs);
+
+    if(readahead)
+        c->rabuf = (uint8_t *)malloc(readahead * c->bs);
+
+    if(!c->slots || !c->hash || !c->sorted || !c->data || !c->wbuf ||
+       (readahead && !c->rabuf)) {
+        free(c->rabuf);
+        free(c->wbuf);
+        free(c->data);
+        free(c->sorted);
+        free(c->hash);
+        free(c->slots);
+        free(c);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    TAILQ_INIT(&c->lru);
+
+    for(i = 0; i < blocks; ++i) {
+        c->slots[i].data = c->data + i * c->bs;
+        TAILQ_INSERT_TAIL(&c->lru, &c->slots[i], lru);
+    }
+
+    mutex_init(&c->lock, MUTEX_TYPE_NORMAL);
+
+    memcpy(rv, &bdc_blockdev, sizeof(kos_blockdev_t));
+    rv->dev_data = c;
+    rv->l_block_size = dev->l_block_size;
+
+    return 0;
+}
+
+int blockdev_cache_free(kos_blockdev_t *d) {
+    bdc_t *c;
+
+    if(!d || d->read_blocks != &bdc_read_blocks) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c = (bdc_t *)d->dev_data;
+
+    mutex_destroy(&c->lock);
+    free(c->wbuf);
+    free(c->rabuf);
+    free(c->data);
+    free(c->sorted);
+    free(c->hash);
+    free(c->slots);
+    free(c);
+    d->dev_data = NULL;
+
+    return 0;
+}
+
+int blockdev_cache_stats(kos_blockdev_t *d, blockdev_cache_stats_t *st) {
+    bdc_t *c;
+
+    if(!d || d->read_blocks != &bdc_read_blocks) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c = (bdc_t *)d->dev_data;
+
+    mutex_lock(&c->lock);
+    memcpy(st, &c->st, sizeof(blockdev_cache_stats_t));
+    mutex_unlock(&c->lock);
+
+    return 0;
+}
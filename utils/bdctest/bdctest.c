@@ -0,0 +1,337 @@
+/* KallistiOS ##version##
+
+   bdctest.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   Test the caching block device wrapper (kernel/fs/blockdev_cache.c) on the
+   host. The wrapper is stacked on top of a block device that reads and writes
+   a disk image file, and then hit with a random mix of reads, writes, flushes
+   and shutdown/init cycles. Everything read back is checked against a copy of
+   the image kept in memory, and the file itself is checked every time the
+   wrapper is flushed or shut down.
+
+   The image is modified, so don't point this at anything you care about. Any
+   file will do, as long as it is at least a few hundred KB:
+
+       dd if=/dev/urandom of=test.img bs=512 count=4096
+       ./bdctest test.img
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <kos/blockdev_cache.h>
+
+#define BLOCK_SHIFT 9
+#define BLOCK_SIZE  (1 << BLOCK_SHIFT)
+
+/* Largest request made, in blocks. */
+#define MAX_REQ     100
+
+static int img_fd = -1;
+static int img_open = 0;
+static int fail_writes = 0;
+static uint64_t img_blocks;
+
+static uint8_t *ref, *cmp;
+
+static int img_init(kos_blockdev_t *d) {
+    (void)d;
+
+    if(img_open) {
+        fprintf(stderr, "init() called twice\n");
+        return -1;
+    }
+
+    img_open = 1;
+    return 0;
+}
+
+static int img_shutdown(kos_blockdev_t *d) {
+    (void)d;
+
+    if(!img_open) {
+        fprintf(stderr, "shutdown() called while not initialized\n");
+        return -1;
+    }
+
+    img_open = 0;
+    return 0;
+}
+
+static int img_read(kos_blockdev_t *d, uint64_t block, size_t count,
+                    void *buf) {
+    size_t len = count << BLOCK_SHIFT;
+
+    (void)d;
+
+    if(!img_open || block + count > img_blocks) {
+        errno = EIO;
+        return -1;
+    }
+
+    if(pread(img_fd, buf, len, block << BLOCK_SHIFT) != (ssize_t)len)
+        return -1;
+
+    return 0;
+}
+
+static int img_write(kos_blockdev_t *d, uint64_t block, size_t count,
+                     const void *buf) {
+    size_t len = count << BLOCK_SHIFT;
+
+    (void)d;
+
+    if(!img_open || fail_writes || block + count > img_blocks) {
+        errno = EIO;
+        return -1;
+    }
+
+    if(pwrite(img_fd, buf, len, block << BLOCK_SHIFT) != (ssize_t)len)
+        return -1;
+
+    return 0;
+}
+
+static uint64_t img_count(kos_blockdev_t *d) {
+    (void)d;
+    return img_blocks;
+}
+
+static int img_flush(kos_blockdev_t *d) {
+    (void)d;
+    return img_open ? 0 : -1;
+}
+
+static kos_blockdev_t img_dev = {
+    NULL,                   /* dev_data */
+    BLOCK_SHIFT,            /* l_block_size */
+    &img_init,              /* init */
+    &img_shutdown,          /* shutdown */
+    &img_read,              /* read_blocks */
+    &img_write,             /* write_blocks */
+    &img_count,             /* count_blocks */
+    &img_flush              /* flush */
+};
+
+/* Make sure everything that has been written made it to the file. */
+static int check_image(const char *when) {
+    size_t len = img_blocks << BLOCK_SHIFT;
+
+    if(pread(img_fd, cmp, len, 0) != (ssize_t)len) {
+        perror("bdctest: pread");
+        return -1;
+    }
+
+    if(memcmp(cmp, ref, len)) {
+        fprintf(stderr, "bdctest: image doesn't match after %s\n", when);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void pick(uint64_t *block, size_t *count) {
+    static uint64_t next = 0;
+
+    *count = 1 + (rand() % 4 ? rand() % 8 : rand() % MAX_REQ);
+
+    /* Carry on from the last request a third of the time, to give the
+       read-ahead something to do. */
+    if(rand() % 3)
+        next = rand() % (img_blocks - *count);
+    else if(next + *count > img_blocks)
+        next = 0;
+
+    *block = next;
+    next += *count;
+}
+
+static int random_ops(kos_blockdev_t *c, int ops) {
+    static uint8_t buf[MAX_REQ * BLOCK_SIZE];
+    uint64_t block;
+    size_t count, i;
+    int op;
+
+    while(ops--) {
+        pick(&block, &count);
+        op = rand() % 100;
+
+        if(op < 60) {
+            if(c->read_blocks(c, block, count, buf)) {
+                fprintf(stderr, "bdctest: read of %zu at %llu failed\n", count,
+                        (unsigned long long)block);
+                return -1;
+            }
+
+            if(memcmp(buf, ref + (block << BLOCK_SHIFT), count * BLOCK_SIZE)) {
+                fprintf(stderr, "bdctest: read of %zu at %llu returned the "
+                        "wrong data\n", count, (unsigned long long)block);
+                return -1;
+            }
+        }
+        else if(op < 95) {
+            for(i = 0; i < count * BLOCK_SIZE; ++i)
+                buf[i] = rand();
+
+            if(c->write_blocks(c, block, count, buf)) {
+                fprintf(stderr, "bdctest: write of %zu at %llu failed\n",
+                        count, (unsigned long long)block);
+                return -1;
+            }
+
+            memcpy(ref + (block << BLOCK_SHIFT), buf, count * BLOCK_SIZE);
+        }
+        else if(op < 99) {
+            if(c->flush(c) || check_image("flush"))
+                return -1;
+        }
+        else {
+            /* What a filesystem does when it's unmounted and remounted. */
+            if(c->shutdown(c) || check_image("shutdown"))
+                return -1;
+
+            if(c->init(c)) {
+                fprintf(stderr, "bdctest: init after shutdown failed\n");
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* A failed write-back while making room for a read has to fail the read. */
+static int write_errors(kos_blockdev_t *c, size_t cache_blocks) {
+    static uint8_t buf[BLOCK_SIZE];
+    uint64_t b;
+    int rv;
+
+    /* With a single slot, one-block reads bypass the cache. */
+    if(cache_blocks < 2)
+        return 0;
+
+    memset(buf, 0xa5, sizeof(buf));
+
+    /* Start clean, so that filling the cache doesn't write anything back and
+       every slot ends up dirty. */
+    if(c->flush(c))
+        return -1;
+
+    for(b = 0; b < cache_blocks; ++b) {
+        if(c->write_blocks(c, b, 1, buf))
+            return -1;
+
+        memcpy(ref + (b << BLOCK_SHIFT), buf, BLOCK_SIZE);
+    }
+
+    fail_writes = 1;
+    rv = c->read_blocks(c, img_blocks - 1, 1, buf);
+    fail_writes = 0;
+
+    if(!rv) {
+        fprintf(stderr, "bdctest: read succeeded although the write-back "
+                "failed\n");
+        return -1;
+    }
+
+    /* Nothing should have been lost. */
+    if(c->flush(c) || check_image("failed write-back"))
+        return -1;
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    kos_blockdev_t c;
+    blockdev_cache_stats_t st;
+    size_t cache_blocks = 64, readahead = 16;
+    int ops = 200000;
+    struct stat s;
+
+    if(argc < 2 || argc > 5) {
+        fprintf(stderr, "Usage: %s image [cache blocks] [read-ahead] "
+                "[operations]\n", argv[0]);
+        return 1;
+    }
+
+    if(argc > 2)
+        cache_blocks = strtoul(argv[2], NULL, 0);
+
+    if(argc > 3)
+        readahead = strtoul(argv[3], NULL, 0);
+
+    if(argc > 4)
+        ops = atoi(argv[4]);
+
+    if((img_fd = open(argv[1], O_RDWR)) < 0 || fstat(img_fd, &s)) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    img_blocks = s.st_size >> BLOCK_SHIFT;
+
+    if(img_blocks < MAX_REQ * 2 || img_blocks < cache_blocks + 1) {
+        fprintf(stderr, "%s: image is too small\n", argv[1]);
+        return 1;
+    }
+
+    ref = (uint8_t *)malloc(img_blocks << BLOCK_SHIFT);
+    cmp = (uint8_t *)malloc(img_blocks << BLOCK_SHIFT);
+
+    if(!ref || !cmp) {
+        fprintf(stderr, "bdctest: out of memory\n");
+        return 1;
+    }
+
+    if(pread(img_fd, ref, img_blocks << BLOCK_SHIFT, 0) !=
+       (ssize_t)(img_blocks << BLOCK_SHIFT)) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    srand(1);
+
+    if(blockdev_cache_wrap(&c, &img_dev, cache_blocks, readahead)) {
+        perror("bdctest: blockdev_cache_wrap");
+        return 1;
+    }
+
+    if(c.init(&c)) {
+        fprintf(stderr, "bdctest: init failed\n");
+        return 1;
+    }
+
+    if(random_ops(&c, ops) || write_errors(&c, cache_blocks))
+        return 1;
+
+    blockdev_cache_stats(&c, &st);
+
+    if(c.shutdown(&c) || check_image("final shutdown"))
+        return 1;
+
+    if(blockdev_cache_free(&c)) {
+        perror("bdctest: blockdev_cache_free");
+        return 1;
+    }
+
+    close(img_fd);
+    free(cmp);
+    free(ref);
+
+    printf("OK: %llu hits, %llu misses, %llu blocks read ahead\n",
+           (unsigned long long)st.hits, (unsigned long long)st.misses,
+           (unsigned long long)st.readahead);
+    printf("    %llu device reads (%llu blocks), %llu device writes (%llu "
+           "blocks)\n", (unsigned long long)st.dev_reads,
+           (unsigned long long)st.blocks_read,
+           (unsigned long long)st.dev_writes,
+           (unsigned long long)st.blocks_written);
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+/* KallistiOS ##version##
+
+   utils/bdctest/host/kos/mutex.h
+   Copyright (C) 2026 The KOS Team and contributors
+
+   Just enough of kos/mutex.h for building kernel/fs/blockdev_cache.c on the
+   host, on top of pthreads.
+*/
+
+#ifndef __KOS_MUTEX_H
+#define __KOS_MUTEX_H
+
+#include <pthread.h>
+
+typedef pthread_mutex_t mutex_t;
+
+#define MUTEX_TYPE_NORMAL   0
+
+static inline int mutex_init(mutex_t *m, int mtype) {
+    (void)mtype;
+    return pthread_mutex_init(m, NULL);
+}
+
+#define mutex_lock(m)       pthread_mutex_lock(m)
+#define mutex_unlock(m)     pthread_mutex_unlock(m)
+#define mutex_destroy(m)    pthread_mutex_destroy(m)
+
+#endif /* !__KOS_MUTEX_H */
@@ -0,0 +1,1422 @@
+/* KallistiOS ##version##
+
+   pvrcap.c
+   Copyright (C) 2026 The KOS Team and contributors
+
+   Reads a frame recorded with pvr_capture_frame(), and draws it on the host
+   the way the PVR would: the TA's tile bins are worked out from the TA
+   stream, then each 32x32 tile is rendered on its own, opaque and
+   punch-through polygons first (with the deferred shading the ISP/TSP
+   does), then translucent ones, sorted per pixel unless presort was on.
+
+   It's not meant to be a pixel-exact emulator. The point is to measure what
+   the hardware would have to do for the frame: how many polygons land in
+   each tile, how much the bins overflow, and how many times each pixel gets
+   depth tested (ISP) and shaded (TSP). Fog, bilinear filtering and modifier
+   volumes aren't drawn (modifier volumes are still binned), and YUV, bump
+   and mipmapped VQ/PAL4 textures come out grey.
+
+   The file format is described in dc/pvr/pvr_capture.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define CAP_ID(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | \
+     ((uint32_t)(d) << 24))
+
+#define CAP_MAGIC   CAP_ID('P', 'V', 'R', 'C')
+#define CAP_REGS    CAP_ID('R', 'E', 'G', 'S')
+#define CAP_PALT    CAP_ID('P', 'A', 'L', 'T')
+#define CAP_LIST    CAP_ID('L', 'I', 'S', 'T')
+#define CAP_VRAM    CAP_ID('V', 'R', 'A', 'M')
+#define CAP_END     CAP_ID('E', 'N', 'D', ' ')
+
+#define TILE        32
+#define LISTS       5
+#define HIST        16
+
+/* List numbers, as in PVR_LIST_* */
+#define L_OP        0
+#define L_OM        1
+#define L_TR        2
+#define L_TM        3
+#define L_PT        4
+
+static const char *list_names[LISTS] = { "OP", "OM", "TR", "TM", "PT" };
+
+/* Must match pvr_capture_regs_t */
+typedef struct {
+    uint32_t width, height, tiles_x, tiles_y, fsaa, lists_enabled;
+    uint32_t opb_size[LISTS], opb_overflow_count;
+    uint32_t bg_color, zclip, pclip_x, pclip_y, presort, to_texture;
+    uint32_t dma_mode, texture_base, txr_stride, pt_alpha_ref, cheap_shadow;
+} regs_t;
+
+typedef struct {
+    float x, y, z, u, v;
+    float col[4], ofs[4];       /* a, r, g, b from 0 to 1 */
+} vert_t;
+
+typedef struct {
+    vert_t v[3];
+    uint32_t pcw, isp, tsp, tex;
+    int list, obj;
+    int x0, y0, x1, y1;         /* Bounding box in pixels, inclusive */
+} tri_t;
+
+/* What the parser needs to remember between parameters in a list. */
+typedef struct {
+    uint32_t pcw, isp, tsp, tex;
+    int kind;                   /* 0 none, 1 polygon, 2 sprite, 3 modvol */
+    int vwords;                 /* Words per vertex */
+    float face[4], face_ofs[4];
+    vert_t prev[2];
+    int nverts;                 /* Vertices so far in this strip */
+    int obj_tris, obj_max;      /* Triangles in this object, and the most */
+} parse_t;
+
+typedef struct {
+    int *idx;
+    size_t count, max;
+} idxlist_t;
+
+typedef struct {
+    uint32_t objs[LISTS];       /* Object pointers in each list's bin */
+    uint32_t tris;              /* Triangles rendered */
+    uint32_t blocks;            /* Overflow blocks needed */
+    uint32_t isp, tsp;          /* Fragments depth tested, shaded */
+} tile_stats_t;
+
+static regs_t regs;
+static uint32_t file_flags, pal_cfg, palette[1024];
+static uint8_t *vram;
+static uint32_t vram_off, vram_len;
+
+static uint32_t *list_data[LISTS];
+static size_t list_words[LISTS];
+
+static uint32_t st_hdrs[LISTS], st_strips[LISTS], st_tris[LISTS];
+static uint32_t st_objs[LISTS];
+
+static tri_t *tris;
+static size_t ntris, maxtris;
+static int nobjs;
+
+static int w, h, tw, th;
+static idxlist_t *bins;         /* Triangles per tile, all lists */
+static tile_stats_t *tstats;
+static uint8_t *image;          /* RGB */
+static uint16_t *isp_map, *tsp_map;
+static int use_textures = 1;
+
+static uint32_t rd32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float u2f(uint32_t i) {
+    float f;
+    memcpy(&f, &i, 4);
+    return f;
+}
+
+static float clamp01(float f) {
+    return f < 0.0f ? 0.0f : f > 1.0f ? 1.0f : f;
+}
+
+static void unpack_argb(uint32_t c, float *out) {
+    out[0] = ((c >> 24) & 0xff) / 255.0f;
+    out[1] = ((c >> 16) & 0xff) / 255.0f;
+    out[2] = ((c >> 8) & 0xff) / 255.0f;
+    out[3] = (c & 0xff) / 255.0f;
+}
+
+static void *xrealloc(void *p, size_t size) {
+    if(!(p = realloc(p, size))) {
+        fprintf(stderr, "pvrcap: out of memory\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+/**** Loading ************************************************************/
+
+static int load(const char *fn) {
+    FILE *f;
+    uint8_t *buf;
+    long len;
+    size_t pos, size, i, n;
+    uint32_t id, list;
+
+    if(!(f = fopen(fn, "rb"))) {
+        perror(fn);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = xrealloc(NULL, len > 0 ? len : 1);
+
+    if(len < 12 || fread(buf, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "%s: can't read file\n", fn);
+        fclose(f);
+        free(buf);
+        return -1;
+    }
+
+    fclose(f);
+
+    if(rd32(buf) != CAP_MAGIC || rd32(buf + 4) != 1) {
+        fprintf(stderr, "%s: not a version 1 PVR capture\n", fn);
+        free(buf);
+        return -1;
+    }
+
+    file_flags = rd32(buf + 8);
+
+    for(pos = 12; pos + 8 <= (size_t)len; pos += 8 + size) {
+        id = rd32(buf + pos);
+        size = rd32(buf + pos + 4);
+
+        if(pos + 8 + size > (size_t)len) {
+            fprintf(stderr, "%s: chunk at %zu runs past the end\n", fn, pos);
+            break;
+        }
+
+        if(id == CAP_END)
+            break;
+
+        if(id == CAP_REGS) {
+            uint32_t *r = (uint32_t *)&regs;
+
+            for(i = 0; i < size / 4 && i < sizeof(regs) / 4; i++)
+                r[i] = rd32(buf + pos + 8 + i * 4);
+        }
+        else if(id == CAP_PALT && size >= 4) {
+            pal_cfg = rd32(buf + pos + 8);
+
+            for(i = 0; i < 1024 && 4 + i * 4 < size; i++)
+                palette[i] = rd32(buf + pos + 12 + i * 4);
+        }
+        else if(id == CAP_LIST && size >= 4) {
+            list = rd32(buf + pos + 8);
+            n = (size - 4) / 4;
+
+            if(list >= LISTS)
+                continue;
+
+            /* A list's chunks are just one stream, split up. */
+            list_data[list] = xrealloc(list_data[list],
+                                       (list_words[list] + n) * 4);
+
+            for(i = 0; i < n; i++)
+                list_data[list][list_words[list] + i] =
+                    rd32(buf + pos + 12 + i * 4);
+
+            list_words[list] += n;
+        }
+        else if(id == CAP_VRAM && size >= 4) {
+            vram_off = rd32(buf + pos + 8);
+            vram_len = size - 4;
+            vram = xrealloc(NULL, vram_len);
+            memcpy(vram, buf + pos + 12, vram_len);
+        }
+    }
+
+    free(buf);
+
+    if(!regs.width || !regs.tiles_x) {
+        fprintf(stderr, "%s: no settings chunk\n", fn);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**** TA stream parsing **************************************************/
+
+static void add_tri(parse_t *p, int list, const vert_t *a, const vert_t *b,
+                    const vert_t *c) {
+    tri_t *t;
+    float x0, y0, x1, y1;
+    int i;
+
+    if(ntris == maxtris) {
+        maxtris = maxtris ? maxtris * 2 : 4096;
+        tris = xrealloc(tris, maxtris * sizeof(tri_t));
+    }
+
+    t = tris + ntris++;
+    t->v[0] = *a;
+    t->v[1] = *b;
+    t->v[2] = *c;
+    t->pcw = p->pcw;
+    t->isp = p->isp;
+    t->tsp = p->tsp;
+    t->tex = p->tex;
+    t->list = list;
+
+    /* Strips are split into objects of up to obj_max triangles, which is
+       what each object pointer in a tile's bin refers to. */
+    if(!p->obj_tris || p->obj_tris >= p->obj_max) {
+        nobjs++;
+        st_objs[list]++;
+        p->obj_tris = 0;
+    }
+
+    p->obj_tris++;
+    t->obj = nobjs - 1;
+    st_tris[list]++;
+
+    x0 = x1 = a->x;
+    y0 = y1 = a->y;
+
+    for(i = 1; i < 3; i++) {
+        x0 = fminf(x0, t->v[i].x);
+        x1 = fmaxf(x1, t->v[i].x);
+        y0 = fminf(y0, t->v[i].y);
+        y1 = fmaxf(y1, t->v[i].y);
+    }
+
+    /* Clamp before converting, in case of wild coordinates. */
+    t->x0 = (int)floorf(fmaxf(x0, -1.0f));
+    t->y0 = (int)floorf(fmaxf(y0, -1.0f));
+    t->x1 = (int)ceilf(fminf(x1, (float)w));
+    t->y1 = (int)ceilf(fminf(y1, (float)h));
+}
+
+static void end_strip(parse_t *p) {
+    p->nverts = 0;
+    p->obj_tris = 0;
+}
+
+/* Read the first volume's colors and UVs out of a polygon vertex. */
+static void read_poly_vert(parse_t *p, const uint32_t *v, vert_t *out) {
+    int col = (p->pcw >> 4) & 3;
+    int tex = p->pcw & 0x08;
+    int uv16 = p->pcw & 0x01;
+    int twovol = (p->pcw & 0xc0) == 0xc0;
+    float in, oin;
+    int i;
+
+    memset(out, 0, sizeof(vert_t));
+    out->x = u2f(v[1]);
+    out->y = u2f(v[2]);
+    out->z = u2f(v[3]);
+
+    if(tex) {
+        if(uv16) {
+            out->u = u2f(v[4] & 0xffff0000);
+            out->v = u2f(v[4] << 16);
+        }
+        else {
+            out->u = u2f(v[4]);
+            out->v = u2f(v[5]);
+        }
+    }
+
+    if(col == 1 && !twovol) {
+        /* Floating point colors: after the UVs if textured */
+        const uint32_t *c = tex ? v + 8 : v + 4;
+
+        for(i = 0; i < 4; i++)
+            out->col[i] = clamp01(u2f(c[i]));
+
+        if(tex)
+            for(i = 0; i < 4; i++)
+                out->ofs[i] = clamp01(u2f(c[4 + i]));
+    }
+    else if(col == 0 || col == 1) {
+        unpack_argb(tex ? v[6] : twovol ? v[4] : v[6], out->col);
+
+        if(tex)
+            unpack_argb(v[7], out->ofs);
+    }
+    else {
+        /* Intensity, which scales the face color from the header */
+        in = clamp01(u2f(tex ? v[6] : twovol ? v[4] : v[6]));
+        oin = tex ? clamp01(u2f(v[7])) : 0.0f;
+
+        out->col[0] = p->face[0];
+        out->ofs[0] = p->face_ofs[0];
+
+        for(i = 1; i < 4; i++) {
+            out->col[i] = p->face[i] * in;
+            out->ofs[i] = p->face_ofs[i] * oin;
+        }
+    }
+}
+
+static void poly_vertex(parse_t *p, int list, const uint32_t *v) {
+    vert_t cur;
+
+    read_poly_vert(p, v, &cur);
+
+    /* Every other triangle in a strip is wound the other way; swap two
+       vertices to keep the winding the same for culling. */
+    if(p->nverts >= 2) {
+        if(p->nverts & 1)
+            add_tri(p, list, &p->prev[1], &p->prev[0], &cur);
+        else
+            add_tri(p, list, &p->prev[0], &p->prev[1], &cur);
+    }
+
+    p->prev[0] = p->prev[1];
+    p->prev[1] = cur;
+    p->nverts++;
+
+    if(v[0] & (1 << 28))
+        end_strip(p);
+}
+
+static void sprite_vertex(parse_t *p, int list, const uint32_t *v) {
+    vert_t q[4];
+    int i, tex = p->pcw & 0x08;
+
+    for(i = 0; i < 4; i++) {
+        memset(q + i, 0, sizeof(vert_t));
+        memcpy(q[i].col, p->face, sizeof(q[i].col));
+        memcpy(q[i].ofs, p->face_ofs, sizeof(q[i].ofs));
+    }
+
+    for(i = 0; i < 3; i++) {
+        q[i].x = u2f(v[1 + i * 3]);
+        q[i].y = u2f(v[2 + i * 3]);
+        q[i].z = u2f(v[3 + i * 3]);
+
+        if(tex) {
+            q[i].u = u2f(v[13 + i] & 0xffff0000);
+            q[i].v = u2f(v[13 + i] << 16);
+        }
+    }
+
+    /* The fourth corner only has X and Y; the rest is on the same plane. */
+    q[3].x = u2f(v[10]);
+    q[3].y = u2f(v[11]);
+    q[3].z = q[0].z + q[2].z - q[1].z;
+    q[3].u = q[0].u + q[2].u - q[1].u;
+    q[3].v = q[0].v + q[2].v - q[1].v;
+
+    /* A sprite is one quad object. */
+    p->obj_tris = 0;
+    p->obj_max = 2;
+    add_tri(p, list, &q[0], &q[1], &q[2]);
+    add_tri(p, list, &q[0], &q[2], &q[3]);
+    p->obj_tris = 0;
+    st_strips[list]++;
+}
+
+static void modvol_vertex(parse_t *p, int list, const uint32_t *v) {
+    vert_t q[3];
+    int i;
+
+    memset(q, 0, sizeof(q));
+
+    for(i = 0; i < 3; i++) {
+        q[i].x = u2f(v[1 + i * 3]);
+        q[i].y = u2f(v[2 + i * 3]);
+        q[i].z = u2f(v[3 + i * 3]);
+    }
+
+    p->obj_tris = 0;
+    p->obj_max = 1;
+    add_tri(p, list, &q[0], &q[1], &q[2]);
+    p->obj_tris = 0;
+    st_strips[list]++;
+}
+
+static void parse_list(int list) {
+    static const int strip_tris[4] = { 1, 2, 4, 6 };
+    const uint32_t *d = list_data[list], *v;
+    size_t n = list_words[list], i, step;
+    parse_t p;
+    int col, twovol, i2;
+
+    memset(&p, 0, sizeof(p));
+
+    for(i = 0; i + 8 <= n; i += step) {
+        v = d + i;
+        step = 8;
+
+        switch(v[0] >> 29) {
+            case 0:     /* End of list */
+                end_strip(&p);
+                p.kind = 0;
+                break;
+
+            case 4:     /* Polygon or modifier volume header */
+                end_strip(&p);
+                st_hdrs[list]++;
+                p.pcw = v[0];
+                p.isp = v[1];
+
+                if(list == L_OM || list == L_TM) {
+                    p.kind = 3;
+                    p.vwords = 16;
+                    break;
+                }
+
+                p.kind = 1;
+                p.tsp = v[2];
+                p.tex = v[3];
+                p.obj_max = strip_tris[(v[0] >> 18) & 3];
+                col = (v[0] >> 4) & 3;
+
+                twovol = (v[0] & 0xc0) == 0xc0;
+                memset(p.face_ofs, 0, sizeof(p.face_ofs));
+
+                if(col == 2) {
+                    for(i2 = 0; i2 < 4; i2++)
+                        p.face[i2] = clamp01(u2f(v[4 + i2]));
+
+                    /* With two volumes, the second face color follows;
+                       otherwise the face offset color does, if used. In
+                       both cases the header is 64 bytes. */
+                    if(twovol || (v[0] & 0x04)) {
+                        if(!twovol && i + 16 <= n)
+                            for(i2 = 0; i2 < 4; i2++)
+                                p.face_ofs[i2] = clamp01(u2f(v[8 + i2]));
+
+                        step = 16;
+                    }
+                }
+
+                if((v[0] & 0x08) && (twovol || col == 1))
+                    p.vwords = 16;
+                else
+                    p.vwords = 8;
+
+                break;
+
+            case 5:     /* Sprite header */
+                end_strip(&p);
+                st_hdrs[list]++;
+                p.kind = 2;
+                p.pcw = v[0];
+                p.isp = v[1];
+                p.tsp = v[2];
+                p.tex = v[3];
+                p.vwords = 16;
+                unpack_argb(v[4], p.face);
+                unpack_argb(v[5], p.face_ofs);
+                break;
+
+            case 7:     /* Vertex */
+                step = p.vwords ? p.vwords : 8;
+
+                if(i + step > n)
+                    break;
+
+                if(p.kind == 1) {
+                    if(v[0] & (1 << 28))
+                        st_strips[list]++;
+
+                    poly_vertex(&p, list, v);
+                }
+                else if(p.kind == 2) {
+                    sprite_vertex(&p, list, v);
+                }
+                else if(p.kind == 3) {
+                    modvol_vertex(&p, list, v);
+                }
+
+                break;
+
+            default:    /* User tile clip, object list set */
+                break;
+        }
+    }
+}
+
+/**** Binning ************************************************************/
+
+static void idx_add(idxlist_t *l, int i) {
+    if(l->count == l->max) {
+        l->max = l->max ? l->max * 2 : 64;
+        l->idx = xrealloc(l->idx, l->max * sizeof(int));
+    }
+
+    l->idx[l->count++] = i;
+}
+
+/* Work out which tiles each triangle could touch, and how many object
+   pointers go in each tile's bins. An object can be made up of more than
+   one triangle, but it only goes in a tile once. */
+static void bin_tris(void) {
+    int *last_obj;
+    size_t i;
+    int x, y, tn;
+    tri_t *t;
+
+    last_obj = xrealloc(NULL, tw * th * sizeof(int));
+
+    for(i = 0; i < (size_t)(tw * th); i++)
+        last_obj[i] = -1;
+
+    for(i = 0; i < ntris; i++) {
+        t = tris + i;
+
+        if(t->x1 < 0 || t->y1 < 0 || t->x0 >= w || t->y0 >= h)
+            continue;
+
+        for(y = (t->y0 < 0 ? 0 : t->y0) / TILE;
+                y <= (t->y1 >= h ? h - 1 : t->y1) / TILE; y++) {
+            for(x = (t->x0 < 0 ? 0 : t->x0) / TILE;
+                    x <= (t->x1 >= w ? w - 1 : t->x1) / TILE; x++) {
+                tn = y * tw + x;
+                idx_add(bins + tn, (int)i);
+
+                if(last_obj[tn] != t->obj) {
+                    last_obj[tn] = t->obj;
+                    tstats[tn].objs[t->list]++;
+                }
+            }
+        }
+    }
+
+    free(last_obj);
+}
+
+/**** Textures ***********************************************************/
+
+static uint32_t twiddle(uint32_t x, uint32_t y, uint32_t tw_, uint32_t th_) {
+    uint32_t idx = 0, shift = 0, bit;
+
+    /* V goes in the low bit; once the shorter side runs out, the rest of
+       the longer side's bits go on top. */
+    for(bit = 1; bit < tw_ || bit < th_; bit <<= 1) {
+        if(bit < th_) {
+            if(y & bit)
+                idx |= 1 << shift;
+
+            shift++;
+        }
+
+        if(bit < tw_) {
+            if(x & bit)
+                idx |= 1 << shift;
+
+            shift++;
+        }
+    }
+
+    return idx;
+}
+
+static int vram8(uint32_t addr, uint8_t *out) {
+    if(addr < vram_off || addr - vram_off >= vram_len)
+        return -1;
+
+    *out = vram[addr - vram_off];
+    return 0;
+}
+
+static int vram16(uint32_t addr, uint16_t *out) {
+    uint8_t lo, hi;
+
+    if(vram8(addr, &lo) || vram8(addr + 1, &hi))
+        return -1;
+
+    *out = lo | (hi << 8);
+    return 0;
+}
+
+static uint32_t conv16(uint16_t c, int fmt) {
+    uint32_t a, r, g, b;
+
+    switch(fmt) {
+        case 0:     /* ARGB1555 */
+            a = (c & 0x8000) ? 255 : 0;
+            r = ((c >> 10) & 31) * 255 / 31;
+            g = ((c >> 5) & 31) * 255 / 31;
+            b = (c & 31) * 255 / 31;
+            break;
+        case 1:     /* RGB565 */
+            a = 255;
+            r = ((c >> 11) & 31) * 255 / 31;
+            g = ((c >> 5) & 63) * 255 / 63;
+            b = (c & 31) * 255 / 31;
+            break;
+        case 2:     /* ARGB4444 */
+            a = ((c >> 12) & 15) * 17;
+            r = ((c >> 8) & 15) * 17;
+            g = ((c >> 4) & 15) * 17;
+            b = (c & 15) * 17;
+            break;
+        default:
+            return 0xff808080;
+    }
+
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+static uint32_t pal_lookup(uint32_t idx) {
+    uint32_t c = palette[idx & 1023];
+
+    if(pal_cfg == 3)
+        return c;
+
+    return conv16(c, pal_cfg);
+}
+
+/* Sums of 4^i for i < n, for finding the largest mipmap level. */
+static uint32_t mip_sum(int n) {
+    return ((1u << (2 * n)) - 1) / 3;
+}
+
+static int log2i(uint32_t v) {
+    int l = 0;
+
+    while((1u << l) < v)
+        l++;
+
+    return l;
+}
+
+static uint32_t sample(const tri_t *t, float u, float v) {
+    uint32_t tex = t->tex, tsp = t->tsp;
+    uint32_t sw = 8 << ((tsp >> 3) & 7), sh = 8 << (tsp & 7);
+    uint32_t addr = (tex & 0x1fffff) << 3;
+    int fmt = (tex >> 27) & 7, mip = tex >> 31, vq = (tex >> 30) & 1;
+    int twid = !((tex >> 26) & 1) || fmt >= 5;
+    int tx, ty, l;
+    uint32_t texel;
+    uint16_t c16;
+    uint8_t c8;
+
+    if(!vram)
+        return 0xff808080;
+
+    if(!twid && (tex & (1 << 25)))
+        sw = regs.txr_stride * 32;
+
+    /* Wrap (or clamp or flip) to the texture */
+    tx = (int)floorf(u * sw);
+    ty = (int)floorf(v * sh);
+
+    if(tsp & (1 << 16))
+        tx = tx < 0 ? 0 : tx >= (int)sw ? (int)sw - 1 : tx;
+    else if((tsp & (1 << 18)) && (((unsigned)tx / sw) & 1))
+        tx = sw - 1 - (tx & (sw - 1));
+
+    if(tsp & (1 << 15))
+        ty = ty < 0 ? 0 : ty >= (int)sh ? (int)sh - 1 : ty;
+    else if((tsp & (1 << 17)) && (((unsigned)ty / sh) & 1))
+        ty = sh - 1 - (ty & (sh - 1));
+
+    tx = (uint32_t)tx % sw;
+    ty = (uint32_t)ty % sh;
+
+    if(vq) {
+        if(mip || !twid)
+            return 0xff808080;
+
+        if(vram8(addr + 2048 + twiddle(tx / 2, ty / 2, sw / 2, sh / 2), &c8) ||
+                vram16(addr + (c8 * 4 + ((tx & 1) << 1) + (ty & 1)) * 2, &c16))
+            return 0xff808080;
+
+        return conv16(c16, fmt);
+    }
+
+    l = log2i(sw);
+
+    switch(fmt) {
+        case 0:
+        case 1:
+        case 2:
+            if(mip)
+                addr += 6 + 2 * mip_sum(l);
+
+            if(vram16(addr + 2 * (twid ? twiddle(tx, ty, sw, sh) :
+                                  (uint32_t)ty * sw + tx), &c16))
+                return 0xff808080;
+
+            return conv16(c16, fmt);
+
+        case 5:     /* 4bpp palette */
+            if(mip)
+                return 0xff808080;
+
+            texel = twiddle(tx, ty, sw, sh);
+
+            if(vram8(addr + texel / 2, &c8))
+                return 0xff808080;
+
+            c8 = (texel & 1) ? c8 >> 4 : c8 & 15;
+            return pal_lookup((((tex >> 21) & 0x3f) << 4) | c8);
+
+        case 6:     /* 8bpp palette */
+            if(mip)
+                addr += 3 + mip_sum(l);
+
+            if(vram8(addr + twiddle(tx, ty, sw, sh), &c8))
+                return 0xff808080;
+
+            return pal_lookup((((tex >> 25) & 3) << 8) | c8);
+
+        default:
+            return 0xff808080;
+    }
+}
+
+/**** Rasterizing ********************************************************/
+
+typedef struct {
+    float a, b, c;              /* Plane: value = a * x + b * y + c */
+} plane_t;
+
+typedef struct {
+    float e[3][3];              /* Edge functions: a, b, c */
+    plane_t z;                  /* 1/w */
+    plane_t attr[10];           /* u, v, col[4], ofs[4], all times 1/w */
+    int persp;
+} setup_t;
+
+static void make_plane(const tri_t *t, const float *val, float area,
+                       plane_t *p) {
+    const vert_t *v = t->v;
+    float d1 = val[1] - val[0], d2 = val[2] - val[0];
+    float x1 = v[1].x - v[0].x, y1 = v[1].y - v[0].y;
+    float x2 = v[2].x - v[0].x, y2 = v[2].y - v[0].y;
+
+    p->a = (d1 * y2 - d2 * y1) / area;
+    p->b = (d2 * x1 - d1 * x2) / area;
+    p->c = val[0] - p->a * v[0].x - p->b * v[0].y;
+}
+
+static float eval(const plane_t *p, float x, float y) {
+    return p->a * x + p->b * y + p->c;
+}
+
+/* Returns 0 if the triangle is culled or has no area. */
+static int setup_tri(const tri_t *t, setup_t *s) {
+    const vert_t *v = t->v;
+    float area, val[3], sign;
+    int i, j, k, cull = (t->isp >> 27) & 3, gouraud = t->pcw & 0x02;
+
+    area = (v[1].x - v[0].x) * (v[2].y - v[0].y) -
+           (v[1].y - v[0].y) * (v[2].x - v[0].x);
+
+    if(area == 0.0f || (cull == 1 && fabsf(area) < 0.1f) ||
+            (cull == 2 && area < 0.0f) || (cull == 3 && area > 0.0f))
+        return 0;
+
+    sign = area > 0.0f ? 1.0f : -1.0f;
+
+    for(i = 0; i < 3; i++) {
+        j = (i + 1) % 3;
+        s->e[i][0] = (v[i].y - v[j].y) * sign;
+        s->e[i][1] = (v[j].x - v[i].x) * sign;
+        s->e[i][2] = (v[i].x * v[j].y - v[j].x * v[i].y) * sign;
+    }
+
+    for(i = 0; i < 3; i++)
+        val[i] = v[i].z;
+
+    make_plane(t, val, area, &s->z);
+    s->persp = v[0].z > 0.0f && v[1].z > 0.0f && v[2].z > 0.0f;
+
+    for(k = 0; k < 10; k++) {
+        for(i = 0; i < 3; i++) {
+            /* Flat shading takes the colors of the last vertex. */
+            const vert_t *cv = gouraud ? v + i : v + 2;
+            float a = k == 0 ? v[i].u : k == 1 ? v[i].v :
+                      k < 6 ? cv->col[k - 2] : cv->ofs[k - 6];
+
+            val[i] = s->persp ? a * v[i].z : a;
+        }
+
+        make_plane(t, val, area, &s->attr[k]);
+    }
+
+    return 1;
+}
+
+static int inside(const setup_t *s, float x, float y) {
+    int i;
+
+    for(i = 0; i < 3; i++) {
+        float e = s->e[i][0] * x + s->e[i][1] * y + s->e[i][2];
+
+        /* Top-left-ish fill rule, so shared edges aren't drawn twice */
+        if(e < 0.0f || (e == 0.0f && (s->e[i][0] < 0.0f ||
+                                      (s->e[i][0] == 0.0f && s->e[i][1] < 0.0f))))
+            return 0;
+    }
+
+    return 1;
+}
+
+static int depth_pass(int mode, float z, float old) {
+    switch(mode) {
+        case 0: return 0;
+        case 1: return z < old;
+        case 2: return z == old;
+        case 3: return z <= old;
+        case 4: return z > old;
+        case 5: return z != old;
+        case 6: return z >= old;
+        default: return 1;
+    }
+}
+
+/* Shade a pixel of a triangle: vertex color, texture, then offset. */
+static void shade(const tri_t *t, const setup_t *s, float x, float y,
+                  float *out) {
+    float a[10], iz = 1.0f, tc[4], col[4];
+    uint32_t texel;
+    int k, env = (t->tsp >> 6) & 3;
+
+    if(s->persp) {
+        iz = eval(&s->z, x, y);
+        iz = iz > 0.0f ? 1.0f / iz : 0.0f;
+    }
+
+    for(k = 0; k < 10; k++)
+        a[k] = eval(&s->attr[k], x, y) * iz;
+
+    for(k = 0; k < 4; k++)
+        col[k] = clamp01(a[2 + k]);
+
+    /* Without "use alpha", vertex alpha is taken as opaque. */
+    if(!(t->tsp & (1 << 20)))
+        col[0] = 1.0f;
+
+    if((t->pcw & 0x08) && use_textures) {
+        texel = sample(t, a[0], a[1]);
+        unpack_argb(texel, tc);
+
+        if(t->tsp & (1 << 19))
+            tc[0] = 1.0f;
+
+        switch(env) {
+            case 0:     /* Decal */
+                out[0] = tc[0];
+
+                for(k = 1; k < 4; k++)
+                    out[k] = tc[k];
+
+                break;
+            case 1:     /* Modulate */
+                out[0] = tc[0];
+
+                for(k = 1; k < 4; k++)
+                    out[k] = tc[k] * col[k];
+
+                break;
+            case 2:     /* Decal alpha */
+                out[0] = col[0];
+
+                for(k = 1; k < 4; k++)
+                    out[k] = tc[k] * tc[0] + col[k] * (1.0f - tc[0]);
+
+                break;
+            default:    /* Modulate alpha */
+                out[0] = tc[0] * col[0];
+
+                for(k = 1; k < 4; k++)
+                    out[k] = tc[k] * col[k];
+
+                break;
+        }
+    }
+    else {
+        memcpy(out, col, sizeof(col));
+    }
+
+    if(t->pcw & 0x04)
+        for(k = 1; k < 4; k++)
+            out[k] = clamp01(out[k] + clamp01(a[6 + k]));
+}
+
+static float blend_factor(int f, const float *src, const float *dst, int k,
+                          int is_src) {
+    const float *other = is_src ? dst : src;
+
+    switch(f) {
+        case 0: return 0.0f;
+        case 1: return 1.0f;
+        case 2: return other[k];
+        case 3: return 1.0f - other[k];
+        case 4: return src[0];
+        case 5: return 1.0f - src[0];
+        case 6: return dst[0];
+        default: return 1.0f - dst[0];
+    }
+}
+
+static void blend(const tri_t *t, const float *src, float *dst) {
+    int sf = t->tsp >> 29, df = (t->tsp >> 26) & 7;
+    float out[4];
+    int k;
+
+    for(k = 0; k < 4; k++)
+        out[k] = clamp01(src[k] * blend_factor(sf, src, dst, k, 1) +
+                         dst[k] * blend_factor(df, src, dst, k, 0));
+
+    memcpy(dst, out, sizeof(out));
+}
+
+typedef struct {
+    int pix;
+    float z;
+    int tri;
+} frag_t;
+
+static int frag_cmp(const void *a, const void *b) {
+    const frag_t *fa = a, *fb = b;
+
+    if(fa->pix != fb->pix)
+        return fa->pix - fb->pix;
+
+    /* Furthest (smallest 1/w) first, then in the order they were sent */
+    if(fa->z != fb->z)
+        return fa->z < fb->z ? -1 : 1;
+
+    return fa->tri - fb->tri;
+}
+
+static void render_tile(int tx, int ty) {
+    idxlist_t *bin = bins + ty * tw + tx;
+    tile_stats_t *ts = tstats + ty * tw + tx;
+    float depth[TILE * TILE], color[TILE * TILE][4], frag[4];
+    int owner[TILE * TILE];
+    setup_t *setups;
+    char *ok;
+    frag_t *frags = NULL;
+    size_t nfrags = 0, maxfrags = 0, i, j;
+    int px0 = tx * TILE, py0 = ty * TILE, x, y, x0, y0, x1, y1, p, pass, mode;
+    float bg[4], zclip = u2f(regs.zclip), z, fx, fy;
+    const tri_t *t;
+    int lists[3] = { L_OP, L_PT, L_TR };
+
+    unpack_argb(regs.bg_color | 0xff000000, bg);
+
+    for(p = 0; p < TILE * TILE; p++) {
+        depth[p] = zclip;
+        owner[p] = -1;
+        memcpy(color[p], bg, sizeof(bg));
+    }
+
+    setups = xrealloc(NULL, (bin->count ? bin->count : 1) * sizeof(setup_t));
+    ok = xrealloc(NULL, bin->count ? bin->count : 1);
+
+    for(i = 0; i < bin->count; i++) {
+        t = tris + bin->idx[i];
+        ok[i] = (t->list == L_OP || t->list == L_PT || t->list == L_TR) &&
+                setup_tri(t, setups + i);
+
+        if(ok[i])
+            ts->tris++;
+    }
+
+    for(pass = 0; pass < 3; pass++) {
+        for(i = 0; i < bin->count; i++) {
+            t = tris + bin->idx[i];
+
+            if(!ok[i] || t->list != lists[pass])
+                continue;
+
+            x0 = t->x0 > px0 ? t->x0 : px0;
+            y0 = t->y0 > py0 ? t->y0 : py0;
+            x1 = t->x1 < px0 + TILE - 1 ? t->x1 : px0 + TILE - 1;
+            y1 = t->y1 < py0 + TILE - 1 ? t->y1 : py0 + TILE - 1;
+            x1 = x1 < w - 1 ? x1 : w - 1;
+            y1 = y1 < h - 1 ? y1 : h - 1;
+            mode = t->isp >> 29;
+
+            for(y = y0; y <= y1; y++) {
+                for(x = x0; x <= x1; x++) {
+                    fx = x + 0.5f;
+                    fy = y + 0.5f;
+
+                    if(!inside(setups + i, fx, fy))
+                        continue;
+
+                    p = (y - py0) * TILE + (x - px0);
+                    z = eval(&setups[i].z, fx, fy);
+                    isp_map[y * w + x]++;
+                    ts->isp++;
+
+                    if(!depth_pass(mode, z, depth[p]))
+                        continue;
+
+                    if(pass == 0) {
+                        /* Opaque: just remember who's on top for now */
+                        owner[p] = (int)i;
+
+                        if(!(t->isp & (1 << 26)))
+                            depth[p] = z;
+                    }
+                    else if(pass == 1) {
+                        /* Punch-through needs the texel to decide */
+                        shade(t, setups + i, fx, fy, frag);
+                        tsp_map[y * w + x]++;
+                        ts->tsp++;
+
+                        if(frag[0] * 255.0f < (regs.pt_alpha_ref & 0xff))
+                            continue;
+
+                        owner[p] = -1;
+                        memcpy(color[p], frag, sizeof(frag));
+
+                        if(!(t->isp & (1 << 26)))
+                            depth[p] = z;
+                    }
+                    else if(regs.presort) {
+                        shade(t, setups + i, fx, fy, frag);
+                        tsp_map[y * w + x]++;
+                        ts->tsp++;
+                        blend(t, frag, color[p]);
+
+                        if(!(t->isp & (1 << 26)))
+                            depth[p] = z;
+                    }
+                    else {
+                        if(nfrags == maxfrags) {
+                            maxfrags = maxfrags ? maxfrags * 2 : 1024;
+                            frags = xrealloc(frags, maxfrags * sizeof(frag_t));
+                        }
+
+                        frags[nfrags].pix = p;
+                        frags[nfrags].z = z;
+                        frags[nfrags].tri = (int)i;
+                        nfrags++;
+                    }
+                }
+            }
+        }
+
+        if(pass == 0) {
+            /* Deferred shading: one TSP fragment per visible opaque pixel */
+            for(p = 0; p < TILE * TILE; p++) {
+                if(owner[p] < 0)
+                    continue;
+
+                x = px0 + p % TILE;
+                y = py0 + p / TILE;
+                t = tris + bin->idx[owner[p]];
+                shade(t, setups + owner[p], x + 0.5f, y + 0.5f, color[p]);
+                color[p][0] = 1.0f;
+                tsp_map[y * w + x]++;
+                ts->tsp++;
+            }
+        }
+    }
+
+    /* Autosorted translucency: back to front, pixel by pixel */
+    if(nfrags) {
+        qsort(frags, nfrags, sizeof(frag_t), frag_cmp);
+
+        for(j = 0; j < nfrags; j++) {
+            p = frags[j].pix;
+            x = px0 + p % TILE;
+            y = py0 + p / TILE;
+            t = tris + bin->idx[frags[j].tri];
+            shade(t, setups + frags[j].tri, x + 0.5f, y + 0.5f, frag);
+            blend(t, frag, color[p]);
+            tsp_map[y * w + x]++;
+            ts->tsp++;
+        }
+    }
+
+    for(p = 0; p < TILE * TILE; p++) {
+        x = px0 + p % TILE;
+        y = py0 + p / TILE;
+
+        if(x >= w || y >= h)
+            continue;
+
+        image[(y * w + x) * 3 + 0] = (uint8_t)(color[p][1] * 255.0f + 0.5f);
+        image[(y * w + x) * 3 + 1] = (uint8_t)(color[p][2] * 255.0f + 0.5f);
+        image[(y * w + x) * 3 + 2] = (uint8_t)(color[p][3] * 255.0f + 0.5f);
+    }
+
+    free(frags);
+    free(ok);
+    free(setups);
+}
+
+/**** Reporting **********************************************************/
+
+/* Bin blocks a tile needs for a list: each block holds one fewer pointer
+   than it has room for, as the last word links to the next block, and the
+   end of the list takes a word too. */
+static uint32_t bin_blocks(uint32_t objs, uint32_t bin_bytes) {
+    uint32_t per = bin_bytes / 4 - 1;
+
+    if(!per || objs <= per)
+        return 1;
+
+    return (objs + per - 1) / per;
+}
+
+static void report(const char *fn) {
+    uint32_t max_objs[LISTS] = { 0 }, over_tiles[LISTS] = { 0 };
+    uint64_t over_bytes[LISTS] = { 0 }, total_objs[LISTS] = { 0 };
+    uint64_t over_total = 0, avail, isp_sum = 0, tsp_sum = 0;
+    uint32_t isp_hist[HIST + 1] = { 0 }, tsp_hist[HIST + 1] = { 0 };
+    uint32_t isp_max = 0, tsp_max = 0, blocks, tiles = tw * th;
+    int i, l, worst[5] = { -1, -1, -1, -1, -1 }, k;
+
+    for(i = 0; i < (int)tiles; i++) {
+        for(l = 0; l < LISTS; l++) {
+            uint32_t o = tstats[i].objs[l];
+
+            total_objs[l] += o;
+
+            if(o > max_objs[l])
+                max_objs[l] = o;
+
+            if(!regs.opb_size[l])
+                continue;
+
+            blocks = bin_blocks(o, regs.opb_size[l]);
+
+            if(blocks > 1) {
+                over_tiles[l]++;
+                over_bytes[l] += (uint64_t)(blocks - 1) * regs.opb_size[l];
+                tstats[i].blocks += blocks - 1;
+            }
+        }
+
+        /* Keep the five busiest tiles */
+        for(k = 0; k < 5; k++) {
+            if(worst[k] < 0 || tstats[i].tris > tstats[worst[k]].tris) {
+                memmove(worst + k + 1, worst + k, (4 - k) * sizeof(int));
+                worst[k] = i;
+                break;
+            }
+        }
+    }
+
+    for(i = 0; i < w * h; i++) {
+        isp_sum += isp_map[i];
+        tsp_sum += tsp_map[i];
+        isp_max = isp_map[i] > isp_max ? isp_map[i] : isp_max;
+        tsp_max = tsp_map[i] > tsp_max ? tsp_map[i] : tsp_max;
+        isp_hist[isp_map[i] > HIST ? HIST : isp_map[i]]++;
+        tsp_hist[tsp_map[i] > HIST ? HIST : tsp_map[i]]++;
+    }
+
+    printf("%s: %ux%u, %ux%u tiles, %s, %s%s%s\n", fn, regs.width,
+           regs.height, regs.tiles_x, regs.tiles_y,
+           regs.dma_mode ? "vertex DMA" : "direct",
+           regs.presort ? "presort" : "autosort",
+           regs.to_texture ? ", to texture" : "",
+           (file_flags & 1) ? ", TRUNCATED" : "");
+
+    printf("\nlist    bytes  hdrs  prims   tris   objs  max/tile  bin  "
+           "over tiles  over bytes\n");
+
+    for(l = 0; l < LISTS; l++) {
+        if(!(regs.lists_enabled & (1 << l)) && !list_words[l])
+            continue;
+
+        printf("%-4s %8zu %5u %6u %6u %6u %9u %4u %11u %11llu\n",
+               list_names[l], list_words[l] * 4, st_hdrs[l], st_strips[l],
+               st_tris[l], st_objs[l], max_objs[l], regs.opb_size[l],
+               over_tiles[l], (unsigned long long)over_bytes[l]);
+        over_total += over_bytes[l];
+    }
+
+    avail = 0;
+
+    for(l = 0; l < LISTS; l++)
+        avail += (uint64_t)regs.opb_size[l] * tiles;
+
+    avail *= regs.opb_overflow_count;
+
+    printf("\nbin overflow: %llu of %llu bytes (%u sets)%s\n",
+           (unsigned long long)over_total, (unsigned long long)avail,
+           regs.opb_overflow_count,
+           over_total > avail ? " - TA WOULD RUN OUT, geometry goes missing" :
+           "");
+
+    printf("\nISP overdraw: %.2f per pixel, %u at most\n",
+           (double)isp_sum / (w * h), isp_max);
+    printf("TSP overdraw: %.2f per pixel, %u at most\n",
+           (double)tsp_sum / (w * h), tsp_max);
+
+    printf("\n depth   ISP pixels   TSP pixels\n");
+
+    for(i = 0; i <= HIST; i++) {
+        if(!isp_hist[i] && !tsp_hist[i])
+            continue;
+
+        printf("%5d%s %12u %12u\n", i, i == HIST ? "+" : " ", isp_hist[i],
+               tsp_hist[i]);
+    }
+
+    printf("\nbusiest tiles:\n");
+
+    for(k = 0; k < 5 && worst[k] >= 0; k++) {
+        tile_stats_t *ts = tstats + worst[k];
+
+        printf("  (%2d,%2d) %6u tris, objs OP %u OM %u TR %u TM %u PT %u, "
+               "ISP %.2f TSP %.2f\n", worst[k] % tw, worst[k] / tw,
+               ts->tris, ts->objs[0], ts->objs[1], ts->objs[2], ts->objs[3],
+               ts->objs[4], ts->isp / (double)(TILE * TILE),
+               ts->tsp / (double)(TILE * TILE));
+    }
+}
+
+static int write_ppm(const char *fn, const uint8_t *rgb) {
+    FILE *f = fopen(fn, "wb");
+
+    if(!f) {
+        perror(fn);
+        return -1;
+    }
+
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    fwrite(rgb, 3, w * h, f);
+    fclose(f);
+
+    return 0;
+}
+
+/* Black for nothing, then blue, green, yellow and red as it gets worse */
+static int write_heatmap(const char *fn) {
+    static const uint8_t ramp[6][3] = {
+        { 0, 0, 0 }, { 0, 0, 160 }, { 0, 160, 0 }, { 220, 220, 0 },
+        { 255, 128, 0 }, { 255, 0, 0 }
+    };
+    uint8_t *rgb = xrealloc(NULL, w * h * 3);
+    int i, c, rv;
+
+    for(i = 0; i < w * h; i++) {
+        c = isp_map[i] > 5 ? 5 : isp_map[i];
+        memcpy(rgb + i * 3, ramp[c], 3);
+
+        /* Brighten anything beyond the end of the ramp */
+        if(isp_map[i] > 5)
+            rgb[i * 3 + 1] = rgb[i * 3 + 2] =
+                (uint8_t)(isp_map[i] >= 15 ? 255 : (isp_map[i] - 5) * 25);
+    }
+
+    rv = write_ppm(fn, rgb);
+    free(rgb);
+
+    return rv;
+}
+
+static int write_tiles(const char *fn) {
+    FILE *f = fopen(fn, "w");
+    int i;
+
+    if(!f) {
+        perror(fn);
+        return -1;
+    }
+
+    fprintf(f, "x,y,op_objs,om_objs,tr_objs,tm_objs,pt_objs,tris,"
+            "overflow_blocks,isp,tsp\n");
+
+    for(i = 0; i < tw * th; i++) {
+        tile_stats_t *ts = tstats + i;
+
+        fprintf(f, "%d,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", i % tw, i / tw,
+                ts->objs[0], ts->objs[1], ts->objs[2], ts->objs[3],
+                ts->objs[4], ts->tris, ts->blocks, ts->isp, ts->tsp);
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: pvrcap [options] <capture file>\n"
+            "\n"
+            "Renders a frame recorded with pvr_capture_frame() on the CPU, and\n"
+            "reports tile bin use and overdraw.\n"
+            "\n"
+            "  -o <file.ppm>   Write the rendered frame\n"
+            "  -d <file.ppm>   Write an ISP overdraw heatmap\n"
+            "  -t <file.csv>   Write per-tile counts\n"
+            "  -n              Don't sample textures\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_img = NULL, *out_heat = NULL, *out_tiles = NULL;
+    const char *fn = NULL;
+    int i, l, x, y;
+
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_img = argv[++i];
+        else if(!strcmp(argv[i], "-d") && i + 1 < argc)
+            out_heat = argv[++i];
+        else if(!strcmp(argv[i], "-t") && i + 1 < argc)
+            out_tiles = argv[++i];
+        else if(!strcmp(argv[i], "-n"))
+            use_textures = 0;
+        else if(argv[i][0] != '-' && !fn)
+            fn = argv[i];
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if(!fn) {
+        usage();
+        return 1;
+    }
+
+    if(load(fn))
+        return 1;
+
+    w = regs.width;
+    h = regs.height;
+    tw = regs.tiles_x;
+    th = regs.tiles_y;
+
+    /* The tile grid covers the screen, even if it's a bit bigger */
+    if(tw * TILE < w)
+        w = tw * TILE;
+
+    if(th * TILE < h)
+        h = th * TILE;
+
+    for(l = 0; l < LISTS; l++)
+        parse_list(l);
+
+    bins = calloc(tw * th, sizeof(idxlist_t));
+    tstats = calloc(tw * th, sizeof(tile_stats_t));
+    image = calloc(w * h, 3);
+    isp_map = calloc(w * h, sizeof(uint16_t));
+    tsp_map = calloc(w * h, sizeof(uint16_t));
+
+    if(!bins || !tstats || !image || !isp_map || !tsp_map) {
+        fprintf(stderr, "pvrcap: out of memory\n");
+        return 1;
+    }
+
+    bin_tris();
+
+    for(y = 0; y < th; y++)
+        for(x = 0; x < tw; x++)
+            render_tile(x, y);
+
+    report(fn);
+
+    if(out_img)
+        write_ppm(out_img, image);
+
+    if(out_heat)
+        write_heatmap(out_heat);
+
+    if(out_tiles)
+        write_tiles(out_tiles);
+
+    return 0;
+}